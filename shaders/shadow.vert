@@ -60,6 +60,11 @@ layout ( push_constant ) uniform PushConstants {
 
 struct ObjectData{
 	mat4 model;
+	vec4 sphereBounds;
+	uint batch;
+	uint indexCount;
+	uint firstIndex;
+	int vertexOffset;
 };
 
 //all object matrices
@@ -34,6 +34,11 @@ layout(set = 0, binding = 1) uniform SceneData{
 
 struct ObjectData{
 	mat4 model;
+	vec4 sphereBounds;
+	uint batch;
+	uint indexCount;
+	uint firstIndex;
+	int vertexOffset;
 };
 
 //all object matrices
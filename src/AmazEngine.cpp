@@ -11,7 +11,9 @@
 #include <functional>
 #include "renderer/Renderer.h"
 #include "input/Input.h"
+#include "input/InputTrace.h"
 #include "physics/Physics.h"
+#include "scene/terrain.hpp"
 #include "glm/glm.hpp"
 #include <variant>
 #include <random>
@@ -53,8 +55,10 @@ int main(int argc, char* argv[]) {
 	Renderer renderer(1600, 900);
 
 	amaz::Physics physics;
+	physics.setCollisionCache(ASSETS_PATH + "cooked/");
 
 	loadScene("test", renderer, physics);
+	physics.bakeCollision();
 
 	// {
 	// 	std::random_device dev;
@@ -79,6 +83,13 @@ int main(int argc, char* argv[]) {
 	Input inputs;
 	glm::vec3 lastFramePos;
 
+	// --record-trace <file> saves the input of every tick on exit, PhysicsBench trace replays it headless
+	string tracePath;
+	for (int i = 1; i + 1 < argc; i++) {
+		if (string(argv[i]) == "--record-trace") tracePath = argv[i + 1];
+	}
+	InputTrace trace(SIM_RATE, inputs.camPos);
+
 	float fps;
 	int frametime = 0;
 
@@ -93,6 +104,9 @@ int main(int argc, char* argv[]) {
 		while (time > nextFrame) {
 			//FrameMarkNamed(main_thread_name.c_str());
 			lastFramePos = inputs.camPos;
+			if (!tracePath.empty()) {
+				trace.record(inputs);
+			}
 			physics.stepLogic(inputs, 1.f/SIM_RATE);
 			nextFrame += frames<SIM_RATE>{ 1 };
 
@@ -142,6 +156,10 @@ int main(int argc, char* argv[]) {
 
 	}
 
+	if (!tracePath.empty()) {
+		trace.save(tracePath);
+	}
+
 	return 0;
 }
 
@@ -248,6 +266,11 @@ void loadScene(string name, Renderer& renderer, amaz::Physics& physics) {
 			}
 		}
 
+		// a 16 bit raw heightmap collided with as a heightfield, there's no terrain rendering yet
+		if (scene.contains("terrain")) {
+			amaz::loadTerrain(scene["terrain"], ASSETS_PATH, physics);
+		}
+
 		if (scene.contains("lights")) {
 			auto lights = scene["lights"];
 
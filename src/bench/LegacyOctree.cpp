@@ -0,0 +1,112 @@
+#include "LegacyOctree.h"
+
+#include <iterator>
+
+constexpr int LEGACY_MAX_OCTREE_ELEMENTS = 8;
+
+namespace amaz::bench {
+
+	std::shared_ptr<LegacyOctree> LegacyOctree::create(AABB aabb) {
+		return std::shared_ptr<LegacyOctree>(new LegacyOctree(aabb));
+	}
+
+	LegacyOctree::LegacyOctree(AABB aabb) {
+		nodes.emplace_back(aabb);
+	}
+
+	void LegacyOctree::addElement(size_t nodeId, size_t tri) {
+		LegacyOcNode& node = nodes[nodeId];
+
+		node.elements.push_back(tri);
+		if (node.children || (node.elements.size() > LEGACY_MAX_OCTREE_ELEMENTS && getArea(nodeId) > 1.f)) {
+			node.dirty = true;
+		}
+	}
+
+	float LegacyOctree::getArea(size_t id) {
+		return amaz::calcArea(nodes[id].aabb);
+	}
+
+	std::deque<size_t> LegacyOctree::getElements(AABB aabb, size_t& count) {
+		return getElements(0, aabb, count);
+	}
+
+	std::deque<size_t> LegacyOctree::getElements(size_t nodeId, AABB aabb, size_t& count) {
+		std::deque<size_t> output;
+
+		std::vector<size_t> nodeIds;
+		nodeIds.push_back(nodeId);
+
+		while (!nodeIds.empty()) {
+			count++;
+			nodeId = nodeIds.back();
+			nodeIds.pop_back();
+			if (!amaz::AABBvsAABB(aabb, nodes[nodeId].aabb)) continue;
+			if (nodes[nodeId].dirty) {
+				if (!nodes[nodeId].children) {
+					genChildren(nodeId);
+				}
+				moveElementsToChildren(nodeId);
+				nodes[nodeId].dirty = false;
+			}
+
+			if (nodes[nodeId].children) {
+				for (size_t i = nodes[nodeId].children; i < nodes[nodeId].children + 8; i++) {
+					nodeIds.push_back(i);
+				}
+			} else {
+				std::copy(nodes[nodeId].elements.begin(), nodes[nodeId].elements.end(), std::back_inserter(output));
+			}
+		}
+
+		return output;
+	}
+
+	void LegacyOctree::genChildren(size_t nodeId) {
+		nodes[nodeId].children = nodes.size();
+
+		glm::vec3 midPoint = (nodes[nodeId].aabb.a + nodes[nodeId].aabb.b) / 2.f;
+
+		for (int i = 0; i < 8; i++) {
+			float x = i > 3 ? nodes[nodeId].aabb.a.x : nodes[nodeId].aabb.b.x;
+			float y = i % 4 > 1 ? nodes[nodeId].aabb.a.y : nodes[nodeId].aabb.b.y;
+			float z = (i % 2) ? nodes[nodeId].aabb.a.z : nodes[nodeId].aabb.b.z;
+			nodes.emplace_back(AABB{ midPoint, {x, y, z} });
+		}
+	}
+
+	void LegacyOctree::moveElementsToChildren(size_t nodeId) {
+		for (auto tri : nodes[nodeId].elements) {
+			AABB triAABB = amaz::getAABBFromTriangle(tri);
+			for (size_t i = nodes[nodeId].children; i < nodes[nodeId].children + 8; i++) {
+				auto& child = nodes[i];
+				if (amaz::AABBvsAABB(triAABB, child.aabb)) {
+					child.elements.push_back(tri);
+					if (child.children || getArea(i) > 1.f)
+						child.dirty = true;
+				}
+			}
+		}
+		nodes[nodeId].elements.clear();
+	}
+
+	void LegacyOctree::genAll() {
+		std::vector<size_t> nodeIds;
+		nodeIds.push_back(0);
+
+		while (!nodeIds.empty()) {
+			size_t nodeId = nodeIds.back();
+			nodeIds.pop_back();
+			if (nodes[nodeId].dirty) {
+				if (!nodes[nodeId].children) {
+					genChildren(nodeId);
+				}
+				moveElementsToChildren(nodeId);
+				nodes[nodeId].dirty = false;
+				for (size_t i = nodes[nodeId].children; i < nodes[nodeId].children + 8; i++) {
+					nodeIds.push_back(i);
+				}
+			}
+		}
+	}
+}
@@ -0,0 +1,52 @@
+#pragma once
+
+#include "../physics/Objects.h"
+#include "../physics/Collision.h"
+#include <vector>
+#include <deque>
+#include <memory>
+
+// The octree as it was before the baked linear layout (deque per node, lazy splitting),
+// only kept around so PhysicsBench has something to compare against.
+namespace amaz::bench {
+
+	struct LegacyOcNode;
+
+	class LegacyOctree {
+	public:
+		[[nodiscard]] static std::shared_ptr<LegacyOctree> create(AABB maxSize);
+
+		void addElement(size_t nodeId, size_t tri);
+		void addElement(size_t tri) {
+			addElement(0, tri);
+		}
+
+		float getArea(size_t id);
+
+		std::deque<size_t> getElements(size_t nodeId, AABB aabb, size_t& count);
+		std::deque<size_t> getElements(AABB aabb, size_t& count);
+
+		void genChildren(size_t nodeId);
+		void moveElementsToChildren(size_t nodeId);
+
+		void genAll();
+
+		size_t nodeCount() const {
+			return nodes.size();
+		}
+
+	private:
+		LegacyOctree(AABB aabb);
+		std::vector<LegacyOcNode> nodes;
+	};
+
+	struct LegacyOcNode {
+		LegacyOcNode(AABB aabb) {
+			this->aabb = aabb;
+		}
+		AABB aabb;
+		size_t children = 0;
+		std::deque<size_t> elements;
+		bool dirty = false;
+	};
+}
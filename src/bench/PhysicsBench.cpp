@@ -0,0 +1,1128 @@
+// PhysicsBench.cpp : Headless benchmarks for the collision code, loads a scene without creating a Renderer.
+//
+#include <chrono>
+#include <iostream>
+#include <fstream>
+#include <random>
+#include <string>
+#include <vector>
+#include <algorithm>
+#include <numeric>
+#include <limits>
+#include <thread>
+#include <atomic>
+#include <filesystem>
+#include <numbers>
+#include <nlohmann/json.hpp>
+#include "../physics/Physics.h"
+#include "../physics/Octree.h"
+#include "../physics/BVH.h"
+#include "../physics/LooseOctree.h"
+#include "../physics/Raycast.h"
+#include "../physics/SweepAndPrune.h"
+#include "../physics/PhysicsState.h"
+#include "../physics/CollisionCache.h"
+#include "../physics/ConvexCollision.h"
+#include "../input/InputTrace.h"
+#include "../scene/terrain.hpp"
+#include "../util/thread_pool.hpp"
+#include <cstring>
+#include "LegacyOctree.h"
+
+using json = nlohmann::json;
+using std::string;
+using Clock = std::chrono::high_resolution_clock;
+
+const string ASSETS_PATH = "../assets/";
+
+constexpr size_t QUERY_COUNT = 100000;
+constexpr size_t STRESS_QUERY_COUNT = 10000;
+constexpr size_t STRESS_ROUNDS = 4;
+constexpr size_t RAY_COUNT = 100000;
+constexpr float RAY_LENGTH = 50.f;
+constexpr size_t PROP_COUNT = 1000;
+constexpr size_t PROP_STEPS = 100;
+constexpr size_t ROLLBACK_TICKS = 8;
+constexpr size_t ROLLBACK_HISTORY = 64;
+constexpr size_t ROLLBACK_BODIES = amaz::MAX_ROLLBACK_BODIES;
+constexpr size_t ROLLBACK_STEPS = 600;
+constexpr size_t ROLLBACK_CHARACTERS = amaz::MAX_ROLLBACK_CHARACTERS;
+// what MAX_ROLLBACK_BODIES is sized for, a rollback has to fit in a frame
+constexpr double ROLLBACK_BUDGET_MS = 16.0;
+constexpr size_t CACHE_RAY_COUNT = 10000;
+constexpr float TICK_SECONDS = 1.f / 60.f;
+// 20 seconds of the scripted walk when no trace file is given
+constexpr size_t SCRIPTED_TRACE_TICKS = 1200;
+constexpr size_t CROWD_CHARACTERS = 5000;
+constexpr size_t CROWD_STEPS = 300;
+// units a second, a walk rather than the player's run
+constexpr float CROWD_SPEED = 4.f;
+// samples along each side of the generated terrain, one unit apart
+constexpr uint32_t TERRAIN_SIZE = 513;
+constexpr size_t TERRAIN_RAYS = 100000;
+constexpr size_t TERRAIN_CHARACTERS = 1000;
+// the rock mesh is ROCK_RINGS * ROCK_SEGMENTS * 2 triangles
+constexpr uint32_t ROCK_RINGS = 96;
+constexpr uint32_t ROCK_SEGMENTS = 96;
+constexpr size_t HULL_PAIRS = 100000;
+constexpr size_t HULL_BODIES = 300;
+constexpr size_t HULL_STEPS = 300;
+constexpr size_t MOVER_COUNT = 10000;
+constexpr size_t MOVER_STEPS = 300;
+// per step, about 3 units a second at 60hz
+constexpr float MOVER_SPEED = 0.05f;
+const AABB MOVER_BOUNDS = { { -100.f, -20.f, -100.f }, { 100.f, 20.f, 100.f } };
+const AABB OCTREE_BOUNDS = { { -65536.f, -65536.f, -65536.f }, { 65536.f, 65536.f, 65536.f } };
+
+double msSince(Clock::time_point start) {
+	return std::chrono::duration<double, std::milli>(Clock::now() - start).count();
+}
+
+// Only loads the collision meshes of a scene, see loadScene in AmazEngine.cpp for the full format
+bool loadCollisionScene(string name, amaz::Physics& physics) {
+	string path = ASSETS_PATH + name + ".json";
+	std::ifstream f(path);
+	if (!f) {
+		std::cout << "Unable to open scene: " << path << "\n";
+		return false;
+	}
+
+	json data = json::parse(f);
+	if (!data.contains("scene")) {
+		return true;
+	}
+
+	if (data["scene"].contains("meshes")) {
+		for (auto& mesh : data["scene"]["meshes"]) {
+			if (!mesh.contains("name") || !mesh.contains("collisonMesh")) continue;
+
+			glm::vec3 offset = { 0.f, 0.f, 0.f };
+			glm::vec3 rotate = { 0.f, 0.f, 0.f };
+			float scale = 1.f;
+
+			if (mesh.contains("offset")) {
+				offset = { mesh["offset"][0].get<float>(), mesh["offset"][1].get<float>(), mesh["offset"][2].get<float>() };
+			}
+			if (mesh.contains("scale")) {
+				scale = mesh["scale"].get<float>();
+			}
+			if (mesh.contains("rotate")) {
+				rotate = { mesh["rotate"][0].get<float>(), mesh["rotate"][1].get<float>(), mesh["rotate"][2].get<float>() };
+			}
+
+			physics.loadMesh(mesh["name"].get<string>(), ASSETS_PATH + mesh["collisonMesh"].get<string>(), offset, scale, rotate);
+		}
+	}
+
+	if (data["scene"].contains("terrain") && !amaz::loadTerrain(data["scene"]["terrain"], ASSETS_PATH, physics)) {
+		return false;
+	}
+
+	return true;
+}
+
+// World space copy of every instance's triangles, for the benchmarks that build their own broadphase over a flat triangle soup
+std::vector<uint32_t> flattenScene(const amaz::Physics& physics) {
+	const amaz::CollisionScene& scene = physics.getCollisionScene();
+	std::vector<uint32_t> tris;
+	tris.reserve(scene.placedTriangleCount());
+	amaz::reserveTris(amaz::trisCount() + scene.placedTriangleCount());
+	for (uint32_t id = 0; id < scene.instanceCount(); id++) {
+		const amaz::CollisionInstance& instance = scene.instance(id);
+		const amaz::CollisionMesh& mesh = scene.mesh(instance.mesh);
+		for (uint32_t tri = mesh.firstTri; tri < mesh.firstTri + mesh.triCount; tri++) {
+			tris.push_back(static_cast<uint32_t>(amaz::registerTri(instance.triangleToWorld(amaz::getTriFromId(tri)))));
+		}
+	}
+	return tris;
+}
+
+AABB sceneBounds(const std::vector<uint32_t>& tris) {
+	AABB bounds = { glm::vec3(std::numeric_limits<float>::max()), glm::vec3(std::numeric_limits<float>::lowest()) };
+	for (uint32_t i : tris) {
+		AABB tri = amaz::getAABBFromTriangle(i);
+		bounds.a = glm::min(bounds.a, tri.a);
+		bounds.b = glm::max(bounds.b, tri.b);
+	}
+	return bounds;
+}
+
+// Player sized boxes scattered over the scene, seeded so runs are comparable
+std::vector<AABB> generateQueries(AABB bounds, size_t count) {
+	std::mt19937 rng(1234);
+	std::uniform_real_distribution<float> x(bounds.a.x, bounds.b.x);
+	std::uniform_real_distribution<float> y(bounds.a.y, bounds.b.y);
+	std::uniform_real_distribution<float> z(bounds.a.z, bounds.b.z);
+
+	glm::vec3 halfSize = { 0.4f, 1.2f, 0.4f };
+
+	std::vector<AABB> queries;
+	queries.reserve(count);
+	for (size_t i = 0; i < count; i++) {
+		glm::vec3 center = { x(rng), y(rng), z(rng) };
+		queries.push_back({ center - halfSize, center + halfSize });
+	}
+	return queries;
+}
+
+// Counts triangles overlapping the queries that a broadphase failed to return, and how many it returned more than once
+template <typename Tree>
+void checkQueries(string name, Tree& tree, const std::vector<AABB>& queries, const std::vector<uint32_t>& tris) {
+	size_t missed = 0;
+	size_t duplicates = 0;
+	size_t count = 0;
+	size_t checked = std::min<size_t>(queries.size(), 1000);
+
+	for (size_t q = 0; q < checked; q++) {
+		auto result = tree.getElements(queries[q], count);
+		std::vector<size_t> found(result.begin(), result.end());
+		std::sort(found.begin(), found.end());
+		duplicates += found.size() - (std::unique(found.begin(), found.end()) - found.begin());
+
+		for (uint32_t i : tris) {
+			if (amaz::AABBvsAABB(amaz::getAABBFromTriangle(i), queries[q]) && !std::binary_search(found.begin(), found.end(), i))
+				missed++;
+		}
+	}
+
+	std::cout << name << ": missed " << missed << " overlapping triangles and returned " << duplicates << " duplicates in " << checked << " queries\n";
+}
+
+template <typename Tree>
+void runQueries(string name, Tree& tree, const std::vector<AABB>& queries) {
+	size_t nodesVisited = 0;
+	size_t candidates = 0;
+	auto start = Clock::now();
+	for (auto& query : queries) {
+		candidates += tree.getElements(query, nodesVisited).size();
+	}
+	double time = msSince(start);
+
+	std::cout << name << ": " << time << "ms for " << queries.size() << " queries (" << (time * 1000000.0 / queries.size()) << "ns each), "
+		<< (double)nodesVisited / queries.size() << " nodes visited, " << (double)candidates / queries.size() << " candidates per query\n";
+}
+
+// Same queries through the allocation free query API, which also deduplicates
+void runBroadphaseQueries(string name, amaz::Broadphase& broadphase, const std::vector<AABB>& queries) {
+	amaz::BroadphaseQuery query;
+	std::vector<uint32_t> out;
+	size_t nodesVisited = 0;
+	size_t candidates = 0;
+	size_t capacity = 0;
+	size_t allocations = 0;
+
+	auto start = Clock::now();
+	for (auto& aabb : queries) {
+		broadphase.query(aabb, query, out);
+		nodesVisited += query.stats.nodesVisited;
+		candidates += query.stats.trianglesEmitted;
+		if (out.capacity() != capacity) {
+			capacity = out.capacity();
+			allocations++;
+		}
+	}
+	double time = msSince(start);
+
+	std::cout << name << " query(): " << time << "ms for " << queries.size() << " queries (" << (time * 1000000.0 / queries.size()) << "ns each), "
+		<< (double)nodesVisited / queries.size() << " nodes visited, " << (double)candidates / queries.size() << " candidates per query, "
+		<< allocations << " output reallocations\n";
+}
+
+void benchOctree(const std::vector<uint32_t>& tris) {
+	std::vector<AABB> queries = generateQueries(sceneBounds(tris), QUERY_COUNT);
+
+	auto start = Clock::now();
+	auto legacy = amaz::bench::LegacyOctree::create(OCTREE_BOUNDS);
+	for (uint32_t tri : tris) {
+		legacy->addElement(tri);
+	}
+	legacy->genAll();
+	std::cout << "legacy octree build: " << msSince(start) << "ms, " << legacy->nodeCount() << " nodes\n";
+
+	start = Clock::now();
+	auto octree = amaz::Octree::create(OCTREE_BOUNDS);
+	for (uint32_t tri : tris) {
+		octree->addElement(tri);
+	}
+	octree->bake();
+	std::cout << "linear octree build: " << msSince(start) << "ms, " << octree->nodeCount() << " nodes, " << octree->elementCount() << " element refs\n";
+
+	runQueries("legacy octree", *legacy, queries);
+	runQueries("linear octree", *octree, queries);
+	runBroadphaseQueries("linear octree", *octree, queries);
+
+	checkQueries("linear octree", *octree, queries, tris);
+}
+
+void benchBVH(const std::vector<uint32_t>& tris) {
+	std::vector<AABB> queries = generateQueries(sceneBounds(tris), QUERY_COUNT);
+
+	auto start = Clock::now();
+	auto octree = amaz::Octree::create(OCTREE_BOUNDS);
+	for (uint32_t tri : tris) {
+		octree->addElement(tri);
+	}
+	octree->bake();
+	std::cout << "octree build: " << msSince(start) << "ms, " << octree->nodeCount() << " nodes, " << octree->elementCount() << " element refs\n";
+
+	start = Clock::now();
+	auto bvh = amaz::BVH::create();
+	for (uint32_t tri : tris) {
+		bvh->addElement(tri);
+	}
+	bvh->bake();
+	std::cout << "bvh build: " << msSince(start) << "ms, " << bvh->nodeCount() << " nodes, " << bvh->elementCount() << " element refs\n";
+
+	runQueries("octree", *octree, queries);
+	runQueries("bvh", *bvh, queries);
+	runBroadphaseQueries("octree", *octree, queries);
+	runBroadphaseQueries("bvh", *bvh, queries);
+
+	checkQueries("octree", *octree, queries, tris);
+	checkQueries("bvh", *bvh, queries, tris);
+}
+
+// Streams half the scene out and back in and moves props around a loose octree that is never rebuilt
+void benchLooseOctree(const std::vector<uint32_t>& tris) {
+	AABB bounds = sceneBounds(tris);
+	std::vector<AABB> queries = generateQueries(bounds, QUERY_COUNT);
+
+	auto start = Clock::now();
+	auto octree = amaz::Octree::create(OCTREE_BOUNDS);
+	for (uint32_t tri : tris) {
+		octree->addElement(tri);
+	}
+	octree->bake();
+	std::cout << "octree build: " << msSince(start) << "ms, " << octree->nodeCount() << " nodes, " << octree->elementCount() << " element refs\n";
+
+	start = Clock::now();
+	auto loose = amaz::LooseOctree::create();
+	for (uint32_t tri : tris) {
+		loose->addElement(tri);
+	}
+	std::cout << "loose octree build: " << msSince(start) << "ms, " << loose->nodeCount() << " nodes, " << loose->elementCount() << " elements\n";
+
+	runQueries("octree", *octree, queries);
+	runQueries("loose octree", *loose, queries);
+	runBroadphaseQueries("octree", *octree, queries);
+	runBroadphaseQueries("loose octree", *loose, queries);
+	checkQueries("loose octree", *loose, queries, tris);
+
+	// unload and reload everything on one side of the scene like a streamed level section
+	float middle = (bounds.a.x + bounds.b.x) / 2.f;
+	std::vector<uint32_t> section;
+	for (uint32_t tri : tris) {
+		if (amaz::getAABBFromTriangle(tri).a.x > middle) section.push_back(tri);
+	}
+	start = Clock::now();
+	for (uint32_t tri : section) {
+		loose->remove(tri);
+	}
+	loose->bake();
+	double unloadTime = msSince(start);
+	size_t unloadedNodes = loose->nodeCount();
+	start = Clock::now();
+	for (uint32_t tri : section) {
+		loose->addElement(tri);
+	}
+	std::cout << "loose octree: streamed " << section.size() << " triangles out in " << unloadTime << "ms (" << unloadedNodes << " nodes left) and back in "
+		<< msSince(start) << "ms\n";
+	checkQueries("loose octree after streaming", *loose, queries, tris);
+
+	// props get ids past the triangles, only some of them leave their node each step
+	size_t triCount = amaz::trisCount();
+	std::mt19937 rng(77);
+	std::uniform_real_distribution<float> x(bounds.a.x, bounds.b.x);
+	std::uniform_real_distribution<float> y(bounds.a.y, bounds.b.y);
+	std::uniform_real_distribution<float> z(bounds.a.z, bounds.b.z);
+	std::uniform_real_distribution<float> speed(-0.1f, 0.1f);
+	std::vector<AABB> props(PROP_COUNT);
+	std::vector<glm::vec3> velocities(PROP_COUNT);
+	for (size_t i = 0; i < PROP_COUNT; i++) {
+		glm::vec3 center = { x(rng), y(rng), z(rng) };
+		props[i] = { center - glm::vec3(0.5f), center + glm::vec3(0.5f) };
+		velocities[i] = { speed(rng), speed(rng), speed(rng) };
+		loose->insert(static_cast<uint32_t>(triCount + i), props[i]);
+	}
+	start = Clock::now();
+	for (size_t step = 0; step < PROP_STEPS; step++) {
+		for (size_t i = 0; i < PROP_COUNT; i++) {
+			props[i].a += velocities[i];
+			props[i].b += velocities[i];
+			loose->update(static_cast<uint32_t>(triCount + i), props[i]);
+		}
+	}
+	double time = msSince(start);
+	std::cout << "loose octree: " << (time * 1000000.0 / (PROP_STEPS * PROP_COUNT)) << "ns per prop update\n";
+}
+
+// Many threads querying one baked broadphase at once, every result is compared against a single threaded run
+void stressQueries(string name, const amaz::Broadphase& broadphase, const std::vector<AABB>& queries) {
+	std::vector<std::vector<uint32_t>> expected(queries.size());
+	amaz::BroadphaseQuery query;
+	for (size_t i = 0; i < queries.size(); i++) {
+		broadphase.query(queries[i], query, expected[i]);
+		std::sort(expected[i].begin(), expected[i].end());
+	}
+
+	size_t threadCount = std::max(4u, std::thread::hardware_concurrency());
+	std::atomic<size_t> mismatches = 0;
+	std::vector<std::thread> threads;
+
+	auto start = Clock::now();
+	for (size_t t = 0; t < threadCount; t++) {
+		threads.emplace_back([&, t]() {
+			amaz::BroadphaseQuery query;
+			std::vector<uint32_t> out;
+			// every thread starts somewhere else so they overlap on different parts of the tree
+			for (size_t n = 0; n < queries.size() * STRESS_ROUNDS; n++) {
+				size_t i = (n + t * queries.size() / threadCount) % queries.size();
+				broadphase.query(queries[i], query, out);
+				std::sort(out.begin(), out.end());
+				if (out != expected[i]) {
+					mismatches++;
+				}
+			}
+		});
+	}
+	for (auto& thread : threads) {
+		thread.join();
+	}
+	double time = msSince(start);
+
+	std::cout << name << " stress: " << threadCount << " threads ran " << threadCount * queries.size() * STRESS_ROUNDS << " queries in "
+		<< time << "ms, " << mismatches << " results differed from the single threaded run\n";
+}
+
+void benchStress(const std::vector<uint32_t>& tris) {
+	std::vector<AABB> queries = generateQueries(sceneBounds(tris), STRESS_QUERY_COUNT);
+
+	for (auto [name, type] : { std::pair{ "octree", amaz::BroadphaseType::Octree }, std::pair{ "bvh", amaz::BroadphaseType::BVH },
+		std::pair{ "loose octree", amaz::BroadphaseType::LooseOctree } }) {
+		auto broadphase = amaz::createBroadphase(type);
+		for (uint32_t tri : tris) {
+			broadphase->addElement(tri);
+		}
+		broadphase->bake();
+		stressQueries(name, *broadphase, queries);
+	}
+}
+
+// Rays from random points in the scene, every 8 share an origin like a burst of visibility checks from one NPC
+std::vector<Ray> generateRays(AABB bounds, size_t count) {
+	std::mt19937 rng(4321);
+	std::uniform_real_distribution<float> x(bounds.a.x, bounds.b.x);
+	std::uniform_real_distribution<float> y(bounds.a.y, bounds.b.y);
+	std::uniform_real_distribution<float> z(bounds.a.z, bounds.b.z);
+	std::uniform_real_distribution<float> spread(-1.f, 1.f);
+
+	std::vector<Ray> rays;
+	rays.reserve(count);
+	glm::vec3 origin;
+	glm::vec3 target;
+	for (size_t i = 0; i < count; i++) {
+		if (i % 8 == 0) {
+			origin = { x(rng), y(rng), z(rng) };
+			target = { x(rng), y(rng), z(rng) };
+		}
+		glm::vec3 dir = glm::normalize(target - origin + glm::vec3(spread(rng), spread(rng), spread(rng)));
+		rays.push_back({ origin, dir });
+	}
+	return rays;
+}
+
+// Hits that disagree on whether or roughly where the ray hit, instances are tested in their own space so t isn't bit exact
+size_t countDifferentHits(const std::vector<amaz::RayHit>& a, const std::vector<amaz::RayHit>& b) {
+	size_t different = 0;
+	for (size_t i = 0; i < a.size(); i++) {
+		if (a[i].hit != b[i].hit || (a[i].hit && std::abs(a[i].t - b[i].t) > 1e-3f)) different++;
+	}
+	return different;
+}
+
+void benchRaycast(amaz::Physics& physics, const std::vector<uint32_t>& tris) {
+	std::vector<Ray> rays = generateRays(sceneBounds(tris), RAY_COUNT);
+	std::vector<amaz::RayHit> hits(rays.size());
+
+	for (auto [name, type] : { std::pair{ "octree", amaz::BroadphaseType::Octree }, std::pair{ "bvh", amaz::BroadphaseType::BVH },
+		std::pair{ "loose octree", amaz::BroadphaseType::LooseOctree } }) {
+		auto broadphase = amaz::createBroadphase(type);
+		for (uint32_t tri : tris) {
+			broadphase->addElement(tri);
+		}
+		broadphase->bake();
+
+		auto start = Clock::now();
+		amaz::castRays(*broadphase, rays, RAY_LENGTH, hits);
+		double time = msSince(start);
+
+		size_t hitCount = std::count_if(hits.begin(), hits.end(), [](const amaz::RayHit& hit) { return hit.hit; });
+		std::cout << name << " raycast: " << time << "ms for " << rays.size() << " rays (" << (time * 1000000.0 / rays.size()) << "ns each), "
+			<< hitCount << " hits\n";
+	}
+
+	// the instanced scene has to find the same hits as the flattened copy of it
+	std::vector<amaz::RayHit> flatHits = hits;
+	auto start = Clock::now();
+	physics.raycastMany(rays, hits, RAY_LENGTH);
+	double time = msSince(start);
+	std::cout << "Physics::raycastMany: " << time << "ms for " << rays.size() << " rays on " << amaz::util::ThreadPool::global().threadCount() + 1 << " threads, "
+		<< countDifferentHits(hits, flatHits) << " hits differ from the flattened scene\n";
+}
+
+// Every overlapping pair by sorting on x and sweeping, what SweepAndPrune::updatePairs should agree with
+std::vector<uint64_t> sweepPairs(const std::vector<AABB>& bounds, const std::vector<uint32_t>& proxies) {
+	std::vector<uint32_t> order(bounds.size());
+	for (uint32_t i = 0; i < order.size(); i++) order[i] = i;
+	std::sort(order.begin(), order.end(), [&](uint32_t a, uint32_t b) { return bounds[a].a.x < bounds[b].a.x; });
+
+	std::vector<uint64_t> pairs;
+	for (size_t i = 0; i < order.size(); i++) {
+		for (size_t j = i + 1; j < order.size() && bounds[order[j]].a.x <= bounds[order[i]].b.x; j++) {
+			if (!amaz::AABBvsAABB(bounds[order[i]], bounds[order[j]])) continue;
+			uint32_t a = proxies[order[i]];
+			uint32_t b = proxies[order[j]];
+			pairs.push_back((uint64_t(std::min(a, b)) << 32) | std::max(a, b));
+		}
+	}
+	std::sort(pairs.begin(), pairs.end());
+	return pairs;
+}
+
+void benchSweepAndPrune() {
+	std::mt19937 rng(99);
+	std::uniform_real_distribution<float> x(MOVER_BOUNDS.a.x, MOVER_BOUNDS.b.x);
+	std::uniform_real_distribution<float> y(MOVER_BOUNDS.a.y, MOVER_BOUNDS.b.y);
+	std::uniform_real_distribution<float> z(MOVER_BOUNDS.a.z, MOVER_BOUNDS.b.z);
+	std::uniform_real_distribution<float> speed(-MOVER_SPEED, MOVER_SPEED);
+
+	std::vector<glm::vec3> positions(MOVER_COUNT);
+	std::vector<glm::vec3> velocities(MOVER_COUNT);
+	std::vector<AABB> bounds(MOVER_COUNT);
+	std::vector<uint32_t> proxies(MOVER_COUNT);
+	amaz::SweepAndPrune sap;
+	for (size_t i = 0; i < MOVER_COUNT; i++) {
+		positions[i] = { x(rng), y(rng), z(rng) };
+		velocities[i] = { speed(rng), speed(rng), speed(rng) };
+		bounds[i] = { positions[i] - glm::vec3(0.5f), positions[i] + glm::vec3(0.5f) };
+		proxies[i] = sap.add(bounds[i]);
+	}
+
+	auto start = Clock::now();
+	sap.updatePairs();
+	std::cout << "sap: first update of " << MOVER_COUNT << " movers took " << msSince(start) << "ms\n";
+
+	double total = 0.0;
+	double worst = 0.0;
+	size_t events[3] = { 0, 0, 0 };
+	size_t mismatches = 0;
+	for (size_t step = 0; step < MOVER_STEPS; step++) {
+		for (size_t i = 0; i < MOVER_COUNT; i++) {
+			positions[i] += velocities[i];
+			for (int axis = 0; axis < 3; axis++) {
+				if (positions[i][axis] < MOVER_BOUNDS.a[axis] || positions[i][axis] > MOVER_BOUNDS.b[axis]) velocities[i][axis] = -velocities[i][axis];
+			}
+			bounds[i] = { positions[i] - glm::vec3(0.5f), positions[i] + glm::vec3(0.5f) };
+			sap.update(proxies[i], bounds[i]);
+		}
+
+		start = Clock::now();
+		sap.updatePairs();
+		double time = msSince(start);
+		total += time;
+		worst = std::max(worst, time);
+
+		std::vector<uint64_t> pairs;
+		sap.forEachPair([&](uint32_t a, uint32_t b, amaz::PairEvent event) {
+			events[static_cast<int>(event)]++;
+			if (event != amaz::PairEvent::End) pairs.push_back((uint64_t(a) << 32) | b);
+		});
+		if (step % 30 == 0) {
+			std::sort(pairs.begin(), pairs.end());
+			if (pairs != sweepPairs(bounds, proxies)) mismatches++;
+		}
+	}
+
+	std::cout << "sap: " << (total / MOVER_STEPS) << "ms per update, worst " << worst << "ms, " << sap.pairCount() << " pairs, "
+		<< sap.candidateCount() << " candidates, " << sap.lastSwapCount() << " swaps last update\n";
+	std::cout << "sap: " << events[0] << " begin, " << events[1] << " persist, " << events[2] << " end events, "
+		<< mismatches << " updates disagreed with a full sweep\n";
+
+	start = Clock::now();
+	sweepPairs(bounds, proxies);
+	std::cout << "full sort and sweep: " << msSince(start) << "ms\n";
+}
+
+// Walks in circles and jumps, the same for a given tick every run
+Input scriptedInput(uint64_t tick) {
+	Input input;
+	input.flying = false;
+	input.moveForward = (tick / 90) % 3 != 2;
+	input.moveLeft = (tick / 45) % 4 == 1;
+	input.jump = tick % 70 < 10;
+	float yaw = tick * 0.03f;
+	input.camDir = { std::cos(yaw), 0.f, std::sin(yaw) };
+	return input;
+}
+
+template <typename T>
+bool sameBits(const T& a, const T& b) {
+	return std::memcmp(&a, &b, sizeof(T)) == 0;
+}
+
+// Compared field by field, the structs have padding that isn't guaranteed to match
+bool sameState(const amaz::PhysicsState& a, const amaz::PhysicsState& b) {
+	if (!sameBits(a.player.position, b.player.position) || !sameBits(a.player.yVelocity, b.player.yVelocity) ||
+		!sameBits(a.player.jumpTime, b.player.jumpTime) || a.player.jumped != b.player.jumped || a.player.isGrounded != b.player.isGrounded) {
+		return false;
+	}
+	if (a.rigid.bodies.size() != b.rigid.bodies.size()) {
+		return false;
+	}
+	for (size_t i = 0; i < a.rigid.bodies.size(); i++) {
+		const amaz::RigidBody& x = a.rigid.bodies[i];
+		const amaz::RigidBody& y = b.rigid.bodies[i];
+		if (x.alive != y.alive || !sameBits(x.position, y.position) || !sameBits(x.velocity, y.velocity)) return false;
+	}
+	const amaz::CharacterSystemState& c = a.characters;
+	const amaz::CharacterSystemState& d = b.characters;
+	if (c.positions.size() != d.positions.size()) {
+		return false;
+	}
+	for (size_t i = 0; i < c.positions.size(); i++) {
+		if (!sameBits(c.positions[i], d.positions[i]) || !sameBits(c.yVelocities[i], d.yVelocities[i]) || c.grounded[i] != d.grounded[i]) return false;
+	}
+	return true;
+}
+
+// Points every character in a direction of its own that turns a little each tick, some of them jump now and then
+void steerCrowd(amaz::CharacterSystem& characters, uint64_t tick) {
+	for (uint32_t id = 0; id < characters.size(); id++) {
+		float yaw = id * 2.399f + tick * 0.01f;
+		characters.setMove(id, glm::vec3{ std::cos(yaw), 0.f, std::sin(yaw) } * CROWD_SPEED);
+		if ((tick + id) % 120 == 0) characters.jump(id);
+	}
+}
+
+// Spreads count characters over the scene's footprint just above its top, they fall onto whatever is below
+void spawnCrowd(amaz::CharacterSystem& characters, AABB bounds, size_t count) {
+	size_t side = static_cast<size_t>(std::ceil(std::sqrt(static_cast<double>(count))));
+	glm::vec3 size = bounds.b - bounds.a;
+	for (size_t i = 0; i < count; i++) {
+		float x = (i % side + 0.5f) / side;
+		float z = (i / side + 0.5f) / side;
+		characters.add({ bounds.a.x + size.x * x, bounds.b.y + 2.f, bounds.a.z + size.z * z });
+	}
+}
+
+// Steps the player and a pile of bodies while recording a history, then keeps rolling back a few ticks and
+// re-simulating them. Every re-simulated state has to match the original run bit for bit.
+void benchRollback(amaz::Physics& physics, const std::vector<uint32_t>& tris) {
+	AABB bounds = sceneBounds(tris);
+	glm::vec3 center = (bounds.a + bounds.b) / 2.f;
+	std::mt19937 rng(5);
+	std::uniform_real_distribution<float> spread(-10.f, 10.f);
+	amaz::RigidWorld& world = physics.getRigidWorld();
+	for (size_t i = 0; i < ROLLBACK_BODIES; i++) {
+		amaz::RigidBodyDesc desc;
+		desc.shape = i % 3 == 0 ? amaz::BodyShape::Box : (i % 3 == 1 ? amaz::BodyShape::Sphere : amaz::BodyShape::Capsule);
+		desc.position = { center.x + spread(rng), bounds.b.y + 2.f + i * 0.05f, center.z + spread(rng) };
+		world.addBody(desc);
+	}
+	// steered once, rollback only replays the player's input so moves changed every tick wouldn't be re-applied
+	spawnCrowd(physics.getCharacters(), bounds, ROLLBACK_CHARACTERS);
+	steerCrowd(physics.getCharacters(), 0);
+
+	amaz::PhysicsHistory history(ROLLBACK_HISTORY);
+	std::vector<amaz::PhysicsState> original(ROLLBACK_STEPS + 1);
+	amaz::PhysicsState resimulated;
+
+	Input input = scriptedInput(0);
+	size_t rollbacks = 0;
+	size_t mismatches = 0;
+	double total = 0.0;
+	double worst = 0.0;
+	double stepTotal = 0.0;
+
+	for (uint64_t tick = 0; tick < ROLLBACK_STEPS; tick++) {
+		glm::vec3 position = input.camPos;
+		input = scriptedInput(tick);
+		input.camPos = position;
+
+		history.record(tick, physics, input);
+		auto start = Clock::now();
+		physics.stepLogic(input, TICK_SECONDS);
+		stepTotal += msSince(start);
+		physics.saveState(original[tick + 1], input);
+
+		if (tick + 1 >= ROLLBACK_TICKS && tick % 10 == 0) {
+			start = Clock::now();
+			physics.rollback(history, tick + 1 - ROLLBACK_TICKS, tick + 1, input, TICK_SECONDS);
+			double time = msSince(start);
+			total += time;
+			worst = std::max(worst, time);
+			rollbacks++;
+
+			physics.saveState(resimulated, input);
+			if (!sameState(resimulated, original[tick + 1])) mismatches++;
+		}
+	}
+
+	std::cout << "rollback: " << ROLLBACK_BODIES << " bodies and " << ROLLBACK_CHARACTERS << " characters, " << (stepTotal / ROLLBACK_STEPS) << "ms per tick, re-simulating " << ROLLBACK_TICKS
+		<< " ticks took " << (total / rollbacks) << "ms, worst " << worst << "ms\n";
+	if (total / rollbacks > ROLLBACK_BUDGET_MS) {
+		std::cout << "rollback: over the " << ROLLBACK_BUDGET_MS << "ms budget MAX_ROLLBACK_BODIES and MAX_ROLLBACK_CHARACTERS are sized for\n";
+	}
+	std::cout << "rollback: " << mismatches << " of " << rollbacks << " rollbacks didn't reproduce the original state exactly, player ended at "
+		<< input.camPos.x << " " << input.camPos.y << " " << input.camPos.z << "\n";
+}
+
+// Loads and bakes the scene into a fresh Physics, triangles are registered after every earlier load's so their ids differ
+double loadTimed(const string& scene, amaz::BroadphaseType type, const string& cacheDirectory, std::unique_ptr<amaz::Physics>& physics) {
+	physics = std::make_unique<amaz::Physics>(type);
+	if (!cacheDirectory.empty()) {
+		physics->setCollisionCache(cacheDirectory);
+	}
+	auto start = Clock::now();
+	loadCollisionScene(scene, *physics);
+	physics->bakeCollision();
+	return msSince(start);
+}
+
+// Parsing the OBJ files and baking against cooking them into the cache and loading them back from it.
+// Rays cast through the loaded scene have to hit the same triangles as through the freshly baked one.
+void benchCollisionCache(const string& scene, const std::vector<uint32_t>& tris) {
+	string directory = ASSETS_PATH + "cooked-bench/";
+	std::filesystem::remove_all(directory);
+
+	std::vector<Ray> rays = generateRays(sceneBounds(tris), CACHE_RAY_COUNT);
+	std::pair<amaz::BroadphaseType, string> types[] = { { amaz::BroadphaseType::Octree, "octree" }, { amaz::BroadphaseType::BVH, "bvh" } };
+
+	for (auto& [type, name] : types) {
+		std::unique_ptr<amaz::Physics> baked, cold, warm;
+		double parseTime = loadTimed(scene, type, "", baked);
+		double coldTime = loadTimed(scene, type, directory, cold);
+		double warmTime = loadTimed(scene, type, directory, warm);
+
+		std::vector<amaz::RayHit> expected(rays.size()), found(rays.size());
+		baked->raycastMany(rays, expected, RAY_LENGTH);
+		warm->raycastMany(rays, found, RAY_LENGTH);
+		// triangle ids differ between the loads, the offset into the hit instance's mesh doesn't
+		auto meshTri = [](const amaz::Physics& physics, const amaz::RayHit& hit) {
+			const amaz::CollisionScene& scene = physics.getCollisionScene();
+			return hit.tri - scene.mesh(scene.instance(hit.instance).mesh).firstTri;
+		};
+		size_t mismatches = 0;
+		for (size_t i = 0; i < rays.size(); i++) {
+			if (expected[i].hit != found[i].hit) {
+				mismatches++;
+			} else if (expected[i].hit && (expected[i].instance != found[i].instance || meshTri(*baked, expected[i]) != meshTri(*warm, found[i]) ||
+				expected[i].t != found[i].t)) {
+				mismatches++;
+			}
+		}
+
+		std::cout << "cache " << name << ": parse and bake " << parseTime << "ms, cook " << coldTime << "ms, load cooked " << warmTime << "ms, "
+			<< mismatches << " of " << rays.size() << " rays differ from the baked scene\n";
+	}
+
+	size_t bytes = 0;
+	for (auto& entry : std::filesystem::directory_iterator(directory)) {
+		bytes += entry.file_size();
+	}
+	std::cout << "cache: " << (bytes / 1024) << "KB cooked in " << directory << "\n";
+	std::filesystem::remove_all(directory);
+}
+
+// value below which fraction of the samples fall
+double percentile(std::vector<double> samples, double fraction) {
+	if (samples.empty()) return 0.0;
+	size_t index = std::min(samples.size() - 1, static_cast<size_t>(fraction * samples.size()));
+	std::nth_element(samples.begin(), samples.begin() + index, samples.end());
+	return samples[index];
+}
+
+// Replays a recorded input trace through stepLogic at the rate it was recorded at, as fast as possible,
+// and reports how long each phase of the player's collision took. Without a trace file the scripted walk is used.
+// Record one with AmazEngine --record-trace <file>.
+void benchTrace(amaz::Physics& physics, const string& tracePath) {
+	InputTrace trace;
+	if (tracePath.empty()) {
+		trace = InputTrace(60, Input().camPos);
+		for (uint64_t tick = 0; tick < SCRIPTED_TRACE_TICKS; tick++) {
+			trace.record(scriptedInput(tick));
+		}
+	} else if (!trace.load(tracePath)) {
+		return;
+	}
+
+	Input input;
+	input.camPos = trace.startPos;
+	float seconds = 1.f / trace.simRate;
+
+	struct Phase {
+		string name;
+		double amaz::StepStats::* time;
+		std::vector<double> samples;
+	};
+	Phase phases[] = {
+		{ "sweep", &amaz::StepStats::sweep }, { "broadphase", &amaz::StepStats::broadphase }, { "narrowphase", &amaz::StepStats::narrowphase },
+		{ "sort", &amaz::StepStats::sort }, { "resolve", &amaz::StepStats::resolve }, { "rigid", &amaz::StepStats::rigid },
+	};
+	std::vector<double> steps;
+	std::vector<double> triangles;
+	size_t contacts = 0;
+	size_t cacheHits = 0;
+	size_t cacheQueries = 0;
+
+	for (size_t tick = 0; tick < trace.size(); tick++) {
+		trace.apply(tick, input);
+		auto start = Clock::now();
+		physics.stepLogic(input, seconds);
+		steps.push_back(msSince(start) * 1000.0);
+
+		const amaz::StepStats& stats = physics.getStepStats();
+		for (auto& phase : phases) {
+			phase.samples.push_back(stats.*phase.time);
+		}
+		triangles.push_back(stats.trianglesTested);
+		contacts += stats.contacts;
+		cacheHits += stats.cacheHits;
+		cacheQueries += stats.cacheHits + stats.cacheMisses;
+	}
+
+	std::cout << "trace: " << trace.size() << " ticks at " << trace.simRate << "hz" << (tracePath.empty() ? " (scripted)" : " from " + tracePath) << "\n";
+	auto report = [](const string& name, const std::vector<double>& samples) {
+		std::cout << "  " << name << ": p50 " << percentile(samples, 0.5) << "us, p99 " << percentile(samples, 0.99) << "us, max "
+			<< (samples.empty() ? 0.0 : *std::max_element(samples.begin(), samples.end())) << "us\n";
+	};
+	for (auto& phase : phases) {
+		report(phase.name, phase.samples);
+	}
+	report("whole step", steps);
+
+	double totalTriangles = std::accumulate(triangles.begin(), triangles.end(), 0.0);
+	std::cout << "trace: " << (totalTriangles / std::max<size_t>(trace.size(), 1)) << " triangles tested per step, p99 " << percentile(triangles, 0.99)
+		<< ", " << (double)contacts / std::max<size_t>(trace.size(), 1) << " contacts per step\n";
+	std::cout << "trace: candidate cache answered " << cacheHits << " of " << cacheQueries << " player queries ("
+		<< 100.0 * cacheHits / std::max<size_t>(cacheQueries, 1) << "%)\n";
+	// changes here without a change to the collision code mean the simulation isn't deterministic anymore
+	std::cout << "trace: player ended at " << input.camPos.x << " " << input.camPos.y << " " << input.camPos.z << "\n";
+}
+
+// Rolling hills a few units high, the same every run
+std::vector<float> generateTerrain(uint32_t size) {
+	std::vector<float> heights(static_cast<size_t>(size) * size);
+	for (uint32_t z = 0; z < size; z++) {
+		for (uint32_t x = 0; x < size; x++) {
+			heights[static_cast<size_t>(z) * size + x] = 6.f * std::sin(x * 0.05f) * std::cos(z * 0.04f) + 1.5f * std::sin(x * 0.23f + z * 0.17f);
+		}
+	}
+	return heights;
+}
+
+size_t triangleStoreBytes(const amaz::TriangleStore& store) {
+	size_t floats = 0;
+	for (const std::vector<float>* component : { &store.ax, &store.ay, &store.az, &store.bx, &store.by, &store.bz, &store.cx, &store.cy, &store.cz,
+		&store.nx, &store.ny, &store.nz, &store.planeDist, &store.abx, &store.aby, &store.abz, &store.bcx, &store.bcy, &store.bcz,
+		&store.cax, &store.cay, &store.caz, &store.minX, &store.minY, &store.minZ, &store.maxX, &store.maxY, &store.maxZ }) {
+		floats += component->size();
+	}
+	return floats * sizeof(float);
+}
+
+// The same terrain as a heightfield and as triangles in an octree. Rays have to hit the same triangles through both,
+// then a crowd walks over the heightfield and has to stay on its surface.
+void benchHeightfield() {
+	float half = (TERRAIN_SIZE - 1) / 2.f;
+	std::vector<float> heights = generateTerrain(TERRAIN_SIZE);
+	amaz::Heightfield terrain = amaz::Heightfield::fromHeights(TERRAIN_SIZE, TERRAIN_SIZE, 1.f, { -half, 0.f, -half }, heights);
+
+	size_t storeBefore = triangleStoreBytes(amaz::getTriangleStore());
+	auto start = Clock::now();
+	uint32_t firstTri = static_cast<uint32_t>(amaz::trisCount());
+	auto octree = amaz::createBroadphase(amaz::BroadphaseType::Octree);
+	for (uint32_t tri = 0; tri < terrain.triangleCount(); tri++) {
+		octree->addElement(static_cast<uint32_t>(amaz::registerTri(terrain.triangle(tri))));
+	}
+	octree->bake();
+	double bakeTime = msSince(start);
+	size_t storeBytes = triangleStoreBytes(amaz::getTriangleStore()) - storeBefore;
+	std::cout << "terrain: " << TERRAIN_SIZE << "x" << TERRAIN_SIZE << " samples, heightfield " << terrain.memoryBytes() / 1024 << "KB, as "
+		<< terrain.triangleCount() << " triangles " << storeBytes / 1024 << "KB in the TriangleStore without the octree, which took " << bakeTime << "ms to build\n";
+
+	AABB bounds = terrain.bounds();
+	std::vector<Ray> rays = generateRays({ bounds.a - glm::vec3(0.f, 5.f, 0.f), bounds.b + glm::vec3(0.f, 10.f, 0.f) }, TERRAIN_RAYS);
+	std::vector<amaz::RayHit> expected(rays.size());
+	start = Clock::now();
+	amaz::castRays(*octree, rays, RAY_LENGTH, expected);
+	double octreeTime = msSince(start);
+
+	std::vector<amaz::RayHit> hits(rays.size());
+	start = Clock::now();
+	for (size_t i = 0; i < rays.size(); i++) {
+		hits[i] = terrain.raycast(rays[i], RAY_LENGTH);
+	}
+	double heightfieldTime = msSince(start);
+
+	// the two ray tests round differently, rays grazing an edge can pick the neighbouring triangle
+	size_t different = 0;
+	size_t hitCount = 0;
+	float worstT = 0.f;
+	for (size_t i = 0; i < rays.size(); i++) {
+		hitCount += hits[i].hit;
+		if (hits[i].hit != expected[i].hit) {
+			different++;
+		} else if (hits[i].hit) {
+			worstT = std::max(worstT, std::abs(hits[i].t - expected[i].t));
+			if (hits[i].tri + firstTri != expected[i].tri) different++;
+		}
+	}
+	std::cout << "terrain: " << rays.size() << " rays, " << hitCount << " hits, " << different << " differ from the octree, worst t difference "
+		<< worstT << ", heightfield " << heightfieldTime << "ms, octree " << octreeTime << "ms\n";
+
+	// walking on it, characters bottoms should sit a skin above the surface
+	amaz::Physics physics;
+	physics.bakeCollision();
+	physics.setHeightfield(terrain);
+	amaz::CharacterSystem& characters = physics.getCharacters();
+	spawnCrowd(characters, { bounds.a + glm::vec3(20.f, 0.f, 20.f), bounds.b - glm::vec3(20.f, 0.f, 20.f) }, TERRAIN_CHARACTERS);
+
+	Input input;
+	std::vector<double> ticks;
+	for (uint64_t tick = 0; tick < CROWD_STEPS; tick++) {
+		steerCrowd(characters, tick);
+		physics.stepLogic(input, TICK_SECONDS);
+		ticks.push_back(physics.getStepStats().characters / 1000.0);
+	}
+
+	float lowest = characters.shape().base.y;
+	size_t below = 0;
+	float worstGap = 0.f;
+	for (size_t id = 0; id < characters.size(); id++) {
+		glm::vec3 position = characters.positions()[id];
+		float ground;
+		if (!terrain.heightAt(position.x, position.z, ground) || !characters.grounded()[id]) continue;
+		float gap = position.y + lowest - ground;
+		if (gap < -0.01f) below++;
+		worstGap = std::max(worstGap, std::abs(gap));
+	}
+	std::span<const uint8_t> grounded = characters.grounded();
+	std::cout << "terrain: " << TERRAIN_CHARACTERS << " characters p50 " << percentile(ticks, 0.5) << "ms per tick, "
+		<< std::count(grounded.begin(), grounded.end(), uint8_t(1)) << " grounded, " << below << " sunk into it, worst distance from the surface " << worstGap << "\n";
+}
+
+// A lumpy sphere of about radius 1 standing in for a detailed prop, the same every run
+std::vector<Triangle> generateRock(uint32_t rings, uint32_t segments) {
+	auto point = [&](uint32_t ring, uint32_t segment) {
+		float theta = std::numbers::pi_v<float> * ring / rings;
+		float phi = 2.f * std::numbers::pi_v<float> * (segment % segments) / segments;
+		float radius = 1.f + 0.08f * std::sin(theta * 7.f) * std::cos(phi * 5.f) + 0.03f * std::sin(phi * 17.f + theta * 11.f);
+		return glm::vec3(std::sin(theta) * std::cos(phi), std::cos(theta), std::sin(theta) * std::sin(phi)) * radius;
+	};
+
+	std::vector<Triangle> tris;
+	for (uint32_t ring = 0; ring < rings; ring++) {
+		for (uint32_t segment = 0; segment < segments; segment++) {
+			glm::vec3 a = point(ring, segment), b = point(ring, segment + 1), c = point(ring + 1, segment), d = point(ring + 1, segment + 1);
+			tris.push_back({ a, b, d });
+			tris.push_back({ a, d, c });
+		}
+	}
+	return tris;
+}
+
+// Cooks a detailed mesh into a hull and compares what a pair costs through GJK against testing the mesh's triangles.
+// Then a pile of hull bodies is dropped on the scene, and a stretch of it is stepped again from a saved state to
+// check the separating axis cache doesn't change anything.
+void benchHulls(amaz::Physics& physics, const std::vector<uint32_t>& tris) {
+	std::vector<Triangle> rock = generateRock(ROCK_RINGS, ROCK_SEGMENTS);
+	auto start = Clock::now();
+	amaz::ConvexHull hull = amaz::ConvexHull::cook(rock);
+	double cookTime = msSince(start);
+	start = Clock::now();
+	amaz::ConvexHull fullHull = amaz::ConvexHull::cook(rock, std::numeric_limits<uint32_t>::max());
+	double fullCookTime = msSince(start);
+	std::cout << "hull: " << rock.size() << " triangle rock cooked into " << hull.vertexCount() << " vertices in " << cookTime << "ms, without a limit "
+		<< fullHull.vertexCount() << " vertices in " << fullCookTime << "ms\n";
+
+	std::mt19937 rng(9);
+	std::uniform_real_distribution<float> unit(-1.f, 1.f);
+	std::vector<glm::vec3> dirs(HULL_PAIRS);
+	for (auto& dir : dirs) {
+		dir = { unit(rng), unit(rng), unit(rng) };
+	}
+
+	// the support function against a loop over the vertices one at a time, both have to find equally far vertices
+	for (const amaz::ConvexHull* shape : { &hull, &fullHull }) {
+		float simdSum = 0.f, scalarSum = 0.f;
+		start = Clock::now();
+		for (glm::vec3 dir : dirs) {
+			simdSum += glm::dot(shape->support(dir), dir);
+		}
+		double simdTime = msSince(start);
+		start = Clock::now();
+		for (glm::vec3 dir : dirs) {
+			float best = std::numeric_limits<float>::lowest();
+			for (uint32_t i = 0; i < shape->vertexCount(); i++) {
+				best = std::max(best, glm::dot(shape->vertex(i), dir));
+			}
+			scalarSum += best;
+		}
+		double scalarTime = msSince(start);
+		std::cout << "hull: support over " << shape->vertexCount() << " vertices " << simdTime * 1e6 / dirs.size() << "ns, one at a time "
+			<< scalarTime * 1e6 / dirs.size() << "ns, sums " << (simdSum == scalarSum ? "match" : "differ") << "\n";
+	}
+
+	// capsules around the rock, through GJK against the hull and against every triangle of the rock
+	std::vector<Capsule> probes(HULL_PAIRS);
+	for (auto& probe : probes) {
+		glm::vec3 center = glm::vec3(unit(rng), unit(rng), unit(rng)) * 1.6f;
+		probe = { center + glm::vec3(0.f, 0.4f, 0.f), center - glm::vec3(0.f, 0.4f, 0.f), 0.3f };
+	}
+	size_t hullContacts = 0;
+	start = Clock::now();
+	for (const Capsule& probe : probes) {
+		hullContacts += amaz::convexContact(amaz::ConvexShape::capsule(probe.tip, probe.base, probe.radius), amaz::ConvexShape::convexHull(hull, glm::vec3(0.f))).collided;
+	}
+	double gjkTime = msSince(start);
+
+	std::vector<uint32_t> rockTris;
+	for (const Triangle& tri : rock) {
+		rockTris.push_back(static_cast<uint32_t>(amaz::registerTri(tri)));
+	}
+	std::vector<amaz::TriangleContact> contacts;
+	size_t soupPairs = HULL_PAIRS / 100;
+	start = Clock::now();
+	for (size_t i = 0; i < soupPairs; i++) {
+		contacts.clear();
+		amaz::capsuleVsTriangles(probes[i], rockTris, contacts);
+	}
+	double soupTime = msSince(start);
+	std::cout << "hull: capsule against the hull " << gjkTime * 1e6 / probes.size() << "ns a pair, " << 100.0 * hullContacts / probes.size()
+		<< "% touching, against the " << rock.size() << " triangles " << soupTime * 1e6 / soupPairs << "ns a pair\n";
+
+	AABB bounds = sceneBounds(tris);
+	glm::vec3 center = (bounds.a + bounds.b) / 2.f;
+	amaz::RigidWorld& world = physics.getRigidWorld();
+	uint32_t rockHull = world.addHull(hull);
+	for (size_t i = 0; i < HULL_BODIES; i++) {
+		amaz::RigidBodyDesc desc;
+		desc.shape = amaz::BodyShape::Hull;
+		desc.hull = rockHull;
+		desc.position = { center.x + unit(rng) * 6.f, bounds.b.y + 2.f + i * 0.1f, center.z + unit(rng) * 6.f };
+		world.addBody(desc);
+	}
+
+	Input input = scriptedInput(0);
+	std::vector<double> ticks;
+	uint64_t convexTests = 0, cachedSeparations = 0;
+	amaz::PhysicsState saved, original, replayed;
+	// a rock whose center crossed a triangle during a step went through the surface
+	std::vector<glm::vec3> previous(HULL_BODIES);
+	std::vector<uint8_t> tunneled(HULL_BODIES, 0);
+	for (uint64_t tick = 0; tick < HULL_STEPS; tick++) {
+		if (tick == HULL_STEPS - 60) physics.saveState(saved, input);
+		for (uint32_t id = 0; id < HULL_BODIES; id++) {
+			previous[id] = world.getBody(id).position;
+		}
+		physics.stepLogic(input, TICK_SECONDS);
+		ticks.push_back(physics.getStepStats().rigid / 1000.0);
+		convexTests += world.stats().convexTests;
+		cachedSeparations += world.stats().cachedSeparations;
+		for (uint32_t id = 0; id < HULL_BODIES; id++) {
+			if (physics.linecast({ previous[id], world.getBody(id).position }).hit) tunneled[id] = 1;
+		}
+	}
+	physics.saveState(original, input);
+
+	// the cache holds the final step's axes now rather than the ones it had when the state was saved
+	physics.restoreState(saved, input);
+	for (uint64_t tick = HULL_STEPS - 60; tick < HULL_STEPS; tick++) {
+		physics.stepLogic(input, TICK_SECONDS);
+	}
+	physics.saveState(replayed, input);
+
+	// the pile pushes some rocks over the scene's edges, they fall forever
+	size_t fallen = std::count_if(original.rigid.bodies.begin(), original.rigid.bodies.end(), [&](const amaz::RigidBody& body) {
+		return body.position.y + hull.bounds().b.y < bounds.a.y;
+	});
+	std::cout << "hull: " << HULL_BODIES << " rocks p50 " << percentile(ticks, 0.5) << "ms, p99 " << percentile(ticks, 0.99) << "ms per step, "
+		<< world.stats().contacts << " contacts at the end, " << fallen << " pushed off the edges, "
+		<< std::count(tunneled.begin(), tunneled.end(), uint8_t(1)) << " went through a surface\n";
+	std::cout << "hull: " << convexTests << " GJK runs, the separating axis cache settled " << cachedSeparations << " more pairs ("
+		<< 100.0 * cachedSeparations / std::max<uint64_t>(convexTests + cachedSeparations, 1) << "%), stepping again from a saved state "
+		<< (sameState(original, replayed) ? "matched" : "DIDN'T match") << "\n";
+}
+
+// Steps a crowd of characters walking around the scene with stepLogic. Each tick steers them first, like game code would.
+void benchCrowd(amaz::Physics& physics, const std::vector<uint32_t>& tris) {
+	amaz::CharacterSystem& characters = physics.getCharacters();
+	spawnCrowd(characters, sceneBounds(tris), CROWD_CHARACTERS);
+
+	Input input;
+	std::vector<double> ticks;
+	for (uint64_t tick = 0; tick < CROWD_STEPS; tick++) {
+		steerCrowd(characters, tick);
+		physics.stepLogic(input, TICK_SECONDS);
+		ticks.push_back(physics.getStepStats().characters / 1000.0);
+	}
+
+	std::span<const uint8_t> grounded = characters.grounded();
+	size_t onGround = std::count(grounded.begin(), grounded.end(), uint8_t(1));
+	amaz::CharacterSystemStats stats = characters.stats();
+	std::cout << "crowd: " << CROWD_CHARACTERS << " characters on " << amaz::util::ThreadPool::global().threadCount() + 1 << " threads, p50 "
+		<< percentile(ticks, 0.5) << "ms, p99 " << percentile(ticks, 0.99) << "ms per tick\n";
+	std::cout << "crowd: " << onGround << " grounded after " << CROWD_STEPS << " ticks, candidate cache answered "
+		<< 100.0 * stats.cacheHits / std::max<uint64_t>(stats.cacheHits + stats.cacheMisses, 1) << "% of queries\n";
+}
+
+int main(int argc, char* argv[]) {
+
+	string mode = argc > 1 ? argv[1] : "octree";
+	string scene = argc > 2 ? argv[2] : "test";
+	string tracePath = argc > 3 ? argv[3] : "";
+
+	amaz::Physics physics;
+	auto start = Clock::now();
+	if (!loadCollisionScene(scene, physics)) {
+		return 1;
+	}
+	physics.bakeCollision();
+	const amaz::CollisionScene& collision = physics.getCollisionScene();
+	std::cout << "Loaded scene " << scene << " in " << msSince(start) << "ms, " << collision.instanceCount() << " instances of " << collision.meshCount()
+		<< " meshes place " << collision.placedTriangleCount() << " triangles from " << amaz::trisCount() << " unique ones\n";
+	std::vector<uint32_t> tris = flattenScene(physics);
+
+	if (mode == "octree") {
+		benchOctree(tris);
+	} else if (mode == "bvh") {
+		benchBVH(tris);
+	} else if (mode == "stress") {
+		benchStress(tris);
+	} else if (mode == "raycast") {
+		benchRaycast(physics, tris);
+	} else if (mode == "loose") {
+		benchLooseOctree(tris);
+	} else if (mode == "rollback") {
+		benchRollback(physics, tris);
+	} else if (mode == "sap") {
+		benchSweepAndPrune();
+	} else if (mode == "cache") {
+		benchCollisionCache(scene, tris);
+	} else if (mode == "trace") {
+		benchTrace(physics, tracePath);
+	} else if (mode == "crowd") {
+		benchCrowd(physics, tris);
+	} else if (mode == "terrain") {
+		benchHeightfield();
+	} else if (mode == "hull") {
+		benchHulls(physics, tris);
+	} else {
+		std::cout << "Unknown benchmark: " << mode << "\n";
+		std::cout << "Usage: PhysicsBench [octree|bvh|loose|stress|raycast|rollback|sap|cache|trace|crowd|terrain|hull] [scene] [input trace]\n";
+		return 1;
+	}
+
+	return 0;
+}
@@ -0,0 +1,107 @@
+#include "InputTrace.h"
+
+#include <fstream>
+#include <iostream>
+
+constexpr uint32_t TRACE_MAGIC = 0x43525441; // "ATRC"
+constexpr uint32_t TRACE_VERSION = 1;
+
+namespace {
+	enum Button : uint16_t {
+		MOVE_FORWARD = 1 << 0,
+		MOVE_BACK = 1 << 1,
+		MOVE_LEFT = 1 << 2,
+		MOVE_RIGHT = 1 << 3,
+		MOVE_DOWN = 1 << 4,
+		MOVE_UP = 1 << 5,
+		JUMP = 1 << 6,
+		FLYING = 1 << 7,
+	};
+
+	struct TraceHeader {
+		uint32_t magic;
+		uint32_t version;
+		int32_t simRate;
+		glm::vec3 startPos;
+		uint64_t count;
+	};
+}
+
+void InputTrace::record(const Input& input) {
+	uint16_t buttons = 0;
+	if (input.moveForward) buttons |= MOVE_FORWARD;
+	if (input.moveBack) buttons |= MOVE_BACK;
+	if (input.moveLeft) buttons |= MOVE_LEFT;
+	if (input.moveRight) buttons |= MOVE_RIGHT;
+	if (input.moveDown) buttons |= MOVE_DOWN;
+	if (input.moveUp) buttons |= MOVE_UP;
+	if (input.jump) buttons |= JUMP;
+	if (input.flying) buttons |= FLYING;
+	ticks.push_back({ input.camDir, buttons });
+}
+
+void InputTrace::apply(size_t tick, Input& input) const {
+	const TracedInput& traced = ticks[tick];
+	input.camDir = traced.camDir;
+	input.moveForward = traced.buttons & MOVE_FORWARD;
+	input.moveBack = traced.buttons & MOVE_BACK;
+	input.moveLeft = traced.buttons & MOVE_LEFT;
+	input.moveRight = traced.buttons & MOVE_RIGHT;
+	input.moveDown = traced.buttons & MOVE_DOWN;
+	input.moveUp = traced.buttons & MOVE_UP;
+	input.jump = traced.buttons & JUMP;
+	input.flying = traced.buttons & FLYING;
+}
+
+bool InputTrace::save(const std::string& path) const {
+	std::ofstream out(path, std::ios::binary | std::ios::trunc);
+	if (!out) {
+		std::cout << "Unable to write input trace: " << path << "\n";
+		return false;
+	}
+
+	TraceHeader header = { TRACE_MAGIC, TRACE_VERSION, simRate, startPos, ticks.size() };
+	out.write(reinterpret_cast<const char*>(&header), sizeof(header));
+	out.write(reinterpret_cast<const char*>(ticks.data()), static_cast<std::streamsize>(ticks.size() * sizeof(TracedInput)));
+	return static_cast<bool>(out);
+}
+
+bool InputTrace::load(const std::string& path) {
+	std::ifstream in(path, std::ios::binary);
+	if (!in) {
+		std::cout << "Unable to open input trace: " << path << "\n";
+		return false;
+	}
+
+	TraceHeader header;
+	if (!in.read(reinterpret_cast<char*>(&header), sizeof(header)) || header.magic != TRACE_MAGIC || header.version != TRACE_VERSION) {
+		std::cout << "Not an input trace or from an older version: " << path << "\n";
+		return false;
+	}
+
+	if (header.simRate <= 0) {
+		std::cout << "Input trace has no simulation rate: " << path << "\n";
+		return false;
+	}
+
+	// the count comes from the file, so check it fits in what's left before allocating for it
+	std::streamoff start = in.tellg();
+	in.seekg(0, std::ios::end);
+	uint64_t remaining = static_cast<uint64_t>(in.tellg() - start);
+	in.seekg(start);
+	if (header.count > remaining / sizeof(TracedInput)) {
+		std::cout << "Input trace is truncated: " << path << "\n";
+		return false;
+	}
+
+	std::vector<TracedInput> loaded(header.count);
+	if (!in.read(reinterpret_cast<char*>(loaded.data()), static_cast<std::streamsize>(loaded.size() * sizeof(TracedInput)))) {
+		std::cout << "Input trace is truncated: " << path << "\n";
+		return false;
+	}
+
+	simRate = header.simRate;
+	startPos = header.startPos;
+	ticks = std::move(loaded);
+	return true;
+}
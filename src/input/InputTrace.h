@@ -0,0 +1,44 @@
+#pragma once
+
+#include "Input.h"
+#include <glm/glm.hpp>
+#include <string>
+#include <vector>
+#include <cstdint>
+
+// The parts of Input that Physics::stepLogic reads, captured once per simulation tick
+struct TracedInput {
+	glm::vec3 camDir;
+	uint16_t buttons;
+	// saved as raw bytes, so the tail padding is spelled out to always be written as zeros
+	uint16_t pad = 0;
+};
+static_assert(sizeof(TracedInput) == 16, "TracedInput is saved as is and must not have implicit padding");
+
+// A recording of the input of every tick of a play session, so the exact same movement can be replayed
+// headless against the physics later. Saved as a small binary file.
+class InputTrace {
+public:
+	InputTrace() = default;
+	InputTrace(int simRate, glm::vec3 startPos) : simRate(simRate), startPos(startPos) {
+	}
+
+	// Call right before stepping each tick with the input it is stepped with
+	void record(const Input& input);
+
+	// Writes the recorded state of tick into input, leaving the player's position and everything else alone
+	void apply(size_t tick, Input& input) const;
+
+	bool save(const std::string& path) const;
+	bool load(const std::string& path);
+
+	size_t size() const {
+		return ticks.size();
+	}
+
+	int simRate = 60;
+	glm::vec3 startPos = glm::vec3(0.f);
+
+private:
+	std::vector<TracedInput> ticks;
+};
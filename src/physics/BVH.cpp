@@ -0,0 +1,337 @@
+#include "BVH.h"
+
+#include "Collision.h"
+#include "../util/thread_pool.hpp"
+#include <algorithm>
+#include <array>
+#include <limits>
+#include <numeric>
+
+constexpr uint32_t BVH_BINS = 16;
+constexpr uint32_t MAX_BVH_LEAF_ELEMENTS = 4;
+constexpr uint32_t MAX_BVH_DEPTH = 64;
+
+// subtrees with more elements than this are built as separate tasks on the thread pool near the top of the tree
+constexpr uint32_t PARALLEL_BVH_ELEMENTS = 4096;
+constexpr uint32_t MAX_PARALLEL_BVH_DEPTH = 4;
+
+namespace amaz {
+
+	namespace {
+		const AABB EMPTY_AABB = { glm::vec3(std::numeric_limits<float>::max()), glm::vec3(std::numeric_limits<float>::lowest()) };
+
+		AABB merge(AABB a, AABB b) {
+			return { glm::min(a.a, b.a), glm::max(a.b, b.b) };
+		}
+
+		float surfaceArea(AABB aabb) {
+			glm::vec3 extent = aabb.b - aabb.a;
+			return 2.f * (extent.x * extent.y + extent.y * extent.z + extent.z * extent.x);
+		}
+
+		struct Split {
+			int axis = -1;
+			uint32_t bin = 0;
+			float min = 0.f;
+			float scale = 0.f;
+
+			uint32_t binOf(glm::vec3 centroid) const {
+				return std::min(BVH_BINS - 1, static_cast<uint32_t>((centroid[axis] - min) * scale));
+			}
+		};
+	}
+
+	std::shared_ptr<BVH> BVH::create() {
+		return std::shared_ptr<BVH>(new BVH());
+	}
+
+	void BVH::addElement(size_t tri) {
+		pending.push_back(static_cast<uint32_t>(tri));
+		dirty = true;
+	}
+
+	std::deque<size_t> BVH::getElements(AABB aabb, size_t& count) const {
+		std::deque<size_t> output;
+
+		if (nodes.empty()) {
+			return output;
+		}
+
+		// two children are pushed per level, so the stack never grows past the depth
+		std::array<uint32_t, MAX_BVH_DEPTH + 2> nodeIds;
+		size_t stackSize = 0;
+		nodeIds[stackSize++] = 0;
+
+		while (stackSize) {
+			count++;
+			const BVHNode& node = nodes[nodeIds[--stackSize]];
+			if (!amaz::AABBvsAABB(aabb, { node.min, node.max })) continue;
+
+			if (node.count) {
+				std::copy(elements.begin() + node.leftFirst, elements.begin() + node.leftFirst + node.count, std::back_inserter(output));
+			} else {
+				nodeIds[stackSize++] = node.leftFirst + 1;
+				nodeIds[stackSize++] = node.leftFirst;
+			}
+		}
+
+		return output;
+	}
+
+	void BVH::visit(AABB aabb, BroadphaseQuery& query, ElementVisitor visitor) const {
+		query.begin(elementRange);
+
+		if (nodes.empty()) {
+			return;
+		}
+
+		std::array<uint32_t, MAX_BVH_DEPTH + 2> nodeIds;
+		size_t stackSize = 0;
+		nodeIds[stackSize++] = 0;
+
+		while (stackSize) {
+			query.stats.nodesVisited++;
+			const BVHNode& node = nodes[nodeIds[--stackSize]];
+			if (!amaz::AABBvsAABB(aabb, { node.min, node.max })) continue;
+
+			if (node.count) {
+				// every triangle is in exactly one leaf, so there is nothing to deduplicate
+				for (uint32_t i = node.leftFirst; i < node.leftFirst + node.count; i++) {
+					query.stats.trianglesEmitted++;
+					visitor(elements[i]);
+				}
+			} else {
+				nodeIds[stackSize++] = node.leftFirst + 1;
+				nodeIds[stackSize++] = node.leftFirst;
+			}
+		}
+	}
+
+	void BVH::traceRays(RayPacket& packet, LeafVisitor visitor) const {
+		if (nodes.empty()) {
+			return;
+		}
+
+		std::array<uint32_t, MAX_BVH_DEPTH + 2> nodeIds;
+		size_t stackSize = 0;
+		nodeIds[stackSize++] = 0;
+
+		while (stackSize) {
+			const BVHNode& node = nodes[nodeIds[--stackSize]];
+			if (!util::simd::any(packet.hits(node.min, node.max))) continue;
+
+			if (node.count) {
+				visitor({ elements.data() + node.leftFirst, node.count });
+				continue;
+			}
+
+			// the child whose center is further along the ray is pushed first so the near one is popped first
+			const BVHNode& left = nodes[node.leftFirst];
+			const BVHNode& right = nodes[node.leftFirst + 1];
+			bool leftFirst = glm::dot(left.min + left.max, packet.dir) <= glm::dot(right.min + right.max, packet.dir);
+			nodeIds[stackSize++] = node.leftFirst + (leftFirst ? 1 : 0);
+			nodeIds[stackSize++] = node.leftFirst + (leftFirst ? 0 : 1);
+		}
+	}
+
+	bool BVH::serialize(std::vector<std::byte>& out) const {
+		if (dirty) return false;
+		uint32_t base = lowestElement(pending);
+		writeElements(out, pending, base);
+		writeArray(out, std::span<const BVHNode>(nodes));
+		writeElements(out, elements, base);
+		return true;
+	}
+
+	bool BVH::deserialize(std::span<const std::byte> data) {
+		uint32_t base = lowestElement(pending);
+		std::vector<uint32_t> added;
+		std::vector<BVHNode> savedNodes;
+		std::vector<uint32_t> savedElements;
+		if (!readElements(data, added, base) || !readArray(data, savedNodes) || !readElements(data, savedElements, base)) {
+			return false;
+		}
+		if (added != pending || savedElements.size() != pending.size() || savedNodes.empty() != pending.empty()) {
+			return false;
+		}
+
+		// a corrupt cache must not send a query out of bounds or past the end of the traversal stack, children always come
+		// after their parent so walking the nodes in order sees every parent's depth before its children's
+		uint32_t range = pending.empty() ? 0 : *std::max_element(pending.begin(), pending.end()) + 1;
+		std::vector<uint32_t> depths(savedNodes.size(), 0);
+		for (size_t i = 0; i < savedNodes.size(); i++) {
+			const BVHNode& node = savedNodes[i];
+			if (node.count) {
+				if (static_cast<uint64_t>(node.leftFirst) + node.count > savedElements.size()) return false;
+				continue;
+			}
+			if (node.leftFirst <= i || static_cast<uint64_t>(node.leftFirst) + 2 > savedNodes.size() || depths[i] >= MAX_BVH_DEPTH) return false;
+			for (uint32_t child = 0; child < 2; child++) {
+				depths[node.leftFirst + child] = std::max(depths[node.leftFirst + child], depths[i] + 1);
+			}
+		}
+		if (std::any_of(savedElements.begin(), savedElements.end(), [&](uint32_t tri) { return tri >= range; })) {
+			return false;
+		}
+
+		nodes = std::move(savedNodes);
+		elements = std::move(savedElements);
+		elementRange = range;
+		dirty = false;
+		return true;
+	}
+
+	void BVH::bake() {
+		nodes.clear();
+		elements.clear();
+		dirty = false;
+		elementRange = pending.empty() ? 0 : *std::max_element(pending.begin(), pending.end()) + 1;
+
+		uint32_t elementCount = static_cast<uint32_t>(pending.size());
+		if (!elementCount) {
+			return;
+		}
+
+		triBounds.resize(elementCount);
+		centroids.resize(elementCount);
+		util::parallelFor(elementCount, PARALLEL_BVH_ELEMENTS, [&](size_t begin, size_t end) {
+			for (size_t i = begin; i < end; i++) {
+				triBounds[i] = amaz::getAABBFromTriangle(pending[i]);
+				centroids[i] = (triBounds[i].a + triBounds[i].b) * 0.5f;
+			}
+		});
+
+		// elements holds indices into pending while building, a subtree with n elements never needs
+		// more than 2n - 1 nodes so every subtree gets a fixed slice of buildNodes and can be built on its own
+		elements.resize(elementCount);
+		std::iota(elements.begin(), elements.end(), 0);
+		std::vector<BuildNode> buildNodes(2 * elementCount - 1);
+		buildNode(buildNodes, 0, 0, elementCount, 0);
+
+		// flatten depth first with siblings next to each other, this drops the unused slots
+		nodes.reserve(2 * elementCount - 1);
+		nodes.emplace_back();
+		std::vector<std::pair<uint32_t, uint32_t>> stack;
+		stack.push_back({ 0, 0 });
+		while (!stack.empty()) {
+			auto [buildId, nodeId] = stack.back();
+			stack.pop_back();
+
+			const BuildNode& buildNode = buildNodes[buildId];
+			nodes[nodeId].min = buildNode.aabb.a;
+			nodes[nodeId].max = buildNode.aabb.b;
+
+			if (!buildNode.left) {
+				nodes[nodeId].leftFirst = buildNode.first;
+				nodes[nodeId].count = buildNode.count;
+				continue;
+			}
+
+			uint32_t child = static_cast<uint32_t>(nodes.size());
+			nodes.emplace_back();
+			nodes.emplace_back();
+			nodes[nodeId].leftFirst = child;
+			nodes[nodeId].count = 0;
+			stack.push_back({ buildNode.right, child + 1 });
+			stack.push_back({ buildNode.left, child });
+		}
+
+		for (auto& element : elements) {
+			element = pending[element];
+		}
+
+		triBounds.clear();
+		triBounds.shrink_to_fit();
+		centroids.clear();
+		centroids.shrink_to_fit();
+	}
+
+	void BVH::buildNode(std::vector<BuildNode>& buildNodes, uint32_t nodeId, uint32_t first, uint32_t count, uint32_t depth) {
+		BuildNode& node = buildNodes[nodeId];
+		node.first = first;
+		node.count = count;
+		node.aabb = EMPTY_AABB;
+		for (uint32_t i = first; i < first + count; i++) {
+			node.aabb = merge(node.aabb, triBounds[elements[i]]);
+		}
+
+		if (count <= 1 || depth >= MAX_BVH_DEPTH) {
+			return;
+		}
+
+		// binned SAH over the centroid bounds
+		AABB centroidBounds = { centroids[elements[first]], centroids[elements[first]] };
+		for (uint32_t i = first + 1; i < first + count; i++) {
+			centroidBounds.a = glm::min(centroidBounds.a, centroids[elements[i]]);
+			centroidBounds.b = glm::max(centroidBounds.b, centroids[elements[i]]);
+		}
+
+		Split best;
+		float bestCost = std::numeric_limits<float>::max();
+		for (int axis = 0; axis < 3; axis++) {
+			float extent = centroidBounds.b[axis] - centroidBounds.a[axis];
+			if (extent <= 0.f) continue;
+
+			Split split = { axis, 0, centroidBounds.a[axis], BVH_BINS / extent };
+
+			std::array<AABB, BVH_BINS> binBounds;
+			std::array<uint32_t, BVH_BINS> binCounts{};
+			binBounds.fill(EMPTY_AABB);
+			for (uint32_t i = first; i < first + count; i++) {
+				uint32_t bin = split.binOf(centroids[elements[i]]);
+				binCounts[bin]++;
+				binBounds[bin] = merge(binBounds[bin], triBounds[elements[i]]);
+			}
+
+			std::array<float, BVH_BINS - 1> leftCost;
+			AABB bounds = EMPTY_AABB;
+			uint32_t sum = 0;
+			for (uint32_t i = 0; i < BVH_BINS - 1; i++) {
+				bounds = merge(bounds, binBounds[i]);
+				sum += binCounts[i];
+				leftCost[i] = sum ? sum * surfaceArea(bounds) : 0.f;
+			}
+
+			bounds = EMPTY_AABB;
+			sum = 0;
+			for (uint32_t i = BVH_BINS - 1; i > 0; i--) {
+				bounds = merge(bounds, binBounds[i]);
+				sum += binCounts[i];
+				float cost = leftCost[i - 1] + (sum ? sum * surfaceArea(bounds) : 0.f);
+				if (sum && sum != count && cost < bestCost) {
+					bestCost = cost;
+					best = split;
+					best.bin = i - 1;
+				}
+			}
+		}
+
+		if (best.axis < 0) {
+			return;
+		}
+
+		if (count <= MAX_BVH_LEAF_ELEMENTS && bestCost >= count * surfaceArea(node.aabb)) {
+			return;
+		}
+
+		auto mid = std::partition(elements.begin() + first, elements.begin() + first + count, [&](uint32_t element) {
+			return best.binOf(centroids[element]) <= best.bin;
+		});
+		uint32_t leftCount = static_cast<uint32_t>(mid - (elements.begin() + first));
+
+		node.left = nodeId + 1;
+		node.right = nodeId + 2 * leftCount;
+
+		if (count > PARALLEL_BVH_ELEMENTS && depth < MAX_PARALLEL_BVH_DEPTH) {
+			util::TaskGroup group;
+			group.run([&]() {
+				buildNode(buildNodes, node.left, first, leftCount, depth + 1);
+			});
+			buildNode(buildNodes, node.right, first + leftCount, count - leftCount, depth + 1);
+			group.wait();
+		} else {
+			buildNode(buildNodes, node.left, first, leftCount, depth + 1);
+			buildNode(buildNodes, node.right, first + leftCount, count - leftCount, depth + 1);
+		}
+	}
+}
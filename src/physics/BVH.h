@@ -0,0 +1,66 @@
+#pragma once
+
+#include "Objects.h"
+#include "Broadphase.h"
+#include <vector>
+#include <deque>
+#include <memory>
+#include <cstdint>
+#include <glm/glm.hpp>
+
+namespace amaz {
+
+	// Inner nodes have count == 0 and their two children at leftFirst and leftFirst + 1,
+	// leaves cover elements [leftFirst, leftFirst + count)
+	struct BVHNode {
+		glm::vec3 min;
+		uint32_t leftFirst = 0;
+		glm::vec3 max;
+		uint32_t count = 0;
+	};
+
+	static_assert(sizeof(BVHNode) == 32, "BVHNode should stay 32 bytes so two fit in a cache line");
+
+	// Binned SAH bounding volume hierarchy, every triangle is referenced exactly once
+	class BVH : public Broadphase {
+	public:
+		[[nodiscard]] static std::shared_ptr<BVH> create();
+
+		void addElement(size_t tri) override;
+		void bake() override;
+		bool serialize(std::vector<std::byte>& out) const override;
+		bool deserialize(std::span<const std::byte> data) override;
+
+		std::deque<size_t> getElements(AABB aabb, size_t& count) const override;
+		void visit(AABB aabb, BroadphaseQuery& query, ElementVisitor visitor) const override;
+		void traceRays(RayPacket& packet, LeafVisitor visitor) const override;
+
+		size_t nodeCount() const {
+			return nodes.size();
+		}
+
+		size_t elementCount() const {
+			return elements.size();
+		}
+
+	private:
+		BVH() = default;
+
+		struct BuildNode {
+			AABB aabb;
+			uint32_t left = 0, right = 0;
+			uint32_t first = 0, count = 0;
+		};
+
+		void buildNode(std::vector<BuildNode>& buildNodes, uint32_t nodeId, uint32_t first, uint32_t count, uint32_t depth);
+
+		std::vector<uint32_t> pending;
+
+		// per element bounds, only alive during bake
+		std::vector<AABB> triBounds;
+		std::vector<glm::vec3> centroids;
+
+		std::vector<BVHNode> nodes;
+		std::vector<uint32_t> elements;
+	};
+}
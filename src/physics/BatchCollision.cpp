@@ -0,0 +1,155 @@
+#include "BatchCollision.h"
+
+#include "Collision.h"
+#include "../util/simd.hpp"
+#include <array>
+
+namespace amaz {
+
+	using namespace util::simd;
+
+	namespace {
+		struct TriangleLanes {
+			vec3x8 a, b, c, n;
+			vec3x8 ab, bc, ca;
+			float8 planeDist;
+		};
+
+		vec3x8 broadcast(glm::vec3 v) {
+			return { v.x, v.y, v.z };
+		}
+
+		vec3x8 closestPointOnLine(const vec3x8& a, const vec3x8& ab, const vec3x8& point) {
+			float8 t = dot(point - a, ab) / dot(ab, ab);
+			return a + ab * clamp(t, 0.f, 1.f);
+		}
+
+		mask8 insideTriangle(const TriangleLanes& tri, const vec3x8& point) {
+			float8 zero = 0.f;
+			return (dot(cross(point - tri.a, tri.ab), tri.n) <= zero)
+				& (dot(cross(point - tri.b, tri.bc), tri.n) <= zero)
+				& (dot(cross(point - tri.c, tri.ca), tri.n) <= zero);
+		}
+
+		// closest point on any of the edges and its squared distance, ties go to the earlier edge like the scalar version
+		vec3x8 closestPointOnEdges(const TriangleLanes& tri, const vec3x8& point, float8& bestDistSq) {
+			vec3x8 best = closestPointOnLine(tri.a, tri.ab, point);
+			vec3x8 d = point - best;
+			bestDistSq = dot(d, d);
+
+			vec3x8 edgePoint = closestPointOnLine(tri.b, tri.bc, point);
+			d = point - edgePoint;
+			float8 distSq = dot(d, d);
+			mask8 closer = distSq < bestDistSq;
+			best = select(closer, edgePoint, best);
+			bestDistSq = select(closer, distSq, bestDistSq);
+
+			edgePoint = closestPointOnLine(tri.c, tri.ca, point);
+			d = point - edgePoint;
+			distSq = dot(d, d);
+			closer = distSq < bestDistSq;
+			best = select(closer, edgePoint, best);
+			bestDistSq = select(closer, distSq, bestDistSq);
+
+			return best;
+		}
+
+		// matches Physics::closestPointOnTriangle, points inside the edges are returned as is
+		vec3x8 closestPointOnTriangle(const TriangleLanes& tri, const vec3x8& point) {
+			float8 distSq;
+			vec3x8 edgePoint = closestPointOnEdges(tri, point, distSq);
+			return select(insideTriangle(tri, point), point, edgePoint);
+		}
+
+		vec3x8 gather(const std::vector<float>& x, const std::vector<float>& y, const std::vector<float>& z, const uint32_t* ids) {
+			return { util::simd::gather(x.data(), ids), util::simd::gather(y.data(), ids), util::simd::gather(z.data(), ids) };
+		}
+
+		TriangleLanes loadTriangles(const TriangleStore& store, const uint32_t* ids) {
+			TriangleLanes tri;
+			tri.a = gather(store.ax, store.ay, store.az, ids);
+			tri.b = gather(store.bx, store.by, store.bz, ids);
+			tri.c = gather(store.cx, store.cy, store.cz, ids);
+			tri.n = gather(store.nx, store.ny, store.nz, ids);
+			tri.ab = gather(store.abx, store.aby, store.abz, ids);
+			tri.bc = gather(store.bcx, store.bcy, store.bcz, ids);
+			tri.ca = gather(store.cax, store.cay, store.caz, ids);
+			tri.planeDist = util::simd::gather(store.planeDist.data(), ids);
+			return tri;
+		}
+	}
+
+	void capsuleVsTriangles(Capsule capsule, std::span<const uint32_t> tris, std::vector<TriangleContact>& contacts) {
+		if (tris.empty()) return;
+
+		const TriangleStore& store = getTriangleStore();
+
+		glm::vec3 capsuleDir = glm::normalize(capsule.tip - capsule.base);
+		glm::vec3 endA = capsule.base + capsuleDir * capsule.radius;
+		glm::vec3 endB = capsule.tip - capsuleDir * capsule.radius;
+
+		vec3x8 dir = broadcast(capsuleDir);
+		vec3x8 base = broadcast(capsule.base);
+		vec3x8 a = broadcast(endA);
+		vec3x8 ab = broadcast(endB - endA);
+		float8 radius = capsule.radius;
+		float8 radiusSq = capsule.radius * capsule.radius;
+		float8 zero = 0.f;
+
+		alignas(32) std::array<uint32_t, WIDTH> ids;
+		alignas(32) std::array<float, WIDTH> depths, nx, ny, nz;
+
+		for (size_t first = 0; first < tris.size(); first += WIDTH) {
+			// pad the last batch by repeating its last triangle, the padded lanes are masked off below
+			size_t laneCount = std::min<size_t>(WIDTH, tris.size() - first);
+			for (size_t i = 0; i < WIDTH; i++) {
+				ids[i] = tris[first + std::min(i, laneCount - 1)];
+			}
+			uint32_t validLanes = (1u << laneCount) - 1;
+
+			TriangleLanes tri = loadTriangles(store, ids.data());
+
+			// point on the capsule axis closest to the triangle, see Physics::CapsuleVsTriangle
+			float8 absDot = abs(dot(tri.n, dir));
+			float8 t = (tri.planeDist - dot(tri.n, base)) / absDot;
+			vec3x8 linePlaneIntersection = base + dir * t;
+			vec3x8 center = closestPointOnLine(a, ab, closestPointOnTriangle(tri, linePlaneIntersection));
+
+			mask8 parallel = absDot == zero;
+			if (bits(parallel) & validLanes) {
+				vec3x8 triBestA = closestPointOnTriangle(tri, a);
+				vec3x8 triBestB = closestPointOnTriangle(tri, a + ab);
+				vec3x8 bestA = closestPointOnLine(a, ab, triBestA);
+				vec3x8 bestB = closestPointOnLine(a, ab, triBestB);
+				vec3x8 dA = bestA - triBestA;
+				vec3x8 dB = bestB - triBestB;
+				center = select(parallel, select(dot(dA, dA) < dot(dB, dB), bestA, bestB), center);
+			}
+
+			// sphere at that point vs the triangle, see Physics::SphereVsTriangle
+			float8 dist = dot(center, tri.n) - tri.planeDist;
+			mask8 onPlane = abs(dist) <= radius;
+			vec3x8 projected = center - tri.n * dist;
+			mask8 inside = insideTriangle(tri, projected);
+
+			float8 edgeDistSq;
+			closestPointOnEdges(tri, center, edgeDistSq);
+			mask8 collided = onPlane & (inside | (edgeDistSq < radiusSq));
+
+			uint32_t hits = bits(collided) & validLanes;
+			if (!hits) continue;
+
+			float8 depth = radius - select(inside, abs(dist), sqrt(edgeDistSq));
+			depth.store(depths.data());
+			tri.n.x.store(nx.data());
+			tri.n.y.store(ny.data());
+			tri.n.z.store(nz.data());
+
+			for (uint32_t lane = 0; lane < WIDTH; lane++) {
+				if (hits & (1u << lane)) {
+					contacts.push_back({ ids[lane], depths[lane], { nx[lane], ny[lane], nz[lane] } });
+				}
+			}
+		}
+	}
+}
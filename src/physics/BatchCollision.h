@@ -0,0 +1,22 @@
+#pragma once
+
+#include "Objects.h"
+#include <vector>
+#include <span>
+#include <cstdint>
+#include <glm/glm.hpp>
+
+namespace amaz {
+
+	struct TriangleContact {
+		uint32_t tri;
+		float depth;
+		glm::vec3 normal;
+		// instance of a CollisionScene the triangle was tested in
+		uint32_t instance = 0;
+	};
+
+	// Tests one capsule against 8 triangles at a time from the TriangleStore and appends every triangle
+	// it penetrates to contacts. Gives the same results as Physics::CapsuleVsTriangle.
+	void capsuleVsTriangles(Capsule capsule, std::span<const uint32_t> tris, std::vector<TriangleContact>& contacts);
+}
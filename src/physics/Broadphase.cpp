@@ -0,0 +1,20 @@
+#include "Broadphase.h"
+
+#include "Octree.h"
+#include "BVH.h"
+#include "LooseOctree.h"
+
+namespace amaz {
+
+	std::shared_ptr<Broadphase> createBroadphase(BroadphaseType type) {
+		switch (type) {
+		case BroadphaseType::BVH:
+			return BVH::create();
+		case BroadphaseType::LooseOctree:
+			return LooseOctree::create();
+		case BroadphaseType::Octree:
+		default:
+			return Octree::create({ { -65536.f, -65536.f, -65536.f }, { 65536.f, 65536.f, 65536.f } });
+		}
+	}
+}
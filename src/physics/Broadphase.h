@@ -0,0 +1,215 @@
+#pragma once
+
+#include "Objects.h"
+#include "../util/simd.hpp"
+#include <deque>
+#include <span>
+#include <utility>
+#include <memory>
+#include <vector>
+#include <cstdint>
+#include <type_traits>
+#include <algorithm>
+#include <cstddef>
+#include <cstring>
+
+namespace amaz {
+
+	enum class BroadphaseType {
+		Octree,
+		BVH,
+		LooseOctree
+	};
+
+	struct BroadphaseQueryStats {
+		uint32_t nodesVisited = 0;
+		uint32_t trianglesEmitted = 0;
+	};
+
+	// Per caller scratch state for Broadphase::query/visit. Triangles are deduplicated by stamping them
+	// with the current query's epoch, so nothing has to be sorted and nothing is allocated once the
+	// stamp array covers every registered triangle.
+	class BroadphaseQuery {
+	public:
+		void begin(uint32_t elementRange) {
+			if (stamps.size() < elementRange) {
+				stamps.resize(elementRange, 0);
+			}
+			if (++epoch == 0) {
+				std::fill(stamps.begin(), stamps.end(), 0);
+				epoch = 1;
+			}
+			stats = {};
+		}
+
+		// true the first time tri is seen since begin()
+		bool mark(uint32_t tri) {
+			if (stamps[tri] == epoch) return false;
+			stamps[tri] = epoch;
+			return true;
+		}
+
+		BroadphaseQueryStats stats;
+
+	private:
+		std::vector<uint32_t> stamps;
+		uint32_t epoch = 0;
+	};
+
+	// Non owning reference to a callable, unlike std::function it never allocates
+	template <typename Signature>
+	class FunctionRef;
+
+	template <typename R, typename... Args>
+	class FunctionRef<R(Args...)> {
+	public:
+		template <typename F> requires (!std::is_same_v<std::remove_cvref_t<F>, FunctionRef>)
+		FunctionRef(F&& f) : object(const_cast<void*>(static_cast<const void*>(&f))) {
+			call = [](void* o, Args... args) -> R {
+				return (*static_cast<std::remove_reference_t<F>*>(o))(std::forward<Args>(args)...);
+			};
+		}
+
+		R operator()(Args... args) const {
+			return call(object, std::forward<Args>(args)...);
+		}
+
+	private:
+		void* object;
+		R (*call)(void*, Args...);
+	};
+
+	// called with a triangle id
+	using ElementVisitor = FunctionRef<void(uint32_t)>;
+
+	// called with the triangles of a leaf a ray packet reached, visitors lower RayPacket::maxT as they find hits
+	using LeafVisitor = FunctionRef<void(std::span<const uint32_t>)>;
+
+	// Up to 8 rays traced through a broadphase together. t is measured in multiples of each ray's dir.
+	struct RayPacket {
+		util::simd::vec3x8 origin;
+		util::simd::vec3x8 invDir;
+		// closest hit so far per lane, nodes entered after it are skipped
+		util::simd::float8 maxT;
+		util::simd::mask8 active;
+		// direction of the first ray, used to visit children front to back
+		glm::vec3 dir;
+
+		// lanes of the packet a node's bounds are hit by before maxT
+		util::simd::mask8 hits(glm::vec3 min, glm::vec3 max) const {
+			using namespace util::simd;
+			vec3x8 t1 = (vec3x8{ min.x, min.y, min.z } - origin) * invDir;
+			vec3x8 t2 = (vec3x8{ max.x, max.y, max.z } - origin) * invDir;
+			float8 tNear = util::simd::max(util::simd::max(util::simd::min(t1.x, t2.x), util::simd::min(t1.y, t2.y)), util::simd::min(t1.z, t2.z));
+			float8 tFar = util::simd::min(util::simd::min(util::simd::max(t1.x, t2.x), util::simd::max(t1.y, t2.y)), util::simd::max(t1.z, t2.z));
+			return active & (tNear <= tFar) & (tNear <= maxT) & (float8(0.f) <= tFar);
+		}
+	};
+
+	// Acceleration structure over the static triangles registered with amaz::registerTri.
+	// Elements are added and then baked once, queries never modify the structure so any number of threads
+	// can query a baked broadphase at the same time, each with its own BroadphaseQuery.
+	class Broadphase {
+	public:
+		virtual ~Broadphase() = default;
+
+		virtual void addElement(size_t tri) = 0;
+
+		// Rebuilds the structure from every element added so far, must not run while it is being queried
+		virtual void bake() = 0;
+
+		// false if elements were added since the last bake, queries won't see those yet
+		bool isBaked() const {
+			return !dirty;
+		}
+
+		// count is incremented for every node visited, triangles may be returned more than once
+		virtual std::deque<size_t> getElements(AABB aabb, size_t& count) const = 0;
+
+		// Calls visitor once for every triangle whose bounds overlap aabb
+		virtual void visit(AABB aabb, BroadphaseQuery& query, ElementVisitor visitor) const = 0;
+
+		// Walks every leaf the packet's rays pass through, roughly front to back so closer hits cull more
+		virtual void traceRays(RayPacket& packet, LeafVisitor visitor) const = 0;
+
+		// Appends the baked structure as plain bytes for the collision cache, false if this broadphase can't be saved
+		virtual bool serialize(std::vector<std::byte>& /*out*/) const {
+			return false;
+		}
+
+		// Takes the place of bake() with what serialize wrote for the same elements, which must have been added
+		// in the same order. Returns false and leaves the broadphase unbaked if data doesn't match them.
+		virtual bool deserialize(std::span<const std::byte> /*data*/) {
+			return false;
+		}
+
+		// Same as visit but fills out, which is cleared first and keeps its capacity between calls
+		void query(AABB aabb, BroadphaseQuery& query, std::vector<uint32_t>& out) const {
+			out.clear();
+			visit(aabb, query, [&](uint32_t tri) {
+				out.push_back(tri);
+			});
+		}
+
+	protected:
+		// arrays are stored as their length followed by their elements
+		template <typename T>
+		static void writeArray(std::vector<std::byte>& out, std::span<const T> values) {
+			static_assert(std::is_trivially_copyable_v<T>);
+			uint64_t count = values.size();
+			size_t offset = out.size();
+			out.resize(offset + sizeof(count) + values.size_bytes());
+			std::memcpy(out.data() + offset, &count, sizeof(count));
+			if (!values.empty()) {
+				std::memcpy(out.data() + offset + sizeof(count), values.data(), values.size_bytes());
+			}
+		}
+
+		// reads an array written by writeArray from the front of data and advances it
+		template <typename T>
+		static bool readArray(std::span<const std::byte>& data, std::vector<T>& values) {
+			static_assert(std::is_trivially_copyable_v<T>);
+			uint64_t count;
+			if (data.size() < sizeof(count)) return false;
+			std::memcpy(&count, data.data(), sizeof(count));
+			data = data.subspan(sizeof(count));
+			if (count > data.size() / sizeof(T)) return false;
+
+			values.resize(count);
+			if (count) {
+				std::memcpy(values.data(), data.data(), count * sizeof(T));
+			}
+			data = data.subspan(count * sizeof(T));
+			return true;
+		}
+
+		// Element ids are stored relative to the lowest one added, so a saved broadphase still matches when its
+		// triangles were registered after some others
+		static void writeElements(std::vector<std::byte>& out, std::span<const uint32_t> ids, uint32_t base) {
+			std::vector<uint32_t> relative(ids.begin(), ids.end());
+			for (auto& id : relative) {
+				id -= base;
+			}
+			writeArray(out, std::span<const uint32_t>(relative));
+		}
+
+		static bool readElements(std::span<const std::byte>& data, std::vector<uint32_t>& ids, uint32_t base) {
+			if (!readArray(data, ids)) return false;
+			for (auto& id : ids) {
+				id += base;
+			}
+			return true;
+		}
+
+		static uint32_t lowestElement(const std::vector<uint32_t>& ids) {
+			return ids.empty() ? 0 : *std::min_element(ids.begin(), ids.end());
+		}
+
+		bool dirty = false;
+
+		// one past the highest triangle id added, the size a BroadphaseQuery stamp array needs
+		uint32_t elementRange = 0;
+	};
+
+	std::shared_ptr<Broadphase> createBroadphase(BroadphaseType type);
+}
@@ -0,0 +1,33 @@
+#include "CandidateCache.h"
+
+namespace amaz {
+
+	namespace {
+		bool contains(AABB outer, AABB inner) {
+			return outer.a.x <= inner.a.x && outer.a.y <= inner.a.y && outer.a.z <= inner.a.z &&
+				inner.b.x <= outer.b.x && inner.b.y <= outer.b.y && inner.b.z <= outer.b.z;
+		}
+	}
+
+	bool CandidateCache::update(const CollisionScene& scene, AABB aabb, BroadphaseQuery& query, std::vector<uint32_t>& scratch) {
+		if (_valid && contains(_bounds, aabb)) {
+			_hits++;
+			return true;
+		}
+
+		_misses++;
+		_bounds = { aabb.a - glm::vec3(_margin), aabb.b + glm::vec3(_margin) };
+		_ranges.clear();
+		_triangles.clear();
+		scene.visitInstances(_bounds, [&](uint32_t id) {
+			const CollisionInstance& instance = scene.instance(id);
+			scene.mesh(instance.mesh).broadphase->query(instance.aabbToLocal(_bounds), query, scratch);
+			if (scratch.empty()) return;
+
+			_ranges.push_back({ id, static_cast<uint32_t>(_triangles.size()), static_cast<uint32_t>(scratch.size()) });
+			_triangles.insert(_triangles.end(), scratch.begin(), scratch.end());
+		});
+		_valid = true;
+		return false;
+	}
+}
@@ -0,0 +1,72 @@
+#pragma once
+
+#include "Objects.h"
+#include "Broadphase.h"
+#include "CollisionScene.h"
+#include <span>
+#include <vector>
+#include <cstdint>
+
+namespace amaz {
+
+	// Candidate triangles around one moving character. The scene is queried with the character's bounds grown by
+	// a margin, and the result is reused for as long as the bounds it's asked for stay inside that. Characters move
+	// a few centimetres a tick, so most ticks skip the broadphase entirely.
+	class CandidateCache {
+	public:
+		// triangles of one instance, in the instance's local space
+		struct Range {
+			uint32_t instance;
+			uint32_t first;
+			uint32_t count;
+		};
+
+		explicit CandidateCache(float margin) : _margin(margin) {
+		}
+
+		// Makes sure the cache holds every triangle whose bounds overlap aabb, querying the scene again if it doesn't.
+		// query and scratch are only used while requerying, so one set can be shared by every cache a thread updates.
+		// Returns true if the cached triangles were reused.
+		bool update(const CollisionScene& scene, AABB aabb, BroadphaseQuery& query, std::vector<uint32_t>& scratch);
+
+		// Forget the cached triangles, call when the scene changes
+		void invalidate() {
+			_valid = false;
+		}
+
+		std::span<const Range> ranges() const {
+			return _ranges;
+		}
+
+		std::span<const uint32_t> triangles(const Range& range) const {
+			return { _triangles.data() + range.first, range.count };
+		}
+
+		// bounds the cached triangles were queried with
+		AABB bounds() const {
+			return _bounds;
+		}
+
+		uint64_t hits() const {
+			return _hits;
+		}
+
+		uint64_t misses() const {
+			return _misses;
+		}
+
+		float hitRate() const {
+			return _hits + _misses ? static_cast<float>(_hits) / (_hits + _misses) : 0.f;
+		}
+
+	private:
+		float _margin;
+		bool _valid = false;
+		AABB _bounds;
+		std::vector<Range> _ranges;
+		std::vector<uint32_t> _triangles;
+
+		uint64_t _hits = 0;
+		uint64_t _misses = 0;
+	};
+}
@@ -0,0 +1,124 @@
+#include "CharacterSystem.h"
+#include "Physics.h"
+#include "PhysicsState.h"
+
+#include "../util/thread_pool.hpp"
+
+// the player's numbers, so a character moves like the player does
+constexpr float CHARACTER_GRAVITY = 36.f;
+constexpr float CHARACTER_TERMINAL_VELOCITY = -240.f;
+constexpr float CHARACTER_JUMP_VELOCITY = 18.f;
+
+// characters handed to each thread pool task at least, a character takes a few microseconds
+constexpr size_t PARALLEL_CHARACTERS = 64;
+
+// same margin as the player's cache
+constexpr float CHARACTER_CANDIDATE_MARGIN = 0.5f;
+
+namespace amaz {
+
+	CharacterSystem::CharacterSystem(Physics& physics) : _physics(physics) {
+	}
+
+	uint32_t CharacterSystem::add(glm::vec3 position) {
+		uint32_t id = static_cast<uint32_t>(_positions.size());
+		_positions.push_back(position);
+		_moves.push_back(glm::vec3(0.f));
+		_yVelocities.push_back(0.f);
+		_grounded.push_back(0);
+		_jumps.push_back(0);
+		_candidates.emplace_back(CHARACTER_CANDIDATE_MARGIN);
+		return id;
+	}
+
+	void CharacterSystem::clear() {
+		_positions.clear();
+		_moves.clear();
+		_yVelocities.clear();
+		_grounded.clear();
+		_jumps.clear();
+		_candidates.clear();
+	}
+
+	void CharacterSystem::setMove(uint32_t id, glm::vec3 velocity) {
+		_moves[id] = { velocity.x, 0.f, velocity.z };
+	}
+
+	void CharacterSystem::jump(uint32_t id) {
+		_jumps[id] = 1;
+	}
+
+	void CharacterSystem::setPosition(uint32_t id, glm::vec3 position) {
+		_positions[id] = position;
+		_yVelocities[id] = 0.f;
+	}
+
+	void CharacterSystem::invalidateCandidates() {
+		for (auto& cache : _candidates) {
+			cache.invalidate();
+		}
+	}
+
+	void CharacterSystem::step(float seconds) {
+		if (_scratch.size() < util::chunkCount(_positions.size(), PARALLEL_CHARACTERS)) {
+			_scratch.resize(util::chunkCount(_positions.size(), PARALLEL_CHARACTERS));
+		}
+
+		util::parallelChunks(_positions.size(), PARALLEL_CHARACTERS, [&](size_t chunk, size_t begin, size_t end) {
+			CharacterScratch& scratch = _scratch[chunk];
+
+			for (size_t id = begin; id < end; id++) {
+				float& yVelocity = _yVelocities[id];
+				if (_jumps[id] && _grounded[id]) {
+					yVelocity += CHARACTER_JUMP_VELOCITY;
+				}
+				_jumps[id] = 0;
+
+				if (yVelocity > CHARACTER_TERMINAL_VELOCITY) {
+					yVelocity -= CHARACTER_GRAVITY * seconds;
+				}
+
+				bool grounded = false;
+				glm::vec3 pos = _positions[id];
+				glm::vec3 motion = _moves[id] * seconds + glm::vec3{ 0, yVelocity * seconds, 0 };
+
+				// the player's order, sweep so nothing tunnels and then push out of what still overlaps
+				motion = _physics.slideCharacter(_shape, pos, motion, _candidates[id], scratch, grounded, nullptr) - pos;
+				_physics.resolveCharacter(_shape, pos, motion, _candidates[id], scratch, grounded, nullptr);
+				_positions[id] = pos + motion;
+
+				if (grounded) {
+					yVelocity = 0;
+				}
+				_grounded[id] = grounded;
+			}
+		});
+	}
+
+	void CharacterSystem::saveState(CharacterSystemState& state) const {
+		state.positions = _positions;
+		state.moves = _moves;
+		state.yVelocities = _yVelocities;
+		state.grounded = _grounded;
+		state.jumps = _jumps;
+	}
+
+	void CharacterSystem::restoreState(const CharacterSystemState& state) {
+		_positions = state.positions;
+		_moves = state.moves;
+		_yVelocities = state.yVelocities;
+		_grounded = state.grounded;
+		_jumps = state.jumps;
+		// characters added since the state was saved are gone again, ones removed since get an empty cache back
+		_candidates.resize(_positions.size(), CandidateCache(CHARACTER_CANDIDATE_MARGIN));
+	}
+
+	CharacterSystemStats CharacterSystem::stats() const {
+		CharacterSystemStats stats;
+		for (const auto& cache : _candidates) {
+			stats.cacheHits += cache.hits();
+			stats.cacheMisses += cache.misses();
+		}
+		return stats;
+	}
+}
@@ -0,0 +1,95 @@
+#pragma once
+
+#include "Objects.h"
+#include "Broadphase.h"
+#include "BatchCollision.h"
+#include "CandidateCache.h"
+#include "Heightfield.h"
+#include <span>
+#include <vector>
+#include <cstdint>
+#include <glm/glm.hpp>
+
+namespace amaz {
+
+	class Physics;
+	struct CharacterSystemState;
+
+	// Scratch for moving one character at a time, reused so stepping doesn't allocate.
+	// Every thread moving characters needs its own.
+	struct CharacterScratch {
+		BroadphaseQuery query;
+		std::vector<uint32_t> candidates;
+		std::vector<TriangleContact> contacts;
+		std::vector<HeightfieldContact> terrainContacts;
+	};
+
+	// Characters answered from their candidate caches over every step since they were added
+	struct CharacterSystemStats {
+		uint64_t cacheHits = 0;
+		uint64_t cacheMisses = 0;
+	};
+
+	// A crowd of capsule characters walking on the static collision meshes and terrain with the same sweep and resolve as the
+	// player. State is kept as one array per field and characters don't collide with each other, so they are moved
+	// in independent chunks on the thread pool.
+	class CharacterSystem {
+	public:
+		explicit CharacterSystem(Physics& physics);
+
+		// The capsule around every character's position, the player's shape unless changed. Set before adding any.
+		void setShape(Capsule shape) {
+			_shape = shape;
+		}
+
+		Capsule shape() const {
+			return _shape;
+		}
+
+		uint32_t add(glm::vec3 position);
+		void clear();
+
+		// Horizontal velocity in units per second, kept until it's changed
+		void setMove(uint32_t id, glm::vec3 velocity);
+		// Jumps at the start of the next step if the character is on the ground then
+		void jump(uint32_t id);
+		void setPosition(uint32_t id, glm::vec3 position);
+
+		void step(float seconds);
+
+		// Forget every character's cached triangles, called when the collision scene is baked again
+		void invalidateCandidates();
+
+		size_t size() const {
+			return _positions.size();
+		}
+
+		std::span<const glm::vec3> positions() const {
+			return _positions;
+		}
+
+		// 1 for characters that stood on something during the last step
+		std::span<const uint8_t> grounded() const {
+			return _grounded;
+		}
+
+		CharacterSystemStats stats() const;
+
+		void saveState(CharacterSystemState& state) const;
+		void restoreState(const CharacterSystemState& state);
+
+	private:
+		Physics& _physics;
+		Capsule _shape;
+
+		std::vector<glm::vec3> _positions;
+		std::vector<glm::vec3> _moves;
+		std::vector<float> _yVelocities;
+		std::vector<uint8_t> _grounded;
+		std::vector<uint8_t> _jumps;
+		std::vector<CandidateCache> _candidates;
+
+		// one per step chunk, kept so their query stamps are only sized once
+		std::vector<CharacterScratch> _scratch;
+	};
+}
@@ -5,7 +5,7 @@
 
 
 namespace amaz {
-	std::vector<Triangle> tris;
+	TriangleStore store;
 
 	bool rayVsAABB(Ray ray, AABB aabb, glm::vec3& colPoint, glm::vec3& colNormal, float& t) {
 		glm::vec3 t_near = (aabb.a - ray.origin) / ray.dir;
@@ -96,25 +96,72 @@ namespace amaz {
 	}
 
 	AABB getAABBFromTriangle(size_t tri) {
-		return getAABBFromTriangle(tris[tri]);
+		return store.aabb(tri);
 	}
 
 	Triangle getTriFromId(size_t id) {
-		if (id > tris.size()) return {};
-		return tris[id];
+		if (id >= store.size()) return {};
+		return store.triangle(id);
 	}
 
 	size_t trisCount() {
-		return tris.size();
+		return store.size();
 	}
 
 	size_t registerTri(Triangle tri) {
-		int id = tris.size();
-		tris.push_back(tri);
-		return id;
+		return store.add(tri);
+	}
+
+	size_t registerTri(const CookedTriangle& tri) {
+		return store.add(tri);
+	}
+
+	CookedTriangle cookTriangle(Triangle tri) {
+		glm::vec3 normal = glm::normalize(glm::cross(tri.b - tri.a, tri.c - tri.a));
+		return { tri, normal, glm::dot(normal, tri.a), getAABBFromTriangle(tri) };
+	}
+
+	void reserveTris(size_t count) {
+		store.reserve(count);
+	}
+
+	const TriangleStore& getTriangleStore() {
+		return store;
 	}
 
+	uint32_t TriangleStore::add(Triangle tri) {
+		return add(cookTriangle(tri));
+	}
+
+	uint32_t TriangleStore::add(const CookedTriangle& cooked) {
+		uint32_t id = static_cast<uint32_t>(size());
+		const Triangle& tri = cooked.tri;
+
+		ax.push_back(tri.a.x); ay.push_back(tri.a.y); az.push_back(tri.a.z);
+		bx.push_back(tri.b.x); by.push_back(tri.b.y); bz.push_back(tri.b.z);
+		cx.push_back(tri.c.x); cy.push_back(tri.c.y); cz.push_back(tri.c.z);
 
+		glm::vec3 ab = tri.b - tri.a;
+		glm::vec3 bc = tri.c - tri.b;
+		glm::vec3 ca = tri.a - tri.c;
+		abx.push_back(ab.x); aby.push_back(ab.y); abz.push_back(ab.z);
+		bcx.push_back(bc.x); bcy.push_back(bc.y); bcz.push_back(bc.z);
+		cax.push_back(ca.x); cay.push_back(ca.y); caz.push_back(ca.z);
 
+		nx.push_back(cooked.normal.x); ny.push_back(cooked.normal.y); nz.push_back(cooked.normal.z);
+		planeDist.push_back(cooked.planeDist);
 
+		const AABB& aabb = cooked.aabb;
+		minX.push_back(aabb.a.x); minY.push_back(aabb.a.y); minZ.push_back(aabb.a.z);
+		maxX.push_back(aabb.b.x); maxY.push_back(aabb.b.y); maxZ.push_back(aabb.b.z);
+
+		return id;
+	}
+
+	void TriangleStore::reserve(size_t count) {
+		for (auto* component : { &ax, &ay, &az, &bx, &by, &bz, &cx, &cy, &cz, &nx, &ny, &nz, &planeDist,
+			&abx, &aby, &abz, &bcx, &bcy, &bcz, &cax, &cay, &caz, &minX, &minY, &minZ, &maxX, &maxY, &maxZ }) {
+			component->reserve(count);
+		}
+	}
 }
\ No newline at end of file
@@ -1,6 +1,8 @@
 #pragma once
 
 #include "Objects.h"
+#include <vector>
+#include <cstdint>
 
 namespace amaz {
 	bool rayVsAABB(Ray ray, AABB aabb, glm::vec3& colPoint, glm::vec3& colNormal, float& t);
@@ -12,5 +14,62 @@ namespace amaz {
 	AABB getAABBFromTriangle(size_t tri);
 	Triangle getTriFromId(size_t id);
 	size_t trisCount();
+	// A triangle with the values TriangleStore derives from it, the layout cooked collision files store
+	struct CookedTriangle {
+		Triangle tri;
+		glm::vec3 normal;
+		float planeDist;
+		AABB aabb;
+	};
+
+	CookedTriangle cookTriangle(Triangle tri);
+
 	size_t registerTri(Triangle tri);
+	size_t registerTri(const CookedTriangle& tri);
+	void reserveTris(size_t count);
+
+	// Every registered triangle together with everything the broadphase and narrowphase need from it,
+	// computed once when the triangle is added. Stored per component so batched tests can load 8 at once.
+	class TriangleStore {
+	public:
+		uint32_t add(Triangle tri);
+		// skips computing the normal and bounds again
+		uint32_t add(const CookedTriangle& tri);
+		void reserve(size_t count);
+
+		size_t size() const {
+			return ax.size();
+		}
+
+		Triangle triangle(size_t id) const {
+			return { { ax[id], ay[id], az[id] }, { bx[id], by[id], bz[id] }, { cx[id], cy[id], cz[id] } };
+		}
+
+		glm::vec3 normal(size_t id) const {
+			return { nx[id], ny[id], nz[id] };
+		}
+
+		AABB aabb(size_t id) const {
+			return { { minX[id], minY[id], minZ[id] }, { maxX[id], maxY[id], maxZ[id] } };
+		}
+
+		// vertices
+		std::vector<float> ax, ay, az;
+		std::vector<float> bx, by, bz;
+		std::vector<float> cx, cy, cz;
+
+		// unit normal and plane distance, dot(normal, a)
+		std::vector<float> nx, ny, nz;
+		std::vector<float> planeDist;
+
+		// edges b - a, c - b and a - c
+		std::vector<float> abx, aby, abz;
+		std::vector<float> bcx, bcy, bcz;
+		std::vector<float> cax, cay, caz;
+
+		std::vector<float> minX, minY, minZ;
+		std::vector<float> maxX, maxY, maxZ;
+	};
+
+	const TriangleStore& getTriangleStore();
 }
\ No newline at end of file
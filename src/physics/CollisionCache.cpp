@@ -0,0 +1,126 @@
+#include "CollisionCache.h"
+
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <cstring>
+#include <cstdio>
+#include <vector>
+
+// bump whenever CookedTriangle, the cooking math or a broadphase's serialized layout changes
+constexpr uint32_t COOKED_FORMAT_VERSION = 2;
+constexpr uint32_t COOKED_MESH_MAGIC = 0x4c4f4341; // "ACOL"
+constexpr uint32_t COOKED_BROADPHASE_MAGIC = 0x50424d41; // "AMBP"
+
+namespace amaz {
+
+	namespace {
+		struct CookedHeader {
+			uint32_t magic;
+			uint32_t version;
+			uint64_t key;
+			// triangles in a cooked mesh, bytes in a cooked broadphase
+			uint64_t count;
+		};
+
+		// the payload starts right after the header, which keeps it aligned for CookedTriangle
+		static_assert(sizeof(CookedHeader) % alignof(CookedTriangle) == 0);
+
+		bool readHeader(std::span<const std::byte> bytes, uint32_t magic, uint64_t key, CookedHeader& header) {
+			if (bytes.size() < sizeof(CookedHeader)) return false;
+			std::memcpy(&header, bytes.data(), sizeof(CookedHeader));
+			return header.magic == magic && header.version == COOKED_FORMAT_VERSION && header.key == key;
+		}
+
+		// written next to the destination and renamed over it, so a crash never leaves a half written file behind
+		bool writeFile(const std::string& path, const CookedHeader& header, std::span<const std::byte> payload) {
+			std::string tmpPath = path + ".tmp";
+			{
+				std::ofstream out(tmpPath, std::ios::binary | std::ios::trunc);
+				if (!out) {
+					std::cout << "Unable to write cooked collision file: " << tmpPath << "\n";
+					return false;
+				}
+				out.write(reinterpret_cast<const char*>(&header), sizeof(header));
+				out.write(reinterpret_cast<const char*>(payload.data()), static_cast<std::streamsize>(payload.size()));
+				if (!out) {
+					std::cout << "Unable to write cooked collision file: " << tmpPath << "\n";
+					return false;
+				}
+			}
+
+			std::error_code error;
+			std::filesystem::rename(tmpPath, path, error);
+			if (error) {
+				std::cout << "Unable to replace cooked collision file " << path << ": " << error.message() << "\n";
+				std::filesystem::remove(tmpPath, error);
+				return false;
+			}
+			return true;
+		}
+	}
+
+	uint64_t collisionMeshKey(const std::string& filename) {
+		util::MappedFile source;
+		if (!source.open(filename)) {
+			return 0;
+		}
+
+		uint64_t key = util::hashBytes(source.bytes());
+		key = util::hashValue(COOKED_FORMAT_VERSION, key);
+		return key ? key : 1;
+	}
+
+	std::string cookedPath(const std::string& directory, const std::string& filename, uint64_t key, const std::string& extension) {
+		char hex[17];
+		std::snprintf(hex, sizeof(hex), "%016llx", static_cast<unsigned long long>(key));
+		std::string stem = std::filesystem::path(filename).stem().string();
+		return (std::filesystem::path(directory) / (stem + "-" + hex + extension)).string();
+	}
+
+	bool CookedMesh::open(const std::string& path, uint64_t key) {
+		_triangles = {};
+		if (!_file.open(path)) {
+			return false;
+		}
+
+		std::span<const std::byte> bytes = _file.bytes();
+		CookedHeader header;
+		if (!readHeader(bytes, COOKED_MESH_MAGIC, key, header) ||
+			header.count != (bytes.size() - sizeof(CookedHeader)) / sizeof(CookedTriangle)) {
+			_file.close();
+			return false;
+		}
+
+		_triangles = { reinterpret_cast<const CookedTriangle*>(bytes.data() + sizeof(CookedHeader)), static_cast<size_t>(header.count) };
+		return true;
+	}
+
+	bool writeCookedMesh(const std::string& path, uint64_t key, std::span<const CookedTriangle> triangles) {
+		CookedHeader header = { COOKED_MESH_MAGIC, COOKED_FORMAT_VERSION, key, triangles.size() };
+		return writeFile(path, header, std::as_bytes(triangles));
+	}
+
+	bool writeCookedBroadphase(const std::string& path, uint64_t key, const Broadphase& broadphase) {
+		std::vector<std::byte> payload;
+		if (!broadphase.serialize(payload)) {
+			return false;
+		}
+		CookedHeader header = { COOKED_BROADPHASE_MAGIC, COOKED_FORMAT_VERSION, key, payload.size() };
+		return writeFile(path, header, payload);
+	}
+
+	bool readCookedBroadphase(const std::string& path, uint64_t key, Broadphase& broadphase) {
+		util::MappedFile file;
+		if (!file.open(path)) {
+			return false;
+		}
+
+		std::span<const std::byte> bytes = file.bytes();
+		CookedHeader header;
+		if (!readHeader(bytes, COOKED_BROADPHASE_MAGIC, key, header) || header.count != bytes.size() - sizeof(CookedHeader)) {
+			return false;
+		}
+		return broadphase.deserialize(bytes.subspan(sizeof(CookedHeader)));
+	}
+}
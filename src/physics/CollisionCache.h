@@ -0,0 +1,43 @@
+#pragma once
+
+#include "Collision.h"
+#include "Broadphase.h"
+#include "../util/mapped_file.hpp"
+#include <string>
+#include <span>
+#include <cstdint>
+
+// Cooked collision files: the local space triangles of a collision mesh with their normals and bounds,
+// and the baked broadphase over them. Both are memory mapped when loaded instead of parsed.
+// Every file starts with the key it was cooked for, a file whose key doesn't match is stale and gets cooked again.
+namespace amaz {
+
+	// Hash of the source file's bytes and the cooked format. 0 if the source can't be read.
+	// Meshes are cooked in their own space, so the same file keeps its key wherever it's placed.
+	uint64_t collisionMeshKey(const std::string& filename);
+
+	// <directory>/<source file name>-<key in hex><extension>
+	std::string cookedPath(const std::string& directory, const std::string& filename, uint64_t key, const std::string& extension);
+
+	class CookedMesh {
+	public:
+		// false if the file is missing, truncated or was cooked for a different key
+		bool open(const std::string& path, uint64_t key);
+
+		// points into the mapped file, valid until the CookedMesh is closed or destroyed
+		std::span<const CookedTriangle> triangles() const {
+			return _triangles;
+		}
+
+	private:
+		util::MappedFile _file;
+		std::span<const CookedTriangle> _triangles;
+	};
+
+	bool writeCookedMesh(const std::string& path, uint64_t key, std::span<const CookedTriangle> triangles);
+
+	// The broadphase must be baked to be written. Reading only works on a broadphase with exactly the
+	// triangles it was cooked with added to it, in the same order.
+	bool writeCookedBroadphase(const std::string& path, uint64_t key, const Broadphase& broadphase);
+	bool readCookedBroadphase(const std::string& path, uint64_t key, Broadphase& broadphase);
+}
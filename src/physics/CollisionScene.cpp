@@ -0,0 +1,194 @@
+#include "CollisionScene.h"
+
+#include "Collision.h"
+#include <algorithm>
+#include <array>
+#include <limits>
+#include <numeric>
+
+constexpr uint32_t MAX_INSTANCE_LEAF = 4;
+// median splits halve the instances every level, so this is never reached in practice
+constexpr uint32_t MAX_INSTANCE_DEPTH = 64;
+
+namespace amaz {
+
+	namespace {
+		const AABB EMPTY_AABB = { glm::vec3(std::numeric_limits<float>::max()), glm::vec3(std::numeric_limits<float>::lowest()) };
+
+		AABB merge(AABB a, AABB b) {
+			return { glm::min(a.a, b.a), glm::max(a.b, b.b) };
+		}
+
+		AABB transformAABB(const glm::mat4& transform, AABB aabb) {
+			// the extent of a box moved by a matrix is the absolute matrix applied to its extent
+			glm::vec3 center = glm::vec3(transform * glm::vec4((aabb.a + aabb.b) * 0.5f, 1.f));
+			glm::vec3 extent = (aabb.b - aabb.a) * 0.5f;
+			glm::mat3 linear = glm::mat3(transform);
+			glm::vec3 halfSize = glm::vec3(0.f);
+			for (int column = 0; column < 3; column++) {
+				halfSize += glm::abs(linear[column]) * extent[column];
+			}
+			return { center - halfSize, center + halfSize };
+		}
+	}
+
+	AABB CollisionInstance::aabbToLocal(AABB aabb) const {
+		return transformAABB(toLocal, aabb);
+	}
+
+	CollisionScene::CollisionScene(BroadphaseType type) : type(type) {
+	}
+
+	uint32_t CollisionScene::addMesh() {
+		CollisionMesh mesh;
+		mesh.broadphase = createBroadphase(type);
+		mesh.bounds = EMPTY_AABB;
+		meshes.push_back(mesh);
+		dirty = true;
+		return static_cast<uint32_t>(meshes.size() - 1);
+	}
+
+	void CollisionScene::addTriangle(uint32_t meshId, uint32_t tri) {
+		// a mesh's triangles are registered one after another, so the range is all it needs to remember
+		CollisionMesh& mesh = meshes[meshId];
+		if (!mesh.triCount) {
+			mesh.firstTri = tri;
+		}
+		mesh.triCount = tri - mesh.firstTri + 1;
+		mesh.bounds = merge(mesh.bounds, getAABBFromTriangle(tri));
+		mesh.broadphase->addElement(tri);
+		dirty = true;
+	}
+
+	uint32_t CollisionScene::addInstance(uint32_t mesh, const glm::mat4& toWorld) {
+		CollisionInstance instance;
+		instance.mesh = mesh;
+		instance.toWorld = toWorld;
+		instance.toLocal = glm::inverse(toWorld);
+		instance.scale = glm::length(glm::vec3(toWorld[0]));
+		instances.push_back(instance);
+		dirty = true;
+		return static_cast<uint32_t>(instances.size() - 1);
+	}
+
+	void CollisionScene::bake() {
+		for (auto& mesh : meshes) {
+			if (!mesh.broadphase->isBaked()) {
+				mesh.broadphase->bake();
+			}
+		}
+
+		nodes.clear();
+		order.resize(instances.size());
+		std::iota(order.begin(), order.end(), 0);
+		for (auto& instance : instances) {
+			const CollisionMesh& mesh = meshes[instance.mesh];
+			instance.bounds = mesh.triCount ? transformAABB(instance.toWorld, mesh.bounds) : EMPTY_AABB;
+		}
+
+		dirty = false;
+		if (instances.empty()) {
+			return;
+		}
+
+		nodes.reserve(2 * instances.size());
+		nodes.emplace_back();
+		buildNode(0, 0, static_cast<uint32_t>(instances.size()));
+	}
+
+	bool CollisionScene::isBaked() const {
+		if (dirty) return false;
+		return std::all_of(meshes.begin(), meshes.end(), [](const CollisionMesh& mesh) {
+			return mesh.broadphase->isBaked();
+		});
+	}
+
+	void CollisionScene::buildNode(uint32_t nodeId, uint32_t first, uint32_t count) {
+		AABB bounds = EMPTY_AABB;
+		AABB centroids = EMPTY_AABB;
+		for (uint32_t i = first; i < first + count; i++) {
+			const AABB& instanceBounds = instances[order[i]].bounds;
+			glm::vec3 centroid = (instanceBounds.a + instanceBounds.b) * 0.5f;
+			bounds = merge(bounds, instanceBounds);
+			centroids = merge(centroids, { centroid, centroid });
+		}
+		nodes[nodeId] = { bounds, 0, first, count };
+
+		if (count <= MAX_INSTANCE_LEAF) {
+			return;
+		}
+
+		// median split on the longest axis of the centroids
+		glm::vec3 extent = centroids.b - centroids.a;
+		int axis = extent.x > extent.y ? (extent.x > extent.z ? 0 : 2) : (extent.y > extent.z ? 1 : 2);
+		uint32_t half = count / 2;
+		std::nth_element(order.begin() + first, order.begin() + first + half, order.begin() + first + count, [&](uint32_t a, uint32_t b) {
+			return instances[a].bounds.a[axis] + instances[a].bounds.b[axis] < instances[b].bounds.a[axis] + instances[b].bounds.b[axis];
+		});
+
+		uint32_t left = static_cast<uint32_t>(nodes.size());
+		nodes.emplace_back();
+		nodes.emplace_back();
+		nodes[nodeId].left = left;
+		nodes[nodeId].count = 0;
+		buildNode(left, first, half);
+		buildNode(left + 1, first + half, count - half);
+	}
+
+	void CollisionScene::visitInstances(AABB aabb, InstanceVisitor visitor) const {
+		if (nodes.empty()) {
+			return;
+		}
+
+		std::array<uint32_t, MAX_INSTANCE_DEPTH + 2> nodeIds;
+		size_t stackSize = 0;
+		nodeIds[stackSize++] = 0;
+
+		while (stackSize) {
+			const InstanceNode& node = nodes[nodeIds[--stackSize]];
+			if (!AABBvsAABB(aabb, node.bounds)) continue;
+
+			if (node.count) {
+				for (uint32_t i = node.first; i < node.first + node.count; i++) {
+					if (AABBvsAABB(aabb, instances[order[i]].bounds)) visitor(order[i]);
+				}
+			} else {
+				nodeIds[stackSize++] = node.left + 1;
+				nodeIds[stackSize++] = node.left;
+			}
+		}
+	}
+
+	void CollisionScene::traceInstances(RayPacket& packet, InstanceVisitor visitor) const {
+		if (nodes.empty()) {
+			return;
+		}
+
+		std::array<uint32_t, MAX_INSTANCE_DEPTH + 2> nodeIds;
+		size_t stackSize = 0;
+		nodeIds[stackSize++] = 0;
+
+		while (stackSize) {
+			const InstanceNode& node = nodes[nodeIds[--stackSize]];
+			if (!util::simd::any(packet.hits(node.bounds.a, node.bounds.b))) continue;
+
+			if (node.count) {
+				for (uint32_t i = node.first; i < node.first + node.count; i++) {
+					const AABB& bounds = instances[order[i]].bounds;
+					if (util::simd::any(packet.hits(bounds.a, bounds.b))) visitor(order[i]);
+				}
+			} else {
+				nodeIds[stackSize++] = node.left + 1;
+				nodeIds[stackSize++] = node.left;
+			}
+		}
+	}
+
+	size_t CollisionScene::placedTriangleCount() const {
+		size_t count = 0;
+		for (const auto& instance : instances) {
+			count += meshes[instance.mesh].triCount;
+		}
+		return count;
+	}
+}
@@ -0,0 +1,127 @@
+#pragma once
+
+#include "Objects.h"
+#include "Broadphase.h"
+#include <memory>
+#include <vector>
+#include <cstdint>
+#include <glm/glm.hpp>
+
+namespace amaz {
+
+	// A unique collision mesh, its triangles are registered once in local space and get their own broadphase
+	struct CollisionMesh {
+		std::shared_ptr<Broadphase> broadphase;
+		uint32_t firstTri = 0;
+		uint32_t triCount = 0;
+		// local space bounds of every triangle
+		AABB bounds;
+	};
+
+	// One placement of a mesh. Only rotation, translation and uniform scale are supported, so shapes keep their
+	// form going into local space and a radius just divides by scale.
+	struct CollisionInstance {
+		uint32_t mesh;
+		glm::mat4 toWorld;
+		glm::mat4 toLocal;
+		float scale;
+		// world space bounds of the mesh's bounds moved by toWorld
+		AABB bounds;
+
+		glm::vec3 pointToLocal(glm::vec3 point) const {
+			return glm::vec3(toLocal * glm::vec4(point, 1.f));
+		}
+
+		glm::vec3 vectorToLocal(glm::vec3 vector) const {
+			return glm::mat3(toLocal) * vector;
+		}
+
+		glm::vec3 pointToWorld(glm::vec3 point) const {
+			return glm::vec3(toWorld * glm::vec4(point, 1.f));
+		}
+
+		// unit length in, unit length out
+		glm::vec3 normalToWorld(glm::vec3 normal) const {
+			return glm::mat3(toWorld) * normal / scale;
+		}
+
+		Capsule capsuleToLocal(Capsule capsule) const {
+			return { pointToLocal(capsule.tip), pointToLocal(capsule.base), capsule.radius / scale };
+		}
+
+		Triangle triangleToWorld(Triangle tri) const {
+			return { pointToWorld(tri.a), pointToWorld(tri.b), pointToWorld(tri.c) };
+		}
+
+		// local bounds containing everything inside the world space aabb
+		AABB aabbToLocal(AABB aabb) const;
+	};
+
+	// called with an instance id
+	using InstanceVisitor = FunctionRef<void(uint32_t)>;
+
+	// The static collision of a scene: every unique mesh with a broadphase over its local space triangles, and
+	// a small BVH over the world bounds of the instances placing them. Memory grows with the unique meshes,
+	// a placement only costs a CollisionInstance. Queries find the instances they overlap, move themselves into
+	// each one's local space and query its mesh's broadphase there.
+	class CollisionScene {
+	public:
+		explicit CollisionScene(BroadphaseType type = BroadphaseType::Octree);
+
+		// An empty mesh, fill it with addTriangle
+		uint32_t addMesh();
+		void addTriangle(uint32_t mesh, uint32_t tri);
+		uint32_t addInstance(uint32_t mesh, const glm::mat4& toWorld);
+
+		// Builds the tree over the instances. Meshes are baked first unless they already are, for example from the collision cache.
+		void bake();
+
+		// false if meshes or instances were added since the last bake
+		bool isBaked() const;
+
+		// Calls visitor for every instance whose world bounds overlap aabb
+		void visitInstances(AABB aabb, InstanceVisitor visitor) const;
+
+		// Calls visitor for every instance whose world bounds a lane of the packet hits before its maxT,
+		// visitors lower packet.maxT as they find hits
+		void traceInstances(RayPacket& packet, InstanceVisitor visitor) const;
+
+		const CollisionMesh& mesh(uint32_t id) const {
+			return meshes[id];
+		}
+
+		const CollisionInstance& instance(uint32_t id) const {
+			return instances[id];
+		}
+
+		size_t meshCount() const {
+			return meshes.size();
+		}
+
+		size_t instanceCount() const {
+			return instances.size();
+		}
+
+		// triangles the scene would have if every instance had its own copy
+		size_t placedTriangleCount() const;
+
+	private:
+		struct InstanceNode {
+			AABB bounds;
+			// children are at left and left + 1, leaves have a count of instances starting at first in order
+			uint32_t left;
+			uint32_t first;
+			uint32_t count;
+		};
+
+		void buildNode(uint32_t nodeId, uint32_t first, uint32_t count);
+
+		BroadphaseType type;
+		std::vector<CollisionMesh> meshes;
+		std::vector<CollisionInstance> instances;
+
+		std::vector<InstanceNode> nodes;
+		std::vector<uint32_t> order;
+		bool dirty = false;
+	};
+}
@@ -0,0 +1,378 @@
+#include "ConvexCollision.h"
+
+#include <algorithm>
+#include <array>
+#include <limits>
+#include <utility>
+#include <vector>
+
+constexpr int GJK_MAX_ITERATIONS = 32;
+// GJK stops once a new support point gets the distance less than this fraction closer
+constexpr float GJK_TOLERANCE = 1e-6f;
+// cores closer than this are treated as overlapping and handed to EPA, the rounded parts can't give a normal then
+constexpr float GJK_CORE_EPSILON = 1e-5f;
+
+constexpr int EPA_MAX_ITERATIONS = 64;
+// EPA stops once the polytope grows less than this towards the closest face, in world units
+constexpr float EPA_TOLERANCE = 1e-4f;
+
+namespace amaz {
+
+	namespace {
+		// a point of the Minkowski difference a - b
+		glm::vec3 supportOf(const ConvexShape& a, const ConvexShape& b, glm::vec3 dir) {
+			return a.support(dir) - b.support(-dir);
+		}
+
+		struct Simplex {
+			std::array<glm::vec3, 4> points;
+			int count = 0;
+		};
+
+		// Ericson's closest point on a triangle to the origin, the simplex keeps only the corners of the closest feature
+		glm::vec3 closestOnTriangle(glm::vec3 a, glm::vec3 b, glm::vec3 c, Simplex& feature) {
+			glm::vec3 ab = b - a;
+			glm::vec3 ac = c - a;
+			float d1 = glm::dot(ab, -a);
+			float d2 = glm::dot(ac, -a);
+			if (d1 <= 0.f && d2 <= 0.f) {
+				feature = { { a }, 1 };
+				return a;
+			}
+
+			float d3 = glm::dot(ab, -b);
+			float d4 = glm::dot(ac, -b);
+			if (d3 >= 0.f && d4 <= d3) {
+				feature = { { b }, 1 };
+				return b;
+			}
+
+			float vc = d1 * d4 - d3 * d2;
+			if (vc <= 0.f && d1 >= 0.f && d3 <= 0.f) {
+				feature = { { a, b }, 2 };
+				return a + ab * (d1 / (d1 - d3));
+			}
+
+			float d5 = glm::dot(ab, -c);
+			float d6 = glm::dot(ac, -c);
+			if (d6 >= 0.f && d5 <= d6) {
+				feature = { { c }, 1 };
+				return c;
+			}
+
+			float vb = d5 * d2 - d1 * d6;
+			if (vb <= 0.f && d2 >= 0.f && d6 <= 0.f) {
+				feature = { { a, c }, 2 };
+				return a + ac * (d2 / (d2 - d6));
+			}
+
+			float va = d3 * d6 - d5 * d4;
+			if (va <= 0.f && d4 - d3 >= 0.f && d5 - d6 >= 0.f) {
+				feature = { { b, c }, 2 };
+				return b + (c - b) * ((d4 - d3) / ((d4 - d3) + (d5 - d6)));
+			}
+
+			float denom = 1.f / (va + vb + vc);
+			feature = { { a, b, c }, 3 };
+			return a + ab * (vb * denom) + ac * (vc * denom);
+		}
+
+		// Closest point of the simplex to the origin, reducing it to the feature that point is on.
+		// False when the origin is inside the tetrahedron.
+		bool closestOnSimplex(Simplex& simplex, glm::vec3& closest) {
+			auto& p = simplex.points;
+			switch (simplex.count) {
+			case 1:
+				closest = p[0];
+				return true;
+			case 2: {
+				glm::vec3 ab = p[1] - p[0];
+				float t = glm::dot(-p[0], ab) / glm::dot(ab, ab);
+				if (!(t > 0.f)) {
+					closest = p[0];
+					simplex = { { closest }, 1 };
+				} else if (t >= 1.f) {
+					closest = p[1];
+					simplex = { { closest }, 1 };
+				} else {
+					closest = p[0] + ab * t;
+				}
+				return true;
+			}
+			case 3: {
+				Simplex feature;
+				closest = closestOnTriangle(p[0], p[1], p[2], feature);
+				simplex = feature;
+				return true;
+			}
+			default: {
+				// only the faces the origin is outside of can hold the closest point
+				static constexpr std::array<std::array<int, 4>, 4> faces = { { { 0, 1, 2, 3 }, { 0, 3, 1, 2 }, { 0, 2, 3, 1 }, { 1, 3, 2, 0 } } };
+				float bestSq = std::numeric_limits<float>::max();
+				Simplex best;
+				bool outside = false;
+				for (const auto& face : faces) {
+					glm::vec3 a = p[face[0]], b = p[face[1]], c = p[face[2]];
+					glm::vec3 n = glm::cross(b - a, c - a);
+					float originSide = glm::dot(-a, n);
+					float otherSide = glm::dot(p[face[3]] - a, n);
+					if (originSide * otherSide > 0.f) continue;
+
+					outside = true;
+					Simplex feature;
+					glm::vec3 point = closestOnTriangle(a, b, c, feature);
+					if (glm::dot(point, point) < bestSq) {
+						bestSq = glm::dot(point, point);
+						best = feature;
+						closest = point;
+					}
+				}
+				if (!outside) return false;
+				simplex = best;
+				return true;
+			}
+			}
+		}
+
+		struct PolytopeFace {
+			std::array<uint32_t, 3> v;
+			glm::vec3 normal;
+			float dist;
+			bool alive = true;
+		};
+
+		// faces without an area stay in the polytope so its edges still match up, but are never the closest
+		PolytopeFace makeFace(const std::vector<glm::vec3>& points, uint32_t a, uint32_t b, uint32_t c) {
+			glm::vec3 normal = glm::cross(points[b] - points[a], points[c] - points[a]);
+			float length = glm::length(normal);
+			if (!(length > 0.f)) return { { a, b, c }, glm::vec3(0.f), std::numeric_limits<float>::max() };
+			normal /= length;
+			return { { a, b, c }, normal, glm::dot(normal, points[a]) };
+		}
+
+		// GJK ended with the origin inside a simplex that may be smaller than a tetrahedron, adds points of the
+		// Minkowski difference until it has some volume. False if the difference is flat there.
+		bool growToTetrahedron(const ConvexShape& a, const ConvexShape& b, Simplex& simplex) {
+			auto& p = simplex.points;
+			if (simplex.count == 1) {
+				for (glm::vec3 dir : { glm::vec3(1, 0, 0), glm::vec3(-1, 0, 0), glm::vec3(0, 1, 0), glm::vec3(0, -1, 0), glm::vec3(0, 0, 1), glm::vec3(0, 0, -1) }) {
+					glm::vec3 w = supportOf(a, b, dir);
+					if (glm::length(w - p[0]) > GJK_CORE_EPSILON) {
+						p[simplex.count++] = w;
+						break;
+					}
+				}
+			}
+			if (simplex.count == 2) {
+				glm::vec3 line = p[1] - p[0];
+				glm::vec3 least = std::abs(line.x) < std::abs(line.y) ? (std::abs(line.x) < std::abs(line.z) ? glm::vec3(1, 0, 0) : glm::vec3(0, 0, 1))
+					: (std::abs(line.y) < std::abs(line.z) ? glm::vec3(0, 1, 0) : glm::vec3(0, 0, 1));
+				glm::vec3 u = glm::normalize(glm::cross(line, least));
+				glm::vec3 v = glm::normalize(glm::cross(line, u));
+				for (int i = 0; i < 6; i++) {
+					float angle = i * 1.0471976f;
+					glm::vec3 w = supportOf(a, b, u * std::cos(angle) + v * std::sin(angle));
+					if (glm::length(glm::cross(w - p[0], line)) > GJK_CORE_EPSILON * glm::length(line)) {
+						p[simplex.count++] = w;
+						break;
+					}
+				}
+			}
+			if (simplex.count == 3) {
+				glm::vec3 n = glm::cross(p[1] - p[0], p[2] - p[0]);
+				float area = glm::length(n);
+				if (area <= 0.f) return false;
+				for (glm::vec3 dir : { n, -n }) {
+					glm::vec3 w = supportOf(a, b, dir);
+					if (std::abs(glm::dot(w - p[0], n)) > GJK_CORE_EPSILON * area) {
+						p[simplex.count++] = w;
+						break;
+					}
+				}
+			}
+			return simplex.count == 4;
+		}
+
+		// Expanding polytope: grows the simplex towards its face closest to the origin until that face is on the
+		// Minkowski difference's surface. Its normal and distance are how far a has to move out of b.
+		void expandPolytope(const ConvexShape& a, const ConvexShape& b, const Simplex& simplex, glm::vec3& normal, float& depth) {
+			std::vector<glm::vec3> points(simplex.points.begin(), simplex.points.end());
+			std::vector<PolytopeFace> faces;
+			glm::vec3 inside = (points[0] + points[1] + points[2] + points[3]) * 0.25f;
+			for (auto [i, j, k] : { std::array<uint32_t, 3>{ 0, 1, 2 }, { 0, 3, 1 }, { 0, 2, 3 }, { 1, 3, 2 } }) {
+				PolytopeFace face = makeFace(points, i, j, k);
+				if (glm::dot(face.normal, inside) - face.dist > 0.f) face = makeFace(points, i, k, j);
+				faces.push_back(face);
+			}
+
+			std::vector<std::pair<uint32_t, uint32_t>> edges;
+			size_t closest = 0;
+			for (int iteration = 0; iteration < EPA_MAX_ITERATIONS; iteration++) {
+				float closestDist = std::numeric_limits<float>::max();
+				for (size_t i = 0; i < faces.size(); i++) {
+					if (faces[i].alive && faces[i].dist < closestDist) {
+						closestDist = faces[i].dist;
+						closest = i;
+					}
+				}
+
+				glm::vec3 w = supportOf(a, b, faces[closest].normal);
+				if (glm::dot(w, faces[closest].normal) - closestDist <= EPA_TOLERANCE) break;
+
+				// same as adding a vertex to a hull, the faces it sees are replaced by a fan
+				uint32_t added = static_cast<uint32_t>(points.size());
+				points.push_back(w);
+				edges.clear();
+				for (PolytopeFace& face : faces) {
+					if (!face.alive || glm::dot(face.normal, w) - face.dist <= 0.f) continue;
+					face.alive = false;
+					for (int i = 0; i < 3; i++) {
+						edges.push_back({ face.v[i], face.v[(i + 1) % 3] });
+					}
+				}
+				std::sort(edges.begin(), edges.end());
+				for (auto [i, j] : edges) {
+					if (!std::binary_search(edges.begin(), edges.end(), std::pair{ j, i })) faces.push_back(makeFace(points, i, j, added));
+				}
+			}
+
+			normal = faces[closest].normal;
+			depth = std::max(faces[closest].dist, 0.f);
+		}
+	}
+
+	ConvexShape ConvexShape::sphere(glm::vec3 center, float radius) {
+		ConvexShape shape;
+		shape.kind = Kind::Point;
+		shape.a = center;
+		shape.radius = radius;
+		return shape;
+	}
+
+	ConvexShape ConvexShape::capsule(glm::vec3 p, glm::vec3 q, float radius) {
+		ConvexShape shape;
+		shape.kind = Kind::Segment;
+		shape.a = p;
+		shape.b = q;
+		shape.radius = radius;
+		return shape;
+	}
+
+	ConvexShape ConvexShape::triangle(const Triangle& tri) {
+		ConvexShape shape;
+		shape.kind = Kind::Triangle;
+		shape.a = tri.a;
+		shape.b = tri.b;
+		shape.c = tri.c;
+		return shape;
+	}
+
+	ConvexShape ConvexShape::box(glm::vec3 center, glm::vec3 halfExtents) {
+		ConvexShape shape;
+		shape.kind = Kind::Box;
+		shape.a = center;
+		shape.b = halfExtents;
+		return shape;
+	}
+
+	ConvexShape ConvexShape::convexHull(const ConvexHull& hull, glm::vec3 position) {
+		ConvexShape shape;
+		shape.kind = Kind::Hull;
+		shape.a = position;
+		shape.hull = &hull;
+		return shape;
+	}
+
+	glm::vec3 ConvexShape::support(glm::vec3 dir) const {
+		switch (kind) {
+		case Kind::Segment:
+			return glm::dot(a, dir) >= glm::dot(b, dir) ? a : b;
+		case Kind::Triangle: {
+			float da = glm::dot(a, dir), db = glm::dot(b, dir), dc = glm::dot(c, dir);
+			return da >= db ? (da >= dc ? a : c) : (db >= dc ? b : c);
+		}
+		case Kind::Box:
+			return a + glm::vec3(dir.x >= 0.f ? b.x : -b.x, dir.y >= 0.f ? b.y : -b.y, dir.z >= 0.f ? b.z : -b.z);
+		case Kind::Hull:
+			return a + hull->support(dir);
+		case Kind::Point:
+		default:
+			return a;
+		}
+	}
+
+	ConvexContact convexContact(const ConvexShape& a, const ConvexShape& b) {
+		ConvexContact contact;
+		float radius = a.radius + b.radius;
+
+		Simplex simplex;
+		glm::vec3 v = supportOf(a, b, { 1.f, 0.f, 0.f });
+		simplex.points[simplex.count++] = v;
+
+		bool overlap = false;
+		for (int iteration = 0; iteration < GJK_MAX_ITERATIONS; iteration++) {
+			float distSq = glm::dot(v, v);
+			if (distSq <= GJK_CORE_EPSILON * GJK_CORE_EPSILON) {
+				overlap = true;
+				break;
+			}
+
+			glm::vec3 w = supportOf(a, b, -v);
+			float progress = glm::dot(v, w);
+			// w bounds how close the cores can get, further apart than the radii means no contact whatever the distance is
+			if (progress > 0.f && progress * progress > distSq * radius * radius) {
+				contact.axis = -v / std::sqrt(distSq);
+				return contact;
+			}
+			if (distSq - progress <= GJK_TOLERANCE * distSq) break;
+
+			simplex.points[simplex.count++] = w;
+			glm::vec3 closest;
+			if (!closestOnSimplex(simplex, closest)) {
+				overlap = true;
+				break;
+			}
+			// rounding can stop the distance from shrinking near the end, the last point is as close as it gets
+			if (glm::dot(closest, closest) >= distSq) break;
+			v = closest;
+		}
+
+		if (!overlap) {
+			float dist = glm::length(v);
+			if (dist >= radius) {
+				contact.axis = -v / dist;
+				return contact;
+			}
+			if (dist > GJK_CORE_EPSILON) {
+				contact.collided = true;
+				contact.normal = v / dist;
+				contact.depth = radius - dist;
+				contact.axis = -contact.normal;
+				return contact;
+			}
+		}
+
+		contact.collided = true;
+		if (!growToTetrahedron(a, b, simplex)) {
+			// the cores touch along a flat patch, there is no direction to push them apart along
+			contact.normal = { 0.f, 1.f, 0.f };
+			contact.depth = radius;
+			contact.axis = -contact.normal;
+			return contact;
+		}
+
+		glm::vec3 normal;
+		float depth;
+		expandPolytope(a, b, simplex, normal, depth);
+		contact.normal = -normal;
+		contact.depth = depth + radius;
+		contact.axis = normal;
+		return contact;
+	}
+
+	bool separatedAlong(const ConvexShape& a, const ConvexShape& b, glm::vec3 axis, float margin) {
+		float aMax = glm::dot(a.support(axis), axis) + a.radius;
+		float bMin = glm::dot(b.support(-axis), axis) - b.radius;
+		return bMin - aMax > margin;
+	}
+}
@@ -0,0 +1,55 @@
+#pragma once
+
+#include "Objects.h"
+#include "ConvexHull.h"
+#include <cstdint>
+#include <glm/glm.hpp>
+
+namespace amaz {
+
+	// A convex shape GJK only knows through its support function: a core of points grown by radius.
+	// Spheres and capsules are a point or a segment with a radius, so their rounded surface is exact.
+	struct ConvexShape {
+		enum class Kind : uint8_t {
+			Point,
+			Segment,
+			Triangle,
+			Box,
+			Hull
+		};
+
+		Kind kind = Kind::Point;
+		// point, segment ends or triangle corners. Boxes are centered on a with half extents b, hulls are moved by a.
+		glm::vec3 a = glm::vec3(0.f);
+		glm::vec3 b = glm::vec3(0.f);
+		glm::vec3 c = glm::vec3(0.f);
+		const ConvexHull* hull = nullptr;
+		float radius = 0.f;
+
+		static ConvexShape sphere(glm::vec3 center, float radius);
+		static ConvexShape capsule(glm::vec3 p, glm::vec3 q, float radius);
+		static ConvexShape triangle(const Triangle& tri);
+		static ConvexShape box(glm::vec3 center, glm::vec3 halfExtents);
+		// the hull has to outlive the shape
+		static ConvexShape convexHull(const ConvexHull& hull, glm::vec3 position);
+
+		// furthest point of the core along dir, without the radius
+		glm::vec3 support(glm::vec3 dir) const;
+	};
+
+	struct ConvexContact {
+		bool collided = false;
+		// pushes a out of b
+		glm::vec3 normal = glm::vec3(0.f);
+		float depth = 0.f;
+		// from a towards b, an axis they are apart along when they didn't collide. Worth keeping for separatedAlong.
+		glm::vec3 axis = glm::vec3(0.f);
+	};
+
+	// GJK for the distance between the cores, and EPA for how deep they are in each other when the cores overlap
+	ConvexContact convexContact(const ConvexShape& a, const ConvexShape& b);
+
+	// True if a and b are further than margin apart along axis, which points from a towards b.
+	// Two support calls against a whole GJK run, pairs that were apart last step usually still are along the same axis.
+	bool separatedAlong(const ConvexShape& a, const ConvexShape& b, glm::vec3 axis, float margin);
+}
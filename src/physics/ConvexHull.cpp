@@ -0,0 +1,256 @@
+#include "ConvexHull.h"
+
+#include "../util/simd.hpp"
+#include <algorithm>
+#include <array>
+#include <iostream>
+#include <limits>
+#include <utility>
+
+// points closer to a face than this fraction of the hull's size count as lying on it
+constexpr float HULL_EPSILON = 1e-5f;
+
+namespace amaz {
+
+	using namespace util::simd;
+
+	namespace {
+		struct HullFace {
+			std::array<uint32_t, 3> v;
+			glm::vec3 normal;
+			float dist;
+			// points outside this face and no face made before it
+			std::vector<uint32_t> outside;
+			bool alive = true;
+		};
+
+		HullFace makeFace(const std::vector<glm::vec3>& points, uint32_t a, uint32_t b, uint32_t c) {
+			glm::vec3 normal = glm::cross(points[b] - points[a], points[c] - points[a]);
+			float length = glm::length(normal);
+			normal = length > 0.f ? normal / length : glm::vec3(0.f);
+			return { { a, b, c }, normal, glm::dot(normal, points[a]), {} };
+		}
+
+		float distanceTo(const HullFace& face, glm::vec3 point) {
+			return glm::dot(face.normal, point) - face.dist;
+		}
+
+		// hands each point to the first face it's outside of, points outside none are inside the hull and dropped
+		void assignOutside(std::vector<HullFace>& faces, size_t firstFace, const std::vector<glm::vec3>& points, std::span<const uint32_t> candidates, float epsilon) {
+			for (uint32_t point : candidates) {
+				for (size_t face = firstFace; face < faces.size(); face++) {
+					if (distanceTo(faces[face], points[point]) > epsilon) {
+						faces[face].outside.push_back(point);
+						break;
+					}
+				}
+			}
+		}
+	}
+
+	ConvexHull ConvexHull::cook(std::span<const Triangle> tris, uint32_t maxVertices) {
+		std::vector<glm::vec3> points;
+		points.reserve(tris.size() * 3);
+		for (const Triangle& tri : tris) {
+			points.push_back(tri.a);
+			points.push_back(tri.b);
+			points.push_back(tri.c);
+		}
+		return cook(points, maxVertices);
+	}
+
+	ConvexHull ConvexHull::cook(std::span<const glm::vec3> input, uint32_t maxVertices) {
+		// meshes share every vertex between a few triangles, duplicates would make faces without an area
+		std::vector<glm::vec3> points(input.begin(), input.end());
+		auto less = [](glm::vec3 a, glm::vec3 b) {
+			return a.x < b.x || (a.x == b.x && (a.y < b.y || (a.y == b.y && a.z < b.z)));
+		};
+		std::sort(points.begin(), points.end(), less);
+		points.erase(std::unique(points.begin(), points.end()), points.end());
+
+		std::vector<uint32_t> kept;
+		std::vector<HullFace> faces;
+
+		if (!points.empty()) {
+			std::array<uint32_t, 6> extremes = {};
+			for (uint32_t i = 0; i < points.size(); i++) {
+				for (int axis = 0; axis < 3; axis++) {
+					if (points[i][axis] < points[extremes[axis * 2]][axis]) extremes[axis * 2] = i;
+					if (points[i][axis] > points[extremes[axis * 2 + 1]][axis]) extremes[axis * 2 + 1] = i;
+				}
+			}
+			glm::vec3 size = { points[extremes[1]].x - points[extremes[0]].x, points[extremes[3]].y - points[extremes[2]].y, points[extremes[5]].z - points[extremes[4]].z };
+			float epsilon = std::max(HULL_EPSILON * glm::length(size), 1e-7f);
+
+			// the first tetrahedron spans the furthest pair of extremes, the point furthest from their line and the one furthest from that plane
+			std::array<uint32_t, 4> start = { extremes[0], extremes[1], 0, 0 };
+			float bestSq = -1.f;
+			for (uint32_t i : extremes) {
+				for (uint32_t j : extremes) {
+					glm::vec3 d = points[j] - points[i];
+					if (glm::dot(d, d) > bestSq) {
+						bestSq = glm::dot(d, d);
+						start[0] = i;
+						start[1] = j;
+					}
+				}
+			}
+			glm::vec3 line = points[start[1]] - points[start[0]];
+			float best = -1.f;
+			for (uint32_t i = 0; i < points.size(); i++) {
+				glm::vec3 off = glm::cross(points[i] - points[start[0]], line);
+				if (glm::dot(off, off) > best) {
+					best = glm::dot(off, off);
+					start[2] = i;
+				}
+			}
+			glm::vec3 planeNormal = glm::cross(line, points[start[2]] - points[start[0]]);
+			best = -1.f;
+			for (uint32_t i = 0; i < points.size(); i++) {
+				float dist = std::abs(glm::dot(points[i] - points[start[0]], planeNormal));
+				if (dist > best) {
+					best = dist;
+					start[3] = i;
+				}
+			}
+
+			float planeLength = glm::length(planeNormal);
+			bool flat = points.size() < 4 || bestSq <= epsilon * epsilon || planeLength <= epsilon * std::sqrt(bestSq) || best <= epsilon * planeLength;
+			if (flat) {
+				// nothing to build faces from, the extremes still give GJK the right support points
+				std::cout << "ConvexHull::cook got " << points.size() << " points without any volume, keeping their extremes\n";
+				kept.assign(extremes.begin(), extremes.end());
+			} else {
+				glm::vec3 inside = (points[start[0]] + points[start[1]] + points[start[2]] + points[start[3]]) * 0.25f;
+				for (auto [a, b, c] : { std::array<uint32_t, 3>{ 0, 1, 2 }, { 0, 3, 1 }, { 0, 2, 3 }, { 1, 3, 2 } }) {
+					HullFace face = makeFace(points, start[a], start[b], start[c]);
+					if (distanceTo(face, inside) > 0.f) face = makeFace(points, start[a], start[c], start[b]);
+					faces.push_back(std::move(face));
+				}
+
+				std::vector<uint32_t> candidates;
+				for (uint32_t i = 0; i < points.size(); i++) {
+					if (std::find(start.begin(), start.end(), i) == start.end()) candidates.push_back(i);
+				}
+				assignOutside(faces, 0, points, candidates, epsilon);
+
+				std::vector<std::pair<uint32_t, uint32_t>> edges;
+				std::vector<std::pair<uint32_t, uint32_t>> horizon;
+				for (uint32_t vertexCount = 4; vertexCount < maxVertices; vertexCount++) {
+					// the point furthest out of all of them, so a capped hull has the vertices that matter most
+					uint32_t eye = 0;
+					float eyeDist = 0.f;
+					for (const HullFace& face : faces) {
+						if (!face.alive) continue;
+						for (uint32_t point : face.outside) {
+							float dist = distanceTo(face, points[point]);
+							if (dist > eyeDist) {
+								eyeDist = dist;
+								eye = point;
+							}
+						}
+					}
+					if (eyeDist <= 0.f) break;
+
+					// faces the new vertex sees are replaced by a fan from it to the edge of the visible region
+					edges.clear();
+					candidates.clear();
+					for (HullFace& face : faces) {
+						if (!face.alive || distanceTo(face, points[eye]) <= epsilon) continue;
+						face.alive = false;
+						for (int i = 0; i < 3; i++) {
+							edges.push_back({ face.v[i], face.v[(i + 1) % 3] });
+						}
+						for (uint32_t point : face.outside) {
+							if (point != eye) candidates.push_back(point);
+						}
+						face.outside = {};
+					}
+
+					std::sort(edges.begin(), edges.end());
+					horizon.clear();
+					for (auto [a, b] : edges) {
+						if (!std::binary_search(edges.begin(), edges.end(), std::pair{ b, a })) horizon.push_back({ a, b });
+					}
+
+					size_t firstFace = faces.size();
+					for (auto [a, b] : horizon) {
+						faces.push_back(makeFace(points, a, b, eye));
+					}
+					assignOutside(faces, firstFace, points, candidates, epsilon);
+				}
+
+				for (const HullFace& face : faces) {
+					if (face.alive) kept.insert(kept.end(), face.v.begin(), face.v.end());
+				}
+			}
+		}
+
+		std::sort(kept.begin(), kept.end());
+		kept.erase(std::unique(kept.begin(), kept.end()), kept.end());
+
+		ConvexHull hull;
+		hull._vertexCount = static_cast<uint32_t>(kept.size());
+		if (kept.empty()) {
+			return hull;
+		}
+
+		// padded with copies of the first vertex, they never change which vertex is furthest
+		size_t padded = (kept.size() + WIDTH - 1) / WIDTH * WIDTH;
+		hull._x.resize(padded);
+		hull._y.resize(padded);
+		hull._z.resize(padded);
+		hull._bounds = { points[kept[0]], points[kept[0]] };
+		for (size_t i = 0; i < padded; i++) {
+			glm::vec3 p = points[kept[i < kept.size() ? i : 0]];
+			hull._x[i] = p.x;
+			hull._y[i] = p.y;
+			hull._z[i] = p.z;
+			hull._bounds.a = glm::min(hull._bounds.a, p);
+			hull._bounds.b = glm::max(hull._bounds.b, p);
+		}
+		for (uint32_t point : kept) {
+			hull._center += points[point];
+		}
+		hull._center /= static_cast<float>(kept.size());
+
+		hull._innerRadius = std::numeric_limits<float>::max();
+		for (const HullFace& face : faces) {
+			if (!face.alive) continue;
+			hull._faceCount++;
+			hull._innerRadius = std::min(hull._innerRadius, -distanceTo(face, hull._center));
+		}
+		hull._innerRadius = hull._faceCount ? std::max(hull._innerRadius, 0.f) : 0.f;
+		return hull;
+	}
+
+	glm::vec3 ConvexHull::support(glm::vec3 dir) const {
+		if (_x.empty()) {
+			return glm::vec3(0.f);
+		}
+
+		// each lane keeps the furthest of every 8th vertex, then the lanes are compared
+		float8 dirX = dir.x, dirY = dir.y, dirZ = dir.z;
+		float8 bestX = float8::load(_x.data()), bestY = float8::load(_y.data()), bestZ = float8::load(_z.data());
+		float8 bestDist = bestX * dirX + bestY * dirY + bestZ * dirZ;
+		for (size_t i = WIDTH; i < _x.size(); i += WIDTH) {
+			float8 x = float8::load(_x.data() + i);
+			float8 y = float8::load(_y.data() + i);
+			float8 z = float8::load(_z.data() + i);
+			float8 dist = x * dirX + y * dirY + z * dirZ;
+			mask8 further = dist > bestDist;
+			bestDist = select(further, dist, bestDist);
+			bestX = select(further, x, bestX);
+			bestY = select(further, y, bestY);
+			bestZ = select(further, z, bestZ);
+		}
+
+		alignas(32) float dists[WIDTH], xs[WIDTH], ys[WIDTH], zs[WIDTH];
+		bestDist.store(dists);
+		bestX.store(xs);
+		bestY.store(ys);
+		bestZ.store(zs);
+		int lane = static_cast<int>(std::max_element(dists, dists + WIDTH) - dists);
+		return { xs[lane], ys[lane], zs[lane] };
+	}
+}
@@ -0,0 +1,61 @@
+#pragma once
+
+#include "Objects.h"
+#include <span>
+#include <vector>
+#include <cstdint>
+#include <glm/glm.hpp>
+
+namespace amaz {
+
+	// Vertices kept by cook unless asked for more, a GJK support call looks at every one of them
+	constexpr uint32_t HULL_MAX_VERTICES = 64;
+
+	// Convex hull of a mesh's vertices for colliding props as one shape instead of as their triangles.
+	// Only the hull's vertices are kept, stored per component and padded to a multiple of 8 so support
+	// can test 8 at a time. Vertices are in the space of the points it was cooked from.
+	class ConvexHull {
+	public:
+		// Builds the hull one vertex at a time, always adding the point furthest outside it next. Stops at maxVertices,
+		// points still outside then are left out, so a capped hull lies a little inside the mesh it was cooked from.
+		static ConvexHull cook(std::span<const glm::vec3> points, uint32_t maxVertices = HULL_MAX_VERTICES);
+		static ConvexHull cook(std::span<const Triangle> tris, uint32_t maxVertices = HULL_MAX_VERTICES);
+
+		// The vertex furthest along dir
+		glm::vec3 support(glm::vec3 dir) const;
+
+		uint32_t vertexCount() const {
+			return _vertexCount;
+		}
+
+		glm::vec3 vertex(uint32_t id) const {
+			return { _x[id], _y[id], _z[id] };
+		}
+
+		uint32_t faceCount() const {
+			return _faceCount;
+		}
+
+		AABB bounds() const {
+			return _bounds;
+		}
+
+		// average of the vertices, always inside the hull
+		glm::vec3 center() const {
+			return _center;
+		}
+
+		// radius of the largest sphere around center that fits inside, what fast moving hulls are swept as
+		float innerRadius() const {
+			return _innerRadius;
+		}
+
+	private:
+		std::vector<float> _x, _y, _z;
+		uint32_t _vertexCount = 0;
+		uint32_t _faceCount = 0;
+		AABB _bounds = { glm::vec3(0.f), glm::vec3(0.f) };
+		glm::vec3 _center = glm::vec3(0.f);
+		float _innerRadius = 0.f;
+	};
+}
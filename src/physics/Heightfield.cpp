@@ -0,0 +1,283 @@
+#include "Heightfield.h"
+
+#include <algorithm>
+#include <cmath>
+#include <fstream>
+#include <iostream>
+
+namespace amaz {
+
+	namespace {
+		// Möller-Trumbore, hits from either side
+		bool rayVsTriangle(Ray ray, const Triangle& tri, float& t) {
+			glm::vec3 ab = tri.b - tri.a;
+			glm::vec3 ac = tri.c - tri.a;
+			glm::vec3 p = glm::cross(ray.dir, ac);
+			float det = glm::dot(ab, p);
+			if (std::abs(det) < 1e-12f) return false;
+
+			float invDet = 1.f / det;
+			glm::vec3 s = ray.origin - tri.a;
+			float u = glm::dot(s, p) * invDet;
+			if (u < 0.f || u > 1.f) return false;
+
+			glm::vec3 q = glm::cross(s, ab);
+			float v = glm::dot(ray.dir, q) * invDet;
+			if (v < 0.f || u + v > 1.f) return false;
+
+			t = glm::dot(ac, q) * invDet;
+			return t >= 0.f;
+		}
+
+		// entry and exit of the ray through aabb, false when it misses
+		bool clipRay(Ray ray, AABB aabb, float& tEnter, float& tExit) {
+			tEnter = 0.f;
+			tExit = std::numeric_limits<float>::max();
+			for (int axis = 0; axis < 3; axis++) {
+				if (ray.dir[axis] == 0.f) {
+					if (ray.origin[axis] < aabb.a[axis] || ray.origin[axis] > aabb.b[axis]) return false;
+					continue;
+				}
+				float invDir = 1.f / ray.dir[axis];
+				float t0 = (aabb.a[axis] - ray.origin[axis]) * invDir;
+				float t1 = (aabb.b[axis] - ray.origin[axis]) * invDir;
+				if (t0 > t1) std::swap(t0, t1);
+				tEnter = std::max(tEnter, t0);
+				tExit = std::min(tExit, t1);
+			}
+			return tEnter <= tExit;
+		}
+
+		uint32_t cellOf(float position, float origin, float cellSize, uint32_t cells) {
+			float cell = std::floor((position - origin) / cellSize);
+			return static_cast<uint32_t>(std::clamp(cell, 0.f, static_cast<float>(cells - 1)));
+		}
+	}
+
+	Heightfield::Heightfield(uint32_t width, uint32_t depth, float cellSize, float heightScale, glm::vec3 origin, std::vector<uint16_t> heights)
+		: _width(width), _depth(depth), _cellSize(cellSize), _heightScale(heightScale), _origin(origin), _heights(std::move(heights)) {
+		if (_heights.size() != static_cast<size_t>(width) * depth) {
+			std::cout << "Heightfield needs " << static_cast<size_t>(width) * depth << " heights, got " << _heights.size() << "\n";
+			_width = 0;
+			_depth = 0;
+			_heights.clear();
+		}
+		computeBounds();
+	}
+
+	Heightfield Heightfield::fromHeights(uint32_t width, uint32_t depth, float cellSize, glm::vec3 origin, std::span<const float> heights) {
+		if (heights.empty()) {
+			return Heightfield(width, depth, cellSize, 1.f, origin, {});
+		}
+
+		auto [low, high] = std::minmax_element(heights.begin(), heights.end());
+		float range = *high - *low;
+		float heightScale = range > 0.f ? range / 65535.f : 1.f;
+
+		std::vector<uint16_t> samples(heights.size());
+		for (size_t i = 0; i < heights.size(); i++) {
+			samples[i] = static_cast<uint16_t>(std::lround((heights[i] - *low) / heightScale));
+		}
+		return Heightfield(width, depth, cellSize, heightScale, origin + glm::vec3(0.f, *low, 0.f), std::move(samples));
+	}
+
+	bool Heightfield::loadRaw(const std::string& filename, uint32_t width, uint32_t depth, float cellSize, float heightScale, glm::vec3 origin) {
+		std::ifstream in(filename, std::ios::binary);
+		if (!in) {
+			std::cout << "Unable to open heightmap: " << filename << "\n";
+			return false;
+		}
+
+		std::vector<unsigned char> bytes(static_cast<size_t>(width) * depth * 2);
+		if (!in.read(reinterpret_cast<char*>(bytes.data()), static_cast<std::streamsize>(bytes.size()))) {
+			std::cout << "Heightmap " << filename << " is smaller than " << width << "x" << depth << " 16 bit samples\n";
+			return false;
+		}
+
+		std::vector<uint16_t> samples(static_cast<size_t>(width) * depth);
+		for (size_t i = 0; i < samples.size(); i++) {
+			samples[i] = static_cast<uint16_t>(bytes[2 * i] | (bytes[2 * i + 1] << 8));
+		}
+		*this = Heightfield(width, depth, cellSize, heightScale, origin, std::move(samples));
+		return true;
+	}
+
+	void Heightfield::computeBounds() {
+		if (_heights.empty()) {
+			_bounds = { _origin, _origin };
+			return;
+		}
+		auto [low, high] = std::minmax_element(_heights.begin(), _heights.end());
+		_bounds = {
+			_origin + glm::vec3(0.f, *low * _heightScale, 0.f),
+			_origin + glm::vec3((_width - 1) * _cellSize, *high * _heightScale, (_depth - 1) * _cellSize)
+		};
+	}
+
+	CookedTriangle Heightfield::triangle(uint32_t tri) const {
+		return cookTriangle(cellTriangle(tri));
+	}
+
+	Triangle Heightfield::cellTriangle(uint32_t tri) const {
+		uint32_t cell = tri / 2;
+		uint32_t x = cell % (_width - 1);
+		uint32_t z = cell / (_width - 1);
+
+		// split from (x, z) to (x + 1, z + 1), both halves wound so their normals point up
+		glm::vec3 corner = vertex(x, z);
+		glm::vec3 opposite = vertex(x + 1, z + 1);
+		if (tri % 2 == 0) {
+			return { corner, vertex(x, z + 1), opposite };
+		}
+		return { corner, opposite, vertex(x + 1, z) };
+	}
+
+	bool Heightfield::heightAt(float x, float z, float& height) const {
+		if (triangleCount() == 0) return false;
+
+		float fx = (x - _origin.x) / _cellSize;
+		float fz = (z - _origin.z) / _cellSize;
+		if (fx < 0.f || fz < 0.f || fx > _width - 1 || fz > _depth - 1) return false;
+
+		uint32_t cx = std::min(static_cast<uint32_t>(fx), _width - 2);
+		uint32_t cz = std::min(static_cast<uint32_t>(fz), _depth - 2);
+		fx -= cx;
+		fz -= cz;
+
+		float h00 = sample(cx, cz), h10 = sample(cx + 1, cz), h01 = sample(cx, cz + 1), h11 = sample(cx + 1, cz + 1);
+		float h = fz >= fx
+			? h00 + (h11 - h01) * fx + (h01 - h00) * fz
+			: h00 + (h10 - h00) * fx + (h11 - h10) * fz;
+		height = _origin.y + h * _heightScale;
+		return true;
+	}
+
+	bool Heightfield::cellRange(AABB aabb, uint32_t& x0, uint32_t& z0, uint32_t& x1, uint32_t& z1) const {
+		if (triangleCount() == 0 || !AABBvsAABB(aabb, _bounds)) return false;
+
+		x0 = cellOf(aabb.a.x, _origin.x, _cellSize, _width - 1);
+		x1 = cellOf(aabb.b.x, _origin.x, _cellSize, _width - 1);
+		z0 = cellOf(aabb.a.z, _origin.z, _cellSize, _depth - 1);
+		z1 = cellOf(aabb.b.z, _origin.z, _cellSize, _depth - 1);
+		return true;
+	}
+
+	void Heightfield::visitTriangles(AABB aabb, HeightfieldVisitor visitor) const {
+		uint32_t x0, z0, x1, z1;
+		if (!cellRange(aabb, x0, z0, x1, z1)) return;
+
+		for (uint32_t z = z0; z <= z1; z++) {
+			for (uint32_t x = x0; x <= x1; x++) {
+				// a cell entirely above or below the bounds has nothing in them
+				uint16_t h00 = sample(x, z), h10 = sample(x + 1, z), h01 = sample(x, z + 1), h11 = sample(x + 1, z + 1);
+				float low = _origin.y + std::min({ h00, h10, h01, h11 }) * _heightScale;
+				float high = _origin.y + std::max({ h00, h10, h01, h11 }) * _heightScale;
+				if (high < aabb.a.y || low > aabb.b.y) continue;
+
+				uint32_t first = 2 * (z * (_width - 1) + x);
+				for (uint32_t tri = first; tri < first + 2; tri++) {
+					// the normal is only worked out for triangles that make it past their bounds
+					Triangle corners = cellTriangle(tri);
+					if (AABBvsAABB(getAABBFromTriangle(corners), aabb)) visitor(tri, cookTriangle(corners));
+				}
+			}
+		}
+	}
+
+	RayHit Heightfield::raycast(Ray ray, float maxT) const {
+		RayHit closest;
+		float tEnter, tExit;
+		if (triangleCount() == 0 || !clipRay(ray, _bounds, tEnter, tExit) || tEnter > maxT) {
+			return closest;
+		}
+		tExit = std::min(tExit, maxT);
+
+		// 2D DDA over the cells under the ray, a triangle never leaves its cell so the first cell with a hit has the closest
+		uint32_t cellsX = _width - 1;
+		uint32_t cellsZ = _depth - 1;
+		glm::vec3 start = ray.origin + ray.dir * tEnter;
+		int64_t x = cellOf(start.x, _origin.x, _cellSize, cellsX);
+		int64_t z = cellOf(start.z, _origin.z, _cellSize, cellsZ);
+
+		int stepX = ray.dir.x > 0.f ? 1 : -1;
+		int stepZ = ray.dir.z > 0.f ? 1 : -1;
+		float inf = std::numeric_limits<float>::max();
+		float deltaX = ray.dir.x != 0.f ? _cellSize / std::abs(ray.dir.x) : inf;
+		float deltaZ = ray.dir.z != 0.f ? _cellSize / std::abs(ray.dir.z) : inf;
+		float nextX = ray.dir.x != 0.f ? (_origin.x + (x + (stepX > 0 ? 1 : 0)) * _cellSize - ray.origin.x) / ray.dir.x : inf;
+		float nextZ = ray.dir.z != 0.f ? (_origin.z + (z + (stepZ > 0 ? 1 : 0)) * _cellSize - ray.origin.z) / ray.dir.z : inf;
+
+		float enter = tEnter;
+		while (x >= 0 && z >= 0 && x < cellsX && z < cellsZ) {
+			float leave = std::min(nextX, nextZ);
+
+			// most cells the ray passes over it stays above or below of the whole way, padded by a height step for rounding
+			float y0 = ray.origin.y + ray.dir.y * enter;
+			float y1 = ray.origin.y + ray.dir.y * std::min(leave, tExit);
+			uint32_t cx = static_cast<uint32_t>(x), cz = static_cast<uint32_t>(z);
+			uint16_t h00 = sample(cx, cz), h10 = sample(cx + 1, cz), h01 = sample(cx, cz + 1), h11 = sample(cx + 1, cz + 1);
+			float low = _origin.y + (std::min({ h00, h10, h01, h11 }) - 1) * _heightScale;
+			float high = _origin.y + (std::max({ h00, h10, h01, h11 }) + 1) * _heightScale;
+			if (std::max(y0, y1) >= low && std::min(y0, y1) <= high) {
+				uint32_t first = 2 * (cz * cellsX + cx);
+				for (uint32_t tri = first; tri < first + 2; tri++) {
+					Triangle corners = cellTriangle(tri);
+					float t;
+					if (rayVsTriangle(ray, corners, t) && t <= maxT && (!closest.hit || t < closest.t)) {
+						glm::vec3 normal = glm::normalize(glm::cross(corners.b - corners.a, corners.c - corners.a));
+						normal = glm::dot(normal, ray.dir) > 0.f ? -normal : normal;
+						closest = { true, t, ray.origin + ray.dir * t, normal, tri, HEIGHTFIELD_INSTANCE };
+					}
+				}
+				if (closest.hit) break;
+			}
+
+			enter = leave;
+			if (leave > tExit) break;
+			if (nextX < nextZ) {
+				x += stepX;
+				nextX += deltaX;
+			} else {
+				z += stepZ;
+				nextZ += deltaZ;
+			}
+		}
+		return closest;
+	}
+
+	SweepHit Heightfield::sweepCapsule(Capsule capsule, glm::vec3 motion) const {
+		SweepHit earliest;
+		visitTriangles(sweptBounds(capsule, motion), [&](uint32_t tri, const CookedTriangle& cooked) {
+			SweepHit hit = sweepCapsuleVsTriangle(capsule, motion, cooked, tri);
+			if (hit.hit && (!earliest.hit || hit.t < earliest.t)) {
+				earliest = hit;
+				earliest.instance = HEIGHTFIELD_INSTANCE;
+			}
+		});
+		return earliest;
+	}
+
+	void Heightfield::segmentContacts(glm::vec3 a, glm::vec3 b, float radius, AABB aabb, std::vector<HeightfieldContact>& contacts) const {
+		visitTriangles(aabb, [&](uint32_t tri, const CookedTriangle& cooked) {
+			SegmentClosestPoints closest = closestPointsOnTriangle(a, b, cooked);
+			if (closest.distSq >= radius * radius) return;
+
+			// the centre line touching the surface is pushed out along the face
+			float dist = std::sqrt(closest.distSq);
+			glm::vec3 normal = dist > 1e-6f ? (closest.onFirst - closest.onSecond) / dist : cooked.normal;
+			contacts.push_back({ tri, normal, radius - dist });
+		});
+	}
+
+	void Heightfield::capsuleContacts(Capsule capsule, std::vector<HeightfieldContact>& contacts) const {
+		glm::vec3 axis = glm::normalize(capsule.tip - capsule.base) * capsule.radius;
+		glm::vec3 extent = glm::vec3(capsule.radius);
+		AABB aabb = { glm::min(capsule.tip, capsule.base) - extent, glm::max(capsule.tip, capsule.base) + extent };
+		segmentContacts(capsule.base + axis, capsule.tip - axis, capsule.radius, aabb, contacts);
+	}
+
+	void Heightfield::sphereContacts(Sphere sphere, std::vector<HeightfieldContact>& contacts) const {
+		glm::vec3 extent = glm::vec3(sphere.radius);
+		segmentContacts(sphere.pos, sphere.pos, sphere.radius, { sphere.pos - extent, sphere.pos + extent }, contacts);
+	}
+}
@@ -0,0 +1,105 @@
+#pragma once
+
+#include "Objects.h"
+#include "Collision.h"
+#include "Raycast.h"
+#include "Sweep.h"
+#include "Broadphase.h"
+#include <limits>
+#include <span>
+#include <string>
+#include <vector>
+#include <cstdint>
+#include <glm/glm.hpp>
+
+namespace amaz {
+
+	// instance of ray and sweep hits against the heightfield in Physics, tri is then the heightfield's triangle id
+	constexpr uint32_t HEIGHTFIELD_INSTANCE = std::numeric_limits<uint32_t>::max();
+
+	using HeightfieldVisitor = FunctionRef<void(uint32_t tri, const CookedTriangle& triangle)>;
+
+	// A shape overlapping one of a heightfield's triangles, normal pushes the shape out of it
+	struct HeightfieldContact {
+		uint32_t tri;
+		glm::vec3 normal;
+		float depth;
+	};
+
+	// Terrain as a grid of 16 bit heights. Sample (x, z) sits at origin + (x * cellSize, height * heightScale, z * cellSize)
+	// and every cell between four samples is split into two triangles along the same diagonal. Triangles are only made
+	// for the cells a query's bounds cover, so memory is 2 bytes a sample and a query never looks at the rest of the grid.
+	class Heightfield {
+	public:
+		Heightfield() = default;
+		// heights holds width * depth samples, row by row along x
+		Heightfield(uint32_t width, uint32_t depth, float cellSize, float heightScale, glm::vec3 origin, std::vector<uint16_t> heights);
+
+		// Quantizes heights to 16 bits over their range, the lowest one ends up at origin.y
+		static Heightfield fromHeights(uint32_t width, uint32_t depth, float cellSize, glm::vec3 origin, std::span<const float> heights);
+		// Little endian 16 bit samples and nothing else, the .r16 terrain tools export
+		bool loadRaw(const std::string& filename, uint32_t width, uint32_t depth, float cellSize, float heightScale, glm::vec3 origin);
+
+		uint32_t width() const {
+			return _width;
+		}
+
+		uint32_t depth() const {
+			return _depth;
+		}
+
+		AABB bounds() const {
+			return _bounds;
+		}
+
+		size_t memoryBytes() const {
+			return _heights.size() * sizeof(uint16_t);
+		}
+
+		// two per cell, a cell's are 2 * (z * (width - 1) + x) and the one after it
+		uint32_t triangleCount() const {
+			return _width < 2 || _depth < 2 ? 0 : 2 * (_width - 1) * (_depth - 1);
+		}
+
+		CookedTriangle triangle(uint32_t tri) const;
+
+		// Height of the surface above (x, z), false outside the grid
+		bool heightAt(float x, float z, float& height) const;
+
+		// Visits every triangle whose bounds overlap aabb, in order of their ids
+		void visitTriangles(AABB aabb, HeightfieldVisitor visitor) const;
+
+		// Closest hit along the ray up to maxT, walking only the cells the ray passes over
+		RayHit raycast(Ray ray, float maxT = std::numeric_limits<float>::max()) const;
+		// Earliest impact of the capsule moved by motion, like sweepCapsule against meshes
+		SweepHit sweepCapsule(Capsule capsule, glm::vec3 motion) const;
+		// Appends a contact for every triangle the shape overlaps
+		void capsuleContacts(Capsule capsule, std::vector<HeightfieldContact>& contacts) const;
+		void sphereContacts(Sphere sphere, std::vector<HeightfieldContact>& contacts) const;
+
+	private:
+		uint16_t sample(uint32_t x, uint32_t z) const {
+			return _heights[static_cast<size_t>(z) * _width + x];
+		}
+
+		glm::vec3 vertex(uint32_t x, uint32_t z) const {
+			return _origin + glm::vec3(x * _cellSize, sample(x, z) * _heightScale, z * _cellSize);
+		}
+
+		// the corners of a triangle, without anything derived from them
+		Triangle cellTriangle(uint32_t tri) const;
+
+		// cells covered by aabb, clamped to the grid, false when it misses the grid
+		bool cellRange(AABB aabb, uint32_t& x0, uint32_t& z0, uint32_t& x1, uint32_t& z1) const;
+		void segmentContacts(glm::vec3 a, glm::vec3 b, float radius, AABB aabb, std::vector<HeightfieldContact>& contacts) const;
+		void computeBounds();
+
+		uint32_t _width = 0;
+		uint32_t _depth = 0;
+		float _cellSize = 1.f;
+		float _heightScale = 1.f;
+		glm::vec3 _origin = glm::vec3(0.f);
+		AABB _bounds = { glm::vec3(0.f), glm::vec3(0.f) };
+		std::vector<uint16_t> _heights;
+	};
+}
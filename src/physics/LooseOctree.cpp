@@ -0,0 +1,337 @@
+#include "LooseOctree.h"
+
+#include "Collision.h"
+#include <array>
+#include <iostream>
+
+// the root starts at this half size around the first element and doubles until it fits everything
+constexpr float INITIAL_LOOSE_HALF_SIZE = 64.f;
+// same reach as the ±65536 root of Octree, elements further out than that stay in the root
+constexpr float MAX_LOOSE_HALF_SIZE = 65536.f;
+constexpr float MIN_LOOSE_HALF_SIZE = 0.5f;
+// levels between MAX_LOOSE_HALF_SIZE and MIN_LOOSE_HALF_SIZE, bounds the traversal stacks
+constexpr uint32_t MAX_LOOSE_DEPTH = 18;
+
+// a leaf is split once it holds more than this
+constexpr size_t MAX_LOOSE_ELEMENTS = 8;
+
+namespace amaz {
+
+	namespace {
+		glm::vec3 centerOf(AABB aabb) {
+			return (aabb.a + aabb.b) * 0.5f;
+		}
+
+		float radiusOf(AABB aabb) {
+			glm::vec3 halfExtent = (aabb.b - aabb.a) * 0.5f;
+			return std::max(halfExtent.x, std::max(halfExtent.y, halfExtent.z));
+		}
+
+		uint32_t octantOf(const LooseNode& node, glm::vec3 point) {
+			return (point.x >= node.center.x ? 4 : 0) | (point.y >= node.center.y ? 2 : 0) | (point.z >= node.center.z ? 1 : 0);
+		}
+
+		AABB looseBounds(const LooseNode& node) {
+			return { node.center - glm::vec3(2.f * node.halfSize), node.center + glm::vec3(2.f * node.halfSize) };
+		}
+
+		bool overlaps(const AABB& x, const AABB& y) {
+			return x.a.x <= y.b.x && y.a.x <= x.b.x && x.a.y <= y.b.y && y.a.y <= x.b.y && x.a.z <= y.b.z && y.a.z <= x.b.z;
+		}
+	}
+
+	std::shared_ptr<LooseOctree> LooseOctree::create() {
+		return std::shared_ptr<LooseOctree>(new LooseOctree());
+	}
+
+	void LooseOctree::addElement(size_t tri) {
+		insert(static_cast<uint32_t>(tri), amaz::getAABBFromTriangle(tri));
+	}
+
+	bool LooseOctree::fits(const LooseNode& node, AABB aabb) const {
+		glm::vec3 offset = centerOf(aabb) - node.center;
+		for (int axis = 0; axis < 3; axis++) {
+			if (offset[axis] < -node.halfSize || offset[axis] >= node.halfSize) return false;
+		}
+		return radiusOf(aabb) <= node.halfSize;
+	}
+
+	void LooseOctree::insert(uint32_t id, AABB aabb) {
+		if (contains(id)) {
+			std::cout << "LooseOctree::insert called with an id that's already inserted: " << id << ", updating it instead\n";
+			update(id, aabb);
+			return;
+		}
+
+		glm::vec3 center = centerOf(aabb);
+		if (nodes.empty()) {
+			nodes.push_back({ center, INITIAL_LOOSE_HALF_SIZE, 0 });
+		}
+		while (!fits(nodes[0], aabb) && nodes[0].halfSize < MAX_LOOSE_HALF_SIZE) {
+			grow(center);
+		}
+
+		if (id >= table.size()) {
+			table.resize(id + 1);
+		}
+		place(id, aabb, 0);
+		elementTotal++;
+		elementRange = std::max(elementRange, id + 1);
+	}
+
+	void LooseOctree::place(uint32_t id, AABB aabb, uint32_t nodeId) {
+		glm::vec3 center = centerOf(aabb);
+		float radius = radiusOf(aabb);
+		while (nodes[nodeId].children) {
+			uint32_t child = nodes[nodeId].children + octantOf(nodes[nodeId], center);
+			if (radius > nodes[child].halfSize) break;
+			nodeId = child;
+		}
+
+		link(id, aabb, nodeId);
+		split(nodeId);
+	}
+
+	void LooseOctree::remove(uint32_t id) {
+		if (!contains(id)) {
+			std::cout << "LooseOctree::remove called with an id that isn't inserted: " << id << "\n";
+			return;
+		}
+		unlink(id);
+		elementTotal--;
+	}
+
+	void LooseOctree::update(uint32_t id, AABB aabb) {
+		if (!contains(id)) {
+			std::cout << "LooseOctree::update called with an id that isn't inserted: " << id << "\n";
+			return;
+		}
+
+		// most moves stay within the loose bounds of the same node, which is just a store
+		uint32_t nodeId = table[id].node;
+		if (fits(nodes[nodeId], aabb)) {
+			nodes[nodeId].bounds[table[id].slot] = aabb;
+			return;
+		}
+
+		// otherwise it usually still fits a nearby ancestor, there's no need to come down from the root
+		unlink(id);
+		while (nodeId != 0 && !fits(nodes[nodeId], aabb)) {
+			nodeId = nodes[nodeId].parent;
+		}
+		if (nodeId == 0) {
+			elementTotal--;
+			insert(id, aabb);
+		} else {
+			place(id, aabb, nodeId);
+		}
+	}
+
+	void LooseOctree::link(uint32_t id, AABB aabb, uint32_t nodeId) {
+		table[id].node = nodeId;
+		table[id].slot = static_cast<uint32_t>(nodes[nodeId].elements.size());
+		nodes[nodeId].elements.push_back(id);
+		nodes[nodeId].bounds.push_back(aabb);
+	}
+
+	void LooseOctree::unlink(uint32_t id) {
+		Entry& entry = table[id];
+		LooseNode& node = nodes[entry.node];
+
+		uint32_t last = node.elements.back();
+		node.elements[entry.slot] = last;
+		node.bounds[entry.slot] = node.bounds.back();
+		table[last].slot = entry.slot;
+		node.elements.pop_back();
+		node.bounds.pop_back();
+
+		if (node.elements.empty() && !node.children && entry.node != 0) {
+			emptied.push_back(entry.node);
+		}
+		entry.node = NONE;
+	}
+
+	void LooseOctree::split(uint32_t nodeId) {
+		if (nodes[nodeId].children || nodes[nodeId].elements.size() <= MAX_LOOSE_ELEMENTS ||
+			nodes[nodeId].halfSize * 0.5f < MIN_LOOSE_HALF_SIZE) {
+			return;
+		}
+
+		uint32_t children = allocateChildren(nodeId);
+		float childHalfSize = nodes[children].halfSize;
+
+		// elements too big for a child stay, the rest move down a level
+		std::vector<uint32_t> elements = std::move(nodes[nodeId].elements);
+		std::vector<AABB> bounds = std::move(nodes[nodeId].bounds);
+		nodes[nodeId].elements.clear();
+		nodes[nodeId].bounds.clear();
+		for (size_t i = 0; i < elements.size(); i++) {
+			if (radiusOf(bounds[i]) > childHalfSize) {
+				link(elements[i], bounds[i], nodeId);
+			} else {
+				link(elements[i], bounds[i], children + octantOf(nodes[nodeId], centerOf(bounds[i])));
+			}
+		}
+
+		for (uint32_t i = 0; i < 8; i++) {
+			split(children + i);
+		}
+	}
+
+	uint32_t LooseOctree::allocateChildren(uint32_t parent) {
+		uint32_t children;
+		if (!freeBlocks.empty()) {
+			children = freeBlocks.back();
+			freeBlocks.pop_back();
+		} else {
+			children = static_cast<uint32_t>(nodes.size());
+			nodes.resize(nodes.size() + 8);
+		}
+
+		const LooseNode& node = nodes[parent];
+		float childHalfSize = node.halfSize * 0.5f;
+		for (uint32_t i = 0; i < 8; i++) {
+			LooseNode& child = nodes[children + i];
+			child.center = node.center + glm::vec3(i & 4 ? childHalfSize : -childHalfSize, i & 2 ? childHalfSize : -childHalfSize, i & 1 ? childHalfSize : -childHalfSize);
+			child.halfSize = childHalfSize;
+			child.parent = parent;
+			child.children = 0;
+			child.elements.clear();
+			child.bounds.clear();
+		}
+		nodes[parent].children = children;
+		return children;
+	}
+
+	void LooseOctree::grow(glm::vec3 towards) {
+		// the old root becomes the child of a root twice its size that extends towards the element that didn't fit
+		LooseNode old = std::move(nodes[0]);
+		glm::vec3 direction = glm::vec3(
+			towards.x >= old.center.x ? 1.f : -1.f,
+			towards.y >= old.center.y ? 1.f : -1.f,
+			towards.z >= old.center.z ? 1.f : -1.f);
+
+		nodes[0] = { old.center + direction * old.halfSize, old.halfSize * 2.f, 0 };
+		uint32_t children = allocateChildren(0);
+		uint32_t octant = (direction.x < 0.f ? 4 : 0) | (direction.y < 0.f ? 2 : 0) | (direction.z < 0.f ? 1 : 0);
+		uint32_t moved = children + octant;
+
+		old.parent = 0;
+		nodes[moved] = std::move(old);
+		if (nodes[moved].children) {
+			for (uint32_t i = 0; i < 8; i++) {
+				nodes[nodes[moved].children + i].parent = moved;
+			}
+		}
+		for (uint32_t id : nodes[moved].elements) {
+			table[id].node = moved;
+		}
+	}
+
+	void LooseOctree::bake() {
+		for (uint32_t nodeId : emptied) {
+			// collapsed or refilled since it was emptied
+			if (nodes[nodeId].halfSize == 0.f || nodes[nodeId].children || !nodes[nodeId].elements.empty()) continue;
+
+			// free sibling blocks of empty leaves, then see if that emptied the parent too
+			while (nodeId != 0) {
+				uint32_t parent = nodes[nodeId].parent;
+				uint32_t children = nodes[parent].children;
+				bool empty = true;
+				for (uint32_t i = 0; i < 8; i++) {
+					empty = empty && !nodes[children + i].children && nodes[children + i].elements.empty();
+				}
+				if (!empty) break;
+
+				for (uint32_t i = 0; i < 8; i++) {
+					nodes[children + i].halfSize = 0.f;
+					nodes[children + i].elements.shrink_to_fit();
+					nodes[children + i].bounds.shrink_to_fit();
+				}
+				freeBlocks.push_back(children);
+				nodes[parent].children = 0;
+
+				if (!nodes[parent].elements.empty()) break;
+				nodeId = parent;
+			}
+		}
+		emptied.clear();
+		dirty = false;
+	}
+
+	AABB LooseOctree::rootBounds() const {
+		if (nodes.empty()) {
+			return { glm::vec3(0.f), glm::vec3(0.f) };
+		}
+		return looseBounds(nodes[0]);
+	}
+
+	std::deque<size_t> LooseOctree::getElements(AABB aabb, size_t& count) const {
+		std::deque<size_t> output;
+		BroadphaseQuery query;
+		visit(aabb, query, [&](uint32_t id) {
+			output.push_back(id);
+		});
+		count += query.stats.nodesVisited;
+		return output;
+	}
+
+	void LooseOctree::visit(AABB aabb, BroadphaseQuery& query, ElementVisitor visitor) const {
+		query.begin(elementRange);
+		if (nodes.empty()) return;
+
+		std::array<uint32_t, 8 * MAX_LOOSE_DEPTH + 1> nodeIds;
+		size_t stackSize = 0;
+		nodeIds[stackSize++] = 0;
+
+		while (stackSize) {
+			query.stats.nodesVisited++;
+			uint32_t nodeId = nodeIds[--stackSize];
+			const LooseNode& node = nodes[nodeId];
+			// the root also holds whatever was too far out to grow it for, so it isn't culled
+			if (nodeId != 0 && !overlaps(aabb, looseBounds(node))) continue;
+
+			// elements are only stored once so they don't need to be deduplicated
+			for (size_t i = 0; i < node.elements.size(); i++) {
+				if (overlaps(aabb, node.bounds[i])) {
+					query.stats.trianglesEmitted++;
+					visitor(node.elements[i]);
+				}
+			}
+
+			if (node.children) {
+				for (uint32_t i = 8; i-- > 0;) {
+					nodeIds[stackSize++] = node.children + i;
+				}
+			}
+		}
+	}
+
+	void LooseOctree::traceRays(RayPacket& packet, LeafVisitor visitor) const {
+		if (nodes.empty()) return;
+
+		uint32_t nearOctant = (packet.dir.x < 0.f ? 4 : 0) | (packet.dir.y < 0.f ? 2 : 0) | (packet.dir.z < 0.f ? 1 : 0);
+
+		std::array<uint32_t, 8 * MAX_LOOSE_DEPTH + 1> nodeIds;
+		size_t stackSize = 0;
+		nodeIds[stackSize++] = 0;
+
+		while (stackSize) {
+			uint32_t nodeId = nodeIds[--stackSize];
+			const LooseNode& node = nodes[nodeId];
+			AABB bounds = looseBounds(node);
+			if (nodeId != 0 && !util::simd::any(packet.hits(bounds.a, bounds.b))) continue;
+
+			// a node's own elements are bigger than its children, visiting them first tends to lower maxT sooner
+			if (!node.elements.empty()) {
+				visitor({ node.elements.data(), node.elements.size() });
+			}
+
+			if (node.children) {
+				for (uint32_t i = 8; i-- > 0;) {
+					nodeIds[stackSize++] = node.children + (i ^ nearOctant);
+				}
+			}
+		}
+	}
+}
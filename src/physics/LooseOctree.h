@@ -0,0 +1,95 @@
+#pragma once
+
+#include "Objects.h"
+#include "Broadphase.h"
+#include <vector>
+#include <memory>
+#include <deque>
+#include <limits>
+#include <cstdint>
+#include <glm/glm.hpp>
+
+namespace amaz {
+
+	// Node of a loose octree. Its cell is center +- halfSize, but elements only need their center inside the
+	// cell and their size at most halfSize, so the node's bounds are loosened to center +- 2 * halfSize.
+	// The 8 children of a node are next to each other in Morton octant order like OcNode.
+	struct LooseNode {
+		glm::vec3 center;
+		float halfSize = 0.f;
+		uint32_t parent = 0;
+		uint32_t children = 0;
+		std::vector<uint32_t> elements;
+		// bounds of every element, next to the ids so queries don't jump around the element table
+		std::vector<AABB> bounds;
+	};
+
+	// Octree that stores every element exactly once, in the smallest node its bounds fit loosely in.
+	// Elements can be added, moved and removed at any time without rebuilding. The root grows to fit
+	// whatever is added, and children that were emptied by removals are collapsed by bake().
+	// Like the other broadphases it must not be modified while it is being queried.
+	class LooseOctree : public Broadphase {
+	public:
+		static constexpr uint32_t NONE = std::numeric_limits<uint32_t>::max();
+
+		[[nodiscard]] static std::shared_ptr<LooseOctree> create();
+
+		// Inserts a static triangle by its bounds
+		void addElement(size_t tri) override;
+		// Collapses emptied children, elements are already queryable as soon as they're inserted
+		void bake() override;
+
+		// Any id works, the element table grows to the highest id used
+		void insert(uint32_t id, AABB aabb);
+		void remove(uint32_t id);
+		// Only moves the element to another node if it no longer fits its current one
+		void update(uint32_t id, AABB aabb);
+		bool contains(uint32_t id) const {
+			return id < table.size() && table[id].node != NONE;
+		}
+
+		std::deque<size_t> getElements(AABB aabb, size_t& count) const override;
+		// Calls visitor for every element whose own bounds overlap aabb
+		void visit(AABB aabb, BroadphaseQuery& query, ElementVisitor visitor) const override;
+		void traceRays(RayPacket& packet, LeafVisitor visitor) const override;
+
+		size_t nodeCount() const {
+			return nodes.size() - freeBlocks.size() * 8;
+		}
+
+		size_t elementCount() const {
+			return elementTotal;
+		}
+
+		AABB rootBounds() const;
+
+	private:
+		LooseOctree() = default;
+
+		// the element table, indexed by element id
+		struct Entry {
+			uint32_t node = NONE;
+			// index into the node's element list
+			uint32_t slot = 0;
+		};
+
+		// links id into the deepest node under node it fits in
+		void place(uint32_t id, AABB aabb, uint32_t node);
+		void link(uint32_t id, AABB aabb, uint32_t node);
+		void unlink(uint32_t id);
+		// moves the elements of a leaf that got too full into new children
+		void split(uint32_t node);
+		void grow(glm::vec3 towards);
+		uint32_t allocateChildren(uint32_t parent);
+		bool fits(const LooseNode& node, AABB aabb) const;
+
+		std::vector<LooseNode> nodes;
+		// first node of every child block that was collapsed and can be reused
+		std::vector<uint32_t> freeBlocks;
+		// nodes that lost their last element, checked for collapsing by bake()
+		std::vector<uint32_t> emptied;
+
+		std::vector<Entry> table;
+		size_t elementTotal = 0;
+	};
+}
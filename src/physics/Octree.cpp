@@ -1,153 +1,314 @@
 #include "Octree.h"
 
 #include "Collision.h"
+#include "../util/thread_pool.hpp"
 #include <iostream>
 
 
 constexpr int MAX_OCTREE_ELEMENTS = 8;
+constexpr uint32_t MAX_OCTREE_DEPTH = 16;
+
+// nodes with more elements than this near the top of the tree are partitioned and baked on the thread pool
+constexpr size_t PARALLEL_OCTREE_ELEMENTS = 4096;
+constexpr uint32_t MAX_PARALLEL_OCTREE_DEPTH = 4;
 
 namespace amaz {
 
+	namespace {
+		bool contains(AABB outer, AABB inner) {
+			return outer.a.x <= inner.a.x && outer.a.y <= inner.a.y && outer.a.z <= inner.a.z &&
+				outer.b.x >= inner.b.x && outer.b.y >= inner.b.y && outer.b.z >= inner.b.z;
+		}
+	}
+
 	std::shared_ptr<Octree> Octree::create(AABB aabb) {
 		return std::shared_ptr<Octree>(new Octree(aabb));
 	}
 
 	Octree::Octree(AABB aabb) {
-		nodes.emplace_back(aabb);
+		bounds = aabb;
+		nodes.push_back({ aabb });
 	}
 
-	void Octree::addElement(size_t nodeId, size_t tri) {
-		OcNode& node = nodes[nodeId];
-
-		node.elements.push_back(tri);
-		if (node.children || (node.elements.size() > MAX_OCTREE_ELEMENTS && getArea(nodeId) > 1.f)) {
-			node.dirty = true;
-		}
+	void Octree::addElement(size_t tri) {
+		pending.push_back(static_cast<uint32_t>(tri));
+		dirty = true;
 	}
 
-	float Octree::getArea(size_t id) {
-		OcNode& node = nodes[id];
+	float Octree::getArea(size_t id) const {
+		const OcNode& node = nodes[id];
 		return amaz::calcArea(node.aabb);
 	}
 
-	std::deque<size_t> Octree::getElements(AABB aabb, size_t& count) {
+	std::deque<size_t> Octree::getElements(AABB aabb, size_t& count) const {
 		return getElements(0, aabb, count);
 	}
 
-	std::deque<size_t> Octree::getElements(size_t nodeId, AABB aabb, size_t& count) {
+	std::deque<size_t> Octree::getElements(size_t nodeId, AABB aabb, size_t& count) const {
 
 		std::deque<size_t> output;
-		if (nodeId > nodes.size()) {
+
+		if (nodeId >= nodes.size()) {
 			std::cout << "NodeId passed to Octree:getElements is higher than nodes size: " << nodes.size() << "\n";
 			std::cout << "nodeId is: " << nodeId << "\n";
 			return output;
 		}
 
-		std::vector<size_t> nodeIds;
-		nodeIds.push_back(nodeId);
+		// every level pushes at most 8 children, so this never overflows
+		std::array<uint32_t, 8 * MAX_OCTREE_DEPTH + 1> nodeIds;
+		size_t stackSize = 0;
+		nodeIds[stackSize++] = static_cast<uint32_t>(nodeId);
 
-		while (!nodeIds.empty()) {
+		while (stackSize) {
 			count++;
-			nodeId = nodeIds.back();
-			nodeIds.pop_back();
-			if (!amaz::AABBvsAABB(aabb, nodes[nodeId].aabb)) continue;
-			if (nodes[nodeId].dirty) {
-				if (!nodes[nodeId].children) {
-					genChildren(nodeId);
-				}
-				moveElementsToChildren(nodeId);
-				nodes[nodeId].dirty = false;
-			}
+			const OcNode& node = nodes[nodeIds[--stackSize]];
+			if (!amaz::AABBvsAABB(aabb, node.aabb)) continue;
 
-			if (nodes[nodeId].children) {
-				for (int i = nodes[nodeId].children; i < nodes[nodeId].children + 8; i++) {
-					if (i > nodes.size()) {
-						std::cout << "Higher than nodes size: " << nodes.size() << "\n";
-						std::cout << "Source node is: " << nodeId << "\n";
-						std::cout << "nodes first child should be: " << nodes[nodeId].children << "\n";
-						std::cout << "i is: " << i << "\n";
-					}
-					nodeIds.push_back(i);
+			if (node.children) {
+				// pushed in reverse so children are visited in Morton order
+				for (uint32_t i = 8; i-- > 0;) {
+					nodeIds[stackSize++] = node.children + i;
 				}
 			} else {
-				std::copy(nodes[nodeId].elements.begin(), nodes[nodeId].elements.end(), std::back_inserter(output));
+				std::copy(elements.begin() + node.begin, elements.begin() + node.begin + node.count, std::back_inserter(output));
 			}
 		}
 
 		return output;
 	}
 
-	void Octree::genChildren(size_t nodeId) {
-		auto& node = nodes[nodeId];
-		nodes[nodeId].children = nodes.size();
+	void Octree::visit(AABB aabb, BroadphaseQuery& query, ElementVisitor visitor) const {
+		query.begin(elementRange);
 
-		glm::vec3 midPoint = (nodes[nodeId].aabb.a + nodes[nodeId].aabb.b) / 2.f;
+		std::array<uint32_t, 8 * MAX_OCTREE_DEPTH + 1> nodeIds;
+		size_t stackSize = 0;
+		nodeIds[stackSize++] = 0;
 
-		for (int i = 0; i < 8; i++) {
-			float x = i > 3 ? nodes[nodeId].aabb.a.x : nodes[nodeId].aabb.b.x;		// 0, 1, 2, 3	4, 5, 6, 7
-			float y = i % 4 > 1 ? nodes[nodeId].aabb.a.y : nodes[nodeId].aabb.b.y;	// 0, 1, 4, 5	2, 3, 6, 7
-			float z = (i % 2) ? nodes[nodeId].aabb.a.z : nodes[nodeId].aabb.b.z;	// 0, 2, 4, 6	1, 3, 5, 7
-			nodes.emplace_back(AABB{ midPoint, {x, y, z} });
+		while (stackSize) {
+			query.stats.nodesVisited++;
+			const OcNode& node = nodes[nodeIds[--stackSize]];
+			if (!amaz::AABBvsAABB(aabb, node.aabb)) continue;
+
+			// a node fully inside the query can hand out its whole subtree range in one go
+			if (node.children && !contains(aabb, node.aabb)) {
+				for (uint32_t i = 8; i-- > 0;) {
+					nodeIds[stackSize++] = node.children + i;
+				}
+				continue;
+			}
+
+			for (uint32_t i = node.begin; i < node.begin + node.count; i++) {
+				uint32_t tri = elements[i];
+				if (query.mark(tri)) {
+					query.stats.trianglesEmitted++;
+					visitor(tri);
+				}
+			}
 		}
 	}
 
-	void Octree::moveElementsToChildren(size_t nodeId) {
-		auto& node = nodes[nodeId];
-		for (auto tri : node.elements) {
+	void Octree::traceRays(RayPacket& packet, LeafVisitor visitor) const {
+		// children are in Morton order, flipping the octant bits along negative axes gives the near child first
+		uint32_t nearOctant = (packet.dir.x < 0.f ? 4 : 0) | (packet.dir.y < 0.f ? 2 : 0) | (packet.dir.z < 0.f ? 1 : 0);
 
-			AABB triAABB = amaz::getAABBFromTriangle(tri);
-			for (int i = node.children; i < node.children + 8; i++) {
-				if (i > nodes.size()) {
-					std::cout << "Higher than nodes size: " << nodes.size() << "\n";
-					std::cout << "Source node is: " << nodeId << "\n";
-					std::cout << "nodes children is: " << node.children << "\n";
-					std::cout << "nodes children should be: " << nodes[nodeId].children << "\n";
-					std::cout << "i is: " << i << "\n";
-				}
-				auto& child = nodes[i];
-				if (amaz::AABBvsAABB(triAABB, child.aabb)) {
-					child.elements.push_back(tri);
-					if (child.children || (/*child.elements.size() > MAX_OCTREE_ELEMENTS && */getArea(i) > 1.f))
-						child.dirty = true;
+		std::array<uint32_t, 8 * MAX_OCTREE_DEPTH + 1> nodeIds;
+		size_t stackSize = 0;
+		nodeIds[stackSize++] = 0;
+
+		while (stackSize) {
+			const OcNode& node = nodes[nodeIds[--stackSize]];
+			if (!util::simd::any(packet.hits(node.aabb.a, node.aabb.b))) continue;
+
+			if (node.children) {
+				for (uint32_t i = 8; i-- > 0;) {
+					nodeIds[stackSize++] = node.children + (i ^ nearOctant);
 				}
+			} else if (node.count) {
+				visitor({ elements.data() + node.begin, node.count });
 			}
 		}
-		node.elements.clear();
 	}
 
+	void Octree::bake() {
+		BakeTarget target;
+		target.elements.reserve(pending.size());
+		target.nodes.push_back({ bounds });
 
-	OcNodeObject Octree::getRoot() {
-		return { 0, getPtr() };
+		elementRange = pending.empty() ? 0 : *std::max_element(pending.begin(), pending.end()) + 1;
+		std::vector<uint32_t> items = pending;
+		bakeNode(target, 0, items, 0);
+
+		nodes = std::move(target.nodes);
+		elements = std::move(target.elements);
+		dirty = false;
+	}
+
+	bool Octree::serialize(std::vector<std::byte>& out) const {
+		if (dirty) return false;
+		uint32_t base = lowestElement(pending);
+		writeElements(out, pending, base);
+		writeArray(out, std::span<const AABB>(&bounds, 1));
+		writeArray(out, std::span<const OcNode>(nodes));
+		writeElements(out, elements, base);
+		return true;
 	}
 
-	void Octree::genAll() {
+	bool Octree::deserialize(std::span<const std::byte> data) {
+		uint32_t base = lowestElement(pending);
+		std::vector<uint32_t> added;
+		std::vector<AABB> savedBounds;
+		std::vector<OcNode> savedNodes;
+		std::vector<uint32_t> savedElements;
+		if (!readElements(data, added, base) || !readArray(data, savedBounds) || !readArray(data, savedNodes) || !readElements(data, savedElements, base)) {
+			return false;
+		}
+		if (added != pending || savedBounds.size() != 1 || std::memcmp(&savedBounds[0], &bounds, sizeof(AABB)) != 0 || savedNodes.empty()) {
+			return false;
+		}
+
+		// a corrupt cache must not send a query out of bounds or past the end of the traversal stack, children always come
+		// after their parent so walking the nodes in order sees every parent's depth before its children's
+		uint32_t range = pending.empty() ? 0 : *std::max_element(pending.begin(), pending.end()) + 1;
+		std::vector<uint32_t> depths(savedNodes.size(), 0);
+		for (size_t i = 0; i < savedNodes.size(); i++) {
+			const OcNode& node = savedNodes[i];
+			if (static_cast<uint64_t>(node.begin) + node.count > savedElements.size()) return false;
+			if (!node.children) continue;
+			if (node.children <= i || static_cast<uint64_t>(node.children) + 8 > savedNodes.size() || depths[i] >= MAX_OCTREE_DEPTH) return false;
+			for (uint32_t child = 0; child < 8; child++) {
+				depths[node.children + child] = std::max(depths[node.children + child], depths[i] + 1);
+			}
+		}
+		if (std::any_of(savedElements.begin(), savedElements.end(), [&](uint32_t tri) { return tri >= range; })) {
+			return false;
+		}
+
+		nodes = std::move(savedNodes);
+		elements = std::move(savedElements);
+		elementRange = range;
+		dirty = false;
+		return true;
+	}
 
-		std::vector<size_t> nodeIds;
-		nodeIds.push_back(0);
+	void Octree::bakeNode(BakeTarget& target, uint32_t nodeId, std::vector<uint32_t>& items, uint32_t depth) {
+		target.nodes[nodeId].begin = static_cast<uint32_t>(target.elements.size());
 
-		size_t nodeId;
+		AABB aabb = target.nodes[nodeId].aabb;
+		if (items.size() <= MAX_OCTREE_ELEMENTS || depth >= MAX_OCTREE_DEPTH || amaz::calcArea(aabb) <= 1.f) {
+			target.elements.insert(target.elements.end(), items.begin(), items.end());
+			target.nodes[nodeId].count = static_cast<uint32_t>(items.size());
+			return;
+		}
 
-		while (!nodeIds.empty()) {
-			nodeId = nodeIds.back();
-			nodeIds.pop_back();
-			if (nodes[nodeId].dirty) {
-				if (!nodes[nodeId].children) {
-					genChildren(nodeId);
+		glm::vec3 midPoint = (aabb.a + aabb.b) / 2.f;
+
+		std::array<AABB, 8> childAABBs;
+		for (int i = 0; i < 8; i++) {
+			childAABBs[i] = {
+				{ i & 4 ? midPoint.x : aabb.a.x, i & 2 ? midPoint.y : aabb.a.y, i & 1 ? midPoint.z : aabb.a.z },
+				{ i & 4 ? aabb.b.x : midPoint.x, i & 2 ? aabb.b.y : midPoint.y, i & 1 ? aabb.b.z : midPoint.z }
+			};
+		}
+
+		bool parallel = items.size() > PARALLEL_OCTREE_ELEMENTS && depth < MAX_PARALLEL_OCTREE_DEPTH;
+
+		// large nodes are partitioned in chunks, concatenating them in chunk order keeps every child's list
+		// in the same order a single thread would produce
+		std::array<std::vector<uint32_t>, 8> childItems;
+		auto partition = [&](size_t begin, size_t end, std::array<std::vector<uint32_t>, 8>& out) {
+			for (size_t item = begin; item < end; item++) {
+				AABB triAABB = amaz::getAABBFromTriangle(items[item]);
+				for (int i = 0; i < 8; i++) {
+					if (amaz::AABBvsAABB(triAABB, childAABBs[i]))
+						out[i].push_back(items[item]);
+				}
+			}
+		};
+
+		if (parallel) {
+			size_t chunkCount = (items.size() + PARALLEL_OCTREE_ELEMENTS - 1) / PARALLEL_OCTREE_ELEMENTS;
+			std::vector<std::array<std::vector<uint32_t>, 8>> chunks(chunkCount);
+			util::parallelFor(chunkCount, 1, [&](size_t begin, size_t end) {
+				for (size_t chunk = begin; chunk < end; chunk++) {
+					partition(chunk * PARALLEL_OCTREE_ELEMENTS, std::min(items.size(), (chunk + 1) * PARALLEL_OCTREE_ELEMENTS), chunks[chunk]);
 				}
-				moveElementsToChildren(nodeId);
-				nodes[nodeId].dirty = false;
-				for (size_t i = nodes[nodeId].children; i < nodes[nodeId].children + 8; i++) {
-					nodeIds.push_back(i);
+			});
+			for (auto& chunk : chunks) {
+				for (int i = 0; i < 8; i++) {
+					childItems[i].insert(childItems[i].end(), chunk[i].begin(), chunk[i].end());
 				}
 			}
+		} else {
+			partition(0, items.size(), childItems);
+		}
+
+		// splitting further won't separate anything if every child got every element
+		if (std::all_of(childItems.begin(), childItems.end(), [&](const auto& child) { return child.size() == items.size(); })) {
+			target.elements.insert(target.elements.end(), items.begin(), items.end());
+			target.nodes[nodeId].count = static_cast<uint32_t>(items.size());
+			return;
+		}
+
+		items.clear();
+		items.shrink_to_fit();
+
+		uint32_t children = static_cast<uint32_t>(target.nodes.size());
+		target.nodes[nodeId].children = children;
+		for (int i = 0; i < 8; i++) {
+			target.nodes.push_back({ childAABBs[i] });
+		}
+
+		if (parallel) {
+			// every child is baked into its own arrays at the same time, then spliced in Morton order,
+			// which gives exactly the layout of the single threaded bake
+			std::array<BakeTarget, 8> subtrees;
+			util::TaskGroup group;
+			for (uint32_t i = 0; i < 8; i++) {
+				group.run([&, i]() {
+					subtrees[i].nodes.push_back({ childAABBs[i] });
+					bakeNode(subtrees[i], 0, childItems[i], depth + 1);
+				});
+			}
+			group.wait();
+
+			for (uint32_t i = 0; i < 8; i++) {
+				splice(target, children + i, subtrees[i]);
+			}
+		} else {
+			for (uint32_t i = 0; i < 8; i++) {
+				bakeNode(target, children + i, childItems[i], depth + 1);
+			}
 		}
+
+		target.nodes[nodeId].count = static_cast<uint32_t>(target.elements.size()) - target.nodes[nodeId].begin;
 	}
 
-	//Node functions
-	void OcNodeObject::addElement(size_t tri) {
-		octree->addElement(this->id, tri);
+	void Octree::splice(BakeTarget& target, uint32_t nodeId, const BakeTarget& subtree) {
+		// the subtree root goes into its reserved slot, the rest is appended so local node i lands at nodeBase + i
+		uint32_t nodeBase = static_cast<uint32_t>(target.nodes.size()) - 1;
+		uint32_t elementBase = static_cast<uint32_t>(target.elements.size());
+
+		auto relocate = [&](OcNode node) {
+			node.begin += elementBase;
+			if (node.children) {
+				node.children += nodeBase;
+			}
+			return node;
+		};
+
+		target.nodes[nodeId] = relocate(subtree.nodes[0]);
+		for (size_t i = 1; i < subtree.nodes.size(); i++) {
+			target.nodes.push_back(relocate(subtree.nodes[i]));
+		}
+		target.elements.insert(target.elements.end(), subtree.elements.begin(), subtree.elements.end());
+	}
+
+
+	OcNodeObject Octree::getRoot() {
+		return { 0, getPtr() };
 	}
 
+	//Node functions
 	float OcNodeObject::getArea() {
 		return octree->getArea(this->id);
 	}
@@ -156,4 +317,4 @@ namespace amaz {
 		return octree->getElements(this->id, aabb, count);
 	}
 
-}
\ No newline at end of file
+}
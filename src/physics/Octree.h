@@ -2,6 +2,7 @@
 
 #include "Objects.h"
 #include "Collision.h"
+#include "Broadphase.h"
 #include <vector>
 #include <array>
 #include <glm/glm.hpp>
@@ -9,62 +10,83 @@
 #include <deque>
 #include <iterator>
 #include <memory>
+#include <cstdint>
 
 namespace amaz {
 
 	class OcNodeObject;
-	struct OcNode;
 
-	class Octree : std::enable_shared_from_this<Octree> {
+	// Baked octree node. The 8 children of a node are stored next to each other in Morton octant order
+	// (bit 2 = upper x, bit 1 = upper y, bit 0 = upper z) and subtrees are laid out depth first,
+	// so [begin, begin + count) of any node covers the elements of its whole subtree.
+	struct OcNode {
+		AABB aabb;
+		uint32_t children = 0;
+		uint32_t begin = 0;
+		uint32_t count = 0;
+	};
+
+	class Octree : public Broadphase, std::enable_shared_from_this<Octree> {
 	public:
 
 		//TODO: make octree dynamically resize maybe?
 		[[nodiscard]] static std::shared_ptr<Octree> create(AABB maxSize);
-		
-		OcNodeObject getRoot();
 
-		void addElement(size_t nodeId, size_t tri);
-		void addElement(size_t tri) {
-			addElement(0, tri);
-		}
+		OcNodeObject getRoot();
 
-		float getArea(size_t id);
+		// Elements are only queued here, the tree is rebuilt by bake()
+		void addElement(size_t tri) override;
 
-		std::deque<size_t> getElements(size_t nodeId, AABB aabb, size_t& count);
-		std::deque<size_t> getElements(AABB aabb, size_t& count);
+		float getArea(size_t id) const;
 
-		void genChildren(size_t nodeId);
-		void moveElementsToChildren(size_t nodeId);
+		std::deque<size_t> getElements(size_t nodeId, AABB aabb, size_t& count) const;
+		std::deque<size_t> getElements(AABB aabb, size_t& count) const override;
+		void visit(AABB aabb, BroadphaseQuery& query, ElementVisitor visitor) const override;
+		void traceRays(RayPacket& packet, LeafVisitor visitor) const override;
 
 		auto getPtr() {
 			return shared_from_this();
 		}
 
-		void genAll();
+		void bake() override;
+		bool serialize(std::vector<std::byte>& out) const override;
+		bool deserialize(std::span<const std::byte> data) override;
+		void genAll() {
+			bake();
+		}
+
+		size_t nodeCount() const {
+			return nodes.size();
+		}
 
+		size_t elementCount() const {
+			return elements.size();
+		}
 
 	private:
+		// nodes and elements of a subtree, large subtrees are baked into their own and spliced into the parent
+		struct BakeTarget {
+			std::vector<OcNode> nodes;
+			std::vector<uint32_t> elements;
+		};
+
 		Octree(AABB aabb);
-		std::vector<OcNode> nodes;
-	};
+		static void bakeNode(BakeTarget& target, uint32_t nodeId, std::vector<uint32_t>& items, uint32_t depth);
+		static void splice(BakeTarget& target, uint32_t nodeId, const BakeTarget& subtree);
 
-	struct OcNode {
-		OcNode(AABB aabb) {
-			this->aabb = aabb;
-		}
-		AABB aabb;
-		size_t children = 0;
-		std::deque<size_t> elements;
-		bool dirty = false;
+		AABB bounds;
+		std::vector<uint32_t> pending;
+
+		std::vector<OcNode> nodes;
+		std::vector<uint32_t> elements;
 	};
 
 	class OcNodeObject {
 	public:
-		void addElement(size_t tri);
 		float getArea();
 		std::deque<size_t> getElements(AABB aabb, size_t& count);
 
 		size_t id;
 		std::shared_ptr<Octree> octree;
 	};
-}
\ No newline at end of file
+}
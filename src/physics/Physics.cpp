@@ -1,9 +1,36 @@
 #include "Physics.h"
 #include <ranges>
 #include "../util/range_view.hpp"
+#include "../util/thread_pool.hpp"
+#include <filesystem>
+
+// how many surfaces a single move can slide along before the rest of it is dropped
+constexpr int MAX_SLIDE_ITERATIONS = 4;
+
+// the player's candidate triangles are queried this far around it and reused until it leaves that,
+// a bit more than a tenth of a second of running
+constexpr float PLAYER_CANDIDATE_MARGIN = 0.5f;
+
+// packets of 8 rays handed to each thread pool task at least
+constexpr size_t PARALLEL_RAY_PACKETS = 32;
 
 namespace amaz {
 
+	namespace {
+		double microsecondsBetween(std::chrono::high_resolution_clock::time_point start, std::chrono::high_resolution_clock::time_point end) {
+			return std::chrono::duration<double, std::micro>(end - start).count();
+		}
+
+		void countCandidateCache(StepStats* stats, bool hit) {
+			if (!stats) return;
+			if (hit) {
+				stats->cacheHits++;
+			} else {
+				stats->cacheMisses++;
+			}
+		}
+	}
+
 	glm::mat4 calcTransformMatrix(glm::vec3 position, float scale, glm::vec3 rotation) {
 		auto translation = glm::translate(position);
 
@@ -110,8 +137,8 @@ namespace amaz {
 		}
 	}
 
-	Physics::Physics() {
-		octree = amaz::Octree::create({ { -65536.f, -65536.f, -65536.f }, { 65536.f, 65536.f, 65536.f } });
+	Physics::Physics(BroadphaseType broadphaseType)
+		: _collision(broadphaseType), _broadphaseType(broadphaseType), _playerCandidates(PLAYER_CANDIDATE_MARGIN) {
 		initCollision();
 
 	}
@@ -124,6 +151,8 @@ namespace amaz {
 			0.4f
 		};
 
+		_characters.setShape(player);
+
 		playerSphere = {
 			{0.f, 0.f, 0.f},
 			0.4f
@@ -137,27 +166,209 @@ namespace amaz {
 
 	}
 
-	void Physics::loadMesh(std::string name, std::string filename, glm::vec3 position, float scale, glm::vec3 rotation) {
+	void Physics::setCollisionCache(std::string directory) {
+		std::error_code error;
+		std::filesystem::create_directories(directory, error);
+		if (error) {
+			std::cout << "Unable to create collision cache " << directory << ": " << error.message() << "\n";
+			return;
+		}
+		_cacheDirectory = directory;
+	}
+
+	uint32_t Physics::loadCollisionMesh(const std::string& filename) {
+		auto found = _collisionMeshIds.find(filename);
+		if (found != _collisionMeshIds.end()) {
+			return found->second;
+		}
+
+		uint32_t meshId = _collision.addMesh();
+		_collisionMeshIds[filename] = meshId;
+
+		uint64_t key = _cacheDirectory.empty() ? 0 : amaz::collisionMeshKey(filename);
+		_meshSources.push_back({ filename, key });
+		std::string path = key ? amaz::cookedPath(_cacheDirectory, filename, key, ".col") : "";
+
+		CookedMesh cooked;
+		if (key && cooked.open(path, key)) {
+			// normals, edges and bounds straight out of the mapped file
+			auto tris = cooked.triangles();
+			amaz::reserveTris(amaz::trisCount() + tris.size());
+			for (const auto& tri : tris) {
+				_collision.addTriangle(meshId, static_cast<uint32_t>(amaz::registerTri(tri)));
+			}
+			return meshId;
+		}
+
 		ColMesh mesh{};
 		mesh.loadObj(filename);
-		mesh.moveObj(position, scale, rotation);
 
+		// normals, edges and bounds are computed here once, see TriangleStore
+		std::vector<CookedTriangle> tris;
+		tris.reserve(mesh.tris.size());
+		amaz::reserveTris(amaz::trisCount() + mesh.tris.size());
 		for (auto tri : mesh.tris) {
-			octree->addElement(amaz::registerTri(tri));
+			tris.push_back(amaz::cookTriangle(tri));
+			_collision.addTriangle(meshId, static_cast<uint32_t>(amaz::registerTri(tris.back())));
 		}
 
-		_meshIDs[name] = _meshes.size();
-		_meshes.push_back(mesh);
+		if (key) {
+			amaz::writeCookedMesh(path, key, tris);
+		}
+		return meshId;
+	}
+
+	void Physics::loadMesh(std::string name, std::string filename, glm::vec3 position, float scale, glm::vec3 rotation) {
+		// the triangles stay in the mesh's own space, placing it again only adds an instance
+		uint32_t meshId = loadCollisionMesh(filename);
+		_meshIDs[name] = static_cast<int>(_collision.addInstance(meshId, calcTransformMatrix(position, scale, rotation)));
+	}
+
+	void Physics::bakeCollision() {
+		for (uint32_t meshId = 0; meshId < _collision.meshCount(); meshId++) {
+			Broadphase& meshBroadphase = *_collision.mesh(meshId).broadphase;
+			const MeshSource& source = _meshSources[meshId];
+			if (meshBroadphase.isBaked() || !source.key) continue;
+
+			// cooked once per mesh and broadphase type, wherever the mesh is placed
+			uint64_t key = util::hashValue(_broadphaseType, source.key);
+			std::string path = amaz::cookedPath(_cacheDirectory, source.filename, key, ".bin");
+			if (!amaz::readCookedBroadphase(path, key, meshBroadphase)) {
+				meshBroadphase.bake();
+				amaz::writeCookedBroadphase(path, key, meshBroadphase);
+			}
+		}
+
+		// bakes whatever couldn't be cached and builds the tree over the instances
+		_collision.bake();
+		_playerCandidates.invalidate();
+		_characters.invalidateCandidates();
+	}
+
+	void Physics::setHeightfield(Heightfield heightfield) {
+		_heightfield = std::move(heightfield);
+	}
+
+	void Physics::clearHeightfield() {
+		_heightfield.reset();
+	}
+
+	void Physics::castHeightfield(Ray ray, float maxT, RayHit& hit) const {
+		if (!_heightfield) return;
+		RayHit terrain = _heightfield->raycast(ray, hit.hit ? std::min(hit.t, maxT) : maxT);
+		if (terrain.hit && (!hit.hit || terrain.t < hit.t)) hit = terrain;
+	}
+
+	void Physics::sweepHeightfield(Capsule capsule, glm::vec3 motion, SweepHit& hit) const {
+		if (!_heightfield) return;
+		SweepHit terrain = _heightfield->sweepCapsule(capsule, motion);
+		if (terrain.hit && (!hit.hit || terrain.t < hit.t)) hit = terrain;
+	}
+
+	RayHit Physics::raycast(Ray ray, float maxT) const {
+		RayHit hit;
+		amaz::castRays(_collision, { &ray, 1 }, maxT, { &hit, 1 });
+		castHeightfield(ray, maxT, hit);
+		return hit;
+	}
+
+	RayHit Physics::linecast(Line line) const {
+		RayHit hit;
+		amaz::castLines(_collision, { &line, 1 }, { &hit, 1 });
+		castHeightfield({ line.a, line.b - line.a }, 1.f, hit);
+		return hit;
+	}
+
+	void Physics::raycastMany(std::span<const Ray> rays, std::span<RayHit> hits, float maxT) const {
+		if (hits.size() < rays.size()) {
+			std::cout << "raycastMany needs a hit for every ray, got " << hits.size() << " hits for " << rays.size() << " rays\n";
+			return;
+		}
+
+		// chunks stay multiples of the packet width so packets are never split between threads
+		size_t packets = (rays.size() + util::simd::WIDTH - 1) / util::simd::WIDTH;
+		util::parallelFor(packets, PARALLEL_RAY_PACKETS, [&](size_t begin, size_t end) {
+			size_t first = begin * util::simd::WIDTH;
+			size_t last = std::min(rays.size(), end * util::simd::WIDTH);
+			amaz::castRays(_collision, rays.subspan(first, last - first), maxT, hits.subspan(first, last - first));
+			for (size_t i = first; i < last; i++) {
+				castHeightfield(rays[i], maxT, hits[i]);
+			}
+		});
+	}
+
+	void Physics::linecastMany(std::span<const Line> lines, std::span<RayHit> hits) const {
+		if (hits.size() < lines.size()) {
+			std::cout << "linecastMany needs a hit for every line, got " << hits.size() << " hits for " << lines.size() << " lines\n";
+			return;
+		}
+
+		size_t packets = (lines.size() + util::simd::WIDTH - 1) / util::simd::WIDTH;
+		util::parallelFor(packets, PARALLEL_RAY_PACKETS, [&](size_t begin, size_t end) {
+			size_t first = begin * util::simd::WIDTH;
+			size_t last = std::min(lines.size(), end * util::simd::WIDTH);
+			amaz::castLines(_collision, lines.subspan(first, last - first), hits.subspan(first, last - first));
+			for (size_t i = first; i < last; i++) {
+				castHeightfield({ lines[i].a, lines[i].b - lines[i].a }, 1.f, hits[i]);
+			}
+		});
+	}
+
+	SweepHit Physics::sweepCapsule(Capsule capsule, glm::vec3 motion) {
+		SweepHit hit = amaz::sweepCapsule(_collision, capsule, motion, _playerScratch.query, _playerScratch.candidates);
+		sweepHeightfield(capsule, motion, hit);
+		return hit;
+	}
+
+	glm::vec3 Physics::collideAndSlide(glm::vec3 pos, glm::vec3 motion) {
+		return slideCharacter(player, pos, motion, _playerCandidates, _playerScratch, isGrounded, &_stepStats);
 	}
 
 	bool Physics::newResolveCollisions(glm::vec3 pos, glm::vec3& moveVector) {
+		resolveCharacter(player, pos, moveVector, _playerCandidates, _playerScratch, isGrounded, &_stepStats);
+		return true;
+	}
+
+	glm::vec3 Physics::slideCharacter(const Capsule& shape, glm::vec3 pos, glm::vec3 motion, CandidateCache& cache,
+		CharacterScratch& scratch, bool& grounded, StepStats* stats) const {
+
+		for (int i = 0; i < MAX_SLIDE_ITERATIONS; i++) {
+			if (glm::dot(motion, motion) <= 1e-12f) {
+				break;
+			}
+
+			Capsule capsule = { shape.tip + pos, shape.base + pos, shape.radius };
+			bool cached = cache.update(_collision, amaz::sweptBounds(capsule, motion), scratch.query, scratch.candidates);
+			countCandidateCache(stats, cached);
+			SweepHit hit = amaz::sweepCapsule(_collision, cache, capsule, motion);
+			sweepHeightfield(capsule, motion, hit);
+			if (!hit.hit) {
+				pos += motion;
+				break;
+			}
+
+			if (hit.normal.y > 0.f) {
+				grounded = true;
+			}
+
+			// move up to the surface, then carry on with what is left of the motion along it
+			pos += motion * hit.t;
+			glm::vec3 remaining = motion * (1.f - hit.t);
+			motion = remaining - hit.normal * glm::dot(remaining, hit.normal);
+		}
+
+		return pos;
+	}
+
+	void Physics::resolveCharacter(const Capsule& shape, glm::vec3 pos, glm::vec3& moveVector, CandidateCache& cache,
+		CharacterScratch& scratch, bool& grounded, StepStats* stats) const {
 
 		glm::vec3 newPos = pos + moveVector;
 
 		Capsule tempPlayer = {
-			player.tip + newPos,
-			player.base + newPos,
-			player.radius
+			shape.tip + newPos,
+			shape.base + newPos,
+			shape.radius
 		};
 
 		//TODO: include old pos?
@@ -172,52 +383,115 @@ namespace amaz {
 
 		AABB playerAABB = { playerMin, playerMax };
 
-		uint64_t count = 0;
-
-		auto startTime = std::chrono::high_resolution_clock::now();
-		std::deque<size_t> tris;
-		tris = octree->getElements(playerAABB, count);
-		auto gotTrisTime = std::chrono::high_resolution_clock::now();
+		// crowds step without stats, reading the clock for every one of them would cost more than their broadphase
+		auto now = [stats]() {
+			return stats ? std::chrono::high_resolution_clock::now() : std::chrono::high_resolution_clock::time_point{};
+		};
 
-		std::vector<std::pair<float, size_t>> collisions;
-		SphereCollisionResults result;
-		for (size_t triId : tris) {
-			if ((result = CapsuleVsTriangle(tempPlayer, amaz::getTriFromId(triId))).collided) {
-				collisions.push_back({ result.penetration_depth, triId });
+		auto startTime = now();
+		countCandidateCache(stats, cache.update(_collision, playerAABB, scratch.query, scratch.candidates));
+		auto gotTrisTime = now();
+
+		const TriangleStore& store = amaz::getTriangleStore();
+		std::vector<uint32_t>& candidates = scratch.candidates;
+		std::vector<TriangleContact>& contacts = scratch.contacts;
+		uint32_t trianglesTested = 0;
+		contacts.clear();
+		for (const auto& range : cache.ranges()) {
+			const CollisionInstance& instance = _collision.instance(range.instance);
+
+			// the cache covers more than the player, only what the player's bounds overlap goes to the narrowphase
+			AABB localAABB = instance.aabbToLocal(playerAABB);
+			candidates.clear();
+			for (uint32_t tri : cache.triangles(range)) {
+				if (amaz::AABBvsAABB(store.aabb(tri), localAABB)) candidates.push_back(tri);
+			}
+			trianglesTested += static_cast<uint32_t>(candidates.size());
+
+			// tested in the instance's space, contacts are moved back out so they sort against every instance's
+			size_t first = contacts.size();
+			amaz::capsuleVsTriangles(instance.capsuleToLocal(tempPlayer), candidates, contacts);
+			for (size_t i = first; i < contacts.size(); i++) {
+				contacts[i].instance = range.instance;
+				contacts[i].depth *= instance.scale;
+				contacts[i].normal = instance.normalToWorld(contacts[i].normal);
 			}
 		}
+		auto firstCollideTime = now();
 
-		auto firstCollideTime = std::chrono::high_resolution_clock::now();
-
-		std::sort(collisions.begin(), collisions.end(), [](const auto& a, const auto& b) {
-			return a.first > b.first;
+		// equal depths are ordered by triangle so the order doesn't depend on what the candidate cache held
+		std::sort(contacts.begin(), contacts.end(), [](const auto& a, const auto& b) {
+			if (a.depth != b.depth) return a.depth > b.depth;
+			return a.instance < b.instance || (a.instance == b.instance && a.tri < b.tri);
 			});
 
-		auto sortedTrisTime = std::chrono::high_resolution_clock::now();
+		auto sortedTrisTime = now();
 
 		SphereCollisionResults collision;
-		for (auto& [f, tri] : collisions) {
-			if ((collision = CapsuleVsTriangle(tempPlayer, amaz::getTriFromId(tri))).collided) {
+		for (auto& contact : contacts) {
+			const CollisionInstance& instance = _collision.instance(contact.instance);
+			if ((collision = CapsuleVsTriangle(instance.capsuleToLocal(tempPlayer), contact.tri)).collided) {
+				collision.penetration_normal = instance.normalToWorld(collision.penetration_normal);
+				collision.penetration_depth *= instance.scale;
 
 				if (collision.penetration_normal.y > 0.f) {
-					isGrounded = true;
+					grounded = true;
 				}
 
 				moveVector += (collision.penetration_normal * collision.penetration_depth);
 				newPos = pos + moveVector;
-				tempPlayer.tip = player.tip + newPos;
-				tempPlayer.base = player.base + newPos;
+				tempPlayer.tip = shape.tip + newPos;
+				tempPlayer.base = shape.base + newPos;
 
 			}
 		}
 
-		auto collidedTrisTime = std::chrono::high_resolution_clock::now();
-
-		return true;
+		// terrain triangles are made on the fly so they're pushed out of after the meshes, the same way
+		if (_heightfield) {
+			std::vector<HeightfieldContact>& terrainContacts = scratch.terrainContacts;
+			terrainContacts.clear();
+			_heightfield->visitTriangles(playerAABB, [&](uint32_t tri, const CookedTriangle& cooked) {
+				trianglesTested++;
+				SphereCollisionResults result = CapsuleVsTriangle(tempPlayer, cooked.tri, cooked.normal);
+				if (result.collided) terrainContacts.push_back({ tri, result.penetration_normal, result.penetration_depth });
+			});
+			std::sort(terrainContacts.begin(), terrainContacts.end(), [](const auto& a, const auto& b) {
+				return a.depth > b.depth || (a.depth == b.depth && a.tri < b.tri);
+				});
+
+			for (const auto& contact : terrainContacts) {
+				CookedTriangle cooked = _heightfield->triangle(contact.tri);
+				if ((collision = CapsuleVsTriangle(tempPlayer, cooked.tri, cooked.normal)).collided) {
+					if (collision.penetration_normal.y > 0.f) {
+						grounded = true;
+					}
+
+					moveVector += (collision.penetration_normal * collision.penetration_depth);
+					newPos = pos + moveVector;
+					tempPlayer.tip = shape.tip + newPos;
+					tempPlayer.base = shape.base + newPos;
+				}
+			}
+		}
 
+		if (stats) {
+			auto collidedTrisTime = now();
+			stats->broadphase += microsecondsBetween(startTime, gotTrisTime);
+			stats->narrowphase += microsecondsBetween(gotTrisTime, firstCollideTime);
+			stats->sort += microsecondsBetween(firstCollideTime, sortedTrisTime);
+			stats->resolve += microsecondsBetween(sortedTrisTime, collidedTrisTime);
+			stats->trianglesTested += trianglesTested;
+			stats->contacts += static_cast<uint32_t>(contacts.size() + (_heightfield ? scratch.terrainContacts.size() : 0));
+		}
 	}
 
 	void Physics::stepLogic(Input& input, float seconds) {
+		_stepStats = {};
+
+		if (!_collision.isBaked()) {
+			std::cout << "Meshes were loaded after bakeCollision, baking again\n";
+			bakeCollision();
+		}
 
 		glm::vec3 movementVector = glm::vec3{ 0.f };
 
@@ -281,6 +555,10 @@ namespace amaz {
 
 			movementVector += glm::vec3{ 0, yVelocity * seconds, 0 };
 			//TODO: Make gravity not slide you down slopes
+			// sweep first so fast moves stop at the first surface, then push out of anything still overlapping
+			auto sweepTime = std::chrono::high_resolution_clock::now();
+			movementVector = collideAndSlide(input.camPos, movementVector) - input.camPos;
+			_stepStats.sweep = microsecondsBetween(sweepTime, std::chrono::high_resolution_clock::now());
 			newResolveCollisions(input.camPos, movementVector);
 			input.camPos += movementVector;
 
@@ -290,44 +568,93 @@ namespace amaz {
 			}
 		}
 
+		auto charactersTime = std::chrono::high_resolution_clock::now();
+		_characters.step(seconds);
+		_stepStats.characters = microsecondsBetween(charactersTime, std::chrono::high_resolution_clock::now());
+
+		auto rigidTime = std::chrono::high_resolution_clock::now();
+		_rigidWorld.step(seconds);
+		_stepStats.rigid = microsecondsBetween(rigidTime, std::chrono::high_resolution_clock::now());
+
+	}
+
+	void Physics::saveState(PhysicsState& state, const Input& input) const {
+		state.player = { input.camPos, yVelocity, jumpTime, jumped, isGrounded };
+		_rigidWorld.saveState(state.rigid);
+		_characters.saveState(state.characters);
+	}
+
+	void Physics::restoreState(const PhysicsState& state, Input& input) {
+		input.camPos = state.player.position;
+		yVelocity = state.player.yVelocity;
+		jumpTime = state.player.jumpTime;
+		jumped = state.player.jumped;
+		isGrounded = state.player.isGrounded;
+		_rigidWorld.restoreState(state.rigid);
+		_characters.restoreState(state.characters);
+	}
+
+	bool Physics::rollback(PhysicsHistory& history, uint64_t fromTick, uint64_t toTick, Input& input, float seconds) {
+		if (!history.contains(fromTick)) {
+			std::cout << "Can't roll back to tick " << fromTick << ", it's no longer in the history\n";
+			return false;
+		}
+
+		Input replay = history.input(fromTick);
+		restoreState(history.state(fromTick), replay);
+		for (uint64_t tick = fromTick; tick < toTick; tick++) {
+			if (tick != fromTick) {
+				// the recorded input drives the step, the position carries on from the re-simulated one
+				glm::vec3 position = replay.camPos;
+				replay = history.input(tick);
+				replay.camPos = position;
+				history.record(tick, *this, replay);
+			}
+			stepLogic(replay, seconds);
+		}
 
+		input.camPos = replay.camPos;
+		return true;
 	}
 
-	float Physics::distBetweenPoints(glm::vec3 a, glm::vec3 b) {
+	float Physics::distBetweenPoints(glm::vec3 a, glm::vec3 b) const {
 		return glm::sqrt(squaredDistBetweenPoints(a, b));
 	}
 
-	float Physics::squaredDistBetweenPoints(glm::vec3 a, glm::vec3 b) {
+	float Physics::squaredDistBetweenPoints(glm::vec3 a, glm::vec3 b) const {
 		glm::vec3 c = glm::abs(b - a);
 		return std::pow(c.x, 2) + std::pow(c.y, 2) + std::pow(c.z, 2);
 	}
 
-	bool Physics::SphereVsSphere(Sphere a, Sphere b) {
+	bool Physics::SphereVsSphere(Sphere a, Sphere b) const {
 		if (squaredDistBetweenPoints(a.pos, b.pos) < (a.radius + b.radius) * (a.radius + b.radius))
 			return true;
 		else
 			return false;
 	}
 
-	glm::vec3 Physics::closestPointOnLine(glm::vec3 a, glm::vec3 b, glm::vec3 point) {
+	glm::vec3 Physics::closestPointOnLine(glm::vec3 a, glm::vec3 b, glm::vec3 point) const {
 		glm::vec3 ab = b - a;
 		float t = dot(point - a, ab) / dot(ab, ab);
 		return a + glm::clamp(t, 0.f, 1.f) * ab;
 	}
 
-	bool Physics::SphereVsLine(Sphere sphere, glm::vec3 a, glm::vec3 b, glm::vec3& point) {
+	bool Physics::SphereVsLine(Sphere sphere, glm::vec3 a, glm::vec3 b, glm::vec3& point) const {
 		point = closestPointOnLine(a, b, sphere.pos);
 		glm::vec3 v = sphere.pos - point;
 		float distsq = dot(v, v);
 		return distsq < std::pow(sphere.radius, 2);
 	}
 
-	glm::vec3 Physics::trianglePlaneNormal(Triangle tri) {
+	glm::vec3 Physics::trianglePlaneNormal(Triangle tri) const {
 		return glm::normalize(glm::cross(tri.b - tri.a, tri.c - tri.a));
 	}
 
-	Physics::SphereCollisionResults Physics::SphereVsTriangle(Sphere sphere, Triangle tri) {
-		glm::vec3 N = trianglePlaneNormal(tri);
+	Physics::SphereCollisionResults Physics::SphereVsTriangle(Sphere sphere, Triangle tri) const {
+		return SphereVsTriangle(sphere, tri, trianglePlaneNormal(tri));
+	}
+
+	Physics::SphereCollisionResults Physics::SphereVsTriangle(Sphere sphere, Triangle tri, glm::vec3 N) const {
 		float dist = glm::dot(sphere.pos - tri.a, N); // absolute distance between sphere and plane
 		if (glm::abs(dist) > sphere.radius) // Not on triangles plane, return false
 			return { false, {}, 0.f };
@@ -344,9 +671,11 @@ namespace amaz {
 		glm::vec3 point1, point2, point3;
 
 		if (!inside) {
-			intersects = SphereVsLine(sphere, tri.a, tri.b, point1)
-				|| SphereVsLine(sphere, tri.b, tri.c, point2)
-				|| SphereVsLine(sphere, tri.c, tri.a, point3);
+			// all three have to run, the closest edge point is picked from them below
+			bool intersects1 = SphereVsLine(sphere, tri.a, tri.b, point1);
+			bool intersects2 = SphereVsLine(sphere, tri.b, tri.c, point2);
+			bool intersects3 = SphereVsLine(sphere, tri.c, tri.a, point3);
+			intersects = intersects1 || intersects2 || intersects3;
 		}
 		if (inside || intersects)
 		{
@@ -388,7 +717,7 @@ namespace amaz {
 		return { false, {}, 0.f };
 	}
 
-	CapsuleEndPoints Physics::calcCapsuleEndpoints(Capsule capsule) {
+	CapsuleEndPoints Physics::calcCapsuleEndpoints(Capsule capsule) const {
 		glm::vec3 normalized = glm::normalize(capsule.tip - capsule.base);
 		glm::vec3 lineEndOffset = normalized * capsule.radius;
 		glm::vec3 a = capsule.base + lineEndOffset;
@@ -397,14 +726,14 @@ namespace amaz {
 		return { a, b };
 	}
 
-	bool Physics::CapsuleVsSphere(Capsule capsule, Sphere sphere) {
+	bool Physics::CapsuleVsSphere(Capsule capsule, Sphere sphere) const {
 		auto endPoints = calcCapsuleEndpoints(capsule);
 		glm::vec3 capsulePoint = closestPointOnLine(endPoints.a, endPoints.b, sphere.pos);
 
 		return SphereVsSphere({ capsulePoint, capsule.radius }, sphere);
 	}
 
-	bool Physics::CapsuleVsCapsule(Capsule a, Capsule b) {
+	bool Physics::CapsuleVsCapsule(Capsule a, Capsule b) const {
 
 		auto endPointsA = calcCapsuleEndpoints(a);
 		auto endPointsB = calcCapsuleEndpoints(b);
@@ -437,8 +766,11 @@ namespace amaz {
 		return intersects;
 	}
 
-	glm::vec3 Physics::closestPointOnTriangle(Triangle tri, glm::vec3 point) {
-		glm::vec3 N = trianglePlaneNormal(tri);
+	glm::vec3 Physics::closestPointOnTriangle(Triangle tri, glm::vec3 point) const {
+		return closestPointOnTriangle(tri, trianglePlaneNormal(tri), point);
+	}
+
+	glm::vec3 Physics::closestPointOnTriangle(Triangle tri, glm::vec3 N, glm::vec3 point) const {
 		glm::vec3 c0 = glm::cross(point - tri.a, tri.b - tri.a);
 		glm::vec3 c1 = glm::cross(point - tri.b, tri.c - tri.b);
 		glm::vec3 c2 = glm::cross(point - tri.c, tri.a - tri.c);
@@ -481,19 +813,26 @@ namespace amaz {
 		return outPoint;
 	}
 
-	Physics::SphereCollisionResults Physics::CapsuleVsTriangle(Capsule capsule, Triangle tri) {
+	Physics::SphereCollisionResults Physics::CapsuleVsTriangle(Capsule capsule, Triangle tri) const {
+		return CapsuleVsTriangle(capsule, tri, trianglePlaneNormal(tri));
+	}
+
+	Physics::SphereCollisionResults Physics::CapsuleVsTriangle(Capsule capsule, size_t triId) const {
+		const TriangleStore& store = amaz::getTriangleStore();
+		return CapsuleVsTriangle(capsule, store.triangle(triId), store.normal(triId));
+	}
+
+	Physics::SphereCollisionResults Physics::CapsuleVsTriangle(Capsule capsule, Triangle tri, glm::vec3 N) const {
 		auto [a, b] = calcCapsuleEndpoints(capsule);
 		glm::vec3 normalizedCapsule = glm::normalize(capsule.tip - capsule.base);
 
-		glm::vec3 N = trianglePlaneNormal(tri);
-
 		float absoluteDot = glm::abs(glm::dot(N, normalizedCapsule));
 
 		glm::vec3 center;
 
 		if (absoluteDot == 0) {
-			glm::vec3 triBestA = closestPointOnTriangle(tri, a);
-			glm::vec3 triBestB = closestPointOnTriangle(tri, b);
+			glm::vec3 triBestA = closestPointOnTriangle(tri, N, a);
+			glm::vec3 triBestB = closestPointOnTriangle(tri, N, b);
 
 			glm::vec3 bestA = closestPointOnLine(a, b, triBestA);
 			glm::vec3 bestB = closestPointOnLine(a, b, triBestB);
@@ -510,7 +849,7 @@ namespace amaz {
 
 			//std::cout << t << "\n";
 			glm::vec3 line_plane_intersection = capsule.base + normalizedCapsule * t;
-			glm::vec3 reference_point = closestPointOnTriangle(tri, line_plane_intersection);
+			glm::vec3 reference_point = closestPointOnTriangle(tri, N, line_plane_intersection);
 
 			center = closestPointOnLine(a, b, reference_point);
 		}
@@ -525,6 +864,6 @@ namespace amaz {
 
 		//return { collided, penetration_normal, penetration_depth};*/
 
-		return SphereVsTriangle({ center, capsule.radius }, tri);
+		return SphereVsTriangle({ center, capsule.radius }, tri, N);
 	}
 };
\ No newline at end of file
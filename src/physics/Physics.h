@@ -10,11 +10,25 @@
 #include <tiny_obj_loader.h>
 #include <unordered_map>
 #include <array>
+#include <span>
+#include <limits>
 #include "Objects.h"
 #include "Octree.h"
+#include "Broadphase.h"
+#include "BatchCollision.h"
+#include "Raycast.h"
+#include "Sweep.h"
+#include "RigidWorld.h"
+#include "PhysicsState.h"
+#include "CollisionCache.h"
+#include "CollisionScene.h"
+#include "CandidateCache.h"
+#include "CharacterSystem.h"
+#include "Heightfield.h"
 
 #include "Collision.h"
 #include <deque>
+#include <optional>
 #include <chrono>
 #include "../input/Input.h"
 
@@ -30,6 +44,27 @@ namespace amaz {
 
 	glm::mat4 calcTransformMatrix(glm::vec3 position, float scale, glm::vec3 rotation);
 
+	// Where the last stepLogic spent its time, in microseconds
+	struct StepStats {
+		// collideAndSlide
+		double sweep = 0.0;
+		// instance and triangle queries around the player before resolving overlaps
+		double broadphase = 0.0;
+		// capsule against every candidate triangle
+		double narrowphase = 0.0;
+		// contacts deepest first
+		double sort = 0.0;
+		// pushing out of the sorted contacts
+		double resolve = 0.0;
+		double rigid = 0.0;
+		double characters = 0.0;
+		uint32_t trianglesTested = 0;
+		uint32_t contacts = 0;
+		// player queries answered from the candidate cache and ones that had to query the scene
+		uint32_t cacheHits = 0;
+		uint32_t cacheMisses = 0;
+	};
+
 	struct ColMesh {
 		std::vector<Triangle> tris;
 		bool loadObj(std::string filename, float scale = 0);
@@ -38,41 +73,140 @@ namespace amaz {
 
 	class Physics {
 	public:
-		Physics();
+		Physics(BroadphaseType broadphaseType = BroadphaseType::Octree);
 		void initCollision();
 		void stepLogic(Input& input, float seconds);
 		void loadMesh(std::string name, std::string filename, glm::vec3 position, float scale, glm::vec3 rotation);
+		// Builds the broadphase over every loaded mesh, call once after loading a scene.
+		// After this collision queries are read only and can run on several threads.
+		void bakeCollision();
+		// Cooked collision meshes and the baked broadphase are kept in directory and memory mapped on the next
+		// load instead of parsing and baking again. Call before loading any meshes, off by default.
+		void setCollisionCache(std::string directory);
+
+		const CollisionScene& getCollisionScene() const {
+			return _collision;
+		}
+
+		// Terrain collided with alongside the meshes by every query, the player, characters and rigid bodies.
+		// Replaces the heightfield set before.
+		void setHeightfield(Heightfield heightfield);
+		void clearHeightfield();
+
+		// null when there's no terrain
+		const Heightfield* getHeightfield() const {
+			return _heightfield ? &*_heightfield : nullptr;
+		}
+
+		// The player's position lives in input.camPos, so it's saved from and restored to there
+		void saveState(PhysicsState& state, const Input& input) const;
+		void restoreState(const PhysicsState& state, Input& input);
+		// Restores the state recorded for fromTick and steps again with the recorded inputs up to toTick, re-recording
+		// every tick on the way so corrections made to the history carry forward. Only the player's position is
+		// written to input, the rest of it is left as it is. False if fromTick is no longer in the history.
+		bool rollback(PhysicsHistory& history, uint64_t fromTick, uint64_t toTick, Input& input, float seconds);
+
+		const StepStats& getStepStats() const {
+			return _stepStats;
+		}
+
+		// Triangles around the player, reused between ticks. Its hits and misses count every query since it was created.
+		const CandidateCache& getPlayerCandidates() const {
+			return _playerCandidates;
+		}
+
+		// dynamic bodies, stepped at the end of every stepLogic
+		RigidWorld& getRigidWorld() {
+			return _rigidWorld;
+		}
+
+		// crowd characters, stepped after the player in every stepLogic
+		CharacterSystem& getCharacters() {
+			return _characters;
+		}
+
+		// Closest hit against the static collision meshes, t is in multiples of ray.dir
+		RayHit raycast(Ray ray, float maxT = std::numeric_limits<float>::max()) const;
+		RayHit linecast(Line line) const;
+		// Batched versions for lots of queries at once like AI visibility checks, split over the thread pool.
+		// hits needs one element per ray.
+		void raycastMany(std::span<const Ray> rays, std::span<RayHit> hits, float maxT = std::numeric_limits<float>::max()) const;
+		void linecastMany(std::span<const Line> lines, std::span<RayHit> hits) const;
+
+		// Earliest time of impact of capsule moved by motion against the static collision meshes
+		SweepHit sweepCapsule(Capsule capsule, glm::vec3 motion);
+		// Replace hit with one against the heightfield if there is one and it's earlier
+		void castHeightfield(Ray ray, float maxT, RayHit& hit) const;
+		void sweepHeightfield(Capsule capsule, glm::vec3 motion, SweepHit& hit) const;
+		// Moves the player capsule from pos by motion, stopping at and sliding along whatever it sweeps into.
+		// Unlike resolving overlaps at the destination this can't tunnel through thin geometry at high speed.
+		glm::vec3 collideAndSlide(glm::vec3 pos, glm::vec3 motion);
+
+		// The player's sweep and resolve for any capsule character, shape is placed around pos. They only read the Physics,
+		// so characters can be moved on several threads at once as long as each thread has its own scratch. grounded is
+		// set when the character lands on something, stats is added to and may be null.
+		glm::vec3 slideCharacter(const Capsule& shape, glm::vec3 pos, glm::vec3 motion, CandidateCache& cache,
+			CharacterScratch& scratch, bool& grounded, StepStats* stats) const;
+		void resolveCharacter(const Capsule& shape, glm::vec3 pos, glm::vec3& moveVector, CandidateCache& cache,
+			CharacterScratch& scratch, bool& grounded, StepStats* stats) const;
 
 		//move these to collision?
 		bool newResolveCollisions(glm::vec3 pos, glm::vec3& moveVector);
 		void detectCollision(glm::vec3 pos, glm::vec3 movementVec);
 
 		// def move to collision
-		float distBetweenPoints(glm::vec3 a, glm::vec3 b);
-		float squaredDistBetweenPoints(glm::vec3 a, glm::vec3 b);
-		bool SphereVsSphere(Sphere a, Sphere b);
-		glm::vec3 closestPointOnLine(glm::vec3 a, glm::vec3 b, glm::vec3 point);
-		bool SphereVsLine(Sphere sphere, glm::vec3 a, glm::vec3 b, glm::vec3& point);
-		glm::vec3 trianglePlaneNormal(Triangle tri);
+		float distBetweenPoints(glm::vec3 a, glm::vec3 b) const;
+		float squaredDistBetweenPoints(glm::vec3 a, glm::vec3 b) const;
+		bool SphereVsSphere(Sphere a, Sphere b) const;
+		glm::vec3 closestPointOnLine(glm::vec3 a, glm::vec3 b, glm::vec3 point) const;
+		bool SphereVsLine(Sphere sphere, glm::vec3 a, glm::vec3 b, glm::vec3& point) const;
+		glm::vec3 trianglePlaneNormal(Triangle tri) const;
 
 		struct SphereCollisionResults {
 			bool collided;
 			glm::vec3 penetration_normal;
 			float penetration_depth;
 		};
-		SphereCollisionResults SphereVsTriangle(Sphere sphere, Triangle tri);
+		SphereCollisionResults SphereVsTriangle(Sphere sphere, Triangle tri) const;
+		SphereCollisionResults SphereVsTriangle(Sphere sphere, Triangle tri, glm::vec3 N) const;
 
-		CapsuleEndPoints calcCapsuleEndpoints(Capsule capsule);
-		bool CapsuleVsSphere(Capsule capsule, Sphere sphere);
-		bool CapsuleVsCapsule(Capsule a, Capsule b);
-		glm::vec3 closestPointOnTriangle(Triangle tri, glm::vec3 point);
-		SphereCollisionResults CapsuleVsTriangle(Capsule capsule, Triangle tri);
+		CapsuleEndPoints calcCapsuleEndpoints(Capsule capsule) const;
+		bool CapsuleVsSphere(Capsule capsule, Sphere sphere) const;
+		bool CapsuleVsCapsule(Capsule a, Capsule b) const;
+		glm::vec3 closestPointOnTriangle(Triangle tri, glm::vec3 point) const;
+		glm::vec3 closestPointOnTriangle(Triangle tri, glm::vec3 N, glm::vec3 point) const;
+		SphereCollisionResults CapsuleVsTriangle(Capsule capsule, Triangle tri) const;
+		SphereCollisionResults CapsuleVsTriangle(Capsule capsule, Triangle tri, glm::vec3 N) const;
+		// uses the normal cached in the TriangleStore instead of recomputing it
+		SphereCollisionResults CapsuleVsTriangle(Capsule capsule, size_t triId) const;
 
 	private:
 		std::vector<CollisionObject> _collisionObjects; // old
-		std::vector<ColMesh> _meshes;
+		// Loads and registers a collision mesh the first time its file is used, returns its id in _collision
+		uint32_t loadCollisionMesh(const std::string& filename);
+
 		std::unordered_map<std::string, int> _meshIDs;
-		std::shared_ptr<amaz::Octree> octree;
+		std::unordered_map<std::string, uint32_t> _collisionMeshIds;
+		CollisionScene _collision;
+		BroadphaseType _broadphaseType;
+		std::optional<Heightfield> _heightfield;
+
+		std::string _cacheDirectory;
+		// file and cache key of every mesh in _collision, the key is 0 when it isn't cached
+		struct MeshSource {
+			std::string filename;
+			uint64_t key;
+		};
+		std::vector<MeshSource> _meshSources;
+
+		// reused every step so neither the broadphase nor the narrowphase allocate
+		CharacterScratch _playerScratch;
+
+		RigidWorld _rigidWorld{ *this };
+		CharacterSystem _characters{ *this };
+		StepStats _stepStats;
+
+		CandidateCache _playerCandidates;
 
 		Capsule player;
 		Sphere playerSphere;
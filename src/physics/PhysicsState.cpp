@@ -0,0 +1,27 @@
+#include "PhysicsState.h"
+
+#include "Physics.h"
+#include <algorithm>
+
+namespace amaz {
+
+	PhysicsHistory::PhysicsHistory(size_t capacity, size_t bodies, size_t characters) : entries(std::max<size_t>(capacity, 1)) {
+		for (Entry& entry : entries) {
+			entry.state.rigid.bodies.reserve(bodies);
+			entry.state.rigid.freeIds.reserve(bodies);
+			CharacterSystemState& state = entry.state.characters;
+			state.positions.reserve(characters);
+			state.moves.reserve(characters);
+			state.yVelocities.reserve(characters);
+			state.grounded.reserve(characters);
+			state.jumps.reserve(characters);
+		}
+	}
+
+	void PhysicsHistory::record(uint64_t tick, const Physics& physics, const Input& input) {
+		Entry& entry = entries[tick % entries.size()];
+		entry.tick = tick;
+		physics.saveState(entry.state, input);
+		entry.input = input;
+	}
+}
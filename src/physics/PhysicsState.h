@@ -0,0 +1,92 @@
+#pragma once
+
+#include "RigidWorld.h"
+#include "CharacterSystem.h"
+#include "../input/Input.h"
+#include <vector>
+#include <cstdint>
+#include <limits>
+#include <type_traits>
+#include <glm/glm.hpp>
+
+namespace amaz {
+
+	class Physics;
+
+	// Everything about the player that stepLogic carries from one tick to the next
+	struct PlayerState {
+		glm::vec3 position;
+		float yVelocity;
+		float jumpTime;
+		bool jumped;
+		bool isGrounded;
+	};
+
+	static_assert(std::is_trivially_copyable_v<PlayerState>, "PlayerState is saved and restored as plain bytes");
+	static_assert(std::is_trivially_copyable_v<RigidBody>, "RigidBody is saved and restored as plain bytes");
+
+	struct RigidWorldState {
+		std::vector<RigidBody> bodies;
+		std::vector<uint32_t> freeIds;
+	};
+
+	// Candidate caches aren't part of it, a character moves the same whatever its cache holds
+	struct CharacterSystemState {
+		std::vector<glm::vec3> positions;
+		std::vector<glm::vec3> moves;
+		std::vector<float> yVelocities;
+		std::vector<uint8_t> grounded;
+		std::vector<uint8_t> jumps;
+	};
+
+	// Simulation state at the start of a tick. Restoring it and stepping with the same input reproduces
+	// the ticks after it bit for bit. Copying into a state that was used before doesn't allocate.
+	struct PhysicsState {
+		PlayerState player;
+		RigidWorldState rigid;
+		CharacterSystemState characters;
+	};
+
+	// Rolling back re-steps every tick after the one rolled back to, copying states is a small part of its cost.
+	// Rolling back 8 ticks of this many bodies and characters fits in a 16ms frame, the rollback bench checks it.
+	constexpr size_t MAX_ROLLBACK_BODIES = 200;
+	constexpr size_t MAX_ROLLBACK_CHARACTERS = 100;
+
+	// Ring buffer of the last capacity ticks, each with the state it started in and the input it was stepped with
+	class PhysicsHistory {
+	public:
+		static constexpr uint64_t NO_TICK = std::numeric_limits<uint64_t>::max();
+
+		// every entry is reserved for bodies and characters up front, so recording up to that many never allocates
+		explicit PhysicsHistory(size_t capacity, size_t bodies = MAX_ROLLBACK_BODIES, size_t characters = MAX_ROLLBACK_CHARACTERS);
+
+		// Call right before stepping tick, overwrites whatever was recorded capacity ticks ago
+		void record(uint64_t tick, const Physics& physics, const Input& input);
+
+		bool contains(uint64_t tick) const {
+			return entries[tick % entries.size()].tick == tick;
+		}
+
+		// Recorded state and input of a tick, can be corrected before rolling back to it
+		PhysicsState& state(uint64_t tick) {
+			return entries[tick % entries.size()].state;
+		}
+
+		Input& input(uint64_t tick) {
+			return entries[tick % entries.size()].input;
+		}
+
+		size_t capacity() const {
+			return entries.size();
+		}
+
+	private:
+		struct Entry {
+			uint64_t tick = NO_TICK;
+			PhysicsState state;
+			Input input;
+		};
+
+		std::vector<Entry> entries;
+	};
+}
@@ -0,0 +1,198 @@
+#include "Raycast.h"
+
+#include "Collision.h"
+#include "../util/simd.hpp"
+#include <array>
+#include <algorithm>
+
+// below this a triangle is treated as parallel to the ray
+constexpr float PARALLEL_DETERMINANT = 1e-12f;
+
+namespace amaz {
+
+	using namespace util::simd;
+
+	namespace {
+		vec3x8 broadcast(glm::vec3 v) {
+			return { v.x, v.y, v.z };
+		}
+
+		// 1 / dir without infinities, 0 * inf would give NaNs for rays starting exactly on a node's face
+		float safeInverse(float f) {
+			constexpr float TINY = 1e-20f;
+			return 1.f / (std::abs(f) < TINY ? (f < 0.f ? -TINY : TINY) : f);
+		}
+
+		// packet of rays[0] ... rays[count - 1], count <= 8, dir gets every lane's direction for the triangle tests
+		RayPacket makePacket(const std::array<Ray, WIDTH>& rays, size_t count, float maxT, vec3x8& dir) {
+			alignas(32) std::array<float, WIDTH> ox, oy, oz, dx, dy, dz, ix, iy, iz, lanes;
+			for (size_t lane = 0; lane < WIDTH; lane++) {
+				// padding lanes repeat the last ray and are masked out
+				Ray ray = rays[std::min(lane, count - 1)];
+				ox[lane] = ray.origin.x; oy[lane] = ray.origin.y; oz[lane] = ray.origin.z;
+				dx[lane] = ray.dir.x; dy[lane] = ray.dir.y; dz[lane] = ray.dir.z;
+				ix[lane] = safeInverse(ray.dir.x); iy[lane] = safeInverse(ray.dir.y); iz[lane] = safeInverse(ray.dir.z);
+				lanes[lane] = static_cast<float>(lane);
+			}
+
+			RayPacket packet;
+			packet.origin = { float8::load(ox.data()), float8::load(oy.data()), float8::load(oz.data()) };
+			packet.invDir = { float8::load(ix.data()), float8::load(iy.data()), float8::load(iz.data()) };
+			packet.maxT = maxT;
+			packet.active = float8::load(lanes.data()) < float8(static_cast<float>(count));
+			packet.dir = rays[0].dir;
+
+			dir = { float8::load(dx.data()), float8::load(dy.data()), float8::load(dz.data()) };
+			return packet;
+		}
+
+		// Moller-Trumbore against every triangle the broadphase hands out, lowering packet.maxT and setting
+		// hitTris for every lane that hits something closer. Returns the lanes that did.
+		uint32_t tracePacket(const Broadphase& broadphase, RayPacket& packet, const vec3x8& dir, std::array<int64_t, WIDTH>& hitTris) {
+			const TriangleStore& store = getTriangleStore();
+			uint32_t hitLanes = 0;
+			broadphase.traceRays(packet, [&](std::span<const uint32_t> tris) {
+				for (uint32_t tri : tris) {
+					vec3x8 a = broadcast({ store.ax[tri], store.ay[tri], store.az[tri] });
+					vec3x8 e1 = broadcast({ store.abx[tri], store.aby[tri], store.abz[tri] });
+					vec3x8 e2 = broadcast({ -store.cax[tri], -store.cay[tri], -store.caz[tri] });
+
+					vec3x8 p = cross(dir, e2);
+					float8 det = dot(e1, p);
+					float8 invDet = float8(1.f) / det;
+
+					vec3x8 s = packet.origin - a;
+					float8 u = dot(s, p) * invDet;
+					vec3x8 q = cross(s, e1);
+					float8 v = dot(dir, q) * invDet;
+					float8 t = dot(e2, q) * invDet;
+
+					float8 zero = 0.f;
+					mask8 hit = packet.active & (float8(PARALLEL_DETERMINANT) < abs(det))
+						& (zero <= u) & (zero <= v) & (u + v <= float8(1.f))
+						& (zero <= t) & (t < packet.maxT);
+
+					uint32_t hitBits = bits(hit);
+					if (!hitBits) continue;
+
+					packet.maxT = select(hit, t, packet.maxT);
+					hitLanes |= hitBits;
+					for (uint32_t lane = 0; lane < WIDTH; lane++) {
+						if (hitBits & (1u << lane)) hitTris[lane] = tri;
+					}
+				}
+			});
+			return hitLanes;
+		}
+
+		void writeHits(const std::array<Ray, WIDTH>& rays, size_t count, const RayPacket& packet, const std::array<int64_t, WIDTH>& hitTris,
+			const std::array<uint32_t, WIDTH>& hitInstances, const CollisionScene* scene, RayHit* hits) {
+			const TriangleStore& store = getTriangleStore();
+			alignas(32) std::array<float, WIDTH> hitT;
+			packet.maxT.store(hitT.data());
+			for (size_t lane = 0; lane < count; lane++) {
+				RayHit& result = hits[lane];
+				result = {};
+				if (hitTris[lane] < 0) continue;
+
+				const Ray& ray = rays[lane];
+				uint32_t tri = static_cast<uint32_t>(hitTris[lane]);
+				glm::vec3 normal = scene ? scene->instance(hitInstances[lane]).normalToWorld(store.normal(tri)) : store.normal(tri);
+
+				result.hit = true;
+				result.t = hitT[lane];
+				result.point = ray.origin + ray.dir * hitT[lane];
+				result.normal = glm::dot(normal, ray.dir) > 0.f ? -normal : normal;
+				result.tri = tri;
+				result.instance = hitInstances[lane];
+			}
+		}
+
+		// traces rayAt(0) ... rayAt(count - 1), count <= 8
+		template <typename RayAt>
+		void castPacket(const Broadphase& broadphase, RayAt rayAt, size_t count, float maxT, RayHit* hits) {
+			std::array<Ray, WIDTH> rays;
+			for (size_t lane = 0; lane < count; lane++) {
+				rays[lane] = rayAt(lane);
+			}
+
+			vec3x8 dir;
+			RayPacket packet = makePacket(rays, count, maxT, dir);
+			std::array<int64_t, WIDTH> hitTris;
+			hitTris.fill(-1);
+			std::array<uint32_t, WIDTH> hitInstances{};
+
+			tracePacket(broadphase, packet, dir, hitTris);
+			writeHits(rays, count, packet, hitTris, hitInstances, nullptr, hits);
+		}
+
+		// Walks the instances the world space packet reaches and traces a copy of it moved into each one's local
+		// space. t is the same in both spaces since dir is moved along, so maxT carries over between instances.
+		template <typename RayAt>
+		void castPacket(const CollisionScene& scene, RayAt rayAt, size_t count, float maxT, RayHit* hits) {
+			std::array<Ray, WIDTH> rays;
+			for (size_t lane = 0; lane < count; lane++) {
+				rays[lane] = rayAt(lane);
+			}
+
+			vec3x8 dir;
+			RayPacket packet = makePacket(rays, count, maxT, dir);
+			std::array<int64_t, WIDTH> hitTris;
+			hitTris.fill(-1);
+			std::array<uint32_t, WIDTH> hitInstances{};
+
+			scene.traceInstances(packet, [&](uint32_t id) {
+				const CollisionInstance& instance = scene.instance(id);
+				std::array<Ray, WIDTH> localRays;
+				for (size_t lane = 0; lane < count; lane++) {
+					localRays[lane] = { instance.pointToLocal(rays[lane].origin), instance.vectorToLocal(rays[lane].dir) };
+				}
+
+				vec3x8 localDir;
+				RayPacket local = makePacket(localRays, count, 0.f, localDir);
+				local.maxT = packet.maxT;
+				uint32_t hitLanes = tracePacket(*scene.mesh(instance.mesh).broadphase, local, localDir, hitTris);
+				packet.maxT = local.maxT;
+				for (uint32_t lane = 0; lane < WIDTH; lane++) {
+					if (hitLanes & (1u << lane)) hitInstances[lane] = id;
+				}
+			});
+
+			writeHits(rays, count, packet, hitTris, hitInstances, &scene, hits);
+		}
+	}
+
+	void castRays(const Broadphase& broadphase, std::span<const Ray> rays, float maxT, std::span<RayHit> hits) {
+		for (size_t first = 0; first < rays.size(); first += WIDTH) {
+			size_t count = std::min<size_t>(WIDTH, rays.size() - first);
+			castPacket(broadphase, [&](size_t i) { return rays[first + i]; }, count, maxT, hits.data() + first);
+		}
+	}
+
+	void castLines(const Broadphase& broadphase, std::span<const Line> lines, std::span<RayHit> hits) {
+		for (size_t first = 0; first < lines.size(); first += WIDTH) {
+			size_t count = std::min<size_t>(WIDTH, lines.size() - first);
+			castPacket(broadphase, [&](size_t i) {
+				Line line = lines[first + i];
+				return Ray{ line.a, line.b - line.a };
+			}, count, 1.f, hits.data() + first);
+		}
+	}
+
+	void castRays(const CollisionScene& scene, std::span<const Ray> rays, float maxT, std::span<RayHit> hits) {
+		for (size_t first = 0; first < rays.size(); first += WIDTH) {
+			size_t count = std::min<size_t>(WIDTH, rays.size() - first);
+			castPacket(scene, [&](size_t i) { return rays[first + i]; }, count, maxT, hits.data() + first);
+		}
+	}
+
+	void castLines(const CollisionScene& scene, std::span<const Line> lines, std::span<RayHit> hits) {
+		for (size_t first = 0; first < lines.size(); first += WIDTH) {
+			size_t count = std::min<size_t>(WIDTH, lines.size() - first);
+			castPacket(scene, [&](size_t i) {
+				Line line = lines[first + i];
+				return Ray{ line.a, line.b - line.a };
+			}, count, 1.f, hits.data() + first);
+		}
+	}
+}
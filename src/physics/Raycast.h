@@ -0,0 +1,35 @@
+#pragma once
+
+#include "Objects.h"
+#include "Broadphase.h"
+#include "CollisionScene.h"
+#include <span>
+#include <cstdint>
+#include <glm/glm.hpp>
+
+namespace amaz {
+
+	struct RayHit {
+		bool hit = false;
+		// distance along the ray in multiples of its dir, 0 to 1 for a line
+		float t = 0.f;
+		glm::vec3 point = glm::vec3(0.f);
+		// normal of the hit triangle, flipped to face the ray's origin
+		glm::vec3 normal = glm::vec3(0.f);
+		uint32_t tri = 0;
+		// instance the triangle belongs to when cast against a CollisionScene
+		uint32_t instance = 0;
+	};
+
+	// Closest triangle hit by each ray before maxT, using Moller-Trumbore against the TriangleStore.
+	// Consecutive rays are traced through the broadphase as 8 wide packets, so keeping rays that start
+	// close together and point the same way next to each other makes the packets cheaper.
+	void castRays(const Broadphase& broadphase, std::span<const Ray> rays, float maxT, std::span<RayHit> hits);
+
+	// Same for segments from line.a to line.b
+	void castLines(const Broadphase& broadphase, std::span<const Line> lines, std::span<RayHit> hits);
+
+	// Same against every instance of a scene, hits are in world space
+	void castRays(const CollisionScene& scene, std::span<const Ray> rays, float maxT, std::span<RayHit> hits);
+	void castLines(const CollisionScene& scene, std::span<const Line> lines, std::span<RayHit> hits);
+}
@@ -0,0 +1,632 @@
+#include "RigidWorld.h"
+
+#include "Physics.h"
+#include "PhysicsState.h"
+#include "Sweep.h"
+#include "ConvexCollision.h"
+#include "../util/thread_pool.hpp"
+#include <algorithm>
+#include <numeric>
+#include <optional>
+#include <array>
+
+constexpr int SOLVER_ITERATIONS = 8;
+// fraction of the penetration removed per step, and how much is allowed to stay so resting contacts don't jitter
+constexpr float BAUMGARTE = 0.2f;
+constexpr float PENETRATION_SLOP = 0.01f;
+// closing speeds below this don't bounce
+constexpr float RESTITUTION_THRESHOLD = 1.f;
+
+// bodies moving further than this fraction of their size in one step are swept against the static meshes
+constexpr float CCD_FRACTION = 0.5f;
+constexpr int MAX_CCD_SLIDES = 3;
+
+// bodies per thread pool task when gathering contacts with the static meshes or integrating
+constexpr size_t PARALLEL_STATIC_BODIES = 64;
+
+// a cached axis only settles a pair that far apart along it, far more than GJK's error so both always agree
+constexpr float CACHED_AXIS_MARGIN = 1e-3f;
+
+namespace amaz {
+
+	namespace {
+		constexpr uint32_t NO_ISLAND = std::numeric_limits<uint32_t>::max();
+
+		struct Contact {
+			glm::vec3 normal;
+			float depth;
+		};
+
+		// spheres and capsules are both a segment with a radius, capsules always stand upright
+		struct Round {
+			glm::vec3 p, q;
+			float radius;
+		};
+
+		Round roundOf(const RigidBody& body) {
+			glm::vec3 offset = { 0.f, body.shape == BodyShape::Capsule ? body.halfHeight : 0.f, 0.f };
+			return { body.position - offset, body.position + offset, body.radius };
+		}
+
+		AABB boundsOf(const RigidBody& body, const std::vector<ConvexHull>& hulls) {
+			glm::vec3 extent;
+			switch (body.shape) {
+			case BodyShape::Hull: {
+				AABB bounds = hulls[body.hull].bounds();
+				return { body.position + bounds.a, body.position + bounds.b };
+			}
+			case BodyShape::Box:
+				extent = body.halfExtents;
+				break;
+			case BodyShape::Capsule:
+				extent = { body.radius, body.halfHeight + body.radius, body.radius };
+				break;
+			case BodyShape::Sphere:
+			default:
+				extent = glm::vec3(body.radius);
+				break;
+			}
+			return { body.position - extent, body.position + extent };
+		}
+
+		ConvexShape convexOf(const RigidBody& body, const std::vector<ConvexHull>& hulls) {
+			switch (body.shape) {
+			case BodyShape::Hull:
+				return ConvexShape::convexHull(hulls[body.hull], body.position);
+			case BodyShape::Box:
+				return ConvexShape::box(body.position, body.halfExtents);
+			default: {
+				Round round = roundOf(body);
+				return ConvexShape::capsule(round.p, round.q, round.radius);
+			}
+			}
+		}
+
+		// The axis the pair was apart along the last time it was tested is tried before GJK. What's cached only
+		// changes how fast the answer comes, so it isn't part of the saved state.
+		std::optional<Contact> cachedConvexContact(const ConvexShape& a, const ConvexShape& b, uint64_t key, std::vector<CachedAxis>& cache,
+			uint32_t step, RigidWorldStats& stats) {
+			auto cached = std::find_if(cache.begin(), cache.end(), [&](const CachedAxis& entry) { return entry.key == key; });
+			if (cached != cache.end()) {
+				cached->step = step;
+				if (separatedAlong(a, b, cached->axis, CACHED_AXIS_MARGIN)) {
+					stats.cachedSeparations++;
+					return {};
+				}
+			}
+
+			stats.convexTests++;
+			ConvexContact contact = convexContact(a, b);
+			if (cached != cache.end()) {
+				cached->axis = contact.axis;
+			} else {
+				cache.push_back({ key, contact.axis, step });
+			}
+			if (!contact.collided) return {};
+			return Contact{ contact.normal, contact.depth };
+		}
+
+		// forgets the pairs that weren't tested in the step before, they have moved apart
+		void pruneAxes(std::vector<CachedAxis>& cache, uint32_t step) {
+			std::erase_if(cache, [&](const CachedAxis& entry) { return entry.step + 1 < step; });
+		}
+
+		std::optional<Contact> roundVsRound(const Round& a, const Round& b) {
+			SegmentClosestPoints closest = closestPointsOnSegments(a.p, a.q, b.p, b.q);
+			float radius = a.radius + b.radius;
+			if (closest.distSq >= radius * radius) return {};
+
+			float dist = std::sqrt(closest.distSq);
+			glm::vec3 normal = dist > 1e-6f ? (closest.onFirst - closest.onSecond) / dist : glm::vec3(0.f, 1.f, 0.f);
+			return Contact{ normal, radius - dist };
+		}
+
+		// normal pushes the round shape out of the box
+		std::optional<Contact> roundVsBox(const Round& round, glm::vec3 center, glm::vec3 halfExtents) {
+			glm::vec3 boxMin = center - halfExtents;
+			glm::vec3 boxMax = center + halfExtents;
+
+			// alternating between the closest point on the segment and on the box converges in a couple of steps
+			glm::vec3 onSegment = (round.p + round.q) * 0.5f;
+			glm::vec3 onBox = glm::clamp(onSegment, boxMin, boxMax);
+			for (int i = 0; i < 3; i++) {
+				SegmentClosestPoints closest = closestPointsOnSegments(round.p, round.q, onBox, onBox);
+				onSegment = closest.onFirst;
+				onBox = glm::clamp(onSegment, boxMin, boxMax);
+			}
+
+			glm::vec3 d = onSegment - onBox;
+			float distSq = glm::dot(d, d);
+			if (distSq > 1e-12f) {
+				if (distSq >= round.radius * round.radius) return {};
+				float dist = std::sqrt(distSq);
+				return Contact{ d / dist, round.radius - dist };
+			}
+
+			// the segment is inside the box, push out through the nearest face
+			glm::vec3 toMax = boxMax - onSegment;
+			glm::vec3 toMin = onSegment - boxMin;
+			Contact best = { { 1.f, 0.f, 0.f }, std::numeric_limits<float>::max() };
+			for (int axis = 0; axis < 3; axis++) {
+				glm::vec3 n(0.f);
+				if (toMax[axis] < best.depth) {
+					n[axis] = 1.f;
+					best = { n, toMax[axis] };
+				}
+				if (toMin[axis] < best.depth) {
+					n[axis] = -1.f;
+					best = { n, toMin[axis] };
+				}
+			}
+			best.depth += round.radius;
+			return best;
+		}
+
+		std::optional<Contact> boxVsBox(AABB a, AABB b) {
+			Contact best = { { 1.f, 0.f, 0.f }, std::numeric_limits<float>::max() };
+			for (int axis = 0; axis < 3; axis++) {
+				float pushUp = b.b[axis] - a.a[axis];
+				float pushDown = a.b[axis] - b.a[axis];
+				if (pushUp <= 0.f || pushDown <= 0.f) return {};
+
+				glm::vec3 n(0.f);
+				if (pushUp < best.depth) {
+					n[axis] = 1.f;
+					best = { n, pushUp };
+				}
+				if (pushDown < best.depth) {
+					n[axis] = -1.f;
+					best = { n, pushDown };
+				}
+			}
+			return best;
+		}
+
+		// separating axis test, normal pushes the box away from the triangle
+		std::optional<Contact> boxVsTriangle(glm::vec3 center, glm::vec3 halfExtents, Triangle tri, glm::vec3 triNormal) {
+			std::array<glm::vec3, 3> v = { tri.a - center, tri.b - center, tri.c - center };
+			std::array<glm::vec3, 3> edges = { v[1] - v[0], v[2] - v[1], v[0] - v[2] };
+
+			std::array<glm::vec3, 13> axes;
+			size_t axisCount = 0;
+			axes[axisCount++] = { 1.f, 0.f, 0.f };
+			axes[axisCount++] = { 0.f, 1.f, 0.f };
+			axes[axisCount++] = { 0.f, 0.f, 1.f };
+			axes[axisCount++] = triNormal;
+			for (const glm::vec3& edge : edges) {
+				for (int axis = 0; axis < 3; axis++) {
+					glm::vec3 boxAxis(0.f);
+					boxAxis[axis] = 1.f;
+					glm::vec3 cross = glm::cross(edge, boxAxis);
+					float lengthSq = glm::dot(cross, cross);
+					if (lengthSq > 1e-10f) axes[axisCount++] = cross / std::sqrt(lengthSq);
+				}
+			}
+
+			Contact best = { triNormal, std::numeric_limits<float>::max() };
+			for (size_t i = 0; i < axisCount; i++) {
+				glm::vec3 axis = axes[i];
+				float r = glm::dot(halfExtents, glm::abs(axis));
+				float p0 = glm::dot(v[0], axis);
+				float p1 = glm::dot(v[1], axis);
+				float p2 = glm::dot(v[2], axis);
+				float triMin = std::min({ p0, p1, p2 });
+				float triMax = std::max({ p0, p1, p2 });
+
+				// the box spans [-r, r] on the axis
+				float pushPositive = triMax + r;
+				float pushNegative = r - triMin;
+				if (pushPositive <= 0.f || pushNegative <= 0.f) return {};
+
+				if (pushPositive < best.depth) best = { axis, pushPositive };
+				if (pushNegative < best.depth) best = { -axis, pushNegative };
+			}
+			return best;
+		}
+	}
+
+	RigidWorld::RigidWorld(Physics& physics) : _physics(physics) {}
+
+	uint32_t RigidWorld::addBody(const RigidBodyDesc& desc) {
+		RigidBody body = {
+			desc.shape,
+			desc.position,
+			desc.velocity,
+			desc.radius,
+			desc.halfHeight,
+			desc.halfExtents,
+			desc.hull,
+			desc.mass > 0.f ? 1.f / desc.mass : 0.f,
+			desc.restitution,
+			desc.friction
+		};
+
+		if (body.shape == BodyShape::Hull && body.hull >= _hulls.size()) {
+			std::cout << "addBody called with a hull that doesn't exist: " << body.hull << ", using a sphere\n";
+			body.shape = BodyShape::Sphere;
+		}
+
+		uint32_t id;
+		if (!_freeIds.empty()) {
+			id = _freeIds.back();
+			_freeIds.pop_back();
+			_bodies[id] = body;
+		} else {
+			id = static_cast<uint32_t>(_bodies.size());
+			_bodies.push_back(body);
+			_proxyOfBody.push_back(0);
+			_pairAxes.emplace_back();
+			_staticAxes.emplace_back();
+		}
+
+		uint32_t proxy = _pairs.add(boundsOf(body, _hulls));
+		if (proxy >= _bodyOfProxy.size()) {
+			_bodyOfProxy.resize(proxy + 1);
+		}
+		_proxyOfBody[id] = proxy;
+		_bodyOfProxy[proxy] = id;
+		return id;
+	}
+
+	void RigidWorld::removeBody(uint32_t id) {
+		if (id >= _bodies.size() || !_bodies[id].alive) {
+			std::cout << "removeBody called with a body that doesn't exist: " << id << "\n";
+			return;
+		}
+		_bodies[id].alive = false;
+		_pairs.remove(_proxyOfBody[id]);
+		_freeIds.push_back(id);
+		_pairAxes[id].clear();
+		_staticAxes[id].clear();
+	}
+
+	uint32_t RigidWorld::addHull(ConvexHull hull) {
+		_hulls.push_back(std::move(hull));
+		return static_cast<uint32_t>(_hulls.size() - 1);
+	}
+
+	void RigidWorld::saveState(RigidWorldState& state) const {
+		state.bodies = _bodies;
+		state.freeIds = _freeIds;
+	}
+
+	void RigidWorld::restoreState(const RigidWorldState& state) {
+		// bodies added or removed since the state was saved get their proxies removed or added back
+		size_t count = std::max(_bodies.size(), state.bodies.size());
+		_proxyOfBody.resize(count);
+		for (uint32_t id = 0; id < count; id++) {
+			bool wasAlive = id < _bodies.size() && _bodies[id].alive;
+			bool alive = id < state.bodies.size() && state.bodies[id].alive;
+			if (wasAlive && !alive) {
+				_pairs.remove(_proxyOfBody[id]);
+			} else if (alive && !wasAlive) {
+				uint32_t proxy = _pairs.add(boundsOf(state.bodies[id], _hulls));
+				if (proxy >= _bodyOfProxy.size()) {
+					_bodyOfProxy.resize(proxy + 1);
+				}
+				_proxyOfBody[id] = proxy;
+				_bodyOfProxy[proxy] = id;
+			}
+		}
+
+		_bodies = state.bodies;
+		_freeIds = state.freeIds;
+		_proxyOfBody.resize(_bodies.size());
+		_pairAxes.resize(_bodies.size());
+		_staticAxes.resize(_bodies.size());
+	}
+
+	void RigidWorld::step(float seconds) {
+		_stats = {};
+		if (seconds <= 0.f) {
+			return;
+		}
+
+		for (auto& body : _bodies) {
+			if (body.alive && body.invMass > 0.f) {
+				body.velocity += gravity * seconds;
+			}
+		}
+
+		_bounds.resize(_bodies.size());
+		for (size_t i = 0; i < _bodies.size(); i++) {
+			_bounds[i] = boundsOf(_bodies[i], _hulls);
+		}
+		_step++;
+
+		_contacts.clear();
+		findPairs();
+		findStaticContacts();
+		buildIslands();
+
+		util::parallelFor(_islandContactStart.size() - 1, 1, [&](size_t begin, size_t end) {
+			for (size_t island = begin; island < end; island++) {
+				solveIsland(static_cast<uint32_t>(island), seconds);
+			}
+		});
+
+		integrate(seconds);
+
+		_stats.contacts = static_cast<uint32_t>(_contacts.size());
+		_stats.islands = static_cast<uint32_t>(_islandContactStart.size() - 1);
+	}
+
+	void RigidWorld::findPairs() {
+		for (uint32_t id = 0; id < _bodies.size(); id++) {
+			if (_bodies[id].alive) _pairs.update(_proxyOfBody[id], _bounds[id]);
+			pruneAxes(_pairAxes[id], _step);
+		}
+		_pairs.updatePairs();
+
+		_pairs.forEachPair([&](uint32_t proxyA, uint32_t proxyB, PairEvent event) {
+			if (event == PairEvent::End) return;
+
+			// ordered by body id rather than proxy id, proxies are handed out differently after a restoreState
+			uint32_t a = std::min(_bodyOfProxy[proxyA], _bodyOfProxy[proxyB]);
+			uint32_t b = std::max(_bodyOfProxy[proxyA], _bodyOfProxy[proxyB]);
+			// the dynamic body goes first so the contact belongs to its island
+			if (_bodies[a].invMass == 0.f) std::swap(a, b);
+			if (_bodies[a].invMass == 0.f) return;
+
+			_stats.pairsTested++;
+			const RigidBody& bodyA = _bodies[a];
+			const RigidBody& bodyB = _bodies[b];
+
+			std::optional<Contact> contact;
+			if (bodyA.shape == BodyShape::Hull || bodyB.shape == BodyShape::Hull) {
+				contact = cachedConvexContact(convexOf(bodyA, _hulls), convexOf(bodyB, _hulls), b, _pairAxes[a], _step, _stats);
+			} else if (bodyA.shape == BodyShape::Box && bodyB.shape == BodyShape::Box) {
+				contact = boxVsBox(_bounds[a], _bounds[b]);
+			} else if (bodyB.shape == BodyShape::Box) {
+				contact = roundVsBox(roundOf(bodyA), bodyB.position, bodyB.halfExtents);
+			} else if (bodyA.shape == BodyShape::Box) {
+				contact = roundVsBox(roundOf(bodyB), bodyA.position, bodyA.halfExtents);
+				if (contact) contact->normal = -contact->normal;
+			} else {
+				contact = roundVsRound(roundOf(bodyA), roundOf(bodyB));
+			}
+
+			if (contact) {
+				_contacts.push_back({ a, b, contact->normal, contact->depth,
+					std::max(bodyA.restitution, bodyB.restitution), std::sqrt(bodyA.friction * bodyB.friction) });
+			}
+		});
+
+		// the order pairs come out in depends on how the proxies moved before, sorting makes the solver
+		// order depend only on the bodies so a restored state steps exactly like the original
+		std::sort(_contacts.begin(), _contacts.end(), [](const BodyContact& x, const BodyContact& y) {
+			return x.a < y.a || (x.a == y.a && x.b < y.b);
+		});
+	}
+
+	void RigidWorld::findStaticContacts() {
+		const CollisionScene& scene = _physics.getCollisionScene();
+		const Heightfield* terrain = _physics.getHeightfield();
+		const TriangleStore& store = getTriangleStore();
+
+		// chunks are consecutive bodies collecting their own contacts, appended in order so the result doesn't depend on thread count
+		size_t chunkCount = util::chunkCount(_bodies.size(), PARALLEL_STATIC_BODIES);
+		if (_chunkScratch.size() < chunkCount) {
+			_chunkScratch.resize(chunkCount);
+		}
+		for (ChunkScratch& scratch : _chunkScratch) {
+			scratch.contacts.clear();
+			scratch.stats = {};
+		}
+
+		util::parallelChunks(_bodies.size(), PARALLEL_STATIC_BODIES, [&](size_t chunk, size_t begin, size_t end) {
+			ChunkScratch& scratch = _chunkScratch[chunk];
+
+			for (uint32_t id = static_cast<uint32_t>(begin); id < end; id++) {
+				const RigidBody& body = _bodies[id];
+				if (!body.alive || body.invMass == 0.f) continue;
+				pruneAxes(_staticAxes[id], _step);
+
+				// key identifies the triangle for the hull's separating axis cache
+				auto addContact = [&](const Triangle& triangle, glm::vec3 normal, uint64_t key) {
+					Physics::SphereCollisionResults result{};
+					switch (body.shape) {
+					case BodyShape::Hull: {
+						std::optional<Contact> contact = cachedConvexContact(convexOf(body, _hulls), ConvexShape::triangle(triangle), key,
+							_staticAxes[id], _step, scratch.stats);
+						result = { contact.has_value(), contact ? contact->normal : glm::vec3(0.f), contact ? contact->depth : 0.f };
+						break;
+					}
+					case BodyShape::Sphere:
+						result = _physics.SphereVsTriangle({ body.position, body.radius }, triangle, normal);
+						break;
+					case BodyShape::Capsule: {
+						glm::vec3 tip = { 0.f, body.halfHeight + body.radius, 0.f };
+						result = _physics.CapsuleVsTriangle({ body.position + tip, body.position - tip, body.radius }, triangle, normal);
+						break;
+					}
+					case BodyShape::Box: {
+						std::optional<Contact> contact = boxVsTriangle(body.position, body.halfExtents, triangle, normal);
+						result = { contact.has_value(), contact ? contact->normal : glm::vec3(0.f), contact ? contact->depth : 0.f };
+						break;
+					}
+					}
+
+					if (result.collided) {
+						scratch.contacts.push_back({ id, BodyContact::STATIC, result.penetration_normal, result.penetration_depth,
+							body.restitution, body.friction });
+					}
+				};
+
+				scene.visitInstances(_bounds[id], [&](uint32_t instanceId) {
+					const CollisionInstance& instance = scene.instance(instanceId);
+					scene.mesh(instance.mesh).broadphase->query(instance.aabbToLocal(_bounds[id]), scratch.query, scratch.candidates);
+
+					// the few candidates are moved into world space rather than the body into local space, boxes stay axis aligned that way
+					for (uint32_t tri : scratch.candidates) {
+						addContact(instance.triangleToWorld(store.triangle(tri)), instance.normalToWorld(store.normal(tri)), (uint64_t(instanceId) << 32) | tri);
+					}
+				});
+
+				if (terrain) {
+					terrain->visitTriangles(_bounds[id], [&](uint32_t tri, const CookedTriangle& cooked) {
+						addContact(cooked.tri, cooked.normal, (uint64_t(HEIGHTFIELD_INSTANCE) << 32) | tri);
+					});
+				}
+			}
+		});
+
+		for (const ChunkScratch& scratch : _chunkScratch) {
+			_contacts.insert(_contacts.end(), scratch.contacts.begin(), scratch.contacts.end());
+			_stats.convexTests += scratch.stats.convexTests;
+			_stats.cachedSeparations += scratch.stats.cachedSeparations;
+		}
+	}
+
+	void RigidWorld::integrate(float seconds) {
+		const CollisionScene& scene = _physics.getCollisionScene();
+
+		if (_chunkScratch.size() < util::chunkCount(_bodies.size(), PARALLEL_STATIC_BODIES)) {
+			_chunkScratch.resize(util::chunkCount(_bodies.size(), PARALLEL_STATIC_BODIES));
+		}
+
+		util::parallelChunks(_bodies.size(), PARALLEL_STATIC_BODIES, [&](size_t chunk, size_t begin, size_t end) {
+			BroadphaseQuery& query = _chunkScratch[chunk].query;
+			std::vector<uint32_t>& candidates = _chunkScratch[chunk].candidates;
+
+			for (size_t id = begin; id < end; id++) {
+				RigidBody& body = _bodies[id];
+				if (!body.alive || body.invMass == 0.f) continue;
+
+				glm::vec3 motion = body.velocity * seconds;
+
+				// contacts only exist once shapes overlap, so anything fast enough to skip past a thin
+				// surface in one step is swept as an upright capsule, boxes and hulls by their inscribed sphere
+				float radius = body.radius;
+				glm::vec3 center = glm::vec3(0.f);
+				if (body.shape == BodyShape::Box) {
+					radius = std::min({ body.halfExtents.x, body.halfExtents.y, body.halfExtents.z });
+				} else if (body.shape == BodyShape::Hull) {
+					radius = _hulls[body.hull].innerRadius();
+					center = _hulls[body.hull].center();
+				}
+				if (glm::dot(motion, motion) <= radius * radius * CCD_FRACTION * CCD_FRACTION) {
+					body.position += motion;
+					continue;
+				}
+
+				glm::vec3 tip = { 0.f, (body.shape == BodyShape::Capsule ? body.halfHeight : 0.f) + radius, 0.f };
+				for (int i = 0; i < MAX_CCD_SLIDES && glm::dot(motion, motion) > 1e-12f; i++) {
+					Capsule capsule = { body.position + center + tip, body.position + center - tip, radius };
+					SweepHit hit = amaz::sweepCapsule(scene, capsule, motion, query, candidates);
+					_physics.sweepHeightfield(capsule, motion, hit);
+					if (!hit.hit) {
+						body.position += motion;
+						break;
+					}
+
+					// stop at the surface, bounce the velocity off it and slide the rest of the motion along it
+					body.position += motion * hit.t;
+					float closing = glm::dot(body.velocity, hit.normal);
+					if (closing < 0.f) {
+						body.velocity -= hit.normal * closing * (1.f + body.restitution);
+					}
+					glm::vec3 remaining = motion * (1.f - hit.t);
+					motion = remaining - hit.normal * glm::dot(remaining, hit.normal);
+				}
+			}
+		});
+	}
+
+	uint32_t RigidWorld::findRoot(uint32_t body) {
+		while (_parents[body] != body) {
+			_parents[body] = _parents[_parents[body]];
+			body = _parents[body];
+		}
+		return body;
+	}
+
+	void RigidWorld::buildIslands() {
+		_parents.resize(_bodies.size());
+		std::iota(_parents.begin(), _parents.end(), 0);
+
+		// static bodies and triangles are never written by the solver, so they don't join islands together
+		for (const auto& contact : _contacts) {
+			if (contact.b == BodyContact::STATIC || _bodies[contact.b].invMass == 0.f) continue;
+			uint32_t rootA = findRoot(contact.a);
+			uint32_t rootB = findRoot(contact.b);
+			if (rootA != rootB) _parents[std::max(rootA, rootB)] = std::min(rootA, rootB);
+		}
+
+		// islands are numbered in order of their first contact, then contacts are bucketed by island
+		_islandOfRoot.assign(_bodies.size(), NO_ISLAND);
+		_contactIslands.resize(_contacts.size());
+		uint32_t islandCount = 0;
+		for (size_t i = 0; i < _contacts.size(); i++) {
+			uint32_t root = findRoot(_contacts[i].a);
+			if (_islandOfRoot[root] == NO_ISLAND) _islandOfRoot[root] = islandCount++;
+			_contactIslands[i] = _islandOfRoot[root];
+		}
+
+		_islandContactStart.assign(islandCount + 1, 0);
+		for (uint32_t island : _contactIslands) {
+			_islandContactStart[island + 1]++;
+		}
+		for (uint32_t i = 0; i < islandCount; i++) {
+			_islandContactStart[i + 1] += _islandContactStart[i];
+		}
+
+		_islandContacts.resize(_contacts.size());
+		std::vector<uint32_t> cursor(_islandContactStart.begin(), _islandContactStart.end() - 1);
+		for (uint32_t i = 0; i < _contacts.size(); i++) {
+			_islandContacts[cursor[_contactIslands[i]]++] = i;
+		}
+	}
+
+	void RigidWorld::solveIsland(uint32_t island, float seconds) {
+		uint32_t begin = _islandContactStart[island];
+		uint32_t end = _islandContactStart[island + 1];
+
+		auto velocityOf = [&](uint32_t body) {
+			return body == BodyContact::STATIC ? glm::vec3(0.f) : _bodies[body].velocity;
+		};
+		auto invMassOf = [&](uint32_t body) {
+			return body == BodyContact::STATIC ? 0.f : _bodies[body].invMass;
+		};
+
+		for (uint32_t i = begin; i < end; i++) {
+			BodyContact& contact = _contacts[_islandContacts[i]];
+			float closing = glm::dot(velocityOf(contact.a) - velocityOf(contact.b), contact.normal);
+			float bounce = closing < -RESTITUTION_THRESHOLD ? -contact.restitution * closing : 0.f;
+			float bias = BAUMGARTE / seconds * std::max(contact.depth - PENETRATION_SLOP, 0.f);
+			contact.targetVelocity = std::max(bounce, bias);
+			contact.normalImpulse = 0.f;
+		}
+
+		for (int iteration = 0; iteration < SOLVER_ITERATIONS; iteration++) {
+			for (uint32_t i = begin; i < end; i++) {
+				BodyContact& contact = _contacts[_islandContacts[i]];
+				float invMassA = invMassOf(contact.a);
+				float invMassB = invMassOf(contact.b);
+				float invMassSum = invMassA + invMassB;
+				if (invMassSum <= 0.f) continue;
+
+				// static bodies are shared between islands, only bodies that can move are ever written
+				auto apply = [&](glm::vec3 impulse) {
+					if (invMassA > 0.f) _bodies[contact.a].velocity += impulse * invMassA;
+					if (invMassB > 0.f) _bodies[contact.b].velocity -= impulse * invMassB;
+				};
+
+				glm::vec3 relative = velocityOf(contact.a) - velocityOf(contact.b);
+				float lambda = (contact.targetVelocity - glm::dot(relative, contact.normal)) / invMassSum;
+				float accumulated = std::max(contact.normalImpulse + lambda, 0.f);
+				lambda = accumulated - contact.normalImpulse;
+				contact.normalImpulse = accumulated;
+				apply(contact.normal * lambda);
+
+				relative = velocityOf(contact.a) - velocityOf(contact.b);
+				glm::vec3 tangent = relative - contact.normal * glm::dot(relative, contact.normal);
+				float tangentSpeed = glm::length(tangent);
+				if (tangentSpeed > 1e-6f) {
+					float friction = std::min(tangentSpeed / invMassSum, contact.friction * contact.normalImpulse);
+					apply(-tangent / tangentSpeed * friction);
+				}
+			}
+		}
+	}
+}
@@ -0,0 +1,172 @@
+#pragma once
+
+#include "Objects.h"
+#include "Broadphase.h"
+#include "SweepAndPrune.h"
+#include "ConvexHull.h"
+#include <vector>
+#include <cstdint>
+#include <limits>
+#include <glm/glm.hpp>
+
+namespace amaz {
+
+	class Physics;
+	struct RigidWorldState;
+
+	enum class BodyShape {
+		Sphere,
+		Capsule,
+		Box,
+		Hull
+	};
+
+	// Bodies only translate, boxes and hulls keep their orientation
+	struct RigidBodyDesc {
+		BodyShape shape = BodyShape::Sphere;
+		glm::vec3 position = glm::vec3(0.f);
+		glm::vec3 velocity = glm::vec3(0.f);
+		// sphere and capsule radius
+		float radius = 0.5f;
+		// capsule distance from its center to the center of either cap
+		float halfHeight = 0.5f;
+		glm::vec3 halfExtents = glm::vec3(0.5f);
+		// 0 makes the body static, it still collides but never moves
+		float mass = 1.f;
+		float restitution = 0.f;
+		float friction = 0.5f;
+		// id from addHull, the hull's vertices are relative to position
+		uint32_t hull = 0;
+	};
+
+	struct RigidBody {
+		BodyShape shape;
+		glm::vec3 position;
+		glm::vec3 velocity;
+		float radius;
+		float halfHeight;
+		glm::vec3 halfExtents;
+		uint32_t hull;
+		float invMass;
+		float restitution;
+		float friction;
+		bool alive = true;
+	};
+
+	// One contact between a body and another body or a static triangle, normal pushes a away from b
+	struct BodyContact {
+		static constexpr uint32_t STATIC = std::numeric_limits<uint32_t>::max();
+
+		uint32_t a;
+		uint32_t b;
+		glm::vec3 normal;
+		float depth;
+		float restitution;
+		float friction;
+		// solver state, accumulated over the iterations of one step
+		float normalImpulse = 0.f;
+		float targetVelocity = 0.f;
+	};
+
+	struct RigidWorldStats {
+		uint32_t pairsTested = 0;
+		uint32_t contacts = 0;
+		uint32_t islands = 0;
+		// pairs with a hull in them that went through GJK, and ones a cached separating axis answered instead
+		uint32_t convexTests = 0;
+		uint32_t cachedSeparations = 0;
+	};
+
+	// Axis a pair with a hull in it was apart along, or about to be, the last time it was tested.
+	// key is the other body, or the instance and triangle for static triangles.
+	struct CachedAxis {
+		uint64_t key;
+		glm::vec3 axis;
+		uint32_t step;
+	};
+
+	// Dynamic spheres, capsules, boxes and convex hulls colliding with each other and the static collision meshes.
+	// Bodies touching each other form islands, islands don't share bodies so they are solved on separate threads.
+	class RigidWorld {
+	public:
+		explicit RigidWorld(Physics& physics);
+
+		uint32_t addBody(const RigidBodyDesc& desc);
+		void removeBody(uint32_t id);
+
+		// Hulls are shared by every body made with their id, and stay until the world is destroyed
+		uint32_t addHull(ConvexHull hull);
+
+		const ConvexHull& getHull(uint32_t id) const {
+			return _hulls[id];
+		}
+
+		RigidBody& getBody(uint32_t id) {
+			return _bodies[id];
+		}
+
+		size_t bodyCount() const {
+			return _bodies.size() - _freeIds.size();
+		}
+
+		void step(float seconds);
+
+		// Copies every body into state, bodies are plain data so this is a straight copy
+		void saveState(RigidWorldState& state) const;
+		void restoreState(const RigidWorldState& state);
+
+		const RigidWorldStats& stats() const {
+			return _stats;
+		}
+
+		glm::vec3 gravity = { 0.f, -36.f, 0.f };
+
+	private:
+		void findPairs();
+		void findStaticContacts();
+		void buildIslands();
+		void solveIsland(uint32_t island, float seconds);
+		void integrate(float seconds);
+		uint32_t findRoot(uint32_t body);
+
+		Physics& _physics;
+
+		std::vector<RigidBody> _bodies;
+		std::vector<uint32_t> _freeIds;
+		std::vector<ConvexHull> _hulls;
+
+		// per body, separating axes of its pairs with hulls from the steps before. Only makes the
+		// tests faster, a cached axis is checked against the shapes as they are now before it's trusted.
+		std::vector<std::vector<CachedAxis>> _pairAxes;
+		std::vector<std::vector<CachedAxis>> _staticAxes;
+		uint32_t _step = 0;
+
+		// dynamic pairs, each body has a proxy that is updated with its bounds every step
+		SweepAndPrune _pairs;
+		std::vector<uint32_t> _proxyOfBody;
+		std::vector<uint32_t> _bodyOfProxy;
+
+		// rebuilt every step
+		std::vector<AABB> _bounds;
+		std::vector<BodyContact> _contacts;
+
+		// what each chunk of bodies uses while finding static contacts and sweeping, kept between steps
+		// so the query stamps and contact lists only grow once
+		struct ChunkScratch {
+			BroadphaseQuery query;
+			std::vector<uint32_t> candidates;
+			std::vector<BodyContact> contacts;
+			RigidWorldStats stats;
+		};
+		std::vector<ChunkScratch> _chunkScratch;
+
+		// union find over bodies linked by contacts, then contacts grouped by island
+		std::vector<uint32_t> _parents;
+		std::vector<uint32_t> _islandOfRoot;
+		std::vector<uint32_t> _contactIslands;
+		std::vector<uint32_t> _islandContactStart;
+		std::vector<uint32_t> _islandContacts;
+
+		RigidWorldStats _stats;
+	};
+}
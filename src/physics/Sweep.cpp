@@ -0,0 +1,285 @@
+#include "Sweep.h"
+
+#include "Collision.h"
+#include <algorithm>
+#include <cmath>
+
+constexpr int MAX_TOI_ITERATIONS = 16;
+constexpr float TOI_TOLERANCE = 1e-4f;
+// fraction of the motion's length it has to close in on a triangle by to count as moving towards it
+constexpr float PARALLEL_APPROACH = 1e-4f;
+
+namespace amaz {
+
+	namespace {
+		struct ClosestPoints {
+			glm::vec3 onSegment;
+			glm::vec3 onTriangle;
+			float distSq;
+		};
+
+		// Real-Time Collision Detection 5.1.5
+		glm::vec3 closestPointOnTriangle(glm::vec3 p, glm::vec3 a, glm::vec3 b, glm::vec3 c) {
+			glm::vec3 ab = b - a;
+			glm::vec3 ac = c - a;
+			glm::vec3 ap = p - a;
+			float d1 = glm::dot(ab, ap);
+			float d2 = glm::dot(ac, ap);
+			if (d1 <= 0.f && d2 <= 0.f) return a;
+
+			glm::vec3 bp = p - b;
+			float d3 = glm::dot(ab, bp);
+			float d4 = glm::dot(ac, bp);
+			if (d3 >= 0.f && d4 <= d3) return b;
+
+			float vc = d1 * d4 - d3 * d2;
+			if (vc <= 0.f && d1 >= 0.f && d3 <= 0.f) return a + ab * (d1 / (d1 - d3));
+
+			glm::vec3 cp = p - c;
+			float d5 = glm::dot(ab, cp);
+			float d6 = glm::dot(ac, cp);
+			if (d6 >= 0.f && d5 <= d6) return c;
+
+			float vb = d5 * d2 - d1 * d6;
+			if (vb <= 0.f && d2 >= 0.f && d6 <= 0.f) return a + ac * (d2 / (d2 - d6));
+
+			float va = d3 * d6 - d5 * d4;
+			if (va <= 0.f && (d4 - d3) >= 0.f && (d5 - d6) >= 0.f) return b + (c - b) * ((d4 - d3) / ((d4 - d3) + (d5 - d6)));
+
+			float denom = 1.f / (va + vb + vc);
+			return a + ab * (vb * denom) + ac * (vc * denom);
+		}
+
+		ClosestPoints edgePoints(glm::vec3 p, glm::vec3 q, glm::vec3 a, glm::vec3 b) {
+			SegmentClosestPoints closest = closestPointsOnSegments(p, q, a, b);
+			return { closest.onFirst, closest.onSecond, closest.distSq };
+		}
+
+		ClosestPoints segmentVsTriangle(glm::vec3 p, glm::vec3 q, const Triangle& t, glm::vec3 n, float planeDist) {
+			// a segment crossing the plane inside the triangle touches it
+			float dp = glm::dot(p, n) - planeDist;
+			float dq = glm::dot(q, n) - planeDist;
+			if (dp * dq <= 0.f && dp != dq) {
+				glm::vec3 x = p + (q - p) * (dp / (dp - dq));
+				if (glm::dot(glm::cross(t.b - t.a, x - t.a), n) >= 0.f &&
+					glm::dot(glm::cross(t.c - t.b, x - t.b), n) >= 0.f &&
+					glm::dot(glm::cross(t.a - t.c, x - t.c), n) >= 0.f) {
+					return { x, x, 0.f };
+				}
+			}
+
+			// otherwise the closest points involve an endpoint of the segment or an edge of the triangle
+			auto pointVsTriangle = [&](glm::vec3 point) {
+				glm::vec3 onTriangle = closestPointOnTriangle(point, t.a, t.b, t.c);
+				glm::vec3 d = point - onTriangle;
+				return ClosestPoints{ point, onTriangle, glm::dot(d, d) };
+			};
+
+			ClosestPoints best = pointVsTriangle(p);
+			for (const ClosestPoints& candidate : { pointVsTriangle(q),
+				edgePoints(p, q, t.a, t.b), edgePoints(p, q, t.b, t.c), edgePoints(p, q, t.c, t.a) }) {
+				if (candidate.distSq < best.distSq) best = candidate;
+			}
+			return best;
+		}
+
+		// separating direction from the triangle to the segment, falls back to the face normal when they touch
+		glm::vec3 separatingNormal(const ClosestPoints& closest, glm::vec3 faceNormal, glm::vec3 motion) {
+			if (closest.distSq > 1e-12f) {
+				return (closest.onSegment - closest.onTriangle) / std::sqrt(closest.distSq);
+			}
+			return glm::dot(faceNormal, motion) > 0.f ? -faceNormal : faceNormal;
+		}
+
+		// Triangles come from the TriangleStore or are made on the fly, like a heightfield's
+		SweepHit sweepVsTriangle(Capsule capsule, glm::vec3 motion, const Triangle& triangle, glm::vec3 faceNormal, float planeDist,
+			uint32_t tri, float scale) {
+
+			float skin = SWEEP_SKIN / scale;
+			float tolerance = TOI_TOLERANCE / scale;
+
+			glm::vec3 axis = glm::normalize(capsule.tip - capsule.base) * capsule.radius;
+			glm::vec3 a = capsule.base + axis;
+			glm::vec3 b = capsule.tip - axis;
+
+			// the triangle is never closer than its plane, so a segment that stays well clear of the plane on one side
+			// for the whole motion can't reach it
+			float reach = capsule.radius + skin + 2.f * tolerance;
+			float da = glm::dot(a, faceNormal) - planeDist;
+			float db = glm::dot(b, faceNormal) - planeDist;
+			float dm = glm::dot(motion, faceNormal);
+			float nearest = std::min(std::min(da, db), std::min(da, db) + dm);
+			float farthest = std::max(std::max(da, db), std::max(da, db) + dm);
+			if (nearest > reach || farthest < -reach) {
+				return {};
+			}
+
+			// The distance between two convex shapes is convex in t under translation, so stepping to where its
+			// tangent reaches the skin never passes the real time of impact
+			float speed = glm::length(motion);
+			float t = 0.f;
+			for (int i = 0; i < MAX_TOI_ITERATIONS; i++) {
+				glm::vec3 offset = motion * t;
+				ClosestPoints closest = segmentVsTriangle(a + offset, b + offset, triangle, faceNormal, planeDist);
+				float dist = std::sqrt(closest.distSq) - capsule.radius;
+				glm::vec3 normal = separatingNormal(closest, faceNormal, motion);
+
+				// motion along a surface, like sliding after a previous hit, never reaches it
+				float approach = -glm::dot(motion, normal);
+				if (approach <= PARALLEL_APPROACH * speed) {
+					return {};
+				}
+
+				if (dist <= skin + tolerance) {
+					return { true, t, normal, tri };
+				}
+
+				t += (dist - skin) / approach;
+				if (t > 1.f) {
+					return {};
+				}
+			}
+
+			// still approaching after every iteration, t is a safe place to stop anyway
+			glm::vec3 offset = motion * t;
+			ClosestPoints closest = segmentVsTriangle(a + offset, b + offset, triangle, faceNormal, planeDist);
+			return { true, t, separatingNormal(closest, faceNormal, motion), tri };
+		}
+
+		SweepHit earliestHit(Capsule capsule, glm::vec3 motion, const std::vector<uint32_t>& candidates, float scale) {
+			SweepHit earliest;
+			for (uint32_t tri : candidates) {
+				SweepHit hit = sweepCapsuleVsTriangle(capsule, motion, tri, scale);
+				if (hit.hit && (!earliest.hit || hit.t < earliest.t)) {
+					earliest = hit;
+					// the capsule is blocked immediately, nothing can be earlier
+					if (hit.t == 0.f) break;
+				}
+			}
+			return earliest;
+		}
+	}
+
+	// Real-Time Collision Detection 5.1.9
+	SegmentClosestPoints closestPointsOnSegments(glm::vec3 p1, glm::vec3 q1, glm::vec3 p2, glm::vec3 q2) {
+		glm::vec3 d1 = q1 - p1;
+		glm::vec3 d2 = q2 - p2;
+		glm::vec3 r = p1 - p2;
+		float a = glm::dot(d1, d1);
+		float e = glm::dot(d2, d2);
+		float f = glm::dot(d2, r);
+		float s = 0.f;
+		float t = 0.f;
+
+		if (a <= 1e-12f && e <= 1e-12f) {
+			// both degenerate
+		} else if (a <= 1e-12f) {
+			t = std::clamp(f / e, 0.f, 1.f);
+		} else {
+			float c = glm::dot(d1, r);
+			if (e <= 1e-12f) {
+				s = std::clamp(-c / a, 0.f, 1.f);
+			} else {
+				float b = glm::dot(d1, d2);
+				float denom = a * e - b * b;
+				s = denom != 0.f ? std::clamp((b * f - c * e) / denom, 0.f, 1.f) : 0.f;
+				t = (b * s + f) / e;
+				if (t < 0.f) {
+					t = 0.f;
+					s = std::clamp(-c / a, 0.f, 1.f);
+				} else if (t > 1.f) {
+					t = 1.f;
+					s = std::clamp((b - c) / a, 0.f, 1.f);
+				}
+			}
+		}
+
+		glm::vec3 onFirst = p1 + d1 * s;
+		glm::vec3 onSecond = p2 + d2 * t;
+		glm::vec3 d = onFirst - onSecond;
+		return { onFirst, onSecond, glm::dot(d, d) };
+	}
+
+	AABB sweptBounds(Capsule capsule, glm::vec3 motion, float skin) {
+		glm::vec3 extent = glm::vec3(capsule.radius + skin);
+		glm::vec3 start = glm::min(capsule.tip, capsule.base);
+		glm::vec3 end = glm::max(capsule.tip, capsule.base);
+		return {
+			glm::min(start, start + motion) - extent,
+			glm::max(end, end + motion) + extent
+		};
+	}
+
+	SweepHit sweepCapsuleVsTriangle(Capsule capsule, glm::vec3 motion, uint32_t tri, float scale) {
+		const TriangleStore& store = getTriangleStore();
+		return sweepVsTriangle(capsule, motion, store.triangle(tri), store.normal(tri), store.planeDist[tri], tri, scale);
+	}
+
+	SweepHit sweepCapsuleVsTriangle(Capsule capsule, glm::vec3 motion, const CookedTriangle& tri, uint32_t id, float scale) {
+		return sweepVsTriangle(capsule, motion, tri.tri, tri.normal, tri.planeDist, id, scale);
+	}
+
+	SegmentClosestPoints closestPointsOnTriangle(glm::vec3 p, glm::vec3 q, const CookedTriangle& tri) {
+		ClosestPoints closest = segmentVsTriangle(p, q, tri.tri, tri.normal, tri.planeDist);
+		return { closest.onSegment, closest.onTriangle, closest.distSq };
+	}
+
+	SweepHit sweepCapsule(const Broadphase& broadphase, Capsule capsule, glm::vec3 motion,
+		BroadphaseQuery& query, std::vector<uint32_t>& candidates) {
+
+		AABB swept = sweptBounds(capsule, motion, SWEEP_SKIN);
+		broadphase.query(swept, query, candidates);
+		return earliestHit(capsule, motion, candidates, 1.f);
+	}
+
+	SweepHit sweepCapsule(const CollisionScene& scene, Capsule capsule, glm::vec3 motion,
+		BroadphaseQuery& query, std::vector<uint32_t>& candidates) {
+
+		// the fraction of the motion is the same in local space, so only the normal has to come back out
+		SweepHit earliest;
+		scene.visitInstances(sweptBounds(capsule, motion, SWEEP_SKIN), [&](uint32_t id) {
+			const CollisionInstance& instance = scene.instance(id);
+			Capsule local = instance.capsuleToLocal(capsule);
+			glm::vec3 localMotion = instance.vectorToLocal(motion);
+
+			scene.mesh(instance.mesh).broadphase->query(sweptBounds(local, localMotion, SWEEP_SKIN / instance.scale), query, candidates);
+			SweepHit hit = earliestHit(local, localMotion, candidates, instance.scale);
+			if (hit.hit && (!earliest.hit || hit.t < earliest.t)) {
+				earliest = hit;
+				earliest.normal = instance.normalToWorld(hit.normal);
+				earliest.instance = id;
+			}
+		});
+		return earliest;
+	}
+
+	SweepHit sweepCapsule(const CollisionScene& scene, const CandidateCache& cache, Capsule capsule, glm::vec3 motion) {
+		const TriangleStore& store = getTriangleStore();
+
+		// The cache holds more triangles than the motion can reach, in an order that depends on when it was filled.
+		// Triangles outside the swept bounds are skipped and ties go to the lowest instance and triangle, so the hit
+		// is the same whatever the cache looked like, which keeps rollback exact.
+		SweepHit earliest;
+		for (const auto& range : cache.ranges()) {
+			const CollisionInstance& instance = scene.instance(range.instance);
+			Capsule local = instance.capsuleToLocal(capsule);
+			glm::vec3 localMotion = instance.vectorToLocal(motion);
+			AABB swept = sweptBounds(local, localMotion, SWEEP_SKIN / instance.scale);
+
+			for (uint32_t tri : cache.triangles(range)) {
+				if (!AABBvsAABB(store.aabb(tri), swept)) continue;
+
+				SweepHit hit = sweepCapsuleVsTriangle(local, localMotion, tri, instance.scale);
+				if (!hit.hit) continue;
+				bool earlier = !earliest.hit || hit.t < earliest.t ||
+					(hit.t == earliest.t && (range.instance < earliest.instance || (range.instance == earliest.instance && tri < earliest.tri)));
+				if (earlier) {
+					earliest = hit;
+					earliest.normal = instance.normalToWorld(hit.normal);
+					earliest.instance = range.instance;
+				}
+			}
+		}
+		return earliest;
+	}
+}
@@ -0,0 +1,61 @@
+#pragma once
+
+#include "Objects.h"
+#include "Collision.h"
+#include "Broadphase.h"
+#include "CollisionScene.h"
+#include "CandidateCache.h"
+#include <vector>
+#include <cstdint>
+#include <glm/glm.hpp>
+
+namespace amaz {
+
+	struct SweepHit {
+		bool hit = false;
+		// fraction of the motion that can be travelled before touching
+		float t = 1.f;
+		// points from the triangle towards the capsule
+		glm::vec3 normal = glm::vec3(0.f);
+		uint32_t tri = 0;
+		// instance the triangle belongs to when swept against a CollisionScene
+		uint32_t instance = 0;
+	};
+
+	struct SegmentClosestPoints {
+		glm::vec3 onFirst;
+		glm::vec3 onSecond;
+		float distSq;
+	};
+
+	// Closest points between the segments p1-q1 and p2-q2, either may be a single point
+	SegmentClosestPoints closestPointsOnSegments(glm::vec3 p1, glm::vec3 q1, glm::vec3 p2, glm::vec3 q2);
+
+	// Capsules stop this far from the surfaces they sweep into so the next sweep doesn't start touching
+	constexpr float SWEEP_SKIN = 0.005f;
+
+	// Everything a capsule touches on its way along motion, grown by skin
+	AABB sweptBounds(Capsule capsule, glm::vec3 motion, float skin = SWEEP_SKIN);
+
+	// Time of impact of a capsule translated by motion against one triangle of the TriangleStore.
+	// Triangles the capsule already touches only count when the motion goes further into them.
+	// scale is world units per unit of the triangle's space, the skin stays the same distance in the world.
+	SweepHit sweepCapsuleVsTriangle(Capsule capsule, glm::vec3 motion, uint32_t tri, float scale = 1.f);
+	// Same against a triangle that isn't in the TriangleStore, id is returned as the hit's tri
+	SweepHit sweepCapsuleVsTriangle(Capsule capsule, glm::vec3 motion, const CookedTriangle& tri, uint32_t id, float scale = 1.f);
+
+	// Closest points between the segment p-q and a triangle, onFirst is on the segment
+	SegmentClosestPoints closestPointsOnTriangle(glm::vec3 p, glm::vec3 q, const CookedTriangle& tri);
+
+	// Earliest impact against every triangle the swept capsule's bounds overlap.
+	// query and candidates are scratch space so repeated sweeps don't allocate.
+	SweepHit sweepCapsule(const Broadphase& broadphase, Capsule capsule, glm::vec3 motion,
+		BroadphaseQuery& query, std::vector<uint32_t>& candidates);
+
+	// Same against every instance of a scene, the normal is in world space
+	SweepHit sweepCapsule(const CollisionScene& scene, Capsule capsule, glm::vec3 motion,
+		BroadphaseQuery& query, std::vector<uint32_t>& candidates);
+
+	// Same against the triangles in cache, which has to have been updated with bounds covering the whole sweep
+	SweepHit sweepCapsule(const CollisionScene& scene, const CandidateCache& cache, Capsule capsule, glm::vec3 motion);
+}
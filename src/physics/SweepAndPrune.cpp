@@ -0,0 +1,180 @@
+#include "SweepAndPrune.h"
+#include "../util/simd.hpp"
+
+#include <algorithm>
+#include <bit>
+#include <iostream>
+#include <limits>
+
+// adding more than this fraction of the existing proxies at once sorts everything from scratch instead of merging
+constexpr size_t RESORT_DIVISOR = 4;
+
+namespace amaz {
+
+	uint32_t SweepAndPrune::add(AABB aabb) {
+		uint32_t proxy;
+		if (!_free.empty()) {
+			proxy = _free.back();
+			_free.pop_back();
+			_bounds[proxy] = aabb;
+			_alive[proxy] = true;
+		} else {
+			proxy = static_cast<uint32_t>(_bounds.size());
+			_bounds.push_back(aabb);
+			_alive.push_back(true);
+		}
+		_added.push_back(proxy);
+		return proxy;
+	}
+
+	void SweepAndPrune::remove(uint32_t proxy) {
+		if (proxy >= _alive.size() || !_alive[proxy]) {
+			std::cout << "SweepAndPrune::remove called with a proxy that doesn't exist: " << proxy << "\n";
+			return;
+		}
+		_alive[proxy] = false;
+		_removed.push_back(proxy);
+	}
+
+	void SweepAndPrune::updatePairs() {
+		_frame++;
+		_ended.clear();
+		_swaps = 0;
+
+		// removed proxies are never found by the sweep, so their pairs end with the rest of the unseen ones.
+		// proxies removed before their first update never got a box
+		if (!_removed.empty()) {
+			std::erase_if(_boxes, [&](const Box& box) { return !_alive[box.proxy]; });
+		}
+		std::erase_if(_added, [&](uint32_t proxy) { return !_alive[proxy]; });
+
+		sortBoxes();
+		if (!_added.empty()) {
+			insertAdded();
+		}
+
+		sweep();
+		endUnseenPairs();
+
+		_free.insert(_free.end(), _removed.begin(), _removed.end());
+		_removed.clear();
+		_added.clear();
+	}
+
+	void SweepAndPrune::sortBoxes() {
+		for (Box& box : _boxes) {
+			const AABB& bounds = _bounds[box.proxy];
+			box = { bounds.a.x, bounds.b.x, bounds.a.y, bounds.b.y, bounds.a.z, bounds.b.z, box.proxy };
+		}
+
+		// insertion sort, the boxes were sorted last update and only moved a little since
+		for (size_t i = 1; i < _boxes.size(); i++) {
+			Box moving = _boxes[i];
+			size_t j = i;
+			while (j > 0 && moving.minX < _boxes[j - 1].minX) {
+				_boxes[j] = _boxes[j - 1];
+				j--;
+			}
+			_swaps += i - j;
+			_boxes[j] = moving;
+		}
+	}
+
+	void SweepAndPrune::insertAdded() {
+		size_t existing = _boxes.size();
+		for (uint32_t proxy : _added) {
+			const AABB& bounds = _bounds[proxy];
+			_boxes.push_back({ bounds.a.x, bounds.b.x, bounds.a.y, bounds.b.y, bounds.a.z, bounds.b.z, proxy });
+		}
+
+		// sorting new boxes in from the end would move them past most of the others, merge them in instead
+		auto byMinX = [](const Box& a, const Box& b) { return a.minX < b.minX; };
+		if (_added.size() * RESORT_DIVISOR > existing) {
+			std::sort(_boxes.begin(), _boxes.end(), byMinX);
+		} else {
+			std::sort(_boxes.begin() + existing, _boxes.end(), byMinX);
+			std::inplace_merge(_boxes.begin(), _boxes.begin() + existing, _boxes.end(), byMinX);
+		}
+	}
+
+	void SweepAndPrune::sweep() {
+		using namespace util::simd;
+
+		// the sorted bounds a lane per box, padded so the last box's lanes can read past the end. The padding
+		// starts past every max so the sweep stops there.
+		size_t count = _boxes.size();
+		for (auto& lanes : _lanes) {
+			lanes.resize(count + WIDTH);
+		}
+		for (size_t i = 0; i < count; i++) {
+			const Box& box = _boxes[i];
+			_lanes[MIN_X][i] = box.minX;
+			_lanes[MIN_Z][i] = box.minZ;
+			_lanes[MAX_Z][i] = box.maxZ;
+		}
+		for (size_t i = count; i < count + WIDTH; i++) {
+			_lanes[MIN_X][i] = std::numeric_limits<float>::infinity();
+		}
+
+		const float* minXs = _lanes[MIN_X].data();
+		const float* minZs = _lanes[MIN_Z].data();
+		const float* maxZs = _lanes[MAX_Z].data();
+
+		size_t candidates = 0;
+		for (size_t i = 0; i < count; i++) {
+			const Box& box = _boxes[i];
+			float8 maxX = box.maxX, minZ = box.minZ, maxZ = box.maxZ;
+
+			// WIDTH boxes after this one at a time, until one starts past its max x. Nearly all of them miss on z,
+			// so the test doesn't branch per box. Levels are mostly flat, so y rarely rejects and is only checked
+			// for the boxes that overlap on x and z. Touching bounds count as overlapping, like AABBvsAABB.
+			for (size_t j = i + 1;; j += WIDTH) {
+				mask8 onX = float8::load(minXs + j) <= maxX;
+				mask8 onZ = (float8::load(minZs + j) <= maxZ) & (minZ <= float8::load(maxZs + j));
+
+				uint32_t xBits = bits(onX);
+				for (uint32_t hits = bits(onX & onZ); hits != 0; hits &= hits - 1) {
+					const Box& other = _boxes[j + std::countr_zero(hits)];
+					if (box.minY <= other.maxY && other.minY <= box.maxY) {
+						addPair(box.proxy, other.proxy);
+					}
+				}
+
+				// sorted on min x, once a lane is past the max every later box is too, so the lanes on x are a prefix
+				if (xBits != (1u << WIDTH) - 1) {
+					candidates += j - i - 1 + std::countr_one(xBits);
+					break;
+				}
+			}
+		}
+
+		_candidates = candidates;
+	}
+
+	void SweepAndPrune::addPair(uint32_t a, uint32_t b) {
+		uint64_t key = pairKey(a, b);
+		auto [it, inserted] = _pairIndex.try_emplace(key, static_cast<uint32_t>(_pairs.size()));
+		if (inserted) {
+			_pairs.push_back({ key, _frame, _frame });
+		} else {
+			_pairs[it->second].seen = _frame;
+		}
+	}
+
+	void SweepAndPrune::endUnseenPairs() {
+		for (size_t i = 0; i < _pairs.size();) {
+			if (_pairs[i].seen == _frame) {
+				i++;
+				continue;
+			}
+
+			_ended.push_back(_pairs[i].key);
+			_pairIndex.erase(_pairs[i].key);
+			if (i != _pairs.size() - 1) {
+				_pairs[i] = _pairs.back();
+				_pairIndex[_pairs[i].key] = static_cast<uint32_t>(i);
+			}
+			_pairs.pop_back();
+		}
+	}
+}
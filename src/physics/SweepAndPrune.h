@@ -0,0 +1,111 @@
+#pragma once
+
+#include "Objects.h"
+#include <vector>
+#include <array>
+#include <unordered_map>
+#include <cstdint>
+
+namespace amaz {
+
+	enum class PairEvent {
+		Begin,
+		Persist,
+		End
+	};
+
+	// Incremental sweep and prune over the bounds of moving objects. The bounds stay sorted by their min x between
+	// updates, so when objects only move a little each frame re-sorting is close to linear. Every update then sweeps
+	// x once, testing the boxes overlapping on x against z a few at a time. Levels are mostly flat, so y rarely
+	// rejects and is only checked for the few that overlap on z. Keeping a second axis sorted to track candidates
+	// by endpoint swaps cost more than the whole sweep.
+	class SweepAndPrune {
+	public:
+		uint32_t add(AABB aabb);
+		// the proxy's pairs are reported as ended on the next updatePairs, its id is reused after that
+		void remove(uint32_t proxy);
+		void update(uint32_t proxy, AABB aabb) {
+			_bounds[proxy] = aabb;
+		}
+
+		// Re-sorts the bounds and finds the pairs that started or stopped overlapping since the last call
+		void updatePairs();
+
+		// Calls f(a, b, event) for every pair overlapping now and every pair that stopped overlapping in the last updatePairs
+		template <typename F>
+		void forEachPair(F&& f) const {
+			for (const auto& pair : _pairs) {
+				f(first(pair.key), second(pair.key), pair.frame == _frame ? PairEvent::Begin : PairEvent::Persist);
+			}
+			for (uint64_t key : _ended) {
+				f(first(key), second(key), PairEvent::End);
+			}
+		}
+
+		size_t pairCount() const {
+			return _pairs.size();
+		}
+
+		// pairs overlapping on x in the last updatePairs, the ones that had their y and z checked
+		size_t candidateCount() const {
+			return _candidates;
+		}
+
+		size_t proxyCount() const {
+			return _bounds.size() - _free.size() - _removed.size();
+		}
+
+		// swaps done re-sorting x in the last updatePairs, roughly how much the objects moved relative to each other
+		size_t lastSwapCount() const {
+			return _swaps;
+		}
+
+	private:
+		// a proxy's bounds in sort order, all the sweep reads
+		struct Box {
+			float minX, maxX;
+			float minY, maxY, minZ, maxZ;
+			uint32_t proxy;
+		};
+
+		struct Pair {
+			uint64_t key;
+			// updatePairs call the pair began overlapping in
+			uint64_t frame = 0;
+			// updatePairs call that last found it overlapping
+			uint64_t seen = 0;
+		};
+
+		static uint64_t pairKey(uint32_t a, uint32_t b) {
+			return a < b ? (uint64_t(a) << 32) | b : (uint64_t(b) << 32) | a;
+		}
+		static uint32_t first(uint64_t key) { return static_cast<uint32_t>(key >> 32); }
+		static uint32_t second(uint64_t key) { return static_cast<uint32_t>(key); }
+
+		void sortBoxes();
+		void insertAdded();
+		void sweep();
+		void addPair(uint32_t a, uint32_t b);
+		void endUnseenPairs();
+
+		std::vector<AABB> _bounds;
+		std::vector<uint8_t> _alive;
+		std::vector<uint32_t> _free;
+		std::vector<uint32_t> _added;
+		std::vector<uint32_t> _removed;
+
+		// every live proxy sorted by min x
+		std::vector<Box> _boxes;
+		// _boxes split into an array per bound for the sweep to load a few at once
+		enum Lane { MIN_X, MIN_Z, MAX_Z, LANE_COUNT };
+		std::array<std::vector<float>, LANE_COUNT> _lanes;
+
+		// the pairs overlapping as of the last updatePairs
+		std::vector<Pair> _pairs;
+		std::unordered_map<uint64_t, uint32_t> _pairIndex;
+		std::vector<uint64_t> _ended;
+		uint64_t _frame = 0;
+		size_t _candidates = 0;
+		size_t _swaps = 0;
+	};
+}
@@ -0,0 +1,88 @@
+#include "RangeAllocator.h"
+
+#include <algorithm>
+#include <iostream>
+
+namespace amaz::eng {
+
+	RangeAllocator::RangeAllocator(uint32_t capacity) {
+		grow(capacity);
+	}
+
+	std::optional<uint32_t> RangeAllocator::allocate(uint32_t count) {
+		if (count == 0)
+			return 0;
+
+		auto it = std::find_if(_free.begin(), _free.end(), [count](const Range& range) {
+			return range.count >= count;
+		});
+		if (it == _free.end())
+			return std::nullopt;
+
+		uint32_t offset = it->offset;
+		if (it->count == count) {
+			_free.erase(it);
+		} else {
+			it->offset += count;
+			it->count -= count;
+		}
+
+		_used += count;
+		return offset;
+	}
+
+	void RangeAllocator::free(uint32_t offset, uint32_t count) {
+		if (count == 0)
+			return;
+
+		auto next = std::lower_bound(_free.begin(), _free.end(), offset, [](const Range& range, uint32_t offset) {
+			return range.offset < offset;
+		});
+
+		bool overlapsNext = next != _free.end() && offset + count > next->offset;
+		bool overlapsPrev = next != _free.begin() && std::prev(next)->offset + std::prev(next)->count > offset;
+		if (offset + count > _capacity || overlapsNext || overlapsPrev) {
+			std::cout << "RangeAllocator::free got " << count << " elements at " << offset << " that aren't allocated, ignoring them\n";
+			return;
+		}
+
+		_used -= count;
+
+		bool mergeNext = next != _free.end() && offset + count == next->offset;
+		bool mergePrev = next != _free.begin() && std::prev(next)->offset + std::prev(next)->count == offset;
+
+		if (mergePrev && mergeNext) {
+			std::prev(next)->count += count + next->count;
+			_free.erase(next);
+		} else if (mergePrev) {
+			std::prev(next)->count += count;
+		} else if (mergeNext) {
+			next->offset = offset;
+			next->count += count;
+		} else {
+			_free.insert(next, { offset, count });
+		}
+	}
+
+	void RangeAllocator::grow(uint32_t capacity) {
+		if (capacity <= _capacity)
+			return;
+
+		uint32_t added = capacity - _capacity;
+		if (!_free.empty() && _free.back().offset + _free.back().count == _capacity) {
+			_free.back().count += added;
+		} else {
+			_free.push_back({ _capacity, added });
+		}
+		_capacity = capacity;
+	}
+
+	uint32_t RangeAllocator::largestFree() const {
+		uint32_t largest = 0;
+		for (const Range& range : _free) {
+			largest = std::max(largest, range.count);
+		}
+		return largest;
+	}
+
+}
@@ -0,0 +1,45 @@
+#pragma once
+
+#include <stdint.h>
+#include <vector>
+#include <optional>
+
+namespace amaz::eng {
+
+	// Hands out ranges of a buffer counted in elements. Free ranges are kept sorted by offset, allocations take the
+	// first one that fits and freed ranges are merged with their free neighbours so the space doesn't fragment.
+	class RangeAllocator {
+	public:
+		RangeAllocator() = default;
+		explicit RangeAllocator(uint32_t capacity);
+
+		// offset of count free elements, nullopt when no free range is big enough
+		std::optional<uint32_t> allocate(uint32_t count);
+		void free(uint32_t offset, uint32_t count);
+
+		// makes the buffer bigger, the new space is free
+		void grow(uint32_t capacity);
+
+		uint32_t capacity() const {
+			return _capacity;
+		}
+
+		uint32_t used() const {
+			return _used;
+		}
+
+		// the biggest allocation that would currently fit
+		uint32_t largestFree() const;
+
+	private:
+		struct Range {
+			uint32_t offset;
+			uint32_t count;
+		};
+
+		std::vector<Range> _free;
+		uint32_t _capacity = 0;
+		uint32_t _used = 0;
+	};
+
+}
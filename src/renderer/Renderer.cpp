@@ -10,6 +10,7 @@
 #include <exception>
 #include "vk_descriptor.h"
 #include <sstream>
+#include <numeric>
 #include "vk_pipeline.h"
 #include <format>
 
@@ -39,6 +40,8 @@ Renderer::Renderer(int width, int height) : _window(nullptr, SDL_DestroyWindow)
 	std::cout << "FRAME BUFFERS INITIALIZED\n";
 	initDescriptors();
 	std::cout << "DESCRIPTORS INITIALIZED\n";
+	initGeometryPool();
+	std::cout << "GEOMETRY POOL INITIALIZED\n";
 	initPipelines();
 	std::cout << "PIPELINES INITIALIZED\n";
 	initImgui();
@@ -825,16 +828,13 @@ void Renderer::initSyncStructures() {
 }
 
 void Renderer::initDescriptors() {
-	const size_t sceneParamBufferSize = (padUniformBufferSize(sizeof(GPUCameraData)) + padUniformBufferSize(sizeof(GPUSceneData))) * FRAME_OVERLAP;
-
-	_sceneParameterBuffer = createBuffer(sceneParamBufferSize, VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT, VMA_MEMORY_USAGE_CPU_TO_GPU);
-	
 	//create a descriptor pool that will hold 10 uniform buffers and 10 dynamic uniform buffers
 	std::vector<VkDescriptorPoolSize> sizes =
 	{
 		{ VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, 10 },
 		{ VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC, 10},
-		{ VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, 10 },
+		{ VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, 7 * FRAME_OVERLAP },
+		{ VK_DESCRIPTOR_TYPE_STORAGE_BUFFER_DYNAMIC, 6 * FRAME_OVERLAP },
 		{ VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, 1000 }
 	};
 
@@ -848,7 +848,6 @@ void Renderer::initDescriptors() {
 
 	vkCreateDescriptorPool(_device, &pool_info, nullptr, &_descriptorPool);
 
-
 	auto globalDescriptorLayoutBuilder = amaz::eng::DescriptorBuilder::init()
 		.add_buffer(0, 1, amaz::eng::BindingType::UNIFORM_BUFFER_DYNAMIC,
 			amaz::eng::ShaderStages::VERTEX | amaz::eng::ShaderStages::FRAGMENT | amaz::eng::ShaderStages::COMPUTE)
@@ -860,36 +859,67 @@ void Renderer::initDescriptors() {
 	_globalSetLayout = globalDescriptorLayoutBuilder.build_layout(_device);
 
 	auto objectDescriptorLayoutBuilder = amaz::eng::DescriptorBuilder::init()
-		.add_buffer(0, 1, amaz::eng::BindingType::STORAGE_BUFFER, 
+		.add_buffer(0, 1, amaz::eng::BindingType::STORAGE_BUFFER,
 			amaz::eng::ShaderStages::VERTEX | amaz::eng::ShaderStages::FRAGMENT | amaz::eng::ShaderStages::COMPUTE)
-		.add_buffer(1, 1, amaz::eng::BindingType::STORAGE_BUFFER,
+		.add_buffer(1, 1, amaz::eng::BindingType::STORAGE_BUFFER_DYNAMIC,
 			amaz::eng::ShaderStages::VERTEX | amaz::eng::ShaderStages::FRAGMENT | amaz::eng::ShaderStages::COMPUTE)
-		.add_buffer(2, 1, amaz::eng::BindingType::STORAGE_BUFFER, 
+		.add_buffer(2, 1, amaz::eng::BindingType::STORAGE_BUFFER_DYNAMIC, 
 			amaz::eng::ShaderStages::VERTEX | amaz::eng::ShaderStages::FRAGMENT | amaz::eng::ShaderStages::COMPUTE)
-		.add_buffer(3, 1, amaz::eng::BindingType::STORAGE_BUFFER,
+		.add_buffer(3, 1, amaz::eng::BindingType::STORAGE_BUFFER_DYNAMIC,
 			amaz::eng::ShaderStages::VERTEX | amaz::eng::ShaderStages::FRAGMENT | amaz::eng::ShaderStages::COMPUTE)
 		.add_buffer(4, 1, amaz::eng::BindingType::STORAGE_BUFFER,
 			amaz::eng::ShaderStages::VERTEX | amaz::eng::ShaderStages::FRAGMENT | amaz::eng::ShaderStages::COMPUTE)
 		.add_buffer(5, 1, amaz::eng::BindingType::STORAGE_BUFFER,
 			amaz::eng::ShaderStages::VERTEX | amaz::eng::ShaderStages::FRAGMENT | amaz::eng::ShaderStages::COMPUTE)
 		.add_buffer(6, 1, amaz::eng::BindingType::STORAGE_BUFFER,
+			amaz::eng::ShaderStages::VERTEX | amaz::eng::ShaderStages::FRAGMENT | amaz::eng::ShaderStages::COMPUTE)
+		.add_buffer(7, 1, amaz::eng::BindingType::STORAGE_BUFFER,
+			amaz::eng::ShaderStages::VERTEX | amaz::eng::ShaderStages::FRAGMENT | amaz::eng::ShaderStages::COMPUTE)
+		.add_buffer(8, 1, amaz::eng::BindingType::STORAGE_BUFFER,
+			amaz::eng::ShaderStages::VERTEX | amaz::eng::ShaderStages::FRAGMENT | amaz::eng::ShaderStages::COMPUTE)
+		.add_buffer(9, 1, amaz::eng::BindingType::STORAGE_BUFFER_DYNAMIC,
 			amaz::eng::ShaderStages::VERTEX | amaz::eng::ShaderStages::FRAGMENT | amaz::eng::ShaderStages::COMPUTE);
 	
 	_objectSetLayout = objectDescriptorLayoutBuilder.build_layout(_device);
 
-	for (int i = 0; i < FRAME_OVERLAP; i++)
-	{
-		constexpr int MAX_OBJECTS = 1000000;
-		_frames[i].objectBuffer = createBuffer(sizeof(GPUObjectData) * MAX_OBJECTS, VK_BUFFER_USAGE_STORAGE_BUFFER_BIT, VMA_MEMORY_USAGE_CPU_TO_GPU);
-		
-		constexpr int MAX_DIR_LIGHTS = 1000;
-		_frames[i].dirLightBuffer = createBuffer(sizeof(int) + (sizeof(GPUDirLight) * MAX_DIR_LIGHTS), VK_BUFFER_USAGE_STORAGE_BUFFER_BIT, VMA_MEMORY_USAGE_CPU_TO_GPU);
+	auto objectScatterLayoutBuilder = amaz::eng::DescriptorBuilder::init()
+		.add_buffer(0, 1, amaz::eng::BindingType::STORAGE_BUFFER, amaz::eng::ShaderStages::COMPUTE)
+		.add_buffer(1, 1, amaz::eng::BindingType::STORAGE_BUFFER_DYNAMIC, amaz::eng::ShaderStages::COMPUTE)
+		.add_buffer(2, 1, amaz::eng::BindingType::STORAGE_BUFFER_DYNAMIC, amaz::eng::ShaderStages::COMPUTE);
 
-		constexpr int MAX_POINT_LIGHTS = 1000;
-		_frames[i].pointLightBuffer = createBuffer(sizeof(int) + (sizeof(GPUPointLight) * MAX_POINT_LIGHTS), VK_BUFFER_USAGE_STORAGE_BUFFER_BIT, VMA_MEMORY_USAGE_CPU_TO_GPU);
+	_objectScatterSetLayout = objectScatterLayoutBuilder.build_layout(_device);
 
-		constexpr int MAX_SPOT_LIGHTS = 1000;
-		_frames[i].spotLightBuffer = createBuffer(sizeof(int) + (sizeof(GPUSpotLight) * MAX_SPOT_LIGHTS), VK_BUFFER_USAGE_STORAGE_BUFFER_BIT, VMA_MEMORY_USAGE_CPU_TO_GPU);
+	// objects past the draw lists' room are never uploaded, so they get no space
+	const size_t objectRange = sizeof(GPUObjectData) * MAX_DRAWS;
+	_objectBuffer = createBuffer(objectRange, VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT, VMA_MEMORY_USAGE_GPU_ONLY);
+
+	// ids the culling reaches before their first upload read as zero indices, nothing to draw
+	immediateSubmit([&](VkCommandBuffer cmd) {
+		vkCmdFillBuffer(cmd, _objectBuffer._buffer, 0, objectRange, 0);
+	});
+
+	// the ranges the descriptors bind in the upload arenas
+	const size_t objectUploadRange = sizeof(GPUObjectData) * MAX_OBJECT_UPLOADS;
+	const size_t objectIndexRange = sizeof(uint32_t) * MAX_OBJECT_UPLOADS;
+	const size_t dirLightRange = amaz::eng::UploadArena::COUNT_HEADER + sizeof(GPUDirLight) * MAX_DIR_LIGHTS;
+	const size_t pointLightRange = amaz::eng::UploadArena::COUNT_HEADER + sizeof(GPUPointLight) * MAX_POINT_LIGHTS;
+	const size_t spotLightRange = amaz::eng::UploadArena::COUNT_HEADER + sizeof(GPUSpotLight) * MAX_SPOT_LIGHTS;
+	const size_t batchRange = sizeof(uint32_t) * MAX_DRAW_BATCHES;
+
+	// each range gets room for its alignment too, so wherever mapData puts one the bound range stays inside the buffer
+	const size_t uboAlignment = _gpuProperties.limits.minUniformBufferOffsetAlignment;
+	const size_t ssboAlignment = _gpuProperties.limits.minStorageBufferOffsetAlignment;
+	const size_t uploadArenaSize = sizeof(GPUCameraData) + sizeof(GPUSceneData) + 2 * uboAlignment
+		+ objectUploadRange + objectIndexRange + dirLightRange + pointLightRange + spotLightRange + batchRange + 6 * ssboAlignment;
+
+	for (int i = 0; i < FRAME_OVERLAP; i++)
+	{
+		_frames[i].uploads = createUploadArena(uploadArenaSize, VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT | VK_BUFFER_USAGE_STORAGE_BUFFER_BIT);
+		_frames[i].globalOffsets = {};
+		_frames[i].objectOffsets = {};
+		_frames[i].objectScatterOffsets = {};
+		_frames[i].objectScatterCount = 0;
+		const AllocatedBuffer& uploadBuffer = _frames[i].uploads.buffer();
 
 		constexpr int MAX_ACTIVE_LIGHTS = 1000;
 		_frames[i].activeLightBuffer = createBuffer(sizeof(uint32_t) + (sizeof(uint32_t) * 2 * MAX_ACTIVE_LIGHTS), VK_BUFFER_USAGE_TRANSFER_DST_BIT | VK_BUFFER_USAGE_STORAGE_BUFFER_BIT, VMA_MEMORY_USAGE_GPU_ONLY);
@@ -900,9 +930,10 @@ void Renderer::initDescriptors() {
 		constexpr int MAX_LIGHT_INDICES = 1000;
 		_frames[i].lightIndicesBuffer = createBuffer(sizeof(uint32_t) + (sizeof(uint32_t) * MAX_LIGHT_INDICES), VK_BUFFER_USAGE_TRANSFER_DST_BIT | VK_BUFFER_USAGE_STORAGE_BUFFER_BIT, VMA_MEMORY_USAGE_GPU_ONLY);
 
-		const int MAX_DRAWS = 10000;
-		_frames[i].indirectBuffer = createBuffer(MAX_DRAWS * sizeof(VkDrawIndexedIndirectCommand), VK_BUFFER_USAGE_TRANSFER_DST_BIT | VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_INDIRECT_BUFFER_BIT, VMA_MEMORY_USAGE_CPU_TO_GPU);
-		_frames[i].indirectCount = createBuffer(sizeof(uint32_t), VK_BUFFER_USAGE_TRANSFER_DST_BIT | VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_INDIRECT_BUFFER_BIT, VMA_MEMORY_USAGE_CPU_TO_GPU);
+		// both are only written by generateDraws.comp, a draw list and a count per batch for each pass
+		constexpr size_t DRAW_LISTS = static_cast<size_t>(DrawList::Count);
+		_frames[i].indirectBuffer = createBuffer(DRAW_LISTS * MAX_DRAWS * sizeof(VkDrawIndexedIndirectCommand), VK_BUFFER_USAGE_TRANSFER_DST_BIT | VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_INDIRECT_BUFFER_BIT, VMA_MEMORY_USAGE_GPU_ONLY);
+		_frames[i].indirectCount = createBuffer(DRAW_LISTS * MAX_DRAW_BATCHES * sizeof(uint32_t), VK_BUFFER_USAGE_TRANSFER_DST_BIT | VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_INDIRECT_BUFFER_BIT, VMA_MEMORY_USAGE_GPU_ONLY);
 
 		VkSamplerCreateInfo samplerInfo = vkinit::sampler_create_info(VK_FILTER_NEAREST, VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_BORDER);
 
@@ -920,10 +951,10 @@ void Renderer::initDescriptors() {
 		auto globalDescriptorBuilder = amaz::eng::DescriptorBuilder::init()
 			.add_buffer(0, 1, amaz::eng::BindingType::UNIFORM_BUFFER_DYNAMIC,
 				amaz::eng::ShaderStages::VERTEX | amaz::eng::ShaderStages::FRAGMENT | amaz::eng::ShaderStages::COMPUTE,
-				vkinit::descriptorBufferInfo(_sceneParameterBuffer, 0, sizeof(GPUCameraData)))
+				vkinit::descriptorBufferInfo(uploadBuffer, 0, sizeof(GPUCameraData)))
 			.add_buffer(1, 1, amaz::eng::BindingType::UNIFORM_BUFFER_DYNAMIC,
 				amaz::eng::ShaderStages::VERTEX | amaz::eng::ShaderStages::FRAGMENT | amaz::eng::ShaderStages::COMPUTE,
-				vkinit::descriptorBufferInfo(_sceneParameterBuffer, 0, sizeof(GPUSceneData)))
+				vkinit::descriptorBufferInfo(uploadBuffer, 0, sizeof(GPUSceneData)))
 			.add_image(2, 1, amaz::eng::BindingType::IMAGE_SAMPLER,
 				amaz::eng::ShaderStages::VERTEX | amaz::eng::ShaderStages::FRAGMENT | amaz::eng::ShaderStages::COMPUTE,
 				shadowBufferInfo);
@@ -932,18 +963,18 @@ void Renderer::initDescriptors() {
 
 
 		auto objectDescriptorSetBuilder = amaz::eng::DescriptorBuilder::init()
-			.add_buffer(0, 1, amaz::eng::BindingType::STORAGE_BUFFER, 
+			.add_buffer(0, 1, amaz::eng::BindingType::STORAGE_BUFFER,
 				amaz::eng::ShaderStages::VERTEX | amaz::eng::ShaderStages::FRAGMENT | amaz::eng::ShaderStages::COMPUTE,
-				vkinit::descriptorBufferInfo(_frames[i].objectBuffer, 0, sizeof(GPUObjectData) * MAX_OBJECTS))
-			.add_buffer(1, 1, amaz::eng::BindingType::STORAGE_BUFFER,
+				vkinit::descriptorBufferInfo(_objectBuffer, 0, objectRange))
+			.add_buffer(1, 1, amaz::eng::BindingType::STORAGE_BUFFER_DYNAMIC,
 				amaz::eng::ShaderStages::VERTEX | amaz::eng::ShaderStages::FRAGMENT | amaz::eng::ShaderStages::COMPUTE,
-				vkinit::descriptorBufferInfo(_frames[i].dirLightBuffer, 0, sizeof(uint32_t) + sizeof(GPUDirLight) * MAX_DIR_LIGHTS))
-			.add_buffer(2, 1, amaz::eng::BindingType::STORAGE_BUFFER, 
+				vkinit::descriptorBufferInfo(uploadBuffer, 0, dirLightRange))
+			.add_buffer(2, 1, amaz::eng::BindingType::STORAGE_BUFFER_DYNAMIC,
 				amaz::eng::ShaderStages::VERTEX | amaz::eng::ShaderStages::FRAGMENT | amaz::eng::ShaderStages::COMPUTE,
-				vkinit::descriptorBufferInfo(_frames[i].pointLightBuffer, 0, sizeof(uint32_t) + sizeof(GPUPointLight) * MAX_POINT_LIGHTS))
-			.add_buffer(3, 1, amaz::eng::BindingType::STORAGE_BUFFER,
+				vkinit::descriptorBufferInfo(uploadBuffer, 0, pointLightRange))
+			.add_buffer(3, 1, amaz::eng::BindingType::STORAGE_BUFFER_DYNAMIC,
 				amaz::eng::ShaderStages::VERTEX | amaz::eng::ShaderStages::FRAGMENT | amaz::eng::ShaderStages::COMPUTE,
-				vkinit::descriptorBufferInfo(_frames[i].spotLightBuffer, 0, sizeof(uint32_t) + sizeof(GPUSpotLight) * MAX_SPOT_LIGHTS))
+				vkinit::descriptorBufferInfo(uploadBuffer, 0, spotLightRange))
 			.add_buffer(4, 1, amaz::eng::BindingType::STORAGE_BUFFER,
 				amaz::eng::ShaderStages::VERTEX | amaz::eng::ShaderStages::FRAGMENT | amaz::eng::ShaderStages::COMPUTE,
 				vkinit::descriptorBufferInfo(_frames[i].activeLightBuffer, 0, sizeof(uint32_t) + sizeof(uint32_t) * 2 * MAX_ACTIVE_LIGHTS))
@@ -952,9 +983,28 @@ void Renderer::initDescriptors() {
 				vkinit::descriptorBufferInfo(_frames[i].clustersBuffer, 0, sizeof(GPUCluster) * CLUSTER_COUNT))
 			.add_buffer(6, 1, amaz::eng::BindingType::STORAGE_BUFFER,
 				amaz::eng::ShaderStages::VERTEX | amaz::eng::ShaderStages::FRAGMENT | amaz::eng::ShaderStages::COMPUTE,
-				vkinit::descriptorBufferInfo(_frames[i].lightIndicesBuffer, 0, sizeof(uint32_t) + (sizeof(uint32_t) * MAX_LIGHT_INDICES)));
+				vkinit::descriptorBufferInfo(_frames[i].lightIndicesBuffer, 0, sizeof(uint32_t) + (sizeof(uint32_t) * MAX_LIGHT_INDICES)))
+			.add_buffer(7, 1, amaz::eng::BindingType::STORAGE_BUFFER,
+				amaz::eng::ShaderStages::VERTEX | amaz::eng::ShaderStages::FRAGMENT | amaz::eng::ShaderStages::COMPUTE,
+				vkinit::descriptorBufferInfo(_frames[i].indirectBuffer, 0, DRAW_LISTS * MAX_DRAWS * sizeof(VkDrawIndexedIndirectCommand)))
+			.add_buffer(8, 1, amaz::eng::BindingType::STORAGE_BUFFER,
+				amaz::eng::ShaderStages::VERTEX | amaz::eng::ShaderStages::FRAGMENT | amaz::eng::ShaderStages::COMPUTE,
+				vkinit::descriptorBufferInfo(_frames[i].indirectCount, 0, DRAW_LISTS * MAX_DRAW_BATCHES * sizeof(uint32_t)))
+			.add_buffer(9, 1, amaz::eng::BindingType::STORAGE_BUFFER_DYNAMIC,
+				amaz::eng::ShaderStages::VERTEX | amaz::eng::ShaderStages::FRAGMENT | amaz::eng::ShaderStages::COMPUTE,
+				vkinit::descriptorBufferInfo(uploadBuffer, 0, batchRange));
 
 		_frames[i].objectDescriptor = objectDescriptorSetBuilder.build_set(_device, _descriptorPool, _objectSetLayout);
+
+		auto objectScatterSetBuilder = amaz::eng::DescriptorBuilder::init()
+			.add_buffer(0, 1, amaz::eng::BindingType::STORAGE_BUFFER, amaz::eng::ShaderStages::COMPUTE,
+				vkinit::descriptorBufferInfo(_objectBuffer, 0, objectRange))
+			.add_buffer(1, 1, amaz::eng::BindingType::STORAGE_BUFFER_DYNAMIC, amaz::eng::ShaderStages::COMPUTE,
+				vkinit::descriptorBufferInfo(uploadBuffer, 0, objectUploadRange))
+			.add_buffer(2, 1, amaz::eng::BindingType::STORAGE_BUFFER_DYNAMIC, amaz::eng::ShaderStages::COMPUTE,
+				vkinit::descriptorBufferInfo(uploadBuffer, 0, objectIndexRange));
+
+		_frames[i].objectScatterDescriptor = objectScatterSetBuilder.build_set(_device, _descriptorPool, _objectScatterSetLayout);
 	}
 
 	auto textureDescriptorLayoutBuilder = amaz::eng::DescriptorBuilder::init()
@@ -969,17 +1019,16 @@ void Renderer::initDescriptors() {
 		// add descriptor set layout to deletion queues
 		vkDestroyDescriptorSetLayout(_device, _globalSetLayout, nullptr);
 		vkDestroyDescriptorSetLayout(_device, _objectSetLayout, nullptr);
+		vkDestroyDescriptorSetLayout(_device, _objectScatterSetLayout, nullptr);
 		vkDestroyDescriptorSetLayout(_device, _singleTextureSetLayout, nullptr);
 		vkDestroyDescriptorSetLayout(_device, _specularMapSetLayout, nullptr);
 
 		// add buffers to deletion queues
 		vkDestroyDescriptorPool(_device, _descriptorPool, nullptr);
-		vmaDestroyBuffer(_allocator, _sceneParameterBuffer._buffer, _sceneParameterBuffer._allocation);
+		vmaDestroyBuffer(_allocator, _objectBuffer._buffer, _objectBuffer._allocation);
 		for (int i = 0; i < FRAME_OVERLAP; i++) {
-			vmaDestroyBuffer(_allocator, _frames[i].objectBuffer._buffer, _frames[i].objectBuffer._allocation);
-			vmaDestroyBuffer(_allocator, _frames[i].dirLightBuffer._buffer, _frames[i].dirLightBuffer._allocation);
-			vmaDestroyBuffer(_allocator, _frames[i].pointLightBuffer._buffer, _frames[i].pointLightBuffer._allocation);
-			vmaDestroyBuffer(_allocator, _frames[i].spotLightBuffer._buffer, _frames[i].spotLightBuffer._allocation);
+			// freeing a persistently mapped allocation unmaps it
+			vmaDestroyBuffer(_allocator, _frames[i].uploads.buffer()._buffer, _frames[i].uploads.buffer()._allocation);
 			vmaDestroyBuffer(_allocator, _frames[i].activeLightBuffer._buffer, _frames[i].activeLightBuffer._allocation);
 			vmaDestroyBuffer(_allocator, _frames[i].indirectBuffer._buffer, _frames[i].indirectBuffer._allocation);
 			vmaDestroyBuffer(_allocator, _frames[i].indirectCount._buffer, _frames[i].indirectCount._allocation);
@@ -1023,6 +1072,30 @@ AllocatedBuffer Renderer::createBuffer(size_t allocSize, VkBufferUsageFlags usag
 	return newBuffer;
 }
 
+amaz::eng::UploadArena Renderer::createUploadArena(size_t capacity, VkBufferUsageFlags usage) {
+	VkBufferCreateInfo bufferInfo = {
+		.sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO,
+		.pNext = nullptr,
+		.size = capacity,
+		.usage = usage
+	};
+
+	// mapped for as long as the buffer lives, frames write into it without mapping anything
+	VmaAllocationCreateInfo vmaallocInfo = {
+		.flags = VMA_ALLOCATION_CREATE_MAPPED_BIT,
+		.usage = VMA_MEMORY_USAGE_CPU_TO_GPU
+	};
+
+	AllocatedBuffer newBuffer;
+	VmaAllocationInfo allocationInfo;
+	vmaCreateBuffer(_allocator, &bufferInfo, &vmaallocInfo,
+		&newBuffer._buffer,
+		&newBuffer._allocation,
+		&allocationInfo);
+
+	return amaz::eng::UploadArena(newBuffer, allocationInfo.pMappedData, capacity);
+}
+
 void Renderer::initPipelines() {
 
 	VkShaderModule meshVertShader;
@@ -1566,6 +1639,33 @@ void Renderer::initComputePipelines() {
 
 
 
+	std::vector<VkPushConstantRange> drawCullPushConstants = { {
+		.stageFlags = VK_SHADER_STAGE_COMPUTE_BIT,
+		.offset = 0,
+		.size = sizeof(GPUDrawCullPushConstants)
+	} };
+
+	VkPipelineLayoutCreateInfo drawCullPipelineLayoutInfo = vkinit::pipeline_layout_create_info(setLayouts, drawCullPushConstants);
+	vkCreatePipelineLayout(_device, &drawCullPipelineLayoutInfo, nullptr, &_drawCullPipelineLayout);
+
+	_drawCullPipeline = initComputePipeline("../shaders/generateDraws.comp.spv", _drawCullPipelineLayout);
+
+
+
+	std::array<VkDescriptorSetLayout, 1> objectScatterSetLayouts = { _objectScatterSetLayout };
+	std::array<VkPushConstantRange, 1> objectScatterPushConstants = { {
+		.stageFlags = VK_SHADER_STAGE_COMPUTE_BIT,
+		.offset = 0,
+		.size = sizeof(GPUObjectScatterPushConstants)
+	} };
+
+	VkPipelineLayoutCreateInfo objectScatterPipelineLayoutInfo = vkinit::pipeline_layout_create_info(objectScatterSetLayouts, objectScatterPushConstants);
+	vkCreatePipelineLayout(_device, &objectScatterPipelineLayoutInfo, nullptr, &_objectScatterPipelineLayout);
+
+	_objectScatterPipeline = initComputePipeline("../shaders/scatterObjects.comp.spv", _objectScatterPipelineLayout);
+
+
+
 	std::array<VkDescriptorSetLayout, 1> depthSetLayouts = { _depthPyramidSetLayout };
 
 	VkPushConstantRange depthPushConstant{
@@ -1587,6 +1687,8 @@ void Renderer::initComputePipelines() {
 	//adding the pipelines to the deletion queue
 	_mainDeletionQueue.push_function([=]() {
 		vkDestroyPipelineLayout(_device, _lightCullPipelineLayout, nullptr);
+		vkDestroyPipelineLayout(_device, _drawCullPipelineLayout, nullptr);
+		vkDestroyPipelineLayout(_device, _objectScatterPipelineLayout, nullptr);
 		vkDestroyPipelineLayout(_device, _depthPyramidPipelineLayout, nullptr);
 	});
 }
@@ -1893,6 +1995,32 @@ void Renderer::loadMesh(std::string name, std::string filename) {
 	_meshes[name] = mesh;
 }
 
+void Renderer::unloadMesh(const std::string& name) {
+	auto it = _meshes.find(name);
+	if (it == _meshes.end())
+		return;
+
+	for (const RenderObject& object : _renderables) {
+		if (object.mesh == &it->second) {
+			std::cout << "Can't unload mesh " << name << ", render objects still use it\n";
+			return;
+		}
+	}
+
+	// the ranges are handed to the next meshes uploaded, but frames already submitted may still draw from them.
+	// the last one submitted is the last that could, so they're freed once its fence has signalled
+	const Mesh& mesh = it->second;
+	uint32_t vertexOffset = mesh._vertexOffset, vertexCount = static_cast<uint32_t>(mesh._vertices.size());
+	uint32_t firstIndex = mesh._firstIndex, indexCount = static_cast<uint32_t>(mesh._indices.size());
+	FrameData& lastSubmitted = _frames[(_frameNumber + FRAME_OVERLAP - 1) % FRAME_OVERLAP];
+	lastSubmitted._frameDeletionQueue.push_function([=, this]() {
+		_geometry.vertices.free(vertexOffset, vertexCount);
+		_geometry.indices.free(firstIndex, indexCount);
+	});
+
+	_meshes.erase(it);
+}
+
 void Renderer::addCuboid(std::string name, glm::vec3 size) {
 	auto vertices = createCuboid(size.x, size.y, size.z);
 	std::vector<uint32_t> indices;
@@ -1998,15 +2126,90 @@ std::vector<Vertex> Renderer::createSquare(glm::vec3 topLeft, glm::vec3 topRight
 }
 
 void Renderer::uploadMesh(Mesh& mesh) {
-	createStageAndCopyBuffer(std::span<Vertex>(mesh._vertices), mesh._vertexBuffer, VK_BUFFER_USAGE_VERTEX_BUFFER_BIT);
-	createStageAndCopyBuffer(std::span<uint32_t>(mesh._indices), mesh._indexBuffer, VK_BUFFER_USAGE_INDEX_BUFFER_BIT);
+	// bounding sphere around the middle of the mesh's box, what generateDraws.comp culls it by
+	if (!mesh._vertices.empty()) {
+		glm::vec3 min = mesh._vertices[0].position;
+		glm::vec3 max = mesh._vertices[0].position;
+		for (const Vertex& vertex : mesh._vertices) {
+			min = glm::min(min, vertex.position);
+			max = glm::max(max, vertex.position);
+		}
+
+		glm::vec3 center = (min + max) * 0.5f;
+		float radiusSq = 0.f;
+		for (const Vertex& vertex : mesh._vertices) {
+			glm::vec3 offset = vertex.position - center;
+			radiusSq = std::max(radiusSq, glm::dot(offset, offset));
+		}
+		mesh._sphereBounds = glm::vec4(center, std::sqrt(radiusSq));
+	}
+
+	uint32_t vertexCount = static_cast<uint32_t>(mesh._vertices.size());
+	uint32_t indexCount = static_cast<uint32_t>(mesh._indices.size());
+
+	std::optional<uint32_t> vertexOffset = _geometry.vertices.allocate(vertexCount);
+	if (!vertexOffset) {
+		growGeometryBuffer(_geometry.vertexBuffer, _geometry.vertices, vertexCount, sizeof(Vertex), VK_BUFFER_USAGE_VERTEX_BUFFER_BIT);
+		vertexOffset = _geometry.vertices.allocate(vertexCount);
+	}
+
+	std::optional<uint32_t> firstIndex = _geometry.indices.allocate(indexCount);
+	if (!firstIndex) {
+		growGeometryBuffer(_geometry.indexBuffer, _geometry.indices, indexCount, sizeof(uint32_t), VK_BUFFER_USAGE_INDEX_BUFFER_BIT);
+		firstIndex = _geometry.indices.allocate(indexCount);
+	}
+
+	mesh._vertexOffset = *vertexOffset;
+	mesh._firstIndex = *firstIndex;
+
+	stageAndCopyBuffer(std::span<Vertex>(mesh._vertices), _geometry.vertexBuffer, mesh._vertexOffset * sizeof(Vertex));
+	stageAndCopyBuffer(std::span<uint32_t>(mesh._indices), _geometry.indexBuffer, mesh._firstIndex * sizeof(uint32_t));
+}
+
+void Renderer::initGeometryPool() {
+	_geometry.vertexBuffer = createBuffer(GEOMETRY_POOL_VERTICES * sizeof(Vertex), VK_BUFFER_USAGE_VERTEX_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT | VK_BUFFER_USAGE_TRANSFER_SRC_BIT, VMA_MEMORY_USAGE_GPU_ONLY);
+	_geometry.indexBuffer = createBuffer(GEOMETRY_POOL_INDICES * sizeof(uint32_t), VK_BUFFER_USAGE_INDEX_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT | VK_BUFFER_USAGE_TRANSFER_SRC_BIT, VMA_MEMORY_USAGE_GPU_ONLY);
+	_geometry.vertices = amaz::eng::RangeAllocator(GEOMETRY_POOL_VERTICES);
+	_geometry.indices = amaz::eng::RangeAllocator(GEOMETRY_POOL_INDICES);
+
+	// the buffers can be swapped for bigger ones, so whichever are current when shutting down get destroyed
+	_mainDeletionQueue.push_function([this]() {
+		vmaDestroyBuffer(_allocator, _geometry.vertexBuffer._buffer, _geometry.vertexBuffer._allocation);
+		vmaDestroyBuffer(_allocator, _geometry.indexBuffer._buffer, _geometry.indexBuffer._allocation);
+	});
+}
+
+void Renderer::growGeometryBuffer(AllocatedBuffer& buffer, amaz::eng::RangeAllocator& ranges, uint32_t needed, size_t elementSize, VkBufferUsageFlags usage) {
+	uint32_t capacity = std::max(ranges.capacity() * 2, ranges.capacity() + needed);
+	std::cout << "Growing a geometry buffer from " << ranges.capacity() << " to " << capacity << " elements\n";
+
+	AllocatedBuffer grown = createBuffer(capacity * elementSize, usage | VK_BUFFER_USAGE_TRANSFER_DST_BIT | VK_BUFFER_USAGE_TRANSFER_SRC_BIT, VMA_MEMORY_USAGE_GPU_ONLY);
+
+	immediateSubmit([&](VkCommandBuffer cmd) {
+		VkBufferCopy copy{
+			.srcOffset = 0,
+			.dstOffset = 0,
+			.size = ranges.capacity() * elementSize
+		};
+		vkCmdCopyBuffer(cmd, buffer._buffer, grown._buffer, 1, &copy);
+		});
+
+	// frames still in flight may be drawing from the old one
+	vkDeviceWaitIdle(_device);
+	vmaDestroyBuffer(_allocator, buffer._buffer, buffer._allocation);
+
+	buffer = grown;
+	ranges.grow(capacity);
 }
 
 template <typename T>
-void Renderer::createStageAndCopyBuffer(std::span<T> data, AllocatedBuffer& bufferLocation, VkBufferUsageFlags usageFlags) {
+void Renderer::stageAndCopyBuffer(std::span<T> data, AllocatedBuffer& bufferLocation, VkDeviceSize offset) {
 	const size_t bufferSize = data.size() * sizeof(T);
 	// std::cout << std::format("Buffer size: {}\n", bufferSize);
 
+	if (bufferSize == 0)
+		return;
+
 	//allocate staging buffer
 	VkBufferCreateInfo stagingBufferInfo = {
 		.sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO,
@@ -2038,40 +2241,15 @@ void Renderer::createStageAndCopyBuffer(std::span<T> data, AllocatedBuffer& buff
 
 	vmaUnmapMemory(_allocator, stagingBuffer._allocation);
 
-	//allocate buffer
-	VkBufferCreateInfo bufferInfo = {
-		.sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO,
-		.pNext = nullptr,
-		.size = bufferSize,
-		.usage = usageFlags | VK_BUFFER_USAGE_TRANSFER_DST_BIT
-	};
-
-	vmaallocInfo = {
-		.flags = 0,
-		.usage = VMA_MEMORY_USAGE_AUTO
-	};
-
-	//allocate the buffer
-	vmaCreateBuffer(_allocator, &bufferInfo, &vmaallocInfo,
-		&bufferLocation._buffer,
-		&bufferLocation._allocation,
-		nullptr);
-
 	immediateSubmit([&](VkCommandBuffer cmd) {
 		VkBufferCopy copy{
 			.srcOffset = 0,
-			.dstOffset = 0,
+			.dstOffset = offset,
 			.size = bufferSize
 		};
 		vkCmdCopyBuffer(cmd, stagingBuffer._buffer, bufferLocation._buffer, 1, &copy);
 		});
 
-	
-
-	_mainDeletionQueue.push_function([=]() {
-		vmaDestroyBuffer(_allocator, bufferLocation._buffer, bufferLocation._allocation);
-		});
-
 	vmaDestroyBuffer(_allocator, stagingBuffer._buffer, stagingBuffer._allocation);
 }
 
@@ -2139,25 +2317,73 @@ glm::mat4 Renderer::calcTransformMatrix(glm::vec3 position, float scale, glm::ve
 	return translation * rotate * scaleMatrix;
 }
 
-void Renderer::registerRenderObject(std::string mesh, std::string material, glm::mat4 transform) {
+uint32_t Renderer::registerRenderObject(std::string mesh, std::string material, glm::mat4 transform) {
 	RenderObject object{
 		.mesh = getMesh(mesh),
 		.material = getMaterial(material),
 		.transformMatrix = transform
 	};
 
-	_renderables.push_back(object);
+	uint32_t id;
+	if (!_freeObjects.empty()) {
+		id = _freeObjects.back();
+		_freeObjects.pop_back();
+	} else {
+		id = static_cast<uint32_t>(_renderables.size());
+		_renderables.push_back({ .dirty = false });
+	}
+
+	// a reused id may still be queued to upload its removal, it's only queued once either way
+	object.dirty = _renderables[id].dirty;
+	_renderables[id] = object;
+	markObjectDirty(id);
+	return id;
 }
 
-void Renderer::registerRenderObject(std::string mesh, std::string material, glm::vec3 position) {
-	registerRenderObject(mesh, material, glm::translate(position));
+uint32_t Renderer::registerRenderObject(std::string mesh, std::string material, glm::vec3 position) {
+	return registerRenderObject(mesh, material, glm::translate(position));
 }
 
-void Renderer::registerRenderObject(std::string mesh, std::string material, glm::vec3 position, float scale, glm::vec3 rotation) {
+uint32_t Renderer::registerRenderObject(std::string mesh, std::string material, glm::vec3 position, float scale, glm::vec3 rotation) {
 
 	glm::mat4 transformMatrix = calcTransformMatrix(position, scale, rotation);
 
-	registerRenderObject(mesh, material, transformMatrix);
+	return registerRenderObject(mesh, material, transformMatrix);
+}
+
+void Renderer::setRenderObjectTransform(uint32_t object, glm::mat4 transform) {
+	if (object >= _renderables.size() || _renderables[object].mesh == nullptr) {
+		std::cout << "setRenderObjectTransform got object " << object << " which isn't registered\n";
+		return;
+	}
+
+	_renderables[object].transformMatrix = transform;
+	markObjectDirty(object);
+}
+
+void Renderer::removeRenderObject(uint32_t object) {
+	if (object >= _renderables.size() || _renderables[object].mesh == nullptr) {
+		std::cout << "removeRenderObject got object " << object << " which isn't registered\n";
+		return;
+	}
+
+	// keeps its slot in the object buffer, its next upload is nothing to draw and takes it out of its batch
+	_renderables[object] = RenderObject{
+		.mesh = nullptr,
+		.material = nullptr,
+		.transformMatrix = glm::mat4(1.f),
+		.dirty = _renderables[object].dirty
+	};
+	_freeObjects.push_back(object);
+	markObjectDirty(object);
+}
+
+void Renderer::markObjectDirty(uint32_t object) {
+	RenderObject& renderObject = _renderables[object];
+	if (!renderObject.dirty) {
+		renderObject.dirty = true;
+		_dirtyObjects.push_back(object);
+	}
 }
 
 void Renderer::allocateTexture(VkImageView imageView, VkDescriptorPool descPool, VkDescriptorSetLayout* setLayout, VkDescriptorSet* textureSet) {
@@ -2242,6 +2468,7 @@ int updateFps = 0;
 float timeTillUpdateFps = 0.f;
 
 bool depthPyramid = true;
+bool occlusionCulling = true;
 
 void Renderer::drawImguiWindow(Input* input) {
 
@@ -2324,6 +2551,7 @@ void Renderer::drawImguiWindow(Input* input) {
 	ImGui::PlotLines("Frametimes", frameTimes.data(), frameTimes.size(), 0, nullptr, FLT_MAX, FLT_MAX, ImVec2(300, 100));
 
 	ImGui::Checkbox("generate depth pyramid", &depthPyramid);
+	ImGui::Checkbox("occlusion culling", &occlusionCulling);
 
 	ImGui::End();
 
@@ -2411,6 +2639,7 @@ void Renderer::draw(glm::vec3 camDir, Input* input) {
 	//wait until the GPU has finished rendering the last frame. Timeout of 1 second
 	vkWaitForFences(_device, 1, &frame._renderFence, true, 1000000000);
 	vkResetFences(_device, 1, &frame._renderFence);
+	frame._frameDeletionQueue.flush();
 
 	//request image from the swapchain, one second timeout
 	uint32_t swapchainImageIndex;
@@ -2441,7 +2670,6 @@ void Renderer::draw(glm::vec3 camDir, Input* input) {
 	};
 
 	vkBeginCommandBuffer(cmd, &cmdBeginInfo);
-	//sortObjects(_renderables);
 
 	glm::vec3 camPos;
 
@@ -2508,13 +2736,20 @@ void Renderer::draw(glm::vec3 camDir, Input* input) {
 	// 	}
 	// }
 
-	mapData(_renderables, camView, camProj, inverseCamProj, sceneParameters, _pointLights);
+	mapData(camView, camProj, inverseCamProj, sceneParameters, _pointLights);
+
+	scatterObjectsPass(cmd);
+
+	cullDrawsPass(cmd, DrawList::PrePass, camView, camProj, swapchainImageIndex, zNear, zFar);
 
 	drawPrePass(cmd, _renderables, sceneParameters, swapchainImageIndex);
 
 	if (depthPyramid) 
 		genDepthPyramid(cmd, swapchainImageIndex);
 
+	// after the pyramid, so the main pass skips whatever the prepass' depth hides
+	cullDrawsPass(cmd, DrawList::Main, camView, camProj, swapchainImageIndex, zNear, zFar);
+
 	cullLightsPass(cmd, _pointLights, camView, camProj, swapchainImageIndex, zNear, zFar);
 
 	// {
@@ -2526,6 +2761,7 @@ void Renderer::draw(glm::vec3 camDir, Input* input) {
 
 	static bool hasShadows = false;
 	if (!hasShadows) {
+		cullDrawsPass(cmd, DrawList::Shadow, camView, camProj, swapchainImageIndex, zNear, zFar);
 		drawShadowPass(cmd, _renderables, sceneParameters, _pointLights);
 		hasShadows = true;
 	}
@@ -2635,52 +2871,146 @@ void Renderer::draw(glm::vec3 camDir, Input* input) {
 	_frameNumber++;
 }
 
-void Renderer::sortObjects(std::span<RenderObject> renderObjects) {
-	std::sort(renderObjects.begin(), renderObjects.end(), [](RenderObject& a, RenderObject& b) {
-		return a.material > b.material || (a.material == b.material && a.mesh > b.mesh);
-		});
+// a material gets the next batch the first time an object uses it and keeps it, empty batches are skipped when drawing
+uint32_t Renderer::materialBatch(Material* material) {
+	RenderList& list = _renderList;
+	if (auto it = list.batchOfMaterial.find(material); it != list.batchOfMaterial.end())
+		return it->second;
+
+	// the count buffer has room for MAX_DRAW_BATCHES batches per list
+	uint32_t batch = RenderList::NO_BATCH;
+	if (list.materialBatches.size() < MAX_DRAW_BATCHES) {
+		batch = static_cast<uint32_t>(list.materialBatches.size());
+		list.materialBatches.push_back({ .material = material, .first = 0, .count = 0 });
+	} else {
+		std::cout << "Can't draw objects with more than " << MAX_DRAW_BATCHES << " materials, the draw lists are full\n";
+	}
+
+	list.batchOfMaterial.emplace(material, batch);
+	return batch;
 }
 
-void Renderer::mapData(std::span<RenderObject> renderObjects, glm::mat4 view, glm::mat4 proj, glm::mat4 inverseProj, GPUSceneData sceneParameters, std::span<PointLightObject> lights) {
-	
-	int frameIndex = _frameNumber % FRAME_OVERLAP;
-	int frameOffset = (padUniformBufferSize(sizeof(GPUCameraData)) + padUniformBufferSize(sizeof(GPUSceneData))) * frameIndex;
+// moves an object between batch counts as its upload goes out, so the counts always match the data the GPU has
+void Renderer::updateObjectBatch(uint32_t object) {
+	RenderList& list = _renderList;
+	const RenderObject& renderObject = _renderables[object];
 
+	uint32_t batch = RenderList::NO_BATCH;
+	if (renderObject.mesh != nullptr && renderObject.material != nullptr)
+		batch = materialBatch(renderObject.material);
 
-	//fill a GPU camera data struct
-	GPUCameraData camData{
-		.view = view,
-		.proj = proj,
-		.viewproj = proj * view,
-		.inverseProj = inverseProj
-	};
+	uint32_t& current = list.objectBatch[object];
+	if (current == batch)
+		return;
 
-	//Copy camera and scene parameters into buffer
-	{
-		char* sceneData;
-		vmaMapMemory(_allocator, _sceneParameterBuffer._allocation, (void**)&sceneData);
+	if (current != RenderList::NO_BATCH) {
+		list.materialBatches[current].count--;
+		list.allObjects.count--;
+	}
+	if (batch != RenderList::NO_BATCH) {
+		list.materialBatches[batch].count++;
+		list.allObjects.count++;
+	}
+	current = batch;
+}
+
+// each batch's draws start where the batch before it ends, only the firsts move when a count changes
+void Renderer::layoutBatches() {
+	uint32_t first = 0;
+	for (IndirectBatch& batch : _renderList.materialBatches) {
+		batch.first = first;
+		first += batch.count;
+	}
+}
+
+void Renderer::mapData(glm::mat4 view, glm::mat4 proj, glm::mat4 inverseProj, GPUSceneData sceneParameters, std::span<PointLightObject> lights) {
 
-		sceneData += frameOffset;
-		memcpy(sceneData, &camData, sizeof(GPUCameraData));
+	FrameData& frame = getCurrentFrame();
 
-		sceneData += padUniformBufferSize(sizeof(GPUCameraData));
-		memcpy(sceneData, &sceneParameters, sizeof(GPUSceneData));
+	// the frame's fence was waited on, the GPU is done with what was uploaded last time
+	frame.uploads.reset();
 
-		vmaUnmapMemory(_allocator, _sceneParameterBuffer._allocation);
+	const size_t uboAlignment = _gpuProperties.limits.minUniformBufferOffsetAlignment;
+	const size_t ssboAlignment = _gpuProperties.limits.minStorageBufferOffsetAlignment;
 
+	//Copy camera and scene parameters into the upload arena
+	{
+		auto camera = frame.uploads.allocate<GPUCameraData>(1, uboAlignment);
+		auto scene = frame.uploads.allocate<GPUSceneData>(1, uboAlignment);
+
+		if (!camera.data.empty()) {
+			camera.data[0] = {
+				.view = view,
+				.proj = proj,
+				.viewproj = proj * view,
+				.inverseProj = inverseProj
+			};
+		}
+
+		if (!scene.data.empty()) {
+			scene.data[0] = sceneParameters;
+		}
+
+		frame.globalOffsets = { camera.offset, scene.offset };
 	}
 
 	// Map Object Data
 	{
-		GPUObjectData* objectData;
-		vmaMapMemory(_allocator, getCurrentFrame().objectBuffer._allocation, (void**)&objectData);
+		frame.objectScatterCount = 0;
+
+		// the object buffer has room for MAX_DRAWS ids, anything past that isn't drawn
+		RenderList& list = _renderList;
+		uint32_t objectCount = static_cast<uint32_t>(std::min<size_t>(_renderables.size(), MAX_DRAWS));
+		if (objectCount > list.objectCount) {
+			list.objectBatch.resize(objectCount, RenderList::NO_BATCH);
+			list.objectCount = objectCount;
+		}
 
-		for (int i = 0; i < renderObjects.size(); i++) {
-			objectData[i] = { .modelMatrix = renderObjects[i].transformMatrix };
+		static bool warnedDrawLimit = false;
+		if (_renderables.size() > MAX_DRAWS && !warnedDrawLimit) {
+			std::cout << "Only drawing the first " << MAX_DRAWS << " render object ids, the draw lists are full\n";
+			warnedDrawLimit = true;
 		}
 
-		vmaUnmapMemory(_allocator, getCurrentFrame().objectBuffer._allocation);
+		// changes past what one frame can upload wait for the next one, they're only a frame behind.
+		// ids past the draw lists are dropped but stay dirty, so they're never queued again
+		std::vector<uint32_t> uploads;
+		std::erase_if(_dirtyObjects, [&](uint32_t object) {
+			if (object >= objectCount)
+				return true;
+			if (uploads.size() == MAX_OBJECT_UPLOADS)
+				return false;
+			uploads.push_back(object);
+			return true;
+		});
+
+		auto objects = frame.uploads.allocate<GPUObjectData>(uploads.size(), ssboAlignment);
+		auto indices = frame.uploads.allocate<uint32_t>(uploads.size(), ssboAlignment);
+
+		if (objects.data.size() == uploads.size() && indices.data.size() == uploads.size()) {
+			for (size_t i = 0; i < uploads.size(); i++) {
+				// registered and removed objects change batches only here, with the data the GPU will see
+				updateObjectBatch(uploads[i]);
+				objects.data[i] = gpuObjectData(uploads[i]);
+				indices.data[i] = uploads[i];
+				_renderables[uploads[i]].dirty = false;
+			}
+
+			frame.objectScatterOffsets = { objects.offset, indices.offset };
+			frame.objectScatterCount = static_cast<uint32_t>(uploads.size());
+		} else {
+			// still dirty, they go up once there's room
+			_dirtyObjects.insert(_dirtyObjects.end(), uploads.begin(), uploads.end());
+		}
+
+		// a few bytes per material, so every frame gets its own and the frames in flight keep theirs
+		layoutBatches();
 
+		auto batchFirsts = frame.uploads.allocate<uint32_t>(std::max<size_t>(list.materialBatches.size(), 1), ssboAlignment);
+		for (size_t i = 0; i < list.materialBatches.size() && i < batchFirsts.data.size(); i++) {
+			batchFirsts.data[i] = list.materialBatches[i].first;
+		}
+		frame.objectOffsets[3] = batchFirsts.offset;
 	}
 
 	//Map Light Data
@@ -2688,45 +3018,46 @@ void Renderer::mapData(std::span<RenderObject> renderObjects, glm::mat4 view, gl
 		// Dir Light
 		// TODO: proper implementation lol
 		{
-			int* data;
-			vmaMapMemory(_allocator, getCurrentFrame().dirLightBuffer._allocation, (void**)&data);
-
-			*data = 1;
-
-			GPUDirLight* lightData = (GPUDirLight*)(data + 4);
-
-			*lightData = {
-				.lightPos = sceneParameters.camPos,
-				.lightDir = sceneParameters.sunlightDirection,
-				.lightSpaceMatrix = sceneParameters.lightSpaceMatrix,
-				.lightColor = sceneParameters.sunlightColor,
-				.ambientColor = sceneParameters.ambientColor,
-				.shadowMapData = {
-					0.f, 0.f, 0.5f
-				}
-			};
+			auto dirLights = frame.uploads.allocateCounted<GPUDirLight>(1, ssboAlignment);
+
+			if (!dirLights.data.empty()) {
+				dirLights.data[0] = {
+					.lightPos = sceneParameters.camPos,
+					.lightDir = sceneParameters.sunlightDirection,
+					.lightSpaceMatrix = sceneParameters.lightSpaceMatrix,
+					.lightColor = sceneParameters.sunlightColor,
+					.ambientColor = sceneParameters.ambientColor,
+					.shadowMapData = {
+						0.f, 0.f, 0.5f
+					}
+				};
+			}
 
-			vmaUnmapMemory(_allocator, getCurrentFrame().dirLightBuffer._allocation);
+			frame.objectOffsets[0] = dirLights.offset;
 		}
 
 		// Point light
 		{
-			int* data;
-			vmaMapMemory(_allocator, getCurrentFrame().pointLightBuffer._allocation, (void**)&data);
+			size_t lightCount = std::min<size_t>(lights.size(), MAX_POINT_LIGHTS);
+			auto pointLights = frame.uploads.allocateCounted<GPUPointLight>(lightCount, ssboAlignment);
 
-			*data = lights.size();
+			for (int i = 0; i < pointLights.data.size(); i++) {
+				pointLights.data[i] = generatePointLight(lights[i], (i * 6) + 1);
+			}
 
-			GPUPointLight* lightData = (GPUPointLight*)(data + 4);
+			frame.objectOffsets[1] = pointLights.offset;
+		}
 
-			for (int i = 0; i < lights.size(); i++) {
-				lightData[i] = generatePointLight(lights[i], (i * 6) + 1);
-			}
+		// Spot light, none yet but the shaders still read the count
+		{
+			auto spotLights = frame.uploads.allocateCounted<GPUSpotLight>(0, ssboAlignment);
 
-			vmaUnmapMemory(_allocator, getCurrentFrame().pointLightBuffer._allocation);
+			frame.objectOffsets[2] = spotLights.offset;
 		}
 	}
 
-
+	// a no-op on host coherent memory
+	vmaFlushAllocation(_allocator, frame.uploads.buffer()._allocation, 0, frame.uploads.used());
 }
 
 // pos z = 4, neg z = 5
@@ -2896,12 +3227,6 @@ void Renderer::cullLightsPass(VkCommandBuffer cmd, std::span<PointLightObject> l
 
 	size_t dispatchCount = ceil(lightCount / 64.f);
 
-	int frameIndex = _frameNumber % FRAME_OVERLAP;
-	int frameOffset = (padUniformBufferSize(sizeof(GPUCameraData)) + padUniformBufferSize(sizeof(GPUSceneData))) * frameIndex;
-	uint32_t uniform_offset = frameOffset;
-	uint32_t scene_offset = uniform_offset + padUniformBufferSize(sizeof(GPUCameraData));
-	std::array<uint32_t, 2> offsets{ uniform_offset , scene_offset };
-
 	vkCmdFillBuffer(cmd, getCurrentFrame().activeLightBuffer._buffer, 0, 4, 0);
 
 	auto transferBarrier = vkinit::bufferBarrier(getCurrentFrame().activeLightBuffer._buffer, _graphicsQueueFamily, VK_ACCESS_TRANSFER_WRITE_BIT, VK_ACCESS_SHADER_WRITE_BIT);
@@ -2909,13 +3234,8 @@ void Renderer::cullLightsPass(VkCommandBuffer cmd, std::span<PointLightObject> l
 
 	vkCmdBindPipeline(cmd, VK_PIPELINE_BIND_POINT_COMPUTE, _lightCullPipeline);
 
-	vkCmdBindDescriptorSets(cmd, VK_PIPELINE_BIND_POINT_COMPUTE, _lightCullPipelineLayout,
-		0, 1, &getCurrentFrame().globalDescriptor,
-		offsets.size(), offsets.data());
-
-	vkCmdBindDescriptorSets(cmd, VK_PIPELINE_BIND_POINT_COMPUTE, _lightCullPipelineLayout,
-		1, 1, &getCurrentFrame().objectDescriptor,
-		0, nullptr);
+	bindGlobalDescriptor(cmd, VK_PIPELINE_BIND_POINT_COMPUTE, _lightCullPipelineLayout);
+	bindObjectDescriptor(cmd, VK_PIPELINE_BIND_POINT_COMPUTE, _lightCullPipelineLayout, 1);
 
 	vkCmdBindDescriptorSets(cmd, VK_PIPELINE_BIND_POINT_COMPUTE, _lightCullPipelineLayout,
 		2, 1, &_depthPyramidSets[swapchainIndex],
@@ -2952,6 +3272,132 @@ void Renderer::cullLightsPass(VkCommandBuffer cmd, std::span<PointLightObject> l
 
 }
 
+void Renderer::scatterObjectsPass(VkCommandBuffer cmd) {
+	FrameData& frame = getCurrentFrame();
+	if (frame.objectScatterCount == 0)
+		return;
+
+	// the last frame's passes may still be reading the objects about to be overwritten
+	auto readBarrier = vkinit::bufferBarrier(_objectBuffer._buffer, _graphicsQueueFamily, VK_ACCESS_SHADER_READ_BIT, VK_ACCESS_SHADER_WRITE_BIT);
+	vkCmdPipelineBarrier(cmd, VK_PIPELINE_STAGE_VERTEX_SHADER_BIT | VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, 0, 0, nullptr, 1, &readBarrier, 0, nullptr);
+
+	vkCmdBindPipeline(cmd, VK_PIPELINE_BIND_POINT_COMPUTE, _objectScatterPipeline);
+
+	vkCmdBindDescriptorSets(cmd, VK_PIPELINE_BIND_POINT_COMPUTE, _objectScatterPipelineLayout,
+		0, 1, &frame.objectScatterDescriptor,
+		frame.objectScatterOffsets.size(), frame.objectScatterOffsets.data());
+
+	GPUObjectScatterPushConstants constants{
+		.count = frame.objectScatterCount
+	};
+
+	vkCmdPushConstants(cmd, _objectScatterPipelineLayout, VK_SHADER_STAGE_COMPUTE_BIT, 0, sizeof(GPUObjectScatterPushConstants), &constants);
+
+	vkCmdDispatch(cmd, getGroupCount(frame.objectScatterCount, 64), 1, 1);
+
+	auto writeBarrier = vkinit::bufferBarrier(_objectBuffer._buffer, _graphicsQueueFamily, VK_ACCESS_SHADER_WRITE_BIT, VK_ACCESS_SHADER_READ_BIT);
+	vkCmdPipelineBarrier(cmd, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_PIPELINE_STAGE_VERTEX_SHADER_BIT | VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, 0, 0, nullptr, 1, &writeBarrier, 0, nullptr);
+}
+
+void Renderer::cullDrawsPass(VkCommandBuffer cmd, DrawList list, glm::mat4 viewMatrix, glm::mat4 projMatrix, uint32_t swapchainIndex, float zNear, float zFar) {
+	FrameData& frame = getCurrentFrame();
+
+	uint32_t drawOffset = static_cast<uint32_t>(list) * MAX_DRAWS;
+	uint32_t countOffset = static_cast<uint32_t>(list) * MAX_DRAW_BATCHES;
+
+	// the shader counts up from zero for every batch in the list
+	vkCmdFillBuffer(cmd, frame.indirectCount._buffer, countOffset * sizeof(uint32_t), MAX_DRAW_BATCHES * sizeof(uint32_t), 0);
+
+	auto transferBarrier = vkinit::bufferBarrier(frame.indirectCount._buffer, _graphicsQueueFamily, VK_ACCESS_TRANSFER_WRITE_BIT, VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT);
+	vkCmdPipelineBarrier(cmd, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, 0, 0, nullptr, 1, &transferBarrier, 0, nullptr);
+
+	vkCmdBindPipeline(cmd, VK_PIPELINE_BIND_POINT_COMPUTE, _drawCullPipeline);
+
+	bindObjectDescriptor(cmd, VK_PIPELINE_BIND_POINT_COMPUTE, _drawCullPipelineLayout, 1);
+
+	vkCmdBindDescriptorSets(cmd, VK_PIPELINE_BIND_POINT_COMPUTE, _drawCullPipelineLayout,
+		2, 1, &_depthPyramidSets[swapchainIndex],
+		0, nullptr);
+
+	// only the main pass binds something per batch, the others draw their whole list at once
+	uint32_t flags = 0;
+	if (list != DrawList::Shadow)
+		flags |= DRAW_CULL_FRUSTUM;
+	if (list == DrawList::Main && depthPyramid && occlusionCulling)
+		flags |= DRAW_CULL_OCCLUSION;
+	if (list == DrawList::Main)
+		flags |= DRAW_CULL_PER_BATCH;
+
+	glm::mat4 projectionT = transpose(projMatrix);
+
+	// y is flipped in the projection, so its plane is taken from the bottom row to face inwards like x's
+	glm::vec4 frustumX = normalizePlane(projectionT[3] + projectionT[0]); // x + w < 0
+	glm::vec4 frustumY = normalizePlane(projectionT[3] - projectionT[1]); // -y + w < 0
+
+	GPUDrawCullPushConstants pushConstant{
+		.viewMatrix = viewMatrix,
+		.frustum = {
+			frustumX.x,
+			frustumX.z,
+			frustumY.y,
+			frustumY.z
+		},
+		.P00 = projMatrix[0][0],
+		.P11 = std::abs(projMatrix[1][1]),
+		.P22 = projMatrix[2][2],
+		.P32 = projMatrix[3][2],
+		.zNear = zNear,
+		.zFar = zFar,
+		.objectCount = _renderList.objectCount,
+		.drawOffset = drawOffset,
+		.countOffset = countOffset,
+		.flags = flags,
+		// hardcoded like in genDepthPyramid
+		.pyramidSize = { 1024.f, 512.f }
+	};
+
+	vkCmdPushConstants(cmd, _drawCullPipelineLayout, VK_SHADER_STAGE_COMPUTE_BIT,
+		0, sizeof(GPUDrawCullPushConstants), &pushConstant);
+
+	vkCmdDispatch(cmd, getGroupCount(_renderList.objectCount, 64), 1, 1);
+
+	std::array<VkBufferMemoryBarrier, 2> barriers = {
+		vkinit::bufferBarrier(frame.indirectBuffer._buffer, _graphicsQueueFamily, VK_ACCESS_SHADER_WRITE_BIT, VK_ACCESS_INDIRECT_COMMAND_READ_BIT),
+		vkinit::bufferBarrier(frame.indirectCount._buffer, _graphicsQueueFamily, VK_ACCESS_SHADER_WRITE_BIT, VK_ACCESS_INDIRECT_COMMAND_READ_BIT)
+	};
+	vkCmdPipelineBarrier(cmd, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_PIPELINE_STAGE_DRAW_INDIRECT_BIT, 0, 0, nullptr, barriers.size(), barriers.data(), 0, nullptr);
+}
+
+void Renderer::drawBatch(VkCommandBuffer cmd, DrawList list, uint32_t batch) {
+	const IndirectBatch& draw = renderListView(list)[batch];
+	if (draw.count == 0)
+		return;
+
+	VkDeviceSize indirectOffset = (static_cast<VkDeviceSize>(list) * MAX_DRAWS + draw.first) * sizeof(VkDrawIndexedIndirectCommand);
+	VkDeviceSize countOffset = (static_cast<VkDeviceSize>(list) * MAX_DRAW_BATCHES + batch) * sizeof(uint32_t);
+
+	uint32_t draw_stride = sizeof(VkDrawIndexedIndirectCommand);
+
+	vkCmdDrawIndexedIndirectCount(cmd, getCurrentFrame().indirectBuffer._buffer, indirectOffset, getCurrentFrame().indirectCount._buffer, countOffset, draw.count, draw_stride);
+}
+
+void Renderer::drawList(VkCommandBuffer cmd, DrawList list) {
+	for (uint32_t batch = 0; batch < renderListView(list).size(); batch++) {
+		drawBatch(cmd, list, batch);
+	}
+}
+
+// the batches a pass draws, the culling compacts each list's draws by them
+std::span<const IndirectBatch> Renderer::renderListView(DrawList list) const {
+	if (list == DrawList::Main)
+		return _renderList.materialBatches;
+
+	if (_renderList.allObjects.count == 0)
+		return {};
+
+	return std::span<const IndirectBatch>(&_renderList.allObjects, 1);
+}
+
 void Renderer::clusterLightsPass(VkCommandBuffer cmd, bool findClusters, glm::mat4 viewMatrix, glm::mat4 inverseMatrix, float zNear, float zFar) {
 	auto preTransferBarrier = vkinit::bufferBarrier(getCurrentFrame().lightIndicesBuffer._buffer, _graphicsQueueFamily, VK_ACCESS_SHADER_WRITE_BIT | VK_ACCESS_SHADER_READ_BIT, VK_ACCESS_TRANSFER_WRITE_BIT);
 	vkCmdPipelineBarrier(cmd, VK_PIPELINE_STAGE_VERTEX_SHADER_BIT | VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT | VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT, 0, 0, nullptr, 1, &preTransferBarrier, 0, nullptr);
@@ -2964,20 +3410,8 @@ void Renderer::clusterLightsPass(VkCommandBuffer cmd, bool findClusters, glm::ma
 
 	vkCmdBindPipeline(cmd, VK_PIPELINE_BIND_POINT_COMPUTE, _clusterPipeline);
 
-	int frameIndex = _frameNumber % FRAME_OVERLAP;
-	int frameOffset = (padUniformBufferSize(sizeof(GPUCameraData)) + padUniformBufferSize(sizeof(GPUSceneData))) * frameIndex;
-	uint32_t uniform_offset = frameOffset;
-	uint32_t scene_offset = uniform_offset + padUniformBufferSize(sizeof(GPUCameraData));
-	std::array<uint32_t, 2> offsets{ uniform_offset , scene_offset };
-
-
-	vkCmdBindDescriptorSets(cmd, VK_PIPELINE_BIND_POINT_COMPUTE, _clusterPipelineLayout,
-		0, 1, &getCurrentFrame().globalDescriptor,
-		offsets.size(), offsets.data());
-
-	vkCmdBindDescriptorSets(cmd, VK_PIPELINE_BIND_POINT_COMPUTE, _clusterPipelineLayout,
-		1, 1, &getCurrentFrame().objectDescriptor,
-		0, nullptr);
+	bindGlobalDescriptor(cmd, VK_PIPELINE_BIND_POINT_COMPUTE, _clusterPipelineLayout);
+	bindObjectDescriptor(cmd, VK_PIPELINE_BIND_POINT_COMPUTE, _clusterPipelineLayout, 1);
 
 	static bool find_clusters = true;
 
@@ -3044,52 +3478,12 @@ void Renderer::drawPrePass(VkCommandBuffer cmd, std::span<RenderObject> renderOb
 
 	vkCmdBindPipeline(cmd, VK_PIPELINE_BIND_POINT_GRAPHICS, _prePassPipeline);
 
-	frameIndex = _frameNumber % FRAME_OVERLAP;
-	int frameOffset = (padUniformBufferSize(sizeof(GPUCameraData)) + padUniformBufferSize(sizeof(GPUSceneData))) * frameIndex;
-	uint32_t uniform_offset = frameOffset;
-	uint32_t scene_offset = uniform_offset + padUniformBufferSize(sizeof(GPUCameraData));
-	std::array<uint32_t, 2> offsets{ uniform_offset , scene_offset };
-
-	vkCmdBindDescriptorSets(cmd, VK_PIPELINE_BIND_POINT_GRAPHICS, _prePassPipelineLayout, 0, 1, &getCurrentFrame().globalDescriptor, offsets.size(), offsets.data());
-
-	vkCmdBindDescriptorSets(cmd, VK_PIPELINE_BIND_POINT_GRAPHICS, _prePassPipelineLayout, 1, 1, &getCurrentFrame().objectDescriptor, 0, nullptr);
-
-	auto draws = compactDraws(renderObjects);
-
-	// TODO: generate drawCommands on the GPU
-	{
-		VkDrawIndexedIndirectCommand* drawCommands;
-		vmaMapMemory(_allocator, getCurrentFrame().indirectBuffer._allocation, (void**)&drawCommands);
-
-		for (uint32_t i = 0; i < draws.size(); i++) {
-			auto& draw = draws[i];
-			drawCommands[i] = {
-				//.vertexCount = static_cast<uint32_t>(draw.mesh->_vertices.size()),
-				.indexCount = static_cast<uint32_t>(draw.mesh->_indices.size()),
-				.instanceCount = 1,
-				.firstIndex = 0,
-				.vertexOffset = 0,
-				.firstInstance = i
-			};
-
-		}
-
-		vmaUnmapMemory(_allocator, getCurrentFrame().indirectBuffer._allocation);
-	}
-
-	for (auto& draw : draws) {
-
-		bindMesh(*draw.mesh, cmd);
-
-		VkDeviceSize indirect_offset = draw.first * sizeof(VkDrawIndexedIndirectCommand);
-		VkDeviceSize countOffset = draw.first * sizeof(uint32_t);
-
-		uint32_t draw_stride = sizeof(VkDrawIndexedIndirectCommand);
+	bindGlobalDescriptor(cmd, VK_PIPELINE_BIND_POINT_GRAPHICS, _prePassPipelineLayout);
+	bindObjectDescriptor(cmd, VK_PIPELINE_BIND_POINT_GRAPHICS, _prePassPipelineLayout, 1);
 
-		// TODO: move to using vkCmdDrawIndexedIndirectCount
-		vkCmdDrawIndexedIndirect(cmd, getCurrentFrame().indirectBuffer._buffer, indirect_offset, 1, draw_stride);
-		//vkCmdDrawIndexedIndirectCount(cmd, getCurrentFrame().indirectBuffer._buffer, indirect_offset, getCurrentFrame().indirectCount._buffer, countOffset, 1000000, draw_stride);
-	}
+	// the draws were culled and written by cullDrawsPass
+	bindGeometry(cmd);
+	drawList(cmd, DrawList::PrePass);
 
 	vkCmdEndRendering(cmd);
 }
@@ -3140,55 +3534,24 @@ void Renderer::drawShadowPass(VkCommandBuffer cmd, std::span<RenderObject> rende
 
 	vkCmdBindPipeline(cmd, VK_PIPELINE_BIND_POINT_GRAPHICS, _shadowPipeline);
 
-	vkCmdBindDescriptorSets(cmd, VK_PIPELINE_BIND_POINT_GRAPHICS, _shadowPipelineLayout, 0, 1, &getCurrentFrame().objectDescriptor, 0, nullptr);
-
-	auto draws = compactDraws(renderObjects);
-
-	// TODO: generate drawCommands on the GPU
-	{
-		VkDrawIndexedIndirectCommand* drawCommands;
-		vmaMapMemory(_allocator, getCurrentFrame().indirectBuffer._allocation, (void**)&drawCommands);
-
-		for (uint32_t i = 0; i < draws.size(); i++) {
-			auto& draw = draws[i];
-			drawCommands[i] = {
-				//.vertexCount = static_cast<uint32_t>(draw.mesh->_vertices.size()),
-				.indexCount = static_cast<uint32_t>(draw.mesh->_indices.size()),
-				.instanceCount = 1,
-				.firstIndex = 0,
-				.vertexOffset = 0,
-				.firstInstance = i
-			};
-
-		}
-
-		vmaUnmapMemory(_allocator, getCurrentFrame().indirectBuffer._allocation);
-	}
-
-	uint32_t* drawCounts;
-	vmaMapMemory(_allocator, getCurrentFrame().indirectCount._allocation, (void**)&drawCounts);
+	bindObjectDescriptor(cmd, VK_PIPELINE_BIND_POINT_GRAPHICS, _shadowPipelineLayout, 0);
 
-	for (int i = 0; i < draws.size(); i++) {
+	bindGeometry(cmd);
 
-		drawCounts[i] = draws[i].count;
-	}
-
-	vmaUnmapMemory(_allocator, getCurrentFrame().indirectCount._allocation);
-
-	drawShadow(cmd, draws, 0, 0, 0.f, 0.f, 0.5f);
+	drawShadow(cmd, 0, 0, 0.f, 0.f, 0.5f);
 	
 	for (int i = 0; i < lights.size(); i++) {
 		for (int j = 0; j < 6; j++) {
 			float tileX = (((i * 6) + j + 1) % 16) / 2.0;
 			float tileY = floor(((i * 6) + j + 1) / 16) / 2.0;
-			drawShadow(cmd, draws, 1, (i * 6) + j, tileX, tileY, 0.5f);
+			drawShadow(cmd, 1, (i * 6) + j, tileX, tileY, 0.5f);
 		}
 	}
 
 	vkCmdEndRenderPass(cmd);
 }
 
-void Renderer::drawShadow(VkCommandBuffer cmd, std::span<IndirectBatch> draws, int type, int index, float x, float y, float size) {
+void Renderer::drawShadow(VkCommandBuffer cmd, int type, int index, float x, float y, float size) {
 	
 	VkViewport viewport = {
 		.x = x * 1024.f,
@@ -3227,76 +3590,21 @@ void Renderer::drawShadow(VkCommandBuffer cmd, std::span<IndirectBatch> draws, i
 
 	vkCmdPushConstants(cmd, _shadowPipelineLayout, VK_SHADER_STAGE_VERTEX_BIT, 0, sizeof(GPUShadowPushConstants), &shadowPushConstants);
 	
-	for (auto& draw : draws) {
-
-		bindMesh(*draw.mesh, cmd);
-
-		VkDeviceSize indirect_offset = draw.first * sizeof(VkDrawIndexedIndirectCommand);
-		VkDeviceSize countOffset = draw.first * sizeof(uint32_t);
-
-		uint32_t draw_stride = sizeof(VkDrawIndexedIndirectCommand);
-
-		// TODO: move to vkCmdDrawIndexedIndirectCount
-		vkCmdDrawIndexedIndirect(cmd, getCurrentFrame().indirectBuffer._buffer, indirect_offset, 1, draw_stride);
-	}
+	drawList(cmd, DrawList::Shadow);
 }
 
 void Renderer::drawObjects(VkCommandBuffer cmd, std::span<RenderObject> renderObjects, glm::vec3 camPos, glm::vec3 camDir, GPUSceneData sceneParameters, std::span<PointLightObject> lights) {
 
-	int frameIndex = _frameNumber % FRAME_OVERLAP;
-	int frameOffset = (padUniformBufferSize(sizeof(GPUCameraData)) + padUniformBufferSize(sizeof(GPUSceneData))) * frameIndex;
+	bindGeometry(cmd);
 
-	auto draws = compactDraws(renderObjects);
-
-	// TODO: generate drawCommands on the GPU
-	{
-		VkDrawIndexedIndirectCommand* drawCommands;
-		vmaMapMemory(_allocator, getCurrentFrame().indirectBuffer._allocation, (void**)&drawCommands);
-
-		for (uint32_t i = 0; i < draws.size(); i++) {
-			auto& draw = draws[i];
-			drawCommands[i] = {
-				//.vertexCount = static_cast<uint32_t>(draw.mesh->_vertices.size()),
-				.indexCount = static_cast<uint32_t>(draw.mesh->_indices.size()),
-				.instanceCount = 1,
-				.firstIndex = 0,
-				.vertexOffset = 0,
-				.firstInstance = i
-			};
-
-		}
-
-
-
-		vmaUnmapMemory(_allocator, getCurrentFrame().indirectBuffer._allocation);
-	}
-
-	uint32_t* drawCounts;
-	vmaMapMemory(_allocator, getCurrentFrame().indirectCount._allocation, (void**)&drawCounts);
-
-	for (int i = 0; i < draws.size(); i++) {
-
-		drawCounts[i] = draws[i].count;
-	}
-
-	vmaUnmapMemory(_allocator, getCurrentFrame().indirectCount._allocation);
-
-	Material* lastMaterial = nullptr;
-
-	for (auto& draw : draws) {
-
-		if (draw.material != lastMaterial) bindMaterial(*draw.material, cmd, frameOffset);
-		bindMesh(*draw.mesh, cmd);
-
-		VkDeviceSize indirect_offset = draw.first * sizeof(VkDrawIndexedIndirectCommand);
-		VkDeviceSize countOffset = draw.first * sizeof(uint32_t);
-
-		uint32_t draw_stride = sizeof(VkDrawIndexedIndirectCommand);
-
-
-		// TODO: move to vkCmdDrawIndexedIndirectCount
-		vkCmdDrawIndexedIndirect(cmd, getCurrentFrame().indirectBuffer._buffer, indirect_offset, 1, draw_stride);
+	// a batch per material, consecutive batches never share one
+	std::span<const IndirectBatch> batches = renderListView(DrawList::Main);
+	for (uint32_t i = 0; i < batches.size(); i++) {
+		if (batches[i].count == 0)
+			continue;
 
+		bindMaterial(*batches[i].material, cmd);
+		drawBatch(cmd, DrawList::Main, i);
 	}
 }
 
@@ -3358,53 +3666,29 @@ void Renderer::drawTonemapping(VkCommandBuffer cmd, uint32_t imageIndex) {
 
 }
 
-std::vector<IndirectBatch> Renderer::compactDraws(std::span<RenderObject> objects) {
-
-	std::vector<IndirectBatch> draws;
-
-	IndirectBatch firstDraw;
-	firstDraw.mesh = objects[0].mesh;
-	firstDraw.material = objects[0].material;
-	firstDraw.first = 0;
-	firstDraw.count = 1;
-
-	draws.push_back(firstDraw);
-
-	for (int i = 1; i < objects.size(); i++) {
-		//compare the mesh and material with the end of the vector of draws
-		bool sameMesh = objects[i].mesh == draws.back().mesh;
-		bool sameMaterial = objects[i].material == draws.back().material;
+GPUObjectData Renderer::gpuObjectData(uint32_t object) {
+	uint32_t batch = _renderList.objectBatch[object];
+	// zero indices, the culling skips it
+	if (batch == RenderList::NO_BATCH)
+		return {};
 
-		if (sameMesh && sameMaterial)
-		{
-			//all matches, add count
-			draws.back().count++;
-		}
-		else
-		{
-			//add new draw
-			IndirectBatch newDraw;
-			newDraw.mesh = objects[i].mesh;
-			newDraw.material = objects[i].material;
-			newDraw.first = i;
-			newDraw.count = 1;
-
-			draws.push_back(newDraw);
-		}
-	}
-	return draws;
+	const RenderObject& renderObject = _renderables[object];
+	const Mesh& mesh = *renderObject.mesh;
+	return {
+		.modelMatrix = renderObject.transformMatrix,
+		.sphereBounds = mesh._sphereBounds,
+		.batch = batch,
+		.indexCount = static_cast<uint32_t>(mesh._indices.size()),
+		.firstIndex = mesh._firstIndex,
+		.vertexOffset = static_cast<int32_t>(mesh._vertexOffset)
+	};
 }
 
-void Renderer::bindMaterial(const Material& material, VkCommandBuffer cmd, uint32_t frameOffset) {
+void Renderer::bindMaterial(const Material& material, VkCommandBuffer cmd) {
 	vkCmdBindPipeline(cmd, VK_PIPELINE_BIND_POINT_GRAPHICS, material.pipeline);
 
-	uint32_t uniform_offset = frameOffset;
-	uint32_t scene_offset = uniform_offset + padUniformBufferSize(sizeof(GPUCameraData));
-	std::array<uint32_t, 2> offsets{ uniform_offset , scene_offset };
-
-	vkCmdBindDescriptorSets(cmd, VK_PIPELINE_BIND_POINT_GRAPHICS, material.pipelineLayout, 0, 1, &getCurrentFrame().globalDescriptor, offsets.size(), offsets.data());
-
-	vkCmdBindDescriptorSets(cmd, VK_PIPELINE_BIND_POINT_GRAPHICS, material.pipelineLayout, 1, 1, &getCurrentFrame().objectDescriptor, 0, nullptr);
+	bindGlobalDescriptor(cmd, VK_PIPELINE_BIND_POINT_GRAPHICS, material.pipelineLayout);
+	bindObjectDescriptor(cmd, VK_PIPELINE_BIND_POINT_GRAPHICS, material.pipelineLayout, 1);
 
 	if (material.textureSet != VK_NULL_HANDLE) {
 		//texture descriptor
@@ -3419,10 +3703,22 @@ void Renderer::bindMaterial(const Material& material, VkCommandBuffer cmd, uint3
 	}
 }
 
-void Renderer::bindMesh(const Mesh& mesh, VkCommandBuffer cmd) {
+// the camera and scene this frame uploaded
+void Renderer::bindGlobalDescriptor(VkCommandBuffer cmd, VkPipelineBindPoint bindPoint, VkPipelineLayout layout) {
+	const FrameData& frame = getCurrentFrame();
+	vkCmdBindDescriptorSets(cmd, bindPoint, layout, 0, 1, &frame.globalDescriptor, frame.globalOffsets.size(), frame.globalOffsets.data());
+}
+
+// objects and lights this frame uploaded, with the light culling and draw buffers
+void Renderer::bindObjectDescriptor(VkCommandBuffer cmd, VkPipelineBindPoint bindPoint, VkPipelineLayout layout, uint32_t set) {
+	const FrameData& frame = getCurrentFrame();
+	vkCmdBindDescriptorSets(cmd, bindPoint, layout, set, 1, &frame.objectDescriptor, frame.objectOffsets.size(), frame.objectOffsets.data());
+}
+
+void Renderer::bindGeometry(VkCommandBuffer cmd) {
 	VkDeviceSize offset = 0;
-	vkCmdBindVertexBuffers(cmd, 0, 1, &mesh._vertexBuffer._buffer, &offset);
-	vkCmdBindIndexBuffer(cmd, mesh._indexBuffer._buffer, 0, VK_INDEX_TYPE_UINT32);
+	vkCmdBindVertexBuffers(cmd, 0, 1, &_geometry.vertexBuffer._buffer, &offset);
+	vkCmdBindIndexBuffer(cmd, _geometry.indexBuffer._buffer, 0, VK_INDEX_TYPE_UINT32);
 }
 
 FrameData& Renderer::getCurrentFrame() {
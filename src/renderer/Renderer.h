@@ -27,12 +27,39 @@
 #include "vk_types.h"
 #include "vk_initializers.h"
 #include "gpu_structs.h"
+#include "RangeAllocator.h"
+#include "UploadArena.h"
 #include "../input/Input.h"
 #include "util/ShaderStages.h"
 
 
 constexpr unsigned int FRAME_OVERLAP = 2;
 
+// draw commands a draw list has room for, generateDraws.comp gives every object a slot
+constexpr uint32_t MAX_DRAWS = 1 << 18;
+// material batches a frame can draw
+constexpr uint32_t MAX_DRAW_BATCHES = 4096;
+
+// what the geometry pool starts with, it doubles whenever a mesh doesn't fit
+constexpr uint32_t GEOMETRY_POOL_VERTICES = 1 << 19;
+constexpr uint32_t GEOMETRY_POOL_INDICES = 1 << 21;
+
+// objects whose data a frame can send the GPU, more than that waits for the next frame
+constexpr uint32_t MAX_OBJECT_UPLOADS = 1 << 14;
+
+// lights of each kind a frame can upload
+constexpr uint32_t MAX_DIR_LIGHTS = 1000;
+constexpr uint32_t MAX_POINT_LIGHTS = 1000;
+constexpr uint32_t MAX_SPOT_LIGHTS = 1000;
+
+// The indirect buffer holds a draw list per pass, each culled differently by generateDraws.comp
+enum class DrawList : uint32_t {
+	PrePass,	// frustum culled
+	Shadow,		// everything, the lights see more than the camera does
+	Main,		// frustum and occlusion culled against the prepass' depth pyramid
+	Count
+};
+
 struct Material {
 	VkDescriptorSet textureSet{ VK_NULL_HANDLE };
 	VkDescriptorSet specularSet{ VK_NULL_HANDLE };
@@ -46,6 +73,9 @@ struct RenderObject {
 	Material* material;
 
 	glm::mat4 transformMatrix;
+
+	// changed since its data was last sent to the GPU
+	bool dirty = true;
 };
 
 struct DirLightObject {
@@ -108,21 +138,39 @@ struct FrameData {
 	VkCommandPool _commandPool;
 	VkCommandBuffer _mainCommandBuffer;
 
+	// camera, scene, lights and changed objects, written once by mapData
+	amaz::eng::UploadArena uploads;
+	// where this frame's uploads landed, the dynamic offsets of the global set and the object set's light and batch bindings
+	std::array<uint32_t, 2> globalOffsets;
+	std::array<uint32_t, 4> objectOffsets;
+
+	// scatterObjectsPass copies the changed objects into the object buffer, the offsets of their data and their indices
+	VkDescriptorSet objectScatterDescriptor;
+	std::array<uint32_t, 2> objectScatterOffsets;
+	uint32_t objectScatterCount;
+
 	VkDescriptorSet globalDescriptor;
 
-	AllocatedBuffer dirLightBuffer;
-	AllocatedBuffer pointLightBuffer;
-	AllocatedBuffer spotLightBuffer;
 	AllocatedBuffer activeLightBuffer;
 	AllocatedBuffer clustersBuffer;
 	AllocatedBuffer lightIndicesBuffer;
 
-
-	AllocatedBuffer objectBuffer;
 	VkDescriptorSet objectDescriptor;
 
 	AllocatedBuffer indirectBuffer;
 	AllocatedBuffer indirectCount;
+
+	// run once this frame's fence has signalled, frees what its commands may still read
+	DeletionQueue _frameDeletionQueue;
+};
+
+// Every mesh's vertices and indices live in one vertex and one index buffer, so a pass binds them once.
+// Meshes keep the offsets of their ranges, draws pass them as vertexOffset and firstIndex.
+struct GeometryPool {
+	AllocatedBuffer vertexBuffer;
+	AllocatedBuffer indexBuffer;
+	amaz::eng::RangeAllocator vertices;
+	amaz::eng::RangeAllocator indices;
 };
 
 struct UploadContext {
@@ -160,13 +208,30 @@ struct ShaderStageInfo {
 // 	PipelineBuilder& addShader(ShaderStageInfo shader);
 // };
 
+// objects drawn with the same material, their meshes can differ since they share the geometry buffers
 struct IndirectBatch {
-	Mesh* mesh;
 	Material* material;
 	uint32_t first;
 	uint32_t count;
 };
 
+// The scene's drawn objects counted per material. A material keeps the batch it got for its first object, so
+// registering or removing an object only changes its own batch's count and where the later batches start.
+struct RenderList {
+	// a batch per material in the order they were first used, what the opaque pass binds. Empty ones are skipped.
+	std::vector<IndirectBatch> materialBatches;
+	std::unordered_map<Material*, uint32_t> batchOfMaterial;
+	// every drawn object, the depth only and shadow passes draw them with one pipeline
+	IndirectBatch allObjects{};
+	// the batch each object id is counted in, the one its data on the GPU has. NO_BATCH for removed objects
+	// and ones that don't fit the draw lists
+	std::vector<uint32_t> objectBatch;
+	// ids the culling goes over
+	uint32_t objectCount = 0;
+
+	static constexpr uint32_t NO_BATCH = UINT32_MAX;
+};
+
 class Renderer {
 public:
 	Renderer(int width, int height);
@@ -192,6 +257,7 @@ public:
 	void initPipelines();
 	VkPipeline initComputePipeline(std::string filePath, VkPipelineLayout pipelineLayoutInfo);
 	void initComputePipelines();
+	void initGeometryPool();
 	void createPyramidSetLayout();
 	void createDepthPyramidImage();
 	void initImgui();
@@ -200,7 +266,7 @@ public:
 		VkFormat depthFormat, VkAttachmentLoadOp depthLoadOp, VkAttachmentStoreOp depthStoreOp);
 
 	void draw(glm::vec3 camDir, Input* input);
-	void mapData(std::span<RenderObject> renderObjects, glm::mat4 camView, glm::mat4 camProj, glm::mat4 inverseProj, GPUSceneData sceneParameters, std::span<PointLightObject> lights);
+	void mapData(glm::mat4 camView, glm::mat4 camProj, glm::mat4 inverseProj, GPUSceneData sceneParameters, std::span<PointLightObject> lights);
 	GPUPointLight generatePointLight(PointLightObject light, uint32_t tile);
 	glm::mat4 genCubeMapViewMatrix(uint8_t face, glm::vec3 lightPos);
 	void drawObjects(VkCommandBuffer cmd, std::span<RenderObject> renderObjects, glm::vec3 camPos, glm::vec3 camDir, GPUSceneData sceneParameters, std::span<PointLightObject> lights);
@@ -208,21 +274,32 @@ public:
 	void drawPrePass(VkCommandBuffer cmd, std::span<RenderObject> renderObjects, GPUSceneData sceneParameters, uint32_t frameIndex);
 	void genDepthPyramid(VkCommandBuffer cmd, uint32_t frameNumber);
 	void cullLightsPass(VkCommandBuffer cmd, std::span<PointLightObject> lights, glm::mat4 viewMatrix, glm::mat4 projMatrix, uint32_t swapchainIndex, float zNear, float zFar);
+	void cullDrawsPass(VkCommandBuffer cmd, DrawList list, glm::mat4 viewMatrix, glm::mat4 projMatrix, uint32_t swapchainIndex, float zNear, float zFar);
+	void drawBatch(VkCommandBuffer cmd, DrawList list, uint32_t batch);
+	void drawList(VkCommandBuffer cmd, DrawList list);
+	void scatterObjectsPass(VkCommandBuffer cmd);
 	void clusterLightsPass(VkCommandBuffer cmd, bool findCluster, glm::mat4 viewMatrix, glm::mat4 inverseMatrix, float zNear, float zFar);
 	void drawShadowPass(VkCommandBuffer cmd, std::span<RenderObject> renderObjects, GPUSceneData sceneParameters, std::span<PointLightObject> lights);
-	void drawShadow(VkCommandBuffer cmd, std::span<IndirectBatch> draws, int type, int index, float x, float y, float size);
+	void drawShadow(VkCommandBuffer cmd, int type, int index, float x, float y, float size);
 	void drawTonemapping(VkCommandBuffer cmd, uint32_t imageIndex);
 
-	void sortObjects(std::span<RenderObject> renderObjects);
-	std::vector<IndirectBatch> compactDraws(std::span<RenderObject> objects);
-	void bindMaterial(const Material& material, VkCommandBuffer cmd, uint32_t frameOffset);
-	void bindMesh(const Mesh& mesh, VkCommandBuffer cmd);
+	uint32_t materialBatch(Material* material);
+	void updateObjectBatch(uint32_t object);
+	void layoutBatches();
+	std::span<const IndirectBatch> renderListView(DrawList list) const;
+	GPUObjectData gpuObjectData(uint32_t object);
+	void bindMaterial(const Material& material, VkCommandBuffer cmd);
+	void bindGlobalDescriptor(VkCommandBuffer cmd, VkPipelineBindPoint bindPoint, VkPipelineLayout layout);
+	void bindObjectDescriptor(VkCommandBuffer cmd, VkPipelineBindPoint bindPoint, VkPipelineLayout layout, uint32_t set);
+	void bindGeometry(VkCommandBuffer cmd);
 	template <typename T>
-	void createStageAndCopyBuffer(std::span<T> data, AllocatedBuffer& bufferLocation, VkBufferUsageFlags usageFlags);
+	void stageAndCopyBuffer(std::span<T> data, AllocatedBuffer& bufferLocation, VkDeviceSize offset);
+	void growGeometryBuffer(AllocatedBuffer& buffer, amaz::eng::RangeAllocator& ranges, uint32_t needed, size_t elementSize, VkBufferUsageFlags usage);
 	FrameData& getCurrentFrame();
 
 	size_t padUniformBufferSize(size_t originalSize);
 	AllocatedBuffer createBuffer(size_t allocSize, VkBufferUsageFlags usage, VmaMemoryUsage memoryUsage);
+	amaz::eng::UploadArena createUploadArena(size_t capacity, VkBufferUsageFlags usage);
 	bool loadShaderModule(std::string filePath, VkShaderModule& outShaderModule);
 	Material& createMaterial(VkPipeline pipeline, VkPipelineLayout layout, const std::string& name);
 	void registerMaterial(std::string matTemplate, std::string name, std::optional<std::string> diffuseMap = std::nullopt, std::optional<std::string> specularMap = std::nullopt);
@@ -231,15 +308,21 @@ public:
 	void loadImage(std::string filename, std::string textureName);
 	bool loadImageFromFile(std::string file, AllocatedImage& outImage);
 	void loadMesh(std::string name, std::string filename);
+	void unloadMesh(const std::string& name);
 	void loadLight(glm::vec3 pos, glm::vec3 color, float radius);
 	std::vector<Vertex> createCuboid(float x, float y, float z);
 	std::vector<Vertex> createCube();
 	std::vector<Vertex> createSquare(glm::vec3 topLeft, glm::vec3 topRight, glm::vec3 bottomLeft, glm::vec3 bottomRight, glm::vec3 normal, glm::vec3 color = { 1.f, 1.f, 1.f });
 	void uploadMesh(Mesh& mesh);
 	void immediateSubmit(std::function<void(VkCommandBuffer cmd)>&& function);
-	void registerRenderObject(std::string mesh, std::string material, glm::mat4 transform);
-	void registerRenderObject(std::string mesh, std::string material, glm::vec3 position);
-	void registerRenderObject(std::string mesh, std::string material, glm::vec3 position, float scale, glm::vec3 rotation);
+	uint32_t registerRenderObject(std::string mesh, std::string material, glm::mat4 transform);
+	uint32_t registerRenderObject(std::string mesh, std::string material, glm::vec3 position);
+	uint32_t registerRenderObject(std::string mesh, std::string material, glm::vec3 position, float scale, glm::vec3 rotation);
+	// only objects moved through here are sent to the GPU again
+	void setRenderObjectTransform(uint32_t object, glm::mat4 transform);
+	// the id is handed to the next object registered
+	void removeRenderObject(uint32_t object);
+	void markObjectDirty(uint32_t object);
 	void allocateTexture(VkImageView imageView, VkDescriptorPool descPool, VkDescriptorSetLayout* setLayout, VkDescriptorSet* textureSet);
 	Material* getMaterial(const std::string& name);
 	Mesh* getMesh(const std::string& name);
@@ -361,6 +444,12 @@ private:
 	VkPipeline _clusterPipeline;
 	VkPipelineLayout _clusterPipelineLayout;
 
+	VkPipeline _drawCullPipeline;
+	VkPipelineLayout _drawCullPipelineLayout;
+
+	VkPipeline _objectScatterPipeline;
+	VkPipelineLayout _objectScatterPipelineLayout;
+
 	VkDescriptorSetLayout _shadowPassSetLayout;
 	std::vector<VkDescriptorSet> _shadowPassDescriptorSets;
 
@@ -376,12 +465,11 @@ private:
 	AllocatedImage _pointLightShadowImage;
 	VkImageView _pointLightShadowImageView;
 
-	AllocatedBuffer _sceneParameterBuffer;
-
 	AllocatedBuffer _lightBuffer;
 
 	VkDescriptorSetLayout _globalSetLayout;
 	VkDescriptorSetLayout _objectSetLayout;
+	VkDescriptorSetLayout _objectScatterSetLayout;
 	VkDescriptorPool _descriptorPool;
 
 	VkDescriptorSetLayout _singleTextureSetLayout;
@@ -389,9 +477,17 @@ private:
 
 	std::unordered_map<std::string, Material> _materials;
 	std::unordered_map<std::string, Mesh> _meshes;
+	GeometryPool _geometry;
 	std::unordered_map<std::string, Texture> _loadedTextures;
 
+	// indexed by object id, removed objects have no mesh or material
 	std::vector<RenderObject> _renderables;
+	std::vector<uint32_t> _freeObjects;
+	RenderList _renderList;
+	// every object's GPUObjectData, device local and only written where objects changed
+	AllocatedBuffer _objectBuffer;
+	// objects registered, moved or removed since they were last uploaded, an object is only in here once
+	std::vector<uint32_t> _dirtyObjects;
 	std::vector<DirLightObject> _dirLights;
 	std::vector<PointLightObject> _pointLights;
 	std::vector<SpotLightObject> _spotLights;
@@ -0,0 +1,23 @@
+#include "UploadArena.h"
+
+#include <iostream>
+
+namespace amaz::eng {
+
+	UploadArena::UploadArena(AllocatedBuffer buffer, void* mapped, size_t capacity)
+		: _buffer(buffer), _mapped(static_cast<std::byte*>(mapped)), _capacity(capacity) {
+	}
+
+	std::optional<size_t> UploadArena::allocateBytes(size_t size, size_t alignment) {
+		// device alignments are powers of two
+		size_t offset = (_head + alignment - 1) & ~(alignment - 1);
+		if (_mapped == nullptr || offset + size > _capacity) {
+			std::cout << "UploadArena out of space, " << size << " bytes asked for with " << _capacity - _head << " left\n";
+			return std::nullopt;
+		}
+
+		_head = offset + size;
+		return offset;
+	}
+
+}
@@ -0,0 +1,75 @@
+#pragma once
+
+#include "vk_types.h"
+#include <stdint.h>
+#include <cstddef>
+#include <algorithm>
+#include <optional>
+#include <span>
+
+namespace amaz::eng {
+
+	// A range of an upload arena, written through data and bound at offset
+	template <typename T>
+	struct UploadAllocation {
+		std::span<T> data;
+		uint32_t offset = 0;
+	};
+
+	// A frame's CPU_TO_GPU buffer, mapped once when it's created. Everything the CPU hands the GPU in a frame is bump
+	// allocated from it and written straight into the mapping, descriptors bind it with dynamic offsets.
+	// Only reset once the frame's fence has signalled, the GPU reads it until then.
+	class UploadArena {
+	public:
+		UploadArena() = default;
+		UploadArena(AllocatedBuffer buffer, void* mapped, size_t capacity);
+
+		void reset() {
+			_head = 0;
+		}
+
+		// count elements at a multiple of alignment, empty when the arena is full
+		template <typename T>
+		UploadAllocation<T> allocate(size_t count, size_t alignment) {
+			std::optional<size_t> offset = allocateBytes(count * sizeof(T), std::max(alignment, alignof(T)));
+			if (!offset)
+				return {};
+
+			return { std::span<T>(reinterpret_cast<T*>(_mapped + *offset), count), static_cast<uint32_t>(*offset) };
+		}
+
+		// a uint count followed by the array at COUNT_HEADER bytes, how the shaders read light lists. offset points at the count.
+		template <typename T>
+		UploadAllocation<T> allocateCounted(size_t count, size_t alignment) {
+			std::optional<size_t> offset = allocateBytes(COUNT_HEADER + count * sizeof(T), std::max(alignment, alignof(T)));
+			if (!offset)
+				return {};
+
+			*reinterpret_cast<uint32_t*>(_mapped + *offset) = static_cast<uint32_t>(count);
+			return { std::span<T>(reinterpret_cast<T*>(_mapped + *offset + COUNT_HEADER), count), static_cast<uint32_t>(*offset) };
+		}
+
+		const AllocatedBuffer& buffer() const {
+			return _buffer;
+		}
+
+		size_t capacity() const {
+			return _capacity;
+		}
+
+		size_t used() const {
+			return _head;
+		}
+
+		static constexpr size_t COUNT_HEADER = 16;
+
+	private:
+		std::optional<size_t> allocateBytes(size_t size, size_t alignment);
+
+		AllocatedBuffer _buffer{};
+		std::byte* _mapped = nullptr;
+		size_t _capacity = 0;
+		size_t _head = 0;
+	};
+
+}
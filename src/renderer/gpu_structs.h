@@ -31,6 +31,11 @@ struct GPUSceneData {
 
 struct GPUObjectData {
 	alignas(16) glm::mat4 modelMatrix;
+	alignas(16) glm::vec4 sphereBounds; // mesh space center in xyz, radius in w
+	alignas(4) uint32_t batch; // its material's batch, fixed while the object lives. Where the batch's draws start is in a per frame table
+	alignas(4) uint32_t indexCount;
+	alignas(4) uint32_t firstIndex;
+	alignas(4) int32_t vertexOffset;
 };
 
 struct GPUShadowMapData {
@@ -93,6 +98,32 @@ struct GPULightCullPushConstants {
 	alignas(4) float zFar;
 };
 
+// bits of GPUDrawCullPushConstants::flags
+constexpr uint32_t DRAW_CULL_FRUSTUM = 1 << 0;
+constexpr uint32_t DRAW_CULL_OCCLUSION = 1 << 1;
+// compacts the draws per batch instead of into one list, for passes that bind a material per batch
+constexpr uint32_t DRAW_CULL_PER_BATCH = 1 << 2;
+
+struct GPUDrawCullPushConstants {
+	alignas(64) glm::mat4 viewMatrix;
+	alignas(4) float frustum[4];
+	alignas(4) float P00;
+	alignas(4) float P11;
+	alignas(4) float P22;
+	alignas(4) float P32;
+	alignas(4) float zNear;
+	alignas(4) float zFar;
+	alignas(4) uint32_t objectCount;
+	alignas(4) uint32_t drawOffset; // where the draw list starts in the indirect buffer
+	alignas(4) uint32_t countOffset; // where its batch counts start in the count buffer
+	alignas(4) uint32_t flags; // DRAW_CULL_ bits
+	alignas(8) glm::vec2 pyramidSize;
+};
+
+struct GPUObjectScatterPushConstants {
+	alignas(4) uint32_t count;
+};
+
 struct GPUDepthReducePushConstants {
 	alignas(4) uint32_t index;
 	alignas(8) glm::vec2 imageSize;
@@ -4,6 +4,7 @@
 
 #include <glm/vec3.hpp>
 #include <glm/vec2.hpp>
+#include <glm/vec4.hpp>
 #include "vk_types.h"
 
 struct VertexInputDescription {
@@ -29,8 +30,12 @@ struct Mesh {
     std::vector<Vertex> _vertices;
 	std::vector<uint32_t> _indices;
 
-    AllocatedBuffer _vertexBuffer;
-	AllocatedBuffer _indexBuffer;
+	// where uploadMesh put the mesh in the renderer's geometry pool, counted in vertices and indices
+	uint32_t _vertexOffset = 0;
+	uint32_t _firstIndex = 0;
+
+	// mesh space center in xyz and radius in w, set by uploadMesh
+	glm::vec4 _sphereBounds{ 0.f };
 
     bool load_from_obj(std::string filename);
 	bool load_from_gltf(std::string filename);
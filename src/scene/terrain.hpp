@@ -0,0 +1,35 @@
+#pragma once
+
+#include <iostream>
+#include <string>
+#include <utility>
+#include <glm/glm.hpp>
+#include <nlohmann/json.hpp>
+#include "../physics/Physics.h"
+
+namespace amaz {
+
+	// A scene's "terrain" entry, a 16 bit raw heightmap collided with as a heightfield. False when the entry is missing
+	// a field it needs, a heightmap that fails to load is reported by loadRaw and leaves the scene without terrain.
+	inline bool loadTerrain(const nlohmann::json& terrain, const std::string& assetsPath, Physics& physics) {
+		if (!terrain.contains("heightmap") || !terrain.contains("width") || !terrain.contains("depth")) {
+			std::cout << "Scene terrain needs a heightmap, width and depth\n";
+			return false;
+		}
+
+		glm::vec3 offset = { 0.f, 0.f, 0.f };
+		if (terrain.contains("offset")) {
+			const nlohmann::json& o = terrain["offset"];
+			offset = { o[0].get<float>(), o[1].get<float>(), o[2].get<float>() };
+		}
+		float cellSize = terrain.contains("cellSize") ? terrain["cellSize"].get<float>() : 1.f;
+		float heightScale = terrain.contains("heightScale") ? terrain["heightScale"].get<float>() : 1.f / 256.f;
+
+		Heightfield heightfield;
+		if (heightfield.loadRaw(assetsPath + terrain["heightmap"].get<std::string>(), terrain["width"].get<uint32_t>(), terrain["depth"].get<uint32_t>(),
+			cellSize, heightScale, offset)) {
+			physics.setHeightfield(std::move(heightfield));
+		}
+		return true;
+	}
+}
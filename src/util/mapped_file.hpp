@@ -0,0 +1,128 @@
+#pragma once
+
+#include <string>
+#include <span>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+
+#if defined(_WIN32)
+#define WIN32_LEAN_AND_MEAN
+#define NOMINMAX
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+// Read only memory mapping of a whole file, pages are only read from disk when they're touched.
+// Also has the hashing used to key cooked files by the contents of their source.
+namespace amaz::util {
+
+	class MappedFile {
+	public:
+		MappedFile() = default;
+		MappedFile(const MappedFile&) = delete;
+		MappedFile& operator=(const MappedFile&) = delete;
+
+		~MappedFile() {
+			close();
+		}
+
+		// false if the file doesn't exist, is empty or can't be mapped
+		bool open(const std::string& path) {
+			close();
+#if defined(_WIN32)
+			_file = CreateFileA(path.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr);
+			if (_file == INVALID_HANDLE_VALUE) return false;
+
+			LARGE_INTEGER size;
+			if (!GetFileSizeEx(_file, &size) || size.QuadPart == 0) {
+				close();
+				return false;
+			}
+			_mapping = CreateFileMappingA(_file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+			if (!_mapping) {
+				close();
+				return false;
+			}
+			_data = static_cast<const std::byte*>(MapViewOfFile(_mapping, FILE_MAP_READ, 0, 0, 0));
+			_size = static_cast<size_t>(size.QuadPart);
+#else
+			int fd = ::open(path.c_str(), O_RDONLY);
+			if (fd < 0) return false;
+
+			struct stat info;
+			if (fstat(fd, &info) != 0 || info.st_size == 0) {
+				::close(fd);
+				return false;
+			}
+			void* data = mmap(nullptr, static_cast<size_t>(info.st_size), PROT_READ, MAP_PRIVATE, fd, 0);
+			// the mapping keeps the file alive by itself
+			::close(fd);
+			if (data == MAP_FAILED) return false;
+
+			_data = static_cast<const std::byte*>(data);
+			_size = static_cast<size_t>(info.st_size);
+#endif
+			if (!_data) {
+				close();
+				return false;
+			}
+			return true;
+		}
+
+		void close() {
+#if defined(_WIN32)
+			if (_data) UnmapViewOfFile(_data);
+			if (_mapping) CloseHandle(_mapping);
+			if (_file != INVALID_HANDLE_VALUE) CloseHandle(_file);
+			_mapping = nullptr;
+			_file = INVALID_HANDLE_VALUE;
+#else
+			if (_data) munmap(const_cast<std::byte*>(_data), _size);
+#endif
+			_data = nullptr;
+			_size = 0;
+		}
+
+		std::span<const std::byte> bytes() const {
+			return { _data, _size };
+		}
+
+		bool isOpen() const {
+			return _data != nullptr;
+		}
+
+	private:
+		const std::byte* _data = nullptr;
+		size_t _size = 0;
+#if defined(_WIN32)
+		HANDLE _file = INVALID_HANDLE_VALUE;
+		HANDLE _mapping = nullptr;
+#endif
+	};
+
+	// 64 bit FNV-1a over 8 byte words, bytes past the last full word are mixed in one at a time
+	inline uint64_t hashBytes(std::span<const std::byte> bytes, uint64_t seed = 14695981039346656037ull) {
+		constexpr uint64_t PRIME = 1099511628211ull;
+		uint64_t hash = seed;
+		size_t words = bytes.size() / 8;
+		for (size_t i = 0; i < words; i++) {
+			uint64_t word;
+			std::memcpy(&word, bytes.data() + i * 8, 8);
+			hash = (hash ^ word) * PRIME;
+		}
+		for (size_t i = words * 8; i < bytes.size(); i++) {
+			hash = (hash ^ static_cast<uint8_t>(bytes[i])) * PRIME;
+		}
+		return hash;
+	}
+
+	template <typename T>
+	uint64_t hashValue(const T& value, uint64_t seed) {
+		return hashBytes(std::as_bytes(std::span<const T>(&value, 1)), seed);
+	}
+}
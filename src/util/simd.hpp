@@ -0,0 +1,181 @@
+#pragma once
+
+#include <cstdint>
+#include <cmath>
+#include <algorithm>
+
+#if defined(__AVX__)
+#include <immintrin.h>
+#define AMAZ_SIMD_AVX 1
+#elif defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#include <emmintrin.h>
+#define AMAZ_SIMD_SSE 1
+#endif
+
+// Minimal 8 wide float type for the batched physics code. Uses one AVX register, two SSE registers
+// or a plain array depending on what the compiler targets, the kernels are written once against it.
+namespace amaz::util::simd {
+
+	constexpr int WIDTH = 8;
+
+#if defined(AMAZ_SIMD_AVX)
+
+	struct mask8 {
+		__m256 v;
+	};
+
+	struct float8 {
+		__m256 v;
+
+		float8() = default;
+		float8(__m256 v) : v(v) {}
+		float8(float f) : v(_mm256_set1_ps(f)) {}
+
+		static float8 load(const float* p) { return _mm256_loadu_ps(p); }
+		void store(float* p) const { _mm256_storeu_ps(p, v); }
+	};
+
+	inline float8 operator+(float8 a, float8 b) { return _mm256_add_ps(a.v, b.v); }
+	inline float8 operator-(float8 a, float8 b) { return _mm256_sub_ps(a.v, b.v); }
+	inline float8 operator*(float8 a, float8 b) { return _mm256_mul_ps(a.v, b.v); }
+	inline float8 operator/(float8 a, float8 b) { return _mm256_div_ps(a.v, b.v); }
+	inline float8 operator-(float8 a) { return _mm256_xor_ps(a.v, _mm256_set1_ps(-0.f)); }
+	inline float8 min(float8 a, float8 b) { return _mm256_min_ps(a.v, b.v); }
+	inline float8 max(float8 a, float8 b) { return _mm256_max_ps(a.v, b.v); }
+	inline float8 abs(float8 a) { return _mm256_andnot_ps(_mm256_set1_ps(-0.f), a.v); }
+	inline float8 sqrt(float8 a) { return _mm256_sqrt_ps(a.v); }
+
+	inline mask8 operator<(float8 a, float8 b) { return { _mm256_cmp_ps(a.v, b.v, _CMP_LT_OQ) }; }
+	inline mask8 operator<=(float8 a, float8 b) { return { _mm256_cmp_ps(a.v, b.v, _CMP_LE_OQ) }; }
+	inline mask8 operator>(float8 a, float8 b) { return { _mm256_cmp_ps(a.v, b.v, _CMP_GT_OQ) }; }
+	inline mask8 operator==(float8 a, float8 b) { return { _mm256_cmp_ps(a.v, b.v, _CMP_EQ_OQ) }; }
+	inline mask8 operator&(mask8 a, mask8 b) { return { _mm256_and_ps(a.v, b.v) }; }
+	inline mask8 operator|(mask8 a, mask8 b) { return { _mm256_or_ps(a.v, b.v) }; }
+	inline mask8 andNot(mask8 a, mask8 b) { return { _mm256_andnot_ps(b.v, a.v) }; } // a & !b
+
+	inline float8 select(mask8 m, float8 a, float8 b) { return _mm256_blendv_ps(b.v, a.v, m.v); }
+	inline uint32_t bits(mask8 m) { return static_cast<uint32_t>(_mm256_movemask_ps(m.v)); }
+
+#elif defined(AMAZ_SIMD_SSE)
+
+	struct mask8 {
+		__m128 lo, hi;
+	};
+
+	struct float8 {
+		__m128 lo, hi;
+
+		float8() = default;
+		float8(__m128 lo, __m128 hi) : lo(lo), hi(hi) {}
+		float8(float f) : lo(_mm_set1_ps(f)), hi(_mm_set1_ps(f)) {}
+
+		static float8 load(const float* p) { return { _mm_loadu_ps(p), _mm_loadu_ps(p + 4) }; }
+		void store(float* p) const { _mm_storeu_ps(p, lo); _mm_storeu_ps(p + 4, hi); }
+	};
+
+	inline float8 operator+(float8 a, float8 b) { return { _mm_add_ps(a.lo, b.lo), _mm_add_ps(a.hi, b.hi) }; }
+	inline float8 operator-(float8 a, float8 b) { return { _mm_sub_ps(a.lo, b.lo), _mm_sub_ps(a.hi, b.hi) }; }
+	inline float8 operator*(float8 a, float8 b) { return { _mm_mul_ps(a.lo, b.lo), _mm_mul_ps(a.hi, b.hi) }; }
+	inline float8 operator/(float8 a, float8 b) { return { _mm_div_ps(a.lo, b.lo), _mm_div_ps(a.hi, b.hi) }; }
+	inline float8 operator-(float8 a) { __m128 s = _mm_set1_ps(-0.f); return { _mm_xor_ps(a.lo, s), _mm_xor_ps(a.hi, s) }; }
+	inline float8 min(float8 a, float8 b) { return { _mm_min_ps(a.lo, b.lo), _mm_min_ps(a.hi, b.hi) }; }
+	inline float8 max(float8 a, float8 b) { return { _mm_max_ps(a.lo, b.lo), _mm_max_ps(a.hi, b.hi) }; }
+	inline float8 abs(float8 a) { __m128 s = _mm_set1_ps(-0.f); return { _mm_andnot_ps(s, a.lo), _mm_andnot_ps(s, a.hi) }; }
+	inline float8 sqrt(float8 a) { return { _mm_sqrt_ps(a.lo), _mm_sqrt_ps(a.hi) }; }
+
+	inline mask8 operator<(float8 a, float8 b) { return { _mm_cmplt_ps(a.lo, b.lo), _mm_cmplt_ps(a.hi, b.hi) }; }
+	inline mask8 operator<=(float8 a, float8 b) { return { _mm_cmple_ps(a.lo, b.lo), _mm_cmple_ps(a.hi, b.hi) }; }
+	inline mask8 operator>(float8 a, float8 b) { return { _mm_cmpgt_ps(a.lo, b.lo), _mm_cmpgt_ps(a.hi, b.hi) }; }
+	inline mask8 operator==(float8 a, float8 b) { return { _mm_cmpeq_ps(a.lo, b.lo), _mm_cmpeq_ps(a.hi, b.hi) }; }
+	inline mask8 operator&(mask8 a, mask8 b) { return { _mm_and_ps(a.lo, b.lo), _mm_and_ps(a.hi, b.hi) }; }
+	inline mask8 operator|(mask8 a, mask8 b) { return { _mm_or_ps(a.lo, b.lo), _mm_or_ps(a.hi, b.hi) }; }
+	inline mask8 andNot(mask8 a, mask8 b) { return { _mm_andnot_ps(b.lo, a.lo), _mm_andnot_ps(b.hi, a.hi) }; }
+
+	// SSE2 has no blendv, and/andnot/or does the same thing for full lane masks
+	inline float8 select(mask8 m, float8 a, float8 b) {
+		return {
+			_mm_or_ps(_mm_and_ps(m.lo, a.lo), _mm_andnot_ps(m.lo, b.lo)),
+			_mm_or_ps(_mm_and_ps(m.hi, a.hi), _mm_andnot_ps(m.hi, b.hi))
+		};
+	}
+	inline uint32_t bits(mask8 m) { return static_cast<uint32_t>(_mm_movemask_ps(m.lo) | (_mm_movemask_ps(m.hi) << 4)); }
+
+#else
+
+	struct mask8 {
+		bool v[WIDTH];
+	};
+
+	struct float8 {
+		float v[WIDTH];
+
+		float8() = default;
+		float8(float f) { std::fill(v, v + WIDTH, f); }
+
+		static float8 load(const float* p) { float8 r; std::copy(p, p + WIDTH, r.v); return r; }
+		void store(float* p) const { std::copy(v, v + WIDTH, p); }
+	};
+
+#define AMAZ_SIMD_LANEWISE(ret, name, expr) \
+	inline ret name(float8 a, float8 b) { ret r; for (int i = 0; i < WIDTH; i++) r.v[i] = (expr); return r; }
+
+	AMAZ_SIMD_LANEWISE(float8, operator+, a.v[i] + b.v[i])
+	AMAZ_SIMD_LANEWISE(float8, operator-, a.v[i] - b.v[i])
+	AMAZ_SIMD_LANEWISE(float8, operator*, a.v[i] * b.v[i])
+	AMAZ_SIMD_LANEWISE(float8, operator/, a.v[i] / b.v[i])
+	AMAZ_SIMD_LANEWISE(float8, min, std::min(a.v[i], b.v[i]))
+	AMAZ_SIMD_LANEWISE(float8, max, std::max(a.v[i], b.v[i]))
+	AMAZ_SIMD_LANEWISE(mask8, operator<, a.v[i] < b.v[i])
+	AMAZ_SIMD_LANEWISE(mask8, operator<=, a.v[i] <= b.v[i])
+	AMAZ_SIMD_LANEWISE(mask8, operator>, a.v[i] > b.v[i])
+	AMAZ_SIMD_LANEWISE(mask8, operator==, a.v[i] == b.v[i])
+
+#undef AMAZ_SIMD_LANEWISE
+
+	inline float8 operator-(float8 a) { for (auto& f : a.v) f = -f; return a; }
+	inline float8 abs(float8 a) { for (auto& f : a.v) f = std::abs(f); return a; }
+	inline float8 sqrt(float8 a) { for (auto& f : a.v) f = std::sqrt(f); return a; }
+
+	inline mask8 operator&(mask8 a, mask8 b) { for (int i = 0; i < WIDTH; i++) a.v[i] = a.v[i] && b.v[i]; return a; }
+	inline mask8 operator|(mask8 a, mask8 b) { for (int i = 0; i < WIDTH; i++) a.v[i] = a.v[i] || b.v[i]; return a; }
+	inline mask8 andNot(mask8 a, mask8 b) { for (int i = 0; i < WIDTH; i++) a.v[i] = a.v[i] && !b.v[i]; return a; }
+
+	inline float8 select(mask8 m, float8 a, float8 b) { for (int i = 0; i < WIDTH; i++) b.v[i] = m.v[i] ? a.v[i] : b.v[i]; return b; }
+	inline uint32_t bits(mask8 m) { uint32_t r = 0; for (int i = 0; i < WIDTH; i++) r |= uint32_t(m.v[i]) << i; return r; }
+
+#endif
+
+	inline bool any(mask8 m) { return bits(m) != 0; }
+
+	// loads base[ids[0]] ... base[ids[7]]
+	inline float8 gather(const float* base, const uint32_t* ids) {
+#if defined(__AVX2__)
+		return _mm256_i32gather_ps(base, _mm256_loadu_si256(reinterpret_cast<const __m256i*>(ids)), 4);
+#else
+		alignas(32) float lanes[WIDTH];
+		for (int i = 0; i < WIDTH; i++) {
+			lanes[i] = base[ids[i]];
+		}
+		return float8::load(lanes);
+#endif
+	}
+
+	inline float8 clamp(float8 a, float8 lo, float8 hi) { return min(max(a, lo), hi); }
+
+	// 3 component vector of lanes, one triangle vertex/normal/point per lane
+	struct vec3x8 {
+		float8 x, y, z;
+	};
+
+	inline vec3x8 operator+(const vec3x8& a, const vec3x8& b) { return { a.x + b.x, a.y + b.y, a.z + b.z }; }
+	inline vec3x8 operator-(const vec3x8& a, const vec3x8& b) { return { a.x - b.x, a.y - b.y, a.z - b.z }; }
+	inline vec3x8 operator*(const vec3x8& a, float8 s) { return { a.x * s, a.y * s, a.z * s }; }
+	inline vec3x8 operator*(const vec3x8& a, const vec3x8& b) { return { a.x * b.x, a.y * b.y, a.z * b.z }; }
+	inline float8 dot(const vec3x8& a, const vec3x8& b) { return a.x * b.x + a.y * b.y + a.z * b.z; }
+	inline vec3x8 cross(const vec3x8& a, const vec3x8& b) {
+		return { a.y * b.z - a.z * b.y, a.z * b.x - a.x * b.z, a.x * b.y - a.y * b.x };
+	}
+	inline vec3x8 select(mask8 m, const vec3x8& a, const vec3x8& b) {
+		return { select(m, a.x, b.x), select(m, a.y, b.y), select(m, a.z, b.z) };
+	}
+}
@@ -0,0 +1,219 @@
+#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+#include <algorithm>
+#include <cstddef>
+
+// Small work stealing pool for fork/join style jobs like the broadphase bakes.
+// Every worker owns a deque, it pushes and pops its own work at the back and steals from the front of
+// the others. Threads waiting on a TaskGroup run queued tasks instead of blocking, so nested groups don't deadlock.
+namespace amaz::util {
+
+	class ThreadPool {
+	public:
+		explicit ThreadPool(size_t threads = std::max(1u, std::thread::hardware_concurrency()) - 1) {
+			// the last queue takes tasks submitted from threads outside the pool
+			for (size_t i = 0; i <= threads; i++) {
+				_queues.push_back(std::make_unique<Queue>());
+			}
+			for (size_t i = 0; i < threads; i++) {
+				_workers.emplace_back([this, i]() { workerLoop(i); });
+			}
+		}
+
+		~ThreadPool() {
+			{
+				std::lock_guard lock(_sleepMutex);
+				_stop = true;
+			}
+			_wake.notify_all();
+			for (auto& worker : _workers) {
+				worker.join();
+			}
+		}
+
+		ThreadPool(const ThreadPool&) = delete;
+		ThreadPool& operator=(const ThreadPool&) = delete;
+
+		static ThreadPool& global() {
+			static ThreadPool pool;
+			return pool;
+		}
+
+		// worker threads, the thread calling TaskGroup::wait also works so up to threadCount() + 1 tasks run at once
+		size_t threadCount() const {
+			return _workers.size();
+		}
+
+		void submit(std::function<void()> task) {
+			Queue& queue = *_queues[localQueue()];
+			{
+				std::lock_guard lock(queue.mutex);
+				queue.tasks.push_back(std::move(task));
+			}
+			_pending++;
+			{
+				std::lock_guard lock(_sleepMutex);
+			}
+			_wake.notify_one();
+		}
+
+		// runs one queued task on the calling thread, returns false if there was nothing to do
+		bool runPending() {
+			std::function<void()> task;
+			if (!take(localQueue(), task)) {
+				return false;
+			}
+			task();
+			return true;
+		}
+
+	private:
+		struct Queue {
+			std::mutex mutex;
+			std::deque<std::function<void()>> tasks;
+		};
+
+		size_t localQueue() const {
+			return _currentPool == this ? _workerIndex : _queues.size() - 1;
+		}
+
+		bool take(size_t index, std::function<void()>& task) {
+			{
+				Queue& own = *_queues[index];
+				std::lock_guard lock(own.mutex);
+				if (!own.tasks.empty()) {
+					task = std::move(own.tasks.back());
+					own.tasks.pop_back();
+					_pending--;
+					return true;
+				}
+			}
+
+			for (size_t i = 1; i < _queues.size(); i++) {
+				Queue& victim = *_queues[(index + i) % _queues.size()];
+				std::lock_guard lock(victim.mutex);
+				if (!victim.tasks.empty()) {
+					task = std::move(victim.tasks.front());
+					victim.tasks.pop_front();
+					_pending--;
+					return true;
+				}
+			}
+			return false;
+		}
+
+		void workerLoop(size_t index) {
+			_currentPool = this;
+			_workerIndex = index;
+
+			std::function<void()> task;
+			while (true) {
+				if (take(index, task)) {
+					task();
+					task = nullptr;
+					continue;
+				}
+
+				std::unique_lock lock(_sleepMutex);
+				_wake.wait(lock, [&]() { return _stop || _pending > 0; });
+				if (_stop) {
+					return;
+				}
+			}
+		}
+
+		std::vector<std::unique_ptr<Queue>> _queues;
+		std::vector<std::thread> _workers;
+
+		std::atomic<ptrdiff_t> _pending = 0; // can dip below 0 while a task is taken before submit counted it
+		std::mutex _sleepMutex;
+		std::condition_variable _wake;
+		bool _stop = false;
+
+		static inline thread_local ThreadPool* _currentPool = nullptr;
+		static inline thread_local size_t _workerIndex = 0;
+	};
+
+	// A set of tasks that can be waited on together
+	class TaskGroup {
+	public:
+		explicit TaskGroup(ThreadPool& pool = ThreadPool::global()) : _pool(pool) {}
+
+		~TaskGroup() {
+			wait();
+		}
+
+		TaskGroup(const TaskGroup&) = delete;
+		TaskGroup& operator=(const TaskGroup&) = delete;
+
+		void run(std::function<void()> task) {
+			_outstanding++;
+			_pool.submit([this, task = std::move(task)]() {
+				task();
+				_outstanding--;
+			});
+		}
+
+		void wait() {
+			while (_outstanding > 0) {
+				if (!_pool.runPending()) {
+					std::this_thread::yield();
+				}
+			}
+		}
+
+	private:
+		ThreadPool& _pool;
+		std::atomic<size_t> _outstanding = 0;
+	};
+
+	// Calls f(begin, end) over [0, count) in chunks of at least grain items, chunks are spread over the pool
+	template <typename F>
+	void parallelFor(size_t count, size_t grain, F&& f, ThreadPool& pool = ThreadPool::global()) {
+		grain = std::max<size_t>(grain, 1);
+		size_t chunks = std::min(pool.threadCount() + 1, (count + grain - 1) / grain);
+		if (chunks <= 1) {
+			f(size_t(0), count);
+			return;
+		}
+
+		TaskGroup group(pool);
+		size_t chunkSize = (count + chunks - 1) / chunks;
+		for (size_t begin = chunkSize; begin < count; begin += chunkSize) {
+			group.run([&f, begin, end = std::min(count, begin + chunkSize)]() { f(begin, end); });
+		}
+		f(size_t(0), std::min(count, chunkSize));
+		group.wait();
+	}
+
+	// How many chunks parallelChunks splits count items into, for sizing state kept per chunk
+	inline size_t chunkCount(size_t count, size_t grain, ThreadPool& pool = ThreadPool::global()) {
+		grain = std::max<size_t>(grain, 1);
+		return std::min(pool.threadCount() + 1, (count + grain - 1) / grain);
+	}
+
+	// Calls f(chunk, begin, end) over [0, count) in chunkCount(count, grain) chunks. Each chunk runs exactly once,
+	// so scratch indexed by chunk is never used by two threads at a time and can be kept between calls.
+	template <typename F>
+	void parallelChunks(size_t count, size_t grain, F&& f, ThreadPool& pool = ThreadPool::global()) {
+		size_t chunks = chunkCount(count, grain, pool);
+		if (chunks == 0) {
+			return;
+		}
+
+		size_t chunkSize = (count + chunks - 1) / chunks;
+		parallelFor(chunks, 1, [&](size_t begin, size_t end) {
+			for (size_t chunk = begin; chunk < end; chunk++) {
+				f(chunk, chunk * chunkSize, std::min(count, (chunk + 1) * chunkSize));
+			}
+		}, pool);
+	}
+}